@@ -0,0 +1,35 @@
+//
+//  ASNTable.h
+//  Interconnect
+//
+//  An offline IPv4 to AS table built from a downloaded dataset, so AS details are available without any network
+//  lookup. Supported datasets are:
+//
+//  - iptoasn.com ip2asn-v4.tsv (or -u32.tsv): range start, range end, AS number, country, AS description
+//  - CAIDA routeviews pfx2as: network, prefix length, AS number
+//  - bgpdump -m output of a BGP RIB: TABLE_DUMP2|time|B|peer|peer AS|prefix|AS path|...
+//
+//  Prefix based datasets are flattened into non-overlapping ranges so the longest matching prefix wins. They carry no AS
+//  descriptions, so ranges from them have an empty one (CaptureWorker gets it from whois instead). A dataset mixing
+//  ip2asn ranges with prefixes has its ranges split into prefixes and flattened along with the rest. The ranges are
+//  compiled into a binary file next to the resolution cache which is memory-mapped on subsequent loads. Lookups index
+//  a /16 bucket table and then binary search only the ranges within that bucket.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#define kASNDatasetPathDefaultsKey @"ASNDatasetPath"
+
+@interface ASNTable : NSObject
+
+@property (nonatomic, readonly) NSUInteger rangeCount;
+
+- (instancetype)initWithDatasetAtPath:(NSString*)datasetPath;
+
+- (uint32_t)asNumberForAddress:(uint32_t)address asDescription:(const char**)asDesc;
+- (NSDictionary*)asDetailsForIPAddress:(NSString*)ipAddress;
+
+@end
@@ -0,0 +1,578 @@
+//
+//  ASNTable.m
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "ASNTable.h"
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <fcntl.h>
+#import <arpa/inet.h>
+
+#define kCompiledTableFileName      @"asn.table"
+#define kCompiledTableMagic         0x4e534149          // "IASN"
+#define kCompiledTableVersion       3                   // 3: mixed range and prefix datasets are flattened together
+#define kBucketCount                65536               // one bucket per /16
+
+/**
+ * Compiled table layout: header, bucket index (kBucketCount + 1 entries), then range starts, range ends, AS numbers
+ * and AS description offsets (rangeCount entries each) and finally the NUL terminated AS description strings.
+ *
+ * bucketIndex[b] is the number of ranges that start before the first address of /16 bucket b.
+ */
+struct asn_table_header
+{
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    rangeCount;
+    uint32_t    stringBytes;
+    int64_t     sourceModified;     // the dataset the table was compiled from, if it changes the table is recompiled
+    int64_t     sourceBytes;
+};
+
+struct asn_range
+{
+    uint32_t    start;
+    uint32_t    end;
+    uint32_t    asNumber;
+    uint32_t    asDescOffset;
+};
+
+struct asn_prefix
+{
+    uint32_t    start;
+    uint32_t    end;
+    uint8_t     length;
+    uint32_t    asNumber;
+    uint32_t    asDescOffset;       // only ip2asn ranges split into prefixes have one
+};
+
+@interface ASNTable ()
+
+@property (nonatomic) void* mapping;
+@property (nonatomic) size_t mappingBytes;
+
+@property (nonatomic) const uint32_t* bucketIndex;
+@property (nonatomic) const uint32_t* rangeStarts;
+@property (nonatomic) const uint32_t* rangeEnds;
+@property (nonatomic) const uint32_t* asNumbers;
+@property (nonatomic) const uint32_t* asDescOffsets;
+@property (nonatomic) const char* strings;
+@property (nonatomic) uint32_t stringBytes;
+
+@end
+
+@implementation ASNTable
+
+#pragma mark - Initialisation
+
+- (instancetype)initWithDatasetAtPath:(NSString*)datasetPath
+{
+    if (self = [super init])
+    {
+        _mapping = NULL;
+        _rangeCount = 0;
+
+        struct stat datasetStat;
+        if (stat([datasetPath fileSystemRepresentation], &datasetStat) < 0)
+        {
+            NSLog(@"Could not open AS dataset %@: %s", datasetPath, strerror(errno));
+            return nil;
+        }
+
+        NSURL* cacheDirectory = [[[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask] firstObject];
+        cacheDirectory = [cacheDirectory URLByAppendingPathComponent:[[NSBundle mainBundle] bundleIdentifier] ?: @"Interconnect"];
+        [[NSFileManager defaultManager] createDirectoryAtURL:cacheDirectory withIntermediateDirectories:YES attributes:nil error:nil];
+
+        NSString* compiledPath = [[cacheDirectory URLByAppendingPathComponent:kCompiledTableFileName] path];
+
+        if ( ! [self mapCompiledTableAtPath:compiledPath forDataset:&datasetStat])
+        {
+            NSLog(@"Compiling AS dataset %@", datasetPath);
+
+            NSData* compiledTable = [self compileDatasetAtPath:datasetPath datasetStat:&datasetStat];
+            if ( ! compiledTable || ! [compiledTable writeToFile:compiledPath atomically:YES] || ! [self mapCompiledTableAtPath:compiledPath forDataset:&datasetStat])
+            {
+                NSLog(@"Could not compile AS dataset %@", datasetPath);
+                return nil;
+            }
+        }
+
+        NSLog(@"Loaded AS table with %lu ranges", (unsigned long)_rangeCount);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_mapping)
+    {
+        munmap(_mapping, _mappingBytes);
+    }
+}
+
+- (BOOL)mapCompiledTableAtPath:(NSString*)compiledPath forDataset:(const struct stat*)datasetStat
+{
+    int fd = open([compiledPath fileSystemRepresentation], O_RDONLY);
+    if (fd < 0)
+    {
+        return NO;
+    }
+
+    struct stat compiledStat;
+    if (fstat(fd, &compiledStat) < 0 || compiledStat.st_size < (off_t)sizeof(struct asn_table_header))
+    {
+        close(fd);
+        return NO;
+    }
+
+    void* mapping = mmap(NULL, compiledStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        return NO;
+    }
+
+    const struct asn_table_header* header = (const struct asn_table_header*)mapping;
+    size_t expectedBytes = sizeof(struct asn_table_header) + ((kBucketCount + 1) * sizeof(uint32_t)) + (4 * (size_t)header->rangeCount * sizeof(uint32_t)) + header->stringBytes;
+
+    if (header->magic != kCompiledTableMagic || header->version != kCompiledTableVersion ||
+        header->sourceModified != (int64_t)datasetStat->st_mtime || header->sourceBytes != (int64_t)datasetStat->st_size ||
+        (size_t)compiledStat.st_size != expectedBytes || header->stringBytes == 0)
+    {
+        munmap(mapping, compiledStat.st_size);
+        return NO;
+    }
+
+    self.mapping = mapping;
+    self.mappingBytes = compiledStat.st_size;
+
+    const uint32_t* words = (const uint32_t*)((const uint8_t*)mapping + sizeof(struct asn_table_header));
+    _rangeCount = header->rangeCount;
+    self.bucketIndex = words;
+    self.rangeStarts = self.bucketIndex + kBucketCount + 1;
+    self.rangeEnds = self.rangeStarts + _rangeCount;
+    self.asNumbers = self.rangeEnds + _rangeCount;
+    self.asDescOffsets = self.asNumbers + _rangeCount;
+    self.strings = (const char*)(self.asDescOffsets + _rangeCount);
+    self.stringBytes = header->stringBytes;
+
+    return YES;
+}
+
+#pragma mark - Lookup
+
+/**
+ * Returns the AS number announcing the address (host byte order), or 0 if it is not announced. If asDesc is not NULL
+ * it is set to the AS description, which lives as long as the table.
+ */
+- (uint32_t)asNumberForAddress:(uint32_t)address asDescription:(const char**)asDesc
+{
+    if ( ! _rangeCount)
+    {
+        return 0;
+    }
+
+    // The covering range is the last one starting at or before the address, it's either in this bucket or is the
+    // last range starting before it.
+    uint32_t bucket = address >> 16;
+    uint32_t lo = _bucketIndex[bucket], hi = _bucketIndex[bucket + 1];
+
+    while (lo < hi)
+    {
+        uint32_t mid = lo + ((hi - lo) >> 1);
+
+        if (_rangeStarts[mid] <= address)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if (lo == 0 || address > _rangeEnds[lo - 1])
+    {
+        return 0;
+    }
+
+    if (asDesc)
+    {
+        *asDesc = _strings + _asDescOffsets[lo - 1];
+    }
+
+    return _asNumbers[lo - 1];
+}
+
+/**
+ * Returns AS details in the same form as BulkWhoisResolver (keys "as" and "asDesc"), or nil if the address is not announced.
+ */
+- (NSDictionary*)asDetailsForIPAddress:(NSString*)ipAddress
+{
+    struct in_addr addr;
+
+    if ( ! inet_aton([ipAddress cStringUsingEncoding:NSASCIIStringEncoding], &addr))
+    {
+        return nil;
+    }
+
+    const char* asDesc = "";
+    uint32_t asNumber = [self asNumberForAddress:ntohl(addr.s_addr) asDescription:&asDesc];
+
+    if ( ! asNumber)
+    {
+        return nil;
+    }
+
+    return @{
+        @"as": [NSString stringWithFormat:@"%u", asNumber],
+        @"asDesc": [NSString stringWithUTF8String:asDesc] ?: @""
+    };
+}
+
+#pragma mark - Compilation
+
+static BOOL ParseAddress(const char* text, uint32_t* address)
+{
+    struct in_addr addr;
+
+    if (strchr(text, '.'))
+    {
+        if ( ! inet_aton(text, &addr))
+        {
+            return NO;
+        }
+
+        *address = ntohl(addr.s_addr);
+        return YES;
+    }
+
+    // ip2asn-v4-u32.tsv carries addresses as integers
+    char* end;
+    unsigned long value = strtoul(text, &end, 10);
+    *address = (uint32_t)value;
+
+    return (end != text && value <= 0xffffffffUL);
+}
+
+static BOOL ParsePrefix(uint32_t network, long length, uint32_t asNumber, struct asn_prefix* prefix)
+{
+    if (length < 1 || length > 32 || ! asNumber)
+    {
+        return NO;
+    }
+
+    uint32_t mask = 0xffffffffU << (32 - length);
+
+    prefix->start = network & mask;
+    prefix->end = prefix->start | ~mask;
+    prefix->length = (uint8_t)length;
+    prefix->asNumber = asNumber;
+    prefix->asDescOffset = 0;
+
+    return YES;
+}
+
+/**
+ * Split a range into the fewest prefixes that cover it exactly, largest first.
+ */
+static void AppendRangeAsPrefixes(NSMutableData* prefixes, uint64_t start, uint64_t end, uint32_t asNumber, uint32_t asDescOffset)
+{
+    while (start <= end)
+    {
+        // The largest block aligned at start that doesn't run past the end of the range
+        int length = 0;
+
+        while (length < 32 && ((start & ((1ULL << (32 - length)) - 1)) || start + (1ULL << (32 - length)) - 1 > end))
+        {
+            length++;
+        }
+
+        uint64_t blockSize = 1ULL << (32 - length);
+        struct asn_prefix prefix = { (uint32_t)start, (uint32_t)(start + blockSize - 1), (uint8_t)length, asNumber, asDescOffset };
+
+        [prefixes appendBytes:&prefix length:sizeof(prefix)];
+        start += blockSize;
+    }
+}
+
+static int ComparePrefixes(const void* a, const void* b)
+{
+    const struct asn_prefix* pa = a;
+    const struct asn_prefix* pb = b;
+
+    // Covering (shorter) prefixes sort before the more specific prefixes that start at the same address
+    if (pa->start != pb->start)
+    {
+        return (pa->start < pb->start) ? -1 : 1;
+    }
+
+    return (int)pa->length - (int)pb->length;
+}
+
+static int CompareRanges(const void* a, const void* b)
+{
+    const struct asn_range* ra = a;
+    const struct asn_range* rb = b;
+
+    return (ra->start < rb->start) ? -1 : ((ra->start > rb->start) ? 1 : 0);
+}
+
+/**
+ * Append a range, merging it into the previous range if they are contiguous and belong to the same AS.
+ */
+static void AppendRange(NSMutableData* ranges, uint64_t start, uint64_t end, uint32_t asNumber, uint32_t asDescOffset)
+{
+    if (start > end)
+    {
+        return;
+    }
+
+    struct asn_range* last = [ranges length] ? ((struct asn_range*)[ranges mutableBytes]) + ([ranges length] / sizeof(struct asn_range)) - 1 : NULL;
+
+    if (last && (uint64_t)last->end + 1 == start && last->asNumber == asNumber && last->asDescOffset == asDescOffset)
+    {
+        last->end = (uint32_t)end;
+        return;
+    }
+
+    struct asn_range range = { (uint32_t)start, (uint32_t)end, asNumber, asDescOffset };
+    [ranges appendBytes:&range length:sizeof(range)];
+}
+
+/**
+ * Flatten (possibly nested) prefixes into non-overlapping ranges where every address maps to its longest match.
+ */
+static void FlattenPrefixes(struct asn_prefix* prefixes, size_t prefixCount, NSMutableData* ranges)
+{
+    struct asn_prefix* stack[33];       // a prefix can only be nested inside prefixes that are shorter than it
+    int depth = 0;
+    uint64_t cursor = 0;                // first address not yet emitted
+
+    qsort(prefixes, prefixCount, sizeof(struct asn_prefix), ComparePrefixes);
+
+    for (size_t i = 0; i <= prefixCount; i++)
+    {
+        struct asn_prefix* prefix = (i < prefixCount) ? &prefixes[i] : NULL;
+        uint64_t nextStart = prefix ? prefix->start : 0x100000000ULL;
+
+        // Emit whatever is left of the prefixes that end before the next one starts
+        while (depth && stack[depth - 1]->end < nextStart)
+        {
+            struct asn_prefix* top = stack[--depth];
+
+            if (cursor <= top->end)
+            {
+                AppendRange(ranges, cursor, top->end, top->asNumber, top->asDescOffset);
+                cursor = (uint64_t)top->end + 1;
+            }
+        }
+
+        if ( ! prefix)
+        {
+            break;
+        }
+
+        // The enclosing prefix owns the addresses up to where this more specific one starts
+        if (depth && cursor < nextStart)
+        {
+            AppendRange(ranges, cursor, nextStart - 1, stack[depth - 1]->asNumber, stack[depth - 1]->asDescOffset);
+        }
+
+        if (cursor < nextStart)
+        {
+            cursor = nextStart;
+        }
+
+        if (depth && stack[depth - 1]->start == prefix->start && stack[depth - 1]->length == prefix->length)
+        {
+            continue;       // the same prefix seen from another peer, first one wins
+        }
+
+        stack[depth++] = prefix;
+    }
+}
+
+- (NSData*)compileDatasetAtPath:(NSString*)datasetPath datasetStat:(const struct stat*)datasetStat
+{
+    FILE* dataset = fopen([datasetPath fileSystemRepresentation], "r");
+    if ( ! dataset)
+    {
+        return nil;
+    }
+
+    NSMutableData* ranges = [NSMutableData data];
+    NSMutableData* prefixes = [NSMutableData data];
+    NSMutableData* strings = [NSMutableData dataWithLength:1];     // offset 0 is the empty description
+    NSMutableDictionary* stringOffsets = [NSMutableDictionary dictionary];
+
+    char* line = NULL;
+    size_t lineCapacity = 0;
+    ssize_t lineLength;
+    NSUInteger linesSkipped = 0;
+
+    while ((lineLength = getline(&line, &lineCapacity, dataset)) > 0)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if ( ! line[0] || line[0] == '#' || strchr(line, ':'))
+        {
+            continue;       // blank, comment or IPv6
+        }
+
+        char* fields[8];
+        int fieldCount = 0;
+        char* cursor = line;
+        const char* separator = strchr(line, '|') ? "|" : "\t";
+
+        while (fieldCount < 8 && cursor)
+        {
+            fields[fieldCount++] = strsep(&cursor, separator);
+        }
+
+        uint32_t start, end;
+        struct asn_prefix prefix;
+
+        if (fieldCount >= 7 && separator[0] == '|')
+        {
+            // bgpdump -m: the origin AS is the last AS in the path, an AS_SET is reduced to its first member
+            char* slash = strchr(fields[5], '/');
+            char* origin = strrchr(fields[6], ' ');
+            origin = origin ? origin + 1 : fields[6];
+            origin += strspn(origin, "{");
+
+            if (slash)
+            {
+                *slash = '\0';
+
+                if (ParseAddress(fields[5], &start) && ParsePrefix(start, strtol(slash + 1, NULL, 10), (uint32_t)strtoul(origin, NULL, 10), &prefix))
+                {
+                    [prefixes appendBytes:&prefix length:sizeof(prefix)];
+                    continue;
+                }
+            }
+        }
+        else if (fieldCount == 3 && ! strchr(fields[1], '.'))
+        {
+            // pfx2as: multi-origin prefixes list several ASes separated by '_' or ',', use the first
+            if (ParseAddress(fields[0], &start) && ParsePrefix(start, strtol(fields[1], NULL, 10), (uint32_t)strtoul(fields[2], NULL, 10), &prefix))
+            {
+                [prefixes appendBytes:&prefix length:sizeof(prefix)];
+                continue;
+            }
+        }
+        else if (fieldCount >= 3 && ParseAddress(fields[0], &start) && ParseAddress(fields[1], &end) && start <= end)
+        {
+            // ip2asn: AS 0 marks unrouted space
+            uint32_t asNumber = (uint32_t)strtoul(fields[2], NULL, 10);
+            uint32_t asDescOffset = 0;
+
+            if ( ! asNumber)
+            {
+                continue;
+            }
+
+            if (fieldCount >= 5 && fields[4][0])
+            {
+                NSString* asDesc = [NSString stringWithUTF8String:fields[4]];
+                NSNumber* offset = asDesc ? stringOffsets[asDesc] : nil;
+
+                if (asDesc && ! offset)
+                {
+                    offset = [NSNumber numberWithUnsignedInt:(uint32_t)[strings length]];
+                    [strings appendBytes:fields[4] length:strlen(fields[4]) + 1];
+                    stringOffsets[asDesc] = offset;
+                }
+
+                asDescOffset = [offset unsignedIntValue];
+            }
+
+            struct asn_range range = { start, end, asNumber, asDescOffset };
+            [ranges appendBytes:&range length:sizeof(range)];
+            continue;
+        }
+
+        linesSkipped++;
+    }
+
+    free(line);
+    fclose(dataset);
+
+    if (linesSkipped)
+    {
+        NSLog(@"Skipped %lu unrecognised lines in AS dataset", (unsigned long)linesSkipped);
+    }
+
+    // ip2asn ranges can overlap prefixes in a dataset that mixes both kinds of line (a more specific prefix inside a
+    // range, or the other way around), so they're split into prefixes and flattened together for the longest match
+    if ([prefixes length])
+    {
+        if ([ranges length])
+        {
+            const struct asn_range* mixedRanges = [ranges bytes];
+
+            NSLog(@"AS dataset mixes ranges and prefixes, flattening them together");
+
+            for (size_t i = 0; i < [ranges length] / sizeof(struct asn_range); i++)
+            {
+                AppendRangeAsPrefixes(prefixes, mixedRanges[i].start, mixedRanges[i].end, mixedRanges[i].asNumber, mixedRanges[i].asDescOffset);
+            }
+
+            [ranges setLength:0];
+        }
+
+        FlattenPrefixes([prefixes mutableBytes], [prefixes length] / sizeof(struct asn_prefix), ranges);
+    }
+    else
+    {
+        qsort([ranges mutableBytes], [ranges length] / sizeof(struct asn_range), sizeof(struct asn_range), CompareRanges);
+    }
+
+    uint32_t rangeCount = (uint32_t)([ranges length] / sizeof(struct asn_range));
+    const struct asn_range* rangeList = [ranges bytes];
+
+    if ( ! rangeCount)
+    {
+        return nil;
+    }
+
+    struct asn_table_header header = {
+        kCompiledTableMagic,
+        kCompiledTableVersion,
+        rangeCount,
+        (uint32_t)[strings length],
+        (int64_t)datasetStat->st_mtime,
+        (int64_t)datasetStat->st_size
+    };
+
+    NSMutableData* compiledTable = [NSMutableData dataWithBytes:&header length:sizeof(header)];
+
+    uint32_t rangeIndex = 0;
+    for (uint64_t bucket = 0; bucket <= kBucketCount; bucket++)
+    {
+        while (rangeIndex < rangeCount && rangeList[rangeIndex].start < (bucket << 16))
+        {
+            rangeIndex++;
+        }
+
+        [compiledTable appendBytes:&rangeIndex length:sizeof(rangeIndex)];
+    }
+
+    // Struct of arrays so the binary search only touches range starts
+    for (uint32_t i = 0; i < rangeCount; i++) [compiledTable appendBytes:&rangeList[i].start length:sizeof(uint32_t)];
+    for (uint32_t i = 0; i < rangeCount; i++) [compiledTable appendBytes:&rangeList[i].end length:sizeof(uint32_t)];
+    for (uint32_t i = 0; i < rangeCount; i++) [compiledTable appendBytes:&rangeList[i].asNumber length:sizeof(uint32_t)];
+    for (uint32_t i = 0; i < rangeCount; i++) [compiledTable appendBytes:&rangeList[i].asDescOffset length:sizeof(uint32_t)];
+
+    [compiledTable appendData:strings];
+
+    return compiledTable;
+}
+
+@end
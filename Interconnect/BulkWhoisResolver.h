@@ -0,0 +1,29 @@
+//
+//  BulkWhoisResolver.h
+//  Interconnect
+//
+//  Resolves the AS of IPv4 addresses using the whois bulk mode ("begin" / "end") offered by Team Cymru. Requests are
+//  collected for a short period and then sent together over a single TCP connection, and concurrent requests for the
+//  same address share one lookup.
+//
+//  The whois server is supplied by the client which allows the resolver to be pointed at a local fake server.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#define kCymruWhoisServer   @"v4.whois.cymru.com"
+#define kWhoisPort          43
+
+@interface BulkWhoisResolver : NSObject
+
+@property (nonatomic) NSTimeInterval sessionTimeout;            // per read / write, not for the whole session
+
+- (instancetype)initWithWhoisServer:(NSString*)whoisServer port:(uint16_t)port;
+
+- (void)resolveASDetailsForIPAddress:(NSString*)ipAddress onCompletion:(void (^)(NSString* ipAddress, NSDictionary* asDetails, uint8_t prefixLength))completionBlock;
+- (void)cancelOutstandingResolutions;
+
+@end
@@ -0,0 +1,331 @@
+//
+//  BulkWhoisResolver.m
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "BulkWhoisResolver.h"
+#import <sys/socket.h>
+#import <sys/time.h>
+#import <netinet/in.h>
+#import <arpa/inet.h>
+#import <netdb.h>
+
+#define kBatchCollectionDelayMs     250         // how long do we wait for more requests before starting a session?
+#define kMaxAddressesPerSession     500
+#define kSessionTimeoutSeconds      30          // default sessionTimeout
+
+@interface BulkWhoisResolver ()
+
+@property (nonatomic, copy) NSString* whoisServer;
+@property (nonatomic) uint16_t port;
+
+@property (nonatomic) dispatch_queue_t sessionQueue;            // whois sessions run here, one at a time
+@property (nonatomic, strong) NSLock* lock;
+@property (nonatomic, strong) NSMutableDictionary* pendingRequests;     // IP address -> completion blocks, not yet sent
+@property (nonatomic, strong) NSMutableDictionary* sessionRequests;     // IP address -> completion blocks, in the current session
+@property (nonatomic) BOOL sessionScheduled;
+@property (nonatomic) NSUInteger generation;                    // bumped on cancellation so late session results are dropped
+
+@end
+
+@implementation BulkWhoisResolver
+
+- (instancetype)initWithWhoisServer:(NSString*)whoisServer port:(uint16_t)port
+{
+    if (self = [super init])
+    {
+        _whoisServer = [whoisServer copy];
+        _port = port;
+        _sessionTimeout = kSessionTimeoutSeconds;
+
+        _sessionQueue = dispatch_queue_create("net.oroboto.Interconnect.BulkWhoisResolver", NULL);
+        _lock = [[NSLock alloc] init];
+        _pendingRequests = [[NSMutableDictionary alloc] init];
+        _sessionRequests = [[NSMutableDictionary alloc] init];
+        _sessionScheduled = NO;
+        _generation = 0;
+    }
+
+    return self;
+}
+
+#pragma mark - Public Interface
+
+/**
+ * Queue an address for AS resolution. The completion block is called on the session queue with AS details (keys "as"
+ * and "asDesc") and the length of the announcing BGP prefix. An address the server says isn't announced gets an empty
+ * "as" and a /32 prefix, AS details are nil if the session failed and the server didn't answer for the address.
+ */
+- (void)resolveASDetailsForIPAddress:(NSString*)ipAddress onCompletion:(void (^)(NSString* ipAddress, NSDictionary* asDetails, uint8_t prefixLength))completionBlock
+{
+    [self.lock lock];
+
+    // Coalesce with a lookup for the same address that is already in a session or waiting for one
+    NSMutableArray* completionBlocks = self.sessionRequests[ipAddress] ?: self.pendingRequests[ipAddress];
+
+    if (completionBlocks)
+    {
+        [completionBlocks addObject:completionBlock];
+    }
+    else
+    {
+        self.pendingRequests[ipAddress] = [NSMutableArray arrayWithObject:completionBlock];
+    }
+
+    [self scheduleSession];
+
+    [self.lock unlock];
+}
+
+/**
+ * Drop all queued lookups without calling their completion blocks, results of a session already in progress are ignored.
+ */
+- (void)cancelOutstandingResolutions
+{
+    [self.lock lock];
+
+    [self.pendingRequests removeAllObjects];
+    [self.sessionRequests removeAllObjects];
+    self.generation++;
+
+    [self.lock unlock];
+}
+
+#pragma mark - Sessions
+
+/**
+ * Must be called with the lock held.
+ */
+- (void)scheduleSession
+{
+    if (self.sessionScheduled || ! self.pendingRequests.count)
+    {
+        return;
+    }
+
+    self.sessionScheduled = YES;
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, kBatchCollectionDelayMs * NSEC_PER_MSEC), self.sessionQueue, ^{
+        [self runSession];
+    });
+}
+
+- (void)runSession
+{
+    [self.lock lock];
+
+    NSArray* ipAddresses = [self.pendingRequests allKeys];
+    if (ipAddresses.count > kMaxAddressesPerSession)
+    {
+        ipAddresses = [ipAddresses subarrayWithRange:NSMakeRange(0, kMaxAddressesPerSession)];
+    }
+
+    for (NSString* ipAddress in ipAddresses)
+    {
+        self.sessionRequests[ipAddress] = self.pendingRequests[ipAddress];
+        [self.pendingRequests removeObjectForKey:ipAddress];
+    }
+
+    NSUInteger generation = self.generation;
+
+    [self.lock unlock];
+
+    NSDictionary* results = ipAddresses.count ? [self queryWhoisServerForIPAddresses:ipAddresses] : @{};
+
+    [self.lock lock];
+
+    NSMutableArray* completions = [NSMutableArray arrayWithCapacity:ipAddresses.count];
+
+    if (generation == self.generation)
+    {
+        for (NSString* ipAddress in ipAddresses)
+        {
+            if (self.sessionRequests[ipAddress])
+            {
+                [completions addObject:@[ipAddress, self.sessionRequests[ipAddress]]];
+                [self.sessionRequests removeObjectForKey:ipAddress];
+            }
+        }
+    }
+
+    self.sessionScheduled = NO;
+    [self scheduleSession];         // anything that arrived while we were busy
+
+    [self.lock unlock];
+
+    // Completion blocks are called without the lock held so they are free to queue more lookups
+    for (NSArray* completion in completions)
+    {
+        NSString* ipAddress = completion[0];
+        NSDictionary* result = results[ipAddress];
+
+        for (void (^completionBlock)(NSString*, NSDictionary*, uint8_t) in completion[1])
+        {
+            completionBlock(ipAddress, result[@"asDetails"], [result[@"prefixLength"] unsignedCharValue]);
+        }
+    }
+
+    NSLog(@"Whois session resolved %lu of %lu addresses", (unsigned long)results.count, (unsigned long)ipAddresses.count);
+}
+
+/**
+ * Perform one bulk whois session. Returns a dictionary of IP address -> @{@"asDetails", @"prefixLength"} for those
+ * addresses the server answered for.
+ */
+- (NSDictionary*)queryWhoisServerForIPAddresses:(NSArray*)ipAddresses
+{
+    NSMutableDictionary* results = [NSMutableDictionary dictionaryWithCapacity:ipAddresses.count];
+    int whoisSocket = -1;
+
+    @try
+    {
+        if ((whoisSocket = [self connectToWhoisServer]) < 0)
+        {
+            [NSException raise:@"" format:@"Unable to connect to whois server %@:%hu", self.whoisServer, self.port];
+        }
+
+        // "verbose" adds the BGP prefix, which lets one answer label every address in the prefix
+        NSString* request = [NSString stringWithFormat:@"begin\nverbose\n%@\nend\n", [ipAddresses componentsJoinedByString:@"\n"]];
+        NSData* sendBuf = [request dataUsingEncoding:NSASCIIStringEncoding];
+        size_t bytesWritten = 0;
+
+        while (bytesWritten < [sendBuf length])
+        {
+            ssize_t bytes = send(whoisSocket, (const uint8_t*)[sendBuf bytes] + bytesWritten, [sendBuf length] - bytesWritten, 0);
+            if (bytes <= 0)
+            {
+                [NSException raise:@"" format:@"Error writing to whois server, wrote %lu bytes: %s", bytesWritten, strerror(errno)];
+            }
+
+            bytesWritten += bytes;
+        }
+
+        // The server closes the connection once it has answered everything after "end", reads block until then
+        NSMutableData* recvBuf = [NSMutableData dataWithCapacity:64 * ipAddresses.count];
+        uint8_t recvChunkBuf[4096];
+        ssize_t bytesRead;
+
+        while ((bytesRead = recv(whoisSocket, recvChunkBuf, sizeof(recvChunkBuf), 0)) > 0)
+        {
+            [recvBuf appendBytes:recvChunkBuf length:bytesRead];
+        }
+
+        if (bytesRead < 0)
+        {
+            NSLog(@"Whois session ended with error (using %lu bytes received): %s", (unsigned long)[recvBuf length], strerror(errno));
+        }
+
+        NSString* whoisResult = [[NSString alloc] initWithData:recvBuf encoding:NSASCIIStringEncoding];
+
+        for (NSString* line in [whoisResult componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]])
+        {
+            [self parseWhoisLine:line intoResults:results];
+        }
+    }
+    @catch (NSException *e)
+    {
+        NSLog(@"AS detail resolution failed: %@", e.reason);
+    }
+    @finally
+    {
+        if (whoisSocket >= 0)
+        {
+            close(whoisSocket);
+        }
+    }
+
+    return results;
+}
+
+/**
+ * Verbose bulk output is "AS | IP | BGP Prefix | CC | Registry | Allocated | AS Name", preceded by a banner line.
+ */
+- (void)parseWhoisLine:(NSString*)line intoResults:(NSMutableDictionary*)results
+{
+    NSArray* tokens = [line componentsSeparatedByString:@"|"];
+    if (tokens.count < 7)
+    {
+        return;
+    }
+
+    NSCharacterSet* whitespace = [NSCharacterSet whitespaceCharacterSet];
+    NSString* as = [tokens[0] stringByTrimmingCharactersInSet:whitespace];
+    NSString* ipAddress = [tokens[1] stringByTrimmingCharactersInSet:whitespace];
+    NSString* bgpPrefix = [tokens[2] stringByTrimmingCharactersInSet:whitespace];
+    NSString* asDesc = [tokens[6] stringByTrimmingCharactersInSet:whitespace];
+
+    if ( ! as.length || [as isEqualToString:@"AS"])
+    {
+        return;     // the column header
+    }
+
+    // Unannounced, which is as much an answer as an AS is and is worth remembering
+    if ([as isEqualToString:@"NA"])
+    {
+        results[ipAddress] = @{
+            @"asDetails": @{ @"as": @"", @"asDesc": @"" },
+            @"prefixLength": [NSNumber numberWithUnsignedChar:32]
+        };
+
+        return;
+    }
+
+    // Fall back to caching against the address alone if the prefix is missing or malformed
+    NSInteger prefixLength = 32;
+    NSArray* prefixTokens = [bgpPrefix componentsSeparatedByString:@"/"];
+    if (prefixTokens.count == 2 && [prefixTokens[1] integerValue] > 0 && [prefixTokens[1] integerValue] <= 32)
+    {
+        prefixLength = [prefixTokens[1] integerValue];
+    }
+
+    results[ipAddress] = @{
+        @"asDetails": @{ @"as": as, @"asDesc": asDesc },
+        @"prefixLength": [NSNumber numberWithUnsignedChar:(uint8_t)prefixLength]
+    };
+}
+
+- (int)connectToWhoisServer
+{
+    struct addrinfo hints, *addresses = NULL;
+    int whoisSocket = -1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    NSString* port = [NSString stringWithFormat:@"%hu", self.port];
+    if (getaddrinfo([self.whoisServer cStringUsingEncoding:NSASCIIStringEncoding], [port cStringUsingEncoding:NSASCIIStringEncoding], &hints, &addresses) != 0)
+    {
+        NSLog(@"Could not resolve whois server %@", self.whoisServer);
+        return -1;
+    }
+
+    for (struct addrinfo* address = addresses; address && whoisSocket < 0; address = address->ai_next)
+    {
+        if ((whoisSocket = socket(address->ai_family, address->ai_socktype, address->ai_protocol)) < 0)
+        {
+            continue;
+        }
+
+        struct timeval timeout = { (time_t)self.sessionTimeout, (suseconds_t)((self.sessionTimeout - (time_t)self.sessionTimeout) * 1000000) };
+        int noSigPipe = 1;
+        setsockopt(whoisSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(whoisSocket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        setsockopt(whoisSocket, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+
+        if (connect(whoisSocket, address->ai_addr, address->ai_addrlen) < 0)
+        {
+            close(whoisSocket);
+            whoisSocket = -1;
+        }
+    }
+
+    freeaddrinfo(addresses);
+
+    return whoisSocket;
+}
+
+@end
@@ -13,9 +13,13 @@ typedef enum
     kProbeTypeICMPEcho = 0,
     kProbeTypeTraceroute,
     kProbeTypeThreadICMPEcho,
-    kProbeTypeThreadTraceroute
+    kProbeTypeThreadTraceroute,
+    kProbeTypeThreadTracerouteICMP,
+    kProbeTypeThreadTracerouteTCP
 } ProbeType;
 
+#define PROBE_TYPE_IS_THREAD_TRACEROUTE(type)   ((type) == kProbeTypeThreadTraceroute || (type) == kProbeTypeThreadTracerouteICMP || (type) == kProbeTypeThreadTracerouteTCP)
+
 @interface CaptureWorker : NSObject
 
 @property (nonatomic, readonly) ProbeType probeType;                  // how should newly discovered hosts be probed?
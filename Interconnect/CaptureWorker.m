@@ -23,12 +23,26 @@
 #import "ICMPEchoProbeThread.h"
 #import "ICMPTimeExceededProbeThread.h"
 #import "HostResolver.h"
+#import "ReverseDNSResolver.h"
+#import "ResolutionCache.h"
+#import "BulkWhoisResolver.h"
+#import "ASNTable.h"
 
 #define kLogTraffic NO
-#define kMaxConcurrentResolutionTasks   5                   // how many name resolution threads can run concurrently?
+#define kMaxConcurrentResolutionTasks   5                   // how many fallback name resolution threads can run concurrently?
 #define kRecalculateHostSizePeriodMs 10000                  // recalculate how big hosts should be (based on bytes transferred) this often
+#define kReprobePeriodMs 5000                               // queue hosts that are due to be probed again this often...
+#define kMaxReprobesPerPeriod 10                            // ...up to this many at a time (the re-probe budget, new hosts aren't counted against it)
+
+#define PROBE_FLOW_IS_SET(flows, key)   ((flows)[(key) >> 6] & (1ULL << ((key) & 63)))
+#define SET_PROBE_FLOW(flows, key)      ((flows)[(key) >> 6] |= (1ULL << ((key) & 63)))
+#define CLEAR_PROBE_FLOW(flows, key)    ((flows)[(key) >> 6] &= ~(1ULL << ((key) & 63)))
 
 @interface CaptureWorker ()
+{
+    uint64_t _probeTCPPorts[65536 / 64];            // local ports last seen sending traceroute SYNs, by bit
+    uint64_t _probeEchoIdentifiers[65536 / 64];     // echo identifiers last seen on traceroute echo requests, by bit
+}
 
 @property (nonatomic, copy) void (^stopBlock)(void);        // used to signal capture thread exit
 @property (nonatomic, strong) NSLock* startStopLock;
@@ -36,6 +50,9 @@
 @property (nonatomic) dispatch_queue_t captureQueue;        // libpcap runs here
 @property (nonatomic) NSOperationQueue* probeQueue;         // serialise probes that require it (legacy ICMP echo & traceroute)
 @property (nonatomic) NSOperationQueue* resolverQueue;      // allows multiple concurrent resolutions
+@property (nonatomic, strong) ReverseDNSResolver* nameResolver;     // pipelined host name resolution (nil if no name server is known)
+@property (nonatomic, strong) BulkWhoisResolver* asResolver;        // batched AS resolution
+@property (nonatomic, strong) ASNTable* asnTable;                   // offline AS resolution (nil unless a dataset is configured)
 
 @property (nonatomic) bpf_u_int32 interfaceAddress;         // IPv4 address of capture interface
 @property (nonatomic) bpf_u_int32 interfaceMask;            // IPv4 netmask of capture interface
@@ -43,6 +60,7 @@
 @property (nonatomic, strong) ProbeThread* probeThread;             // for threaded probes
 
 @property (nonatomic) float msSinceLastHostResize;
+@property (nonatomic) float msSinceLastReprobe;
 
 @end
 
@@ -70,6 +88,7 @@
         }
 
         _msSinceLastHostResize = 0;
+        _msSinceLastReprobe = 0;
         _probeQueue = nil;
         _probeThread = nil;
 
@@ -81,6 +100,26 @@
         // Whereas we can run multiple resolver tasks concurrently
         _resolverQueue = [[NSOperationQueue alloc] init];
         [_resolverQueue setMaxConcurrentOperationCount:kMaxConcurrentResolutionTasks];
+        
+        // Host names are resolved asynchronously on a single thread, getnameinfo() on the resolver queue is the fallback
+        NSString* nameServer = [ReverseDNSResolver systemNameServer];
+        if (nameServer && (_nameResolver = [[ReverseDNSResolver alloc] initWithNameServer:nameServer port:kDNSPort]))
+        {
+            [_nameResolver start];
+        }
+        else
+        {
+            NSLog(@"No name server available, host names will be resolved with getnameinfo()");
+        }
+        
+        _asResolver = [[BulkWhoisResolver alloc] initWithWhoisServer:kCymruWhoisServer port:kWhoisPort];
+        
+        // A local AS dataset replaces whois, other than for descriptions the dataset doesn't have
+        NSString* asnDatasetPath = [[NSUserDefaults standardUserDefaults] stringForKey:kASNDatasetPathDefaultsKey];
+        if (asnDatasetPath.length)
+        {
+            _asnTable = [[ASNTable alloc] initWithDatasetAtPath:[asnDatasetPath stringByExpandingTildeInPath]];
+        }
     }
     
     return self;
@@ -133,7 +172,19 @@
             break;
             
         case kProbeTypeThreadTraceroute:
-            self.probeThread = [[ICMPTimeExceededProbeThread alloc] init];
+            self.probeThread = [[ICMPTimeExceededProbeThread alloc] initWithMethod:kTracerouteMethodUDP];
+            self.probeThread.completeTimedOutProbes = self.completeTimedOutProbes;
+            [self.probeThread start];
+            break;
+            
+        case kProbeTypeThreadTracerouteICMP:
+            self.probeThread = [[ICMPTimeExceededProbeThread alloc] initWithMethod:kTracerouteMethodICMPEcho];
+            self.probeThread.completeTimedOutProbes = self.completeTimedOutProbes;
+            [self.probeThread start];
+            break;
+            
+        case kProbeTypeThreadTracerouteTCP:
+            self.probeThread = [[ICMPTimeExceededProbeThread alloc] initWithMethod:kTracerouteMethodTCPSYN];
             self.probeThread.completeTimedOutProbes = self.completeTimedOutProbes;
             [self.probeThread start];
             break;
@@ -268,12 +319,20 @@
 
                         gettimeofday(&timeEnd, NULL);
 
-                        self.msSinceLastHostResize += [self msElapsedBetween:&timeStart endTime:&timeEnd];
+                        float msElapsed = [self msElapsedBetween:&timeStart endTime:&timeEnd];
+                        
+                        self.msSinceLastHostResize += msElapsed;
                         if (self.msSinceLastHostResize >= kRecalculateHostSizePeriodMs)
                         {
                             [self recalculateHostSizes];
                         }
                         
+                        self.msSinceLastReprobe += msElapsed;
+                        if (self.msSinceLastReprobe >= kReprobePeriodMs)
+                        {
+                            [self reprobeHosts];
+                        }
+                        
                         [self.startStopLock lock];
                         if (self.stopBlock)
                         {
@@ -307,6 +366,8 @@
          * For our probes, we ask them to drain their probe queues before we allow ourselves to finish. That way any
          * in flight probe that is received after clearing will be ignored (the threads themselves are not stopped).
          */
+        [self.nameResolver cancelOutstandingResolutions];
+        [self.asResolver cancelOutstandingResolutions];
         [self.resolverQueue cancelAllOperations];
         while (self.resolverQueue.operationCount)
         {
@@ -316,6 +377,8 @@
 
         NSLog(@"All outstanding resolution operations have been cancelled");
         
+        [[ResolutionCache sharedCache] synchronise];
+        
         if (self.probeQueue)
         {
             [self.probeQueue cancelAllOperations];
@@ -445,6 +508,31 @@
         {
             NSLog(@"TCP  %@:%lu -> %@:%lu  %d bytes", srcHost, srcPort, dstHost, dstPort, payload_len);
         }
+        
+        /**
+         * A TCP traceroute's connections leave with the probe's TTL, real connections with the system default (which
+         * is well above it). A local port belongs to a probe from its first low TTL packet until it's seen carrying
+         * a real connection, and what comes back to it in the meantime (SYN-ACK or RST) is the probe's answer.
+         */
+        if (self.probeType == kProbeTypeThreadTracerouteTCP)
+        {
+            if (ip_hdr->ip_saddr.s_addr == _interfaceAddress)
+            {
+                if (ip_hdr->ip_ttl <= kMaxProbeTTL)
+                {
+                    SET_PROBE_FLOW(_probeTCPPorts, srcPort);
+                    trafficIsGeneratedByProbe = YES;
+                }
+                else
+                {
+                    CLEAR_PROBE_FLOW(_probeTCPPorts, srcPort);
+                }
+            }
+            else if (ip_hdr->ip_daddr.s_addr == _interfaceAddress && PROBE_FLOW_IS_SET(_probeTCPPorts, dstPort))
+            {
+                trafficIsGeneratedByProbe = YES;
+            }
+        }
     }
     else if (ip_hdr->ip_proto == IPPROTO_UDP)
     {
@@ -487,12 +575,36 @@
          * @todo: better check for ICMP type, if time exceeded or port unreachable with us as destination
          * and we are running a traceroute probe then this traffic is probe related.
          */
-        if ((self.probeType == kProbeTypeTraceroute || self.probeType == kProbeTypeThreadTraceroute)
+        if ((self.probeType == kProbeTypeTraceroute || PROBE_TYPE_IS_THREAD_TRACEROUTE(self.probeType))
             && ip_hdr->ip_daddr.s_addr == _interfaceAddress
             && (icmp_hdr->icmp_type == ICMP_TIMXCEED || icmp_hdr->icmp_type == ICMP_UNREACH_PORT))
         {
             trafficIsGeneratedByProbe = YES;
         }
+        
+        // An ICMP traceroute's echo requests are told apart by their TTL (as TCP ones are) and replies by identifier
+        if (self.probeType == kProbeTypeThreadTracerouteICMP)
+        {
+            uint16_t identifier = ntohs(icmp_hdr->icmp_hun.ih_idseq.icd_id);
+            
+            if (icmp_hdr->icmp_type == ICMP_ECHO && ip_hdr->ip_saddr.s_addr == _interfaceAddress)
+            {
+                if (ip_hdr->ip_ttl <= kMaxProbeTTL)
+                {
+                    SET_PROBE_FLOW(_probeEchoIdentifiers, identifier);
+                    trafficIsGeneratedByProbe = YES;
+                }
+                else
+                {
+                    CLEAR_PROBE_FLOW(_probeEchoIdentifiers, identifier);
+                }
+            }
+            else if (icmp_hdr->icmp_type == ICMP_ECHOREPLY && ip_hdr->ip_daddr.s_addr == _interfaceAddress &&
+                     PROBE_FLOW_IS_SET(_probeEchoIdentifiers, identifier))
+            {
+                trafficIsGeneratedByProbe = YES;
+            }
+        }
     }
     else
     {
@@ -547,8 +659,7 @@
     }
     
     // First time we've seen this host, resolve its name and send off a probe to work out what its orbital should be.
-    NSInvocationOperation* resolverOperation = [[NSInvocationOperation alloc] initWithTarget:self selector:@selector(resolveHostDetailsForAddress:) object:ipAddress];
-    [self.resolverQueue addOperation:resolverOperation];
+    [self resolveHostDetailsForAddress:ipAddress];
 
     if (self.probeType == kProbeTypeICMPEcho)
     {
@@ -591,26 +702,57 @@
         
         [self.probeQueue addOperation:probeOperation];
     }
-    else if (self.probeType == kProbeTypeThreadICMPEcho || self.probeType == kProbeTypeThreadTraceroute)
+    else if (self.probeType == kProbeTypeThreadICMPEcho || PROBE_TYPE_IS_THREAD_TRACEROUTE(self.probeType))
     {
-        /**
-         * This block will be called on the probe thread itself, which is important because only that thread
-         * can clean up (and invalidate) probe objects.
-         */
-        void (^probeFinishedBlock)(Probe*) = ^void(Probe* probe) {
-            if (self.probeType == kProbeTypeThreadTraceroute && probe.currentTTL > 0)
-            {
-                NSLog(@"Updating %@ with hop count %u from probe", probe.hostIdentifier, probe.currentTTL);
-                [[HostStore sharedStore] updateHost:probe.hostIdentifier withRTT:probe.rttToHost andHopCount:probe.currentTTL];
-            }
-            else if (self.probeType == kProbeTypeThreadICMPEcho && probe.rttToHost > 0)
-            {
-                NSLog(@"Updating %@ with RTT %.2fms from probe", probe.hostIdentifier, probe.rttToHost);
-                [[HostStore sharedStore] updateHost:probe.hostIdentifier withRTT:probe.rttToHost andHopCount:-1];
-            }
-        };
+        [self.probeThread queueProbeForHost:ipAddress port:port withPriority:YES onCompletion:[self probeFinishedBlock]];
+    }
+}
+
+/**
+ * The block called when a threaded probe finishes. It will be called on the probe thread itself, which is important
+ * because only that thread can clean up (and invalidate) probe objects.
+ */
+- (void (^)(Probe*))probeFinishedBlock
+{
+    return ^void(Probe* probe) {
+        if (PROBE_TYPE_IS_THREAD_TRACEROUTE(self.probeType) && probe.currentTTL > 0)
+        {
+            NSLog(@"Updating %@ with hop count %u from probe", probe.hostIdentifier, probe.currentTTL);
+            [[HostStore sharedStore] updateHost:probe.hostIdentifier withRTT:probe.rttToHost andHopCount:probe.currentTTL];
+        }
+        else if (self.probeType == kProbeTypeThreadICMPEcho && probe.rttSamples.count)
+        {
+            NSLog(@"Updating %@ with %lu RTT samples from probe", probe.hostIdentifier, probe.rttSamples.count);
+            [[HostStore sharedStore] updateHost:probe.hostIdentifier withRTTSamples:probe.rttSamples];
+        }
         
-        [self.probeThread queueProbeForHost:ipAddress withPriority:YES onCompletion:probeFinishedBlock];
+        [[HostStore sharedStore] probeFinishedForHost:probe.hostIdentifier];
+    };
+}
+
+/**
+ * Hosts are probed again for as long as they're around so path and latency changes show up in their grouping. Hosts
+ * that keep coming back the same are probed less and less often, and re-probes wait behind probes of new hosts.
+ */
+- (void)reprobeHosts
+{
+    self.msSinceLastReprobe = 0;
+    
+    if ( ! self.probeThread)
+    {
+        return;     // the serialised legacy probes can't keep up with this
+    }
+    
+    NSDictionary* hostsToReprobe = [[HostStore sharedStore] hostsDueForReprobe:kMaxReprobesPerPeriod];
+    
+    for (NSString* ipAddress in hostsToReprobe)
+    {
+        [self.probeThread queueReprobeForHost:ipAddress port:[hostsToReprobe[ipAddress] unsignedShortValue] onCompletion:[self probeFinishedBlock]];
+    }
+    
+    if (hostsToReprobe.count)
+    {
+        NSLog(@"Queued %lu hosts to be probed again", (unsigned long)hostsToReprobe.count);
     }
 }
 
@@ -637,21 +779,100 @@
 
 #pragma mark - Host Detail Resolution
 
+/**
+ * The resolution cache is consulted first, only results it doesn't hold are looked up on the network. AS details come
+ * from the local AS table instead if one was loaded, unless it has no description for the AS (prefix datasets don't).
+ */
 - (void)resolveHostDetailsForAddress:(NSString*)ipAddress
+{
+    ResolutionCache* cache = [ResolutionCache sharedCache];
+    NSString* cachedHostName = nil;
+    
+    if ([cache cachedHostName:&cachedHostName forIPAddress:ipAddress])
+    {
+        if (cachedHostName.length)
+        {
+            [[HostStore sharedStore] updateHost:ipAddress withName:cachedHostName];
+        }
+    }
+    else if (self.nameResolver)
+    {
+        [self.nameResolver resolveHostNameForIPAddress:ipAddress onCompletion:^(NSString* resolvedAddress, NSString* hostName) {
+            // A nil name means the name server failed, which says nothing about the address so isn't cached
+            if (hostName)
+            {
+                [[ResolutionCache sharedCache] cacheHostName:hostName forIPAddress:resolvedAddress];
+            }
+            
+            if (hostName.length)
+            {
+                [[HostStore sharedStore] updateHost:resolvedAddress withName:hostName];
+            }
+        }];
+    }
+    else
+    {
+        // Only block a resolver queue thread on getnameinfo() if the pipelined resolver isn't available
+        NSInvocationOperation* resolverOperation = [[NSInvocationOperation alloc] initWithTarget:self selector:@selector(resolveHostNameForAddress:) object:ipAddress];
+        [self.resolverQueue addOperation:resolverOperation];
+    }
+    
+    if (self.asnTable)
+    {
+        NSDictionary* asDetails = [self.asnTable asDetailsForIPAddress:ipAddress];
+        
+        if (asDetails)
+        {
+            [[HostStore sharedStore] updateHost:ipAddress withAS:asDetails[@"as"] andASDescription:asDetails[@"asDesc"]];
+        }
+        
+        if ( ! asDetails || [asDetails[@"asDesc"] length])
+        {
+            return;
+        }
+    }
+    
+    NSDictionary* cachedASDetails = [cache cachedASDetailsForIPAddress:ipAddress];
+    
+    if (cachedASDetails)
+    {
+        if ([cachedASDetails[@"as"] length])
+        {
+            [[HostStore sharedStore] updateHost:ipAddress withAS:cachedASDetails[@"as"] andASDescription:cachedASDetails[@"asDesc"]];
+        }
+    }
+    else
+    {
+        [self.asResolver resolveASDetailsForIPAddress:ipAddress onCompletion:^(NSString* resolvedAddress, NSDictionary* asDetails, uint8_t prefixLength) {
+            if (asDetails)
+            {
+                [[ResolutionCache sharedCache] cacheASDetails:asDetails forIPAddress:resolvedAddress prefixLength:prefixLength];
+            }
+            
+            if ([asDetails[@"as"] length])
+            {
+                [[HostStore sharedStore] updateHost:resolvedAddress withAS:asDetails[@"as"] andASDescription:asDetails[@"asDesc"]];
+            }
+        }];
+    }
+}
+
+- (void)resolveHostNameForAddress:(NSString*)ipAddress
 {
     HostResolver* resolver = [[HostResolver alloc] initWithIPAddress:ipAddress];
     
     NSString *resolvedName = [resolver resolveHostName];
-    if (resolvedName.length)
+    
+    // As for the pipelined resolver, a failed lookup isn't cached
+    if (resolvedName)
     {
-//      NSLog(@"Resolved [%@] to [%@]", ipAddress, resolvedName);
-        [[HostStore sharedStore] updateHost:ipAddress withName:resolvedName];        
+        [[ResolutionCache sharedCache] cacheHostName:resolvedName forIPAddress:ipAddress];
     }
     
-    NSDictionary *asDetails = [resolver resolveASDetails];
-    if (asDetails[@"as"] && asDetails[@"asDesc"])
+    if (resolvedName.length)
     {
-        [[HostStore sharedStore] updateHost:ipAddress withAS:asDetails[@"as"] andASDescription:asDetails[@"asDesc"]];
+//      NSLog(@"Resolved [%@] to [%@]", ipAddress, resolvedName);
+        [[HostStore sharedStore] updateHost:ipAddress withName:resolvedName];
     }
 }
 
@@ -8,10 +8,13 @@
 
 #import <Cocoa/Cocoa.h>
 #import "Node.h"
+#import "RTTStatistics.h"
 
 @interface Host : Node
 
 @property (nonatomic, copy) NSString* ipAddress;
+@property (nonatomic) uint32_t ipv4Address;                 // ipAddress in host byte order (parsed once for prefix grouping)
+@property (nonatomic) BOOL hasIPv4Address;                  // NO if ipAddress could not be parsed, ipv4Address is then 0
 @property (nonatomic, copy) NSString* hostname;
 @property (nonatomic, copy) NSString* autonomousSystem;
 @property (nonatomic, copy) NSString* autonomousSystemDesc;
@@ -19,7 +22,13 @@
 @property (nonatomic) NSUInteger bytesReceived;
 @property (nonatomic) NSUInteger firstPortSeen;
 @property (nonatomic) float rtt;
+@property (nonatomic, strong) RTTStatistics* rttStatistics;  // nil until the host has been pinged
 @property (nonatomic) NSUInteger hopCount;
+@property (nonatomic) NSTimeInterval lastProbed;            // when a probe of the host last finished, 0 if none has
+@property (nonatomic) NSTimeInterval probeQueued;           // when a re-probe was queued, 0 if none is outstanding
+@property (nonatomic) NSTimeInterval reprobeInterval;       // backs off while re-probes keep finding the same thing
+@property (nonatomic) NSUInteger probedHopCount;            // what the last probe found, to tell if the next one differs
+@property (nonatomic) float probedRTT;
 
 + (instancetype)createInGroup:(NSUInteger)group withIdentifier:(NSString*)identifier andVolume:(float)volume;
 
@@ -23,7 +23,13 @@
         _bytesReceived = 0;
         _firstPortSeen = 0;
         _rtt = 0;
+        _rttStatistics = nil;
         _hopCount = 0;
+        _lastProbed = 0;
+        _probeQueued = 0;
+        _reprobeInterval = 0;
+        _probedHopCount = 0;
+        _probedRTT = 0;
     }
     
     return self;
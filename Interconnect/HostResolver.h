@@ -11,7 +11,9 @@
 @interface HostResolver : NSObject
 
 - (instancetype)initWithIPAddress:(NSString*)ipAddress;
+/**
+ * An empty name if the address has none, nil if the lookup failed for some other (possibly transient) reason.
+ */
 - (NSString*)resolveHostName;
-- (NSDictionary*)resolveASDetails;
 
 @end
@@ -10,8 +10,6 @@
 #import <arpa/inet.h>
 #import <netdb.h>
 
-#define kASWhoisService @"v4.whois.cymru.com"       // Team Cymru
-
 @interface HostResolver ()
 
 @property (nonatomic, copy) NSString* ipAddress;
@@ -47,108 +45,20 @@
     saddr.sin_family = AF_INET;
     saddr.sin_len = sizeof(saddr);
     
-    if (getnameinfo((const struct sockaddr*)&saddr, saddr.sin_len, hostname, sizeof(hostname), NULL, 0, NI_NOFQDN | NI_NAMEREQD) != 0)
+    int error = getnameinfo((const struct sockaddr*)&saddr, saddr.sin_len, hostname, sizeof(hostname), NULL, 0, NI_NOFQDN | NI_NAMEREQD);
+    
+    if (error == EAI_NONAME)
     {
 //      NSLog(@"Could not resolve IP address [%@]", self.ipAddress);
         return @"";
     }
-    
-    return [NSString stringWithFormat:@"%s", hostname];
-}
-
-- (NSDictionary*)resolveASDetails
-{
-    NSMutableDictionary *asDetails = [NSMutableDictionary dictionary];
-
-    CFHostRef whoisHost = NULL;
-    CFReadStreamRef cfStreamRead = NULL;
-    CFWriteStreamRef cfStreamWrite = NULL;
-    
-    @try
-    {
-        whoisHost = CFHostCreateWithName(NULL, kASWhoisService);
-        if ( ! CFHostStartInfoResolution(whoisHost, kCFHostAddresses, NULL))
-        {
-            [NSException raise:@"" format:@"Unable to create CFHost for resolution of whois server"];
-        }
-        
-        CFStreamCreatePairWithSocketToCFHost(NULL, whoisHost, 43, &cfStreamRead, &cfStreamWrite);
-        if ( ! cfStreamRead || ! cfStreamWrite)
-        {
-            [NSException raise:@"" format:@"Unable to create stream pair for socket"];
-        }
-        
-        NSInputStream* streamIn = CFBridgingRelease(cfStreamRead);    // let ARC take ownership of CF stream, no need to release it now
-        NSOutputStream* streamOut = CFBridgingRelease(cfStreamWrite); // as above
-        
-        [streamIn open];
-        [streamOut open];
-        
-        // Perform blocking I/O, we're on our own thread.
-        NSString *request = [NSString stringWithFormat:@"%@\r\n", self.ipAddress];
-        uint8_t* sendBuf = (uint8_t*)[request cStringUsingEncoding:NSASCIIStringEncoding];
-        NSInteger bytesWritten = 0, bytesToWrite = strlen((char*)sendBuf);
-        
-        while (bytesWritten < bytesToWrite)
-        {
-            bytesWritten += [streamOut write:sendBuf+bytesWritten maxLength:bytesToWrite];
-            if ([streamOut streamStatus] == NSStreamStatusError)
-            {
-                [NSException raise:@"" format:@"Error writing to whois stream, wrote %ld bytes: %@", (long)bytesWritten, [[streamOut streamError] localizedDescription]];
-            }
-        }
-        
-        NSMutableData* recvBuf = [NSMutableData dataWithCapacity:1024];
-        uint8_t recvChunkBuf[1024];
-        NSInteger bytesRead = 0;
-        
-        while (true)
-        {
-            if ((bytesRead = [streamIn read:recvChunkBuf maxLength:sizeof(recvChunkBuf)]) > 0)
-            {
-                [recvBuf appendBytes:(const void*)recvChunkBuf length:bytesRead];
-            }
-
-            if ([streamIn streamStatus] != NSStreamStatusOpen && [streamIn streamStatus] != NSStreamStatusReading)
-            {
-                break;
-            }
-        }
-        
-        // If we read any bytes, try to interpret the output
-        if ([recvBuf length])
-        {
-            char null = 0x00;
-            [recvBuf appendBytes:&null length:1];       // null terminate it
-            NSString *whoisResult = [NSString stringWithCString:(const char*)[recvBuf bytes] encoding:NSASCIIStringEncoding];
-            NSArray* lines = [whoisResult componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]];
-            
-            // Cymru should return at least two lines, the second is the one we're interested in.
-            if (lines.count >= 2)
-            {
-                NSArray* tokens = [lines[1] componentsSeparatedByCharactersInSet:[NSCharacterSet characterSetWithCharactersInString:@"|"]];
-                if (tokens.count >= 3)
-                {
-                    asDetails[@"as"] = [tokens[0] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
-                    asDetails[@"asDesc"] = [tokens[2] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
-                }
-            }
-        }
-    }
-    @catch (NSException *e)
+    else if (error != 0)
     {
-        NSLog(@"AS detail resolution failed: %@", e.reason);
-    }
-    @finally
-    {
-        if (whoisHost)
-        {
-            CFRelease(whoisHost);
-        }
-        
+        // EAI_AGAIN, EAI_FAIL, EAI_SYSTEM and the like say nothing about the address
+        return nil;
     }
     
-    return asDetails;
+    return [NSString stringWithFormat:@"%s", hostname];
 }
 
 @end
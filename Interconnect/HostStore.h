@@ -17,13 +17,14 @@ typedef enum
     kHostStoreGroupBasedOnHopCount = 0,
     kHostStoreGroupBasedOnRTT,
     kHostStoreGroupBasedOnAS,
-    kHostStoreGroupBasedOnNetworkClass
+    kHostStoreGroupBasedOnNetworkPrefix
 } HostStoreGroupingStrategy;
 
 @interface HostStore : NodeStore
 
 @property (nonatomic) HostStoreGroupingStrategy groupingStrategy;
 @property (nonatomic) BOOL showOriginConnectorOnTrafficUpdate;      // should the origin connector be shown when a host receives/sends new traffic?
+@property (nonatomic, readonly) uint8_t networkPrefixLength;        // hosts outside site prefixes are aggregated at this length
 
 + (instancetype)sharedStore;
 
@@ -32,8 +33,13 @@ typedef enum
 - (void)updateHost:(NSString*)identifier withName:(NSString*)name;
 - (void)updateHost:(NSString*)identifier withAS:(NSString*)as andASDescription:(NSString*)asDesc;
 - (void)updateHost:(NSString*)identifier withRTT:(float)rtt andHopCount:(NSUInteger)hopCount;
+- (void)updateHost:(NSString*)identifier withRTTSamples:(NSArray*)rttSamples;
+- (void)probeFinishedForHost:(NSString*)identifier;
+- (NSDictionary*)hostsDueForReprobe:(NSUInteger)maxHosts;
 - (void)recalculateHostSizesBasedOnBytesTransferred;
 - (void)regroupHostsBasedOnStrategy:(HostStoreGroupingStrategy)strategy;
+- (void)regroupHostsBasedOnNetworkPrefixLength:(uint8_t)prefixLength;
+- (BOOL)addSitePrefix:(NSString*)cidr;
 
 - (void)resetStore;
 
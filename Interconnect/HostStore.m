@@ -9,11 +9,19 @@
 #import "HostStore.h"
 #import "Node.h"
 #import "Host.h"
+#import "PrefixTrie.h"
 
 #define kMaxVolume      0.3
 #define kMinVolume      0.05
 #define kMaxHostGroups  12
+#define kDefaultNetworkPrefixLength 16
+#define kSitePrefixesDefaultsKey    @"SitePrefixes"     // array of CIDR strings that group ahead of the aggregate prefix length
 #define kShowOriginConnectorOnTrafficUpdate YES
+#define kMinReprobeIntervalSeconds  120         // a host whose path or RTT just changed is probed again this soon...
+#define kMaxReprobeIntervalSeconds  3600        // ...and the interval doubles each time nothing changes, up to this
+#define kReprobeLostSeconds         300         // a queued re-probe that hasn't finished by now was dropped
+#define kReprobeRTTChangeFraction   0.2         // an RTT this far from the last probe's (and...
+#define kReprobeRTTChangeMs         5           // ...at least this far) counts as a change
 
 typedef enum
 {
@@ -28,6 +36,10 @@ typedef enum
 @property (nonatomic) PreferredColourMode preferredColorMode;   // how should a host's preferred colour be set?
 @property (nonatomic) NSDictionary* protocolColourMap;          // when colouring based on protocol, use these colours
 
+@property (nonatomic, strong) PrefixTrie* sitePrefixes;         // configured prefixes -> host group
+@property (nonatomic, strong) PrefixTrie* learnedPrefixes;      // aggregates at networkPrefixLength seen so far -> host group
+@property (nonatomic) NSUInteger nextPrefixGroup;               // prefixes are spread over the host groups in the order they're seen
+
 @end
 
 @implementation HostStore
@@ -87,6 +99,20 @@ typedef enum
         _groupingStrategy = kHostStoreGroupBasedOnHopCount;
         
         _showOriginConnectorOnTrafficUpdate = kShowOriginConnectorOnTrafficUpdate;
+        
+        /**
+         * Prefix grouping places hosts within a configured site prefix in that prefix's group, all other hosts are
+         * grouped by their aggregate prefix.
+         */
+        _sitePrefixes = [[PrefixTrie alloc] init];
+        _learnedPrefixes = [[PrefixTrie alloc] init];
+        _networkPrefixLength = kDefaultNetworkPrefixLength;
+        _nextPrefixGroup = 1;
+        
+        for (NSString* cidr in [[NSUserDefaults standardUserDefaults] stringArrayForKey:kSitePrefixesDefaultsKey])
+        {
+            [self addSitePrefix:cidr];
+        }
     }
     
     return self;
@@ -104,16 +130,26 @@ typedef enum
     
     if ( ! host)
     {
-        // All nodes start off in the first orbital (grouping occurs when more details are known) unless grouping by net class
+        // @dragon: assumes identifiers are always IPv4 addresses
+        uint32_t ipv4Address = 0;
+        BOOL hasIPv4Address = [PrefixTrie parseIPv4Address:identifier address:&ipv4Address];
+        if ( ! hasIPv4Address)
+        {
+            NSLog(@"Cannot determine network address for host %@", identifier);
+        }
+        
+        // All nodes start off in the first orbital (grouping occurs when more details are known) unless grouping by prefix
         NSUInteger hostGroup = 1;
-        if (self.groupingStrategy == kHostStoreGroupBasedOnNetworkClass)
+        if (self.groupingStrategy == kHostStoreGroupBasedOnNetworkPrefix && hasIPv4Address)
         {
-            hostGroup = [self hostGroupBasedOnNetworkClass:identifier];     // @dragon: assumes identifiers are always IPv4 addresses
+            hostGroup = [self hostGroupBasedOnNetworkPrefix:ipv4Address];
         }
 
         // All nodes will grow from 0.01 to their initial volume size
         host = [Host createInGroup:hostGroup withIdentifier:identifier andVolume:0.01];
         host.ipAddress = identifier;
+        host.ipv4Address = ipv4Address;
+        host.hasIPv4Address = hasIPv4Address;
         host.originConnector = 2.0;
         host.firstPortSeen = port;
         
@@ -167,6 +203,7 @@ typedef enum
     }
 
     [host setTargetVolume:volume];
+    [self noteChangeToNode:host];
     
     [self unlockStore];
     
@@ -196,6 +233,7 @@ typedef enum
         }
             
         [host setTargetVolume:volume];
+        [self noteChangeToNode:host];
     }
     
     [self unlockStore];
@@ -209,6 +247,7 @@ typedef enum
     if (host)
     {
         [host setHostname:name];
+        [self noteChange];
     }
     
     [self unlockStore];
@@ -223,6 +262,7 @@ typedef enum
     {
         [host setAutonomousSystem:as];
         [host setAutonomousSystemDesc:asDesc];
+        [self noteChange];
     }
     
     [self unlockStore];
@@ -251,6 +291,8 @@ typedef enum
         {
             host.hopCount = hopCount;
         }
+        
+        [self noteChange];
     }
     
     [self unlockStore];
@@ -269,6 +311,139 @@ typedef enum
     }
 }
 
+/**
+ * Samples are added to the host's rolling RTT statistics and the host takes their median as its RTT, so it doesn't
+ * move between RTT bands because of one slow echo.
+ */
+- (void)updateHost:(NSString*)identifier withRTTSamples:(NSArray*)rttSamples
+{
+    float median = 0;
+    
+    [self lockStore];
+    
+    Host* host = (Host*)[self node:identifier];
+    if (host)
+    {
+        if ( ! host.rttStatistics)
+        {
+            host.rttStatistics = [[RTTStatistics alloc] init];
+        }
+        
+        for (NSNumber* rtt in rttSamples)
+        {
+            [host.rttStatistics addSample:[rtt floatValue]];
+        }
+        
+        median = host.rttStatistics.median;
+        [self noteChange];
+    }
+    
+    [self unlockStore];
+    
+    if (median > 0)
+    {
+        [self updateHost:identifier withRTT:median andHopCount:-1];
+    }
+}
+
+#pragma mark - Re-probing
+
+/**
+ * Called when a probe of the host finishes, whether or not it found anything. A host whose hop count or RTT changed
+ * since its last probe is probed again soon, otherwise its re-probe interval backs off.
+ */
+- (void)probeFinishedForHost:(NSString*)identifier
+{
+    [self lockStore];
+    
+    Host* host = (Host*)[self node:identifier];
+    if (host)
+    {
+        BOOL changed = NO;
+        
+        if (host.lastProbed)
+        {
+            float rttChange = fabsf(host.rtt - host.probedRTT);
+            
+            changed = (host.hopCount != host.probedHopCount) || (rttChange > kReprobeRTTChangeMs && rttChange > host.probedRTT * kReprobeRTTChangeFraction);
+        }
+        
+        if (changed || ! host.lastProbed)
+        {
+            host.reprobeInterval = kMinReprobeIntervalSeconds;
+        }
+        else
+        {
+            host.reprobeInterval = MIN(host.reprobeInterval * 2, kMaxReprobeIntervalSeconds);
+        }
+        
+        if (changed)
+        {
+            NSLog(@"Host %@ changed since its last probe (hops: %lu -> %lu, RTT: %.2fms -> %.2fms)", identifier, host.probedHopCount, host.hopCount, host.probedRTT, host.rtt);
+        }
+        
+        host.lastProbed = [NSDate timeIntervalSinceReferenceDate];
+        host.probeQueued = 0;
+        host.probedHopCount = host.hopCount;
+        host.probedRTT = host.rtt;
+    }
+    
+    [self unlockStore];
+}
+
+/**
+ * Returns up to maxHosts hosts that are due to be probed again, the most overdue and busiest first, as their identifiers
+ * mapped to the first port each was seen on. They're marked as queued so they aren't returned again until their probe
+ * finishes (or is assumed lost). Only hosts whose first probe has finished are considered.
+ */
+- (NSDictionary*)hostsDueForReprobe:(NSUInteger)maxHosts
+{
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    NSMutableArray* dueHosts = [[NSMutableArray alloc] init];
+    
+    [self lockStore];
+    
+    NSDictionary* hosts = [self nodes];
+    
+    for (id hostIdentifier in hosts)
+    {
+        Host* host = hosts[hostIdentifier];
+        NSTimeInterval sinceProbed = now - host.lastProbed;
+        
+        if ( ! host.lastProbed || sinceProbed < host.reprobeInterval || (host.probeQueued && now - host.probeQueued < kReprobeLostSeconds))
+        {
+            continue;
+        }
+        
+        // How overdue the host is, weighted by how much traffic it has seen
+        double priority = (sinceProbed / host.reprobeInterval) * log2(2.0 + host.bytesTransferred);
+        
+        [dueHosts addObject:@[[NSNumber numberWithDouble:priority], host]];
+    }
+    
+    [dueHosts sortUsingComparator:^NSComparisonResult(NSArray* a, NSArray* b) {
+        return [b[0] compare:a[0]];
+    }];
+    
+    NSMutableDictionary* identifiers = [NSMutableDictionary dictionaryWithCapacity:MIN(maxHosts, dueHosts.count)];
+    
+    for (NSArray* dueHost in dueHosts)
+    {
+        if (identifiers.count == maxHosts)
+        {
+            break;
+        }
+        
+        Host* host = dueHost[1];
+        host.probeQueued = now;
+        identifiers[host.ipAddress] = [NSNumber numberWithUnsignedInteger:host.firstPortSeen];
+    }
+    
+    [self unlockStore];
+    
+    return identifiers;
+}
+
 #pragma mark - Group Management
 
 - (NSUInteger)hostGroupBasedOnRTT:(float)rtt
@@ -310,18 +485,60 @@ typedef enum
     return hostGroup;
 }
 
-- (NSUInteger)hostGroupBasedOnNetworkClass:(NSString*)ipAddress
+/**
+ * Must be called with the store locked, the prefix tries are guarded by the store lock.
+ */
+- (NSUInteger)hostGroupBasedOnNetworkPrefix:(uint32_t)ipv4Address
 {
-    // At present this just groups hosts based on the first 8 bits of their network address (modulo max groups)
-    NSArray* dottedQuads = [ipAddress componentsSeparatedByString:@"."];
+    NSUInteger hostGroup = 1;
     
-    if (dottedQuads.count != 4)
+    if ([self.sitePrefixes longestMatchForAddress:ipv4Address value:&hostGroup length:NULL])
     {
-        NSLog(@"Cannot determine host group for IP address %@", ipAddress);
-        return 1;
+        return hostGroup;
     }
     
-    return ([dottedQuads[0] integerValue] % kMaxHostGroups + 1);
+    // The learned trie only holds aggregates of one length so the aggregate is its own exact match
+    uint32_t aggregate = ipv4Address & (0xffffffffU << (32 - self.networkPrefixLength));
+    
+    if ( ! [self.learnedPrefixes longestMatchForAddress:aggregate value:&hostGroup length:NULL])
+    {
+        hostGroup = [self allocatePrefixGroup];
+        [self.learnedPrefixes insertPrefix:aggregate length:self.networkPrefixLength value:hostGroup];
+    }
+    
+    return hostGroup;
+}
+
+- (NSUInteger)allocatePrefixGroup
+{
+    NSUInteger hostGroup = self.nextPrefixGroup;
+    
+    self.nextPrefixGroup = (hostGroup % kMaxHostGroups) + 1;
+    
+    return hostGroup;
+}
+
+/**
+ * Site prefixes take the next free group in the order they're added, and take precedence over aggregate prefixes.
+ */
+- (BOOL)addSitePrefix:(NSString*)cidr
+{
+    uint32_t network;
+    uint8_t length;
+    
+    if ( ! [PrefixTrie parseCIDR:cidr network:&network length:&length])
+    {
+        NSLog(@"Ignoring invalid site prefix %@", cidr);
+        return NO;
+    }
+    
+    [self lockStore];
+    
+    [self.sitePrefixes insertPrefix:network length:length value:[self allocatePrefixGroup]];
+    
+    [self unlockStore];
+    
+    return YES;
 }
 
 /**
@@ -367,8 +584,11 @@ typedef enum
                 hostGroup = [self hostGroupBasedOnAS:host.autonomousSystem];
                 break;
                 
-            case kHostStoreGroupBasedOnNetworkClass:
-                hostGroup = [self hostGroupBasedOnNetworkClass:host.ipAddress];
+            case kHostStoreGroupBasedOnNetworkPrefix:
+                if (host.hasIPv4Address)
+                {
+                    hostGroup = [self hostGroupBasedOnNetworkPrefix:host.ipv4Address];
+                }
                 break;
                 
             default:
@@ -383,6 +603,31 @@ typedef enum
     [self unlockStore];
 }
 
+/**
+ * Aggregates are relearned at the new length from each host's integer address, site prefixes keep their groups.
+ */
+- (void)regroupHostsBasedOnNetworkPrefixLength:(uint8_t)prefixLength
+{
+    if (prefixLength < 1 || prefixLength > 32)
+    {
+        NSLog(@"Invalid network prefix length %u, will not regroup hosts", prefixLength);
+        return;
+    }
+    
+    [self lockStore];
+    
+    [self.learnedPrefixes removeAllPrefixes];
+    self.nextPrefixGroup = (self.sitePrefixes.prefixCount % kMaxHostGroups) + 1;
+    _networkPrefixLength = prefixLength;
+    
+    [self unlockStore];
+    
+    [self regroupHostsBasedOnStrategy:kHostStoreGroupBasedOnNetworkPrefix];
+}
+
+/**
+ * Learned aggregates go with the hosts they were learned from, site prefixes are configuration so they stay.
+ */
 - (void)resetStore
 {
     [self lockStore];
@@ -390,6 +635,9 @@ typedef enum
     [self clearNodes];
     self.largestBytesSeen = 0;
 
+    [self.learnedPrefixes removeAllPrefixes];
+    self.nextPrefixGroup = (self.sitePrefixes.prefixCount % kMaxHostGroups) + 1;
+
     [self unlockStore];
 }
 
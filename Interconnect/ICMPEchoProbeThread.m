@@ -11,6 +11,8 @@
 #import "ProbeThread+ProbeInterface.h"
 #import "Probe.h"
 #import "PacketHeaders.h"
+#import "ProbeSlotTable.h"
+#import "TimerWheel.h"
 #import <sys/socket.h>
 #import <netinet/in.h>
 #import <arpa/inet.h>
@@ -22,11 +24,34 @@
 #import <sys/time.h>
 
 #define kICMPEchoProbePayloadBytes 56
+#define kEchoSamplesPerProbe       5           // echoes sent to each host per probe...
+#define kEchoSampleIntervalMs      200         // ...this far apart, so they're interleaved with other hosts' and see different queueing
+#define kMaxEchoFlightTimeMs       3000        // how long to wait for replies after the last echo is sent
+
+/**
+ * The sequence number of each echo is its sample index, one timer per probe paces the samples and then waits for the
+ * last of the replies. Lost echoes are simply missing samples, the probe only fails if none are answered.
+ */
+@interface EchoProbe : Probe
+{
+    @public
+    uint64_t timeSent[kEchoSamplesPerProbe];        // monotonic ns
+    float rtts[kEchoSamplesPerProbe];               // 0 until answered
+}
+
+@property (nonatomic) uint8_t samplesSent;
+@property (nonatomic) uint8_t samplesReceived;
+
+@end
+
+@implementation EchoProbe
+
+@end
 
 @interface ICMPEchoProbeThread ()
 
 @property (nonatomic) int socket;
-@property (nonatomic) NSMutableDictionary* probesByICMPIdentifier;
+@property (nonatomic) ProbeSlotTable* probesByICMPIdentifier;
 @property (nonatomic) NSMutableDictionary* probesByHostIdentifier;
 
 @end
@@ -40,7 +65,7 @@
         NSLog(@"ICMPEchoProbeThread initialised");
         
         _probesByHostIdentifier = [[NSMutableDictionary alloc] init];
-        _probesByICMPIdentifier = [[NSMutableDictionary alloc] init];
+        _probesByICMPIdentifier = [[ProbeSlotTable alloc] initWithCapacity:kMaxProbeSlots firstSlot:arc4random_uniform(kMaxProbeSlots)];
         
         _socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_ICMP);
         if (_socket < 0)
@@ -57,118 +82,107 @@
     return self.socket;
 }
 
-- (void)sendProbe:(NSString*)toHostIdentifier onCompletion:(void (^)(Probe*))completionBlock retrying:(BOOL)retrying
+- (NSUInteger)packetsPerProbe
+{
+    return kEchoSamplesPerProbe;
+}
+
+- (void)sendProbe:(NSString*)toHostIdentifier port:(uint16_t)port onCompletion:(void (^)(Probe*))completionBlock retrying:(BOOL)retrying reprobing:(BOOL)reprobing
 {
     [self pingIPAddress:toHostIdentifier onCompletion:completionBlock];
 }
 
 - (NSInteger)pingIPAddress:(NSString*)ipAddress onCompletion:completionBlock
 {
-    // Have we already sent a probe to this host?
-    Probe* probe = nil;
-    
-    if ((probe = self.probesByHostIdentifier[ipAddress]))
+    if (self.probesByHostIdentifier[ipAddress])
     {
-        NSLog(@"Host %@ already exists (identifier: %hu, sequence: %hu), sending next probe", ipAddress, probe.icmpIdentifier, probe.sequenceNumber);
-        
-        if (probe.inflight)
-        {
-            [NSException raise:@"pingIPAddress" format:@"Cannot send probe to %@ as there is already a probe in flight", ipAddress];
-        }
-
-        // Ensure we never send anything else with this sequence number and ID combination
-        probe.sequenceNumber++;
+        NSLog(@"Host %@ is already being pinged", ipAddress);
+        return -1;
     }
-    else
+    
+    EchoProbe* probe = [[EchoProbe alloc] init];
+    
+    // The ICMP identifier is the probe's slot
+    uint16_t icmpIdentifier;
+    if ( ! [self.probesByICMPIdentifier allocateSlot:&icmpIdentifier forProbe:probe])
     {
-        probe = [[Probe alloc] init];
-
-        probe.hostIdentifier = ipAddress;
-        probe.icmpIdentifier = arc4random();
-        probe.sequenceNumber = 0;
-        probe.completionBlock = completionBlock;
-        probe.retries = 0;
-
-        self.probesByHostIdentifier[ipAddress] = probe;
-        self.probesByICMPIdentifier[[NSNumber numberWithInt:probe.icmpIdentifier]] = probe;
+        NSLog(@"Could not send probe to %@ as all ICMP identifiers are in use", ipAddress);
+        return -1;
     }
     
+    probe.hostIdentifier = ipAddress;
+    probe.icmpIdentifier = icmpIdentifier;
+    probe.sequenceNumber = 0;
+    probe.completionBlock = completionBlock;
+    probe.samplesSent = 0;
+    probe.samplesReceived = 0;
+    probe.inflight = YES;
+    
+    self.probesByHostIdentifier[ipAddress] = probe;
+    
+    [self sendEchoForProbe:probe];
+    
+    return 0;
+}
+
+/**
+ * Send the probe's next sample and schedule whatever comes after it, the next sample or the end of the probe.
+ */
+- (void)sendEchoForProbe:(EchoProbe*)probe
+{
+    uint8_t sample = probe.samplesSent;
+    
+    probe.sequenceNumber = sample;
+    probe.samplesSent++;
+    
+    // An echo that fails to send is a lost sample like any other
+    [self.timerWheel cancel:probe.timeoutTimer];
+    probe.timeoutTimer = [self.timerWheel scheduleAfterMs:(probe.samplesSent < kEchoSamplesPerProbe) ? kEchoSampleIntervalMs : kMaxEchoFlightTimeMs key:probe.icmpIdentifier context:0];
+    
     struct sockaddr_in dstAddr;
     memset(&dstAddr, 0, sizeof(dstAddr));
     dstAddr.sin_family = AF_INET;
-    dstAddr.sin_addr.s_addr = inet_addr([ipAddress cStringUsingEncoding:NSASCIIStringEncoding]);
-
-    // Create ICMP packet (header + payload, 56 byte payload is standard)
-    NSData* payload = [[NSString stringWithFormat:@"%32zd echoes in an empty room", probe.sequenceNumber] dataUsingEncoding:NSASCIIStringEncoding];
-    assert([payload length] == 56);
+    dstAddr.sin_addr.s_addr = inet_addr([probe.hostIdentifier cStringUsingEncoding:NSASCIIStringEncoding]);
+    
+    // Create ICMP packet (header + payload, 56 byte payload is standard) on the stack, nothing is allocated per request
+    unsigned char packet[sizeof(struct icmp) + kICMPEchoProbePayloadBytes];
+    char payload[kICMPEchoProbePayloadBytes + 1];
+    int payloadLength = snprintf(payload, sizeof(payload), "%32hu echoes in an empty room", probe.sequenceNumber);
+    assert(payloadLength == kICMPEchoProbePayloadBytes);
     
-    NSMutableData* packet = [NSMutableData dataWithLength:sizeof(struct icmp) + [payload length]];
-    if ( ! packet)
-    {
-        NSLog(@"Failed to create ICMP echo request packet");
-        return -1;
-    }
-
     struct icmp* icmpSendHdr;
-    icmpSendHdr = [packet mutableBytes];
+    icmpSendHdr = (struct icmp*)packet;
     icmpSendHdr->icmp_type = ICMP_ECHO;
     icmpSendHdr->icmp_code = 0;
     icmpSendHdr->icmp_cksum = 0;      // must be 0 for checksum calculation to work correctly
     icmpSendHdr->icmp_hun.ih_idseq.icd_id = htons(probe.icmpIdentifier);
     icmpSendHdr->icmp_hun.ih_idseq.icd_seq = htons(probe.sequenceNumber);
-    memcpy(&icmpSendHdr[1], [payload bytes], [payload length]);
+    memcpy(&icmpSendHdr[1], payload, kICMPEchoProbePayloadBytes);
     
     // Calculate the ICMP checksum (no need for endian swap, checksum calculated appropriately)
-    icmpSendHdr->icmp_cksum = [self internetChecksum:(unsigned char*)[packet bytes] length:[packet length]];
+    icmpSendHdr->icmp_cksum = [self internetChecksum:packet length:sizeof(packet)];
     
-    // Send it
-    struct timeval timeSent;
-    if (gettimeofday(&timeSent, NULL))
-    {
-        NSLog(@"Could not get send time");
-        return -1;
-    }
-    probe.timeSent = timeSent;
-    probe.inflight = YES;
+    // Send it, the send time is taken as late as possible (Darwin has no transmit timestamps)
+    probe->timeSent[sample] = [self monotonicNs];
     
-    ssize_t bytesSent = sendto(self.socket, [packet bytes], [packet length], 0, (const struct sockaddr*)&dstAddr, sizeof(dstAddr));
-    if (bytesSent < [packet length])
+    ssize_t bytesSent = sendto(self.socket, packet, sizeof(packet), 0, (const struct sockaddr*)&dstAddr, sizeof(dstAddr));
+    if (bytesSent < (ssize_t)sizeof(packet))
     {
         NSLog(@"Failed while sending ICMP echo request (%lu bytes sent)", bytesSent);
-        return -1;
+        return;
     }
-    
-    NSLog(@"Sent ICMP echo request with ID %u (seq: %hu) to %@", probe.icmpIdentifier, probe.sequenceNumber, probe.hostIdentifier);
 
-    return 0;
+//  NSLog(@"Sent ICMP echo request with ID %u (seq: %hu) to %@", probe.icmpIdentifier, probe.sequenceNumber, probe.hostIdentifier);
 }
 
-- (void)processIncomingSocketData
+- (void)processIncomingDatagram:(unsigned char*)datagram length:(ssize_t)length from:(const struct sockaddr_in*)srcAddr receivedAt:(uint64_t)timeRecv
 {
-    [self readICMPResponse];
+    [self readICMPResponse:datagram length:length from:srcAddr receivedAt:timeRecv];
 }
 
-- (float)readICMPResponse
+- (float)readICMPResponse:(unsigned char*)packetRecv length:(ssize_t)bytesRead from:(const struct sockaddr_in*)srcAddr receivedAt:(uint64_t)timeRecv
 {
-    NSMutableData *packetRecv = [NSMutableData dataWithLength:65535];
-
-    struct sockaddr srcAddr;
-    socklen_t srcAddrLen = sizeof(srcAddr);
-    ssize_t bytesRead = recvfrom(self.socket, [packetRecv mutableBytes], [packetRecv length], 0, &srcAddr, &srcAddrLen);
-    if (bytesRead <= 0)
-    {
-        NSLog(@"Failed to read packet from socket");
-        return -1;
-    }
-    
-//  NSLog(@"Read %lu bytes from %s", bytesRead, inet_ntoa(((struct sockaddr_in*)&srcAddr)->sin_addr));
-
-    struct timeval timeRecv;
-    if (gettimeofday(&timeRecv, NULL))
-    {
-        NSLog(@"Could not get receive time");
-        return -1;
-    }
+//  NSLog(@"Read %lu bytes from %s", bytesRead, inet_ntoa(srcAddr->sin_addr));
     
     // Does this look like a valid ICMP echo response? The returned packet will include the IP header.
     if (bytesRead < (sizeof(struct hdr_ip) + sizeof(struct icmp)))
@@ -177,7 +191,7 @@
         return -1;
     }
     
-    struct hdr_ip* ipHdr = (struct hdr_ip*)[packetRecv bytes];
+    struct hdr_ip* ipHdr = (struct hdr_ip*)packetRecv;
     if (IP_VERSION(ipHdr) != 0x04)
     {
         NSLog(@"Received packet was not IPv4");
@@ -197,7 +211,7 @@
     }
     
     // Validate the checksum
-    struct icmp* icmpRecvHdr = (struct icmp*)((unsigned char*)[packetRecv bytes] + IP_HDR_LEN(ipHdr));
+    struct icmp* icmpRecvHdr = (struct icmp*)(packetRecv + IP_HDR_LEN(ipHdr));
     uint16_t checksumRecv = icmpRecvHdr->icmp_cksum;
     icmpRecvHdr->icmp_cksum = 0;
     uint16_t checksumNeeded = [self internetChecksum:(unsigned char*)icmpRecvHdr length:(bytesRead - IP_HDR_LEN(ipHdr))];
@@ -217,13 +231,11 @@
     
     // Try to find the probe that generated this response
     uint16_t icmpIdentifier = ntohs(icmpRecvHdr->icmp_hun.ih_idseq.icd_id);
-    Probe* probe;
+    EchoProbe* probe;
     
-    if ((probe = self.probesByICMPIdentifier[[NSNumber numberWithInt:icmpIdentifier]]))
+    if ((probe = (EchoProbe*)[self.probesByICMPIdentifier probeInSlot:icmpIdentifier]))
     {
-        probe.inflight = NO;
-        probe.complete = YES;
-//      NSLog(@"Found probe record for ICMP identifier %hu and host %@ (actual host: %s)", probe.icmpIdentifier, probe.hostIdentifier, inet_ntoa(((struct sockaddr_in*)&srcAddr)->sin_addr));
+//      NSLog(@"Found probe record for ICMP identifier %hu and host %@ (actual host: %s)", probe.icmpIdentifier, probe.hostIdentifier, inet_ntoa(srcAddr->sin_addr));
     }
     else
     {
@@ -231,28 +243,114 @@
         return -1;
     }
     
-    if (ntohs(icmpRecvHdr->icmp_hun.ih_idseq.icd_seq) != probe.sequenceNumber)
+    // Replies to earlier samples can arrive after later ones have been sent
+    uint16_t sample = ntohs(icmpRecvHdr->icmp_hun.ih_idseq.icd_seq);
+    
+    if (sample >= probe.samplesSent || probe->rtts[sample] > 0)
     {
-        NSLog(@"Received ICMP packet had incorrect sequence number %u (needed %u)", ntohs(icmpRecvHdr->icmp_hun.ih_idseq.icd_seq), probe.sequenceNumber);
+        NSLog(@"Received ICMP packet had unexpected sequence number %u (%u sent)", sample, probe.samplesSent);
         return -1;
     }
     
     // Calculate the number of ms elapsed between send and receive
-    probe.rttToHost = [self msElapsedBetween:probe.timeSent endTime:timeRecv];
+    probe->rtts[sample] = MAX([self msElapsedBetweenNs:probe->timeSent[sample] endNs:timeRecv], 0.001);
+    probe.samplesReceived++;
+    
+    float rtt = probe->rtts[sample];
+    
+    if (probe.samplesReceived == kEchoSamplesPerProbe)
+    {
+        [self finishProbe:probe];
+    }
     
-    NSLog(@"Finished pinging %@ (RTT: %.2fms)", probe.hostIdentifier, probe.rttToHost);
+    return rtt;
+}
 
-    if (probe.completionBlock)
+/**
+ * Hand every sample that was answered to the completion block, rttToHost is their median.
+ */
+- (void)finishProbe:(EchoProbe*)probe
+{
+    NSMutableArray* rttSamples = [NSMutableArray arrayWithCapacity:probe.samplesReceived];
+    float sorted[kEchoSamplesPerProbe];
+    NSUInteger samples = 0;
+    
+    for (NSUInteger sample = 0; sample < probe.samplesSent; sample++)
+    {
+        if (probe->rtts[sample] > 0)
+        {
+            [rttSamples addObject:[NSNumber numberWithFloat:probe->rtts[sample]]];
+            sorted[samples++] = probe->rtts[sample];
+        }
+    }
+    
+    // Insertion sort, there are only a handful
+    for (NSUInteger i = 1; i < samples; i++)
+    {
+        for (NSUInteger j = i; j > 0 && sorted[j - 1] > sorted[j]; j--)
+        {
+            float swap = sorted[j];
+            sorted[j] = sorted[j - 1];
+            sorted[j - 1] = swap;
+        }
+    }
+    
+    probe.inflight = NO;
+    probe.complete = YES;
+    probe.rttSamples = rttSamples;
+    probe.rttToHost = samples ? sorted[samples / 2] : 0;
+    
+    if (samples)
+    {
+        NSLog(@"Finished pinging %@ (RTT min/median/max: %.2f/%.2f/%.2fms, %lu of %u answered)", probe.hostIdentifier, sorted[0], probe.rttToHost, sorted[samples - 1], samples, probe.samplesSent);
+    }
+    else
+    {
+        NSLog(@"*** COMPLETING TIMED OUT PROBE to %@", probe.hostIdentifier);
+    }
+    
+    if (probe.completionBlock && (samples || self.completeTimedOutProbes))
     {
         probe.completionBlock(probe);
     }
     
-    return probe.rttToHost;
+    [self resetProbe:probe];
+}
+
+/**
+ * Forget a probe so its host can be probed again and its ICMP identifier reused.
+ */
+- (void)resetProbe:(Probe*)probe
+{
+    [self.timerWheel cancel:probe.timeoutTimer];
+    probe.timeoutTimer = 0;
+    
+    [self.probesByICMPIdentifier releaseSlot:probe.icmpIdentifier];
+    [self.probesByHostIdentifier removeObjectForKey:probe.hostIdentifier];
 }
 
-- (void)cleanupProbes
+/**
+ * The probe's timer paces its samples, once they've all been sent it's the deadline for their replies.
+ */
+- (void)probeTimedOut:(uint32_t)key context:(uint32_t)context
 {
-    // @todo: implement
+    EchoProbe* probe = (EchoProbe*)[self.probesByICMPIdentifier probeInSlot:key];
+    
+    if ( ! probe)
+    {
+        return;
+    }
+    
+    probe.timeoutTimer = 0;
+    
+    if (probe.samplesSent < kEchoSamplesPerProbe)
+    {
+        [self sendEchoForProbe:probe];
+    }
+    else
+    {
+        [self finishProbe:probe];
+    }
 }
 
 @end
@@ -0,0 +1,15 @@
+//
+//  ICMPEchoTracerouteMethod.h
+//  Interconnect
+//
+//  Echo requests with rising TTLs, the destination answers with an echo reply.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "TracerouteProbeMethod.h"
+
+@interface ICMPEchoTracerouteMethod : NSObject <TracerouteProbeMethod>
+
+@end
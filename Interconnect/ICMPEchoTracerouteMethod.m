@@ -0,0 +1,118 @@
+//
+//  ICMPEchoTracerouteMethod.m
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "ICMPEchoTracerouteMethod.h"
+#import "TracerouteProbe.h"
+#import "ProbeThread+Private.h"
+#import "ProbeThread+ProbeInterface.h"
+#import <sys/socket.h>
+#import <arpa/inet.h>
+#import <netinet/in_systm.h>
+#import <netinet/ip.h>
+#import <netinet/ip_icmp.h>
+
+#define ECHO_SEQUENCE(ttl, attempt)             (((attempt) << 8) | (ttl))
+
+@interface ICMPEchoTracerouteMethod ()
+
+@property (nonatomic, weak) ProbeThread* probeThread;
+@property (nonatomic) int icmpSocket;
+
+@end
+
+@implementation ICMPEchoTracerouteMethod
+
+/**
+ * Echo requests have to share the ICMP socket replies are read from, so that gets a setsockopt per send.
+ */
+- (void)attachToProbeThread:(ProbeThread*)probeThread replyHandler:(TracerouteReplyHandler)replyHandler
+{
+    self.probeThread = probeThread;
+    self.icmpSocket = [probeThread getNativeSocket];
+}
+
+/**
+ * The echo identifier is the traceroute's slot and the sequence number carries the TTL and attempt.
+ */
+- (HopSendResult)sendHop:(uint8_t)ttl attempt:(uint8_t)attempt forProbe:(TracerouteProbe*)probe
+{
+    struct sockaddr_in dstAddr;
+    memset(&dstAddr, 0, sizeof(dstAddr));
+    dstAddr.sin_family = AF_INET;
+    dstAddr.sin_addr.s_addr = probe.dstAddress;
+
+    unsigned char packet[ICMP_MINLEN + sizeof(struct payload)];
+    struct icmp* icmpSendHdr = (struct icmp*)packet;
+    struct payload* pPayload = (struct payload*)(packet + ICMP_MINLEN);
+
+    memset(packet, 0, sizeof(packet));
+    icmpSendHdr->icmp_type = ICMP_ECHO;
+    icmpSendHdr->icmp_code = 0;
+    icmpSendHdr->icmp_hun.ih_idseq.icd_id = htons(probe.slot);
+    icmpSendHdr->icmp_hun.ih_idseq.icd_seq = htons(ECHO_SEQUENCE(ttl, attempt));
+    pPayload->sequence = htons(attempt);
+    pPayload->ttl = ttl;
+    pPayload->time_sent = htonl(time(NULL));
+    icmpSendHdr->icmp_cksum = [self.probeThread internetChecksum:packet length:sizeof(packet)];
+
+    int ipTTL = ttl;
+    if (setsockopt(self.icmpSocket, IPPROTO_IP, IP_TTL, &ipTTL, sizeof(ipTTL)) < 0)
+    {
+        NSLog(@"Could not set IP TTL %d on ICMP socket: %s", ipTTL, strerror(errno));
+        return kHopSendFailed;
+    }
+
+    probe->hops[ttl].timeSent[attempt] = [self.probeThread monotonicNs];
+
+    ssize_t bytesSent = sendto(self.icmpSocket, packet, sizeof(packet), 0, (struct sockaddr*)&dstAddr, sizeof(dstAddr));
+    if (bytesSent < (ssize_t)sizeof(packet))
+    {
+        NSLog(@"Failed while sending ICMP echo probe (%ld bytes sent): %s", (long)bytesSent, strerror(errno));
+        return kHopSendFailed;
+    }
+
+    return kHopSent;
+}
+
+- (void)closeHop:(struct hop*)hop
+{
+}
+
+- (BOOL)matchQuotedHeader:(const unsigned char*)header proto:(uint8_t)proto slot:(uint16_t*)slot ttl:(uint8_t*)ttl attempt:(int*)attempt
+{
+    if (proto != IPPROTO_ICMP)
+    {
+        return NO;
+    }
+
+    return [self matchEcho:(const struct icmp*)header type:ICMP_ECHO slot:slot ttl:ttl attempt:attempt];
+}
+
+/**
+ * An echo reply comes from the destination itself and carries our identifier and sequence number.
+ */
+- (BOOL)matchReply:(const struct icmp*)icmpHdr slot:(uint16_t*)slot ttl:(uint8_t*)ttl attempt:(int*)attempt
+{
+    return [self matchEcho:icmpHdr type:ICMP_ECHOREPLY slot:slot ttl:ttl attempt:attempt];
+}
+
+- (BOOL)matchEcho:(const struct icmp*)icmpHdr type:(uint8_t)type slot:(uint16_t*)slot ttl:(uint8_t*)ttl attempt:(int*)attempt
+{
+    if (icmpHdr->icmp_type != type)
+    {
+        return NO;
+    }
+
+    *slot = ntohs(icmpHdr->icmp_hun.ih_idseq.icd_id);
+    *ttl = ntohs(icmpHdr->icmp_hun.ih_idseq.icd_seq) & 0xff;
+    *attempt = ntohs(icmpHdr->icmp_hun.ih_idseq.icd_seq) >> 8;
+
+    return YES;
+}
+
+@end
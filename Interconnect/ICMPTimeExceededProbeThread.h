@@ -7,9 +7,23 @@
 //
 
 #import "ProbeThread.h"
+#import "TracerouteProbeMethod.h"
 
 #define kBaseTracerouteUDPPort 30000
+#define kMaxProbeTTL 30                 // probes never leave with a higher TTL, other traffic from this host uses the system default
+
+typedef enum
+{
+    kTracerouteMethodUDP = 0,       // datagrams to unused high ports, the destination answers with port unreachable
+    kTracerouteMethodICMPEcho,      // echo requests, the destination answers with an echo reply
+    kTracerouteMethodTCPSYN         // connections to the host's service port, the destination answers with SYN-ACK or RST
+} TracerouteMethod;
 
 @interface ICMPTimeExceededProbeThread : ProbeThread
 
+@property (nonatomic, readonly, strong) id<TracerouteProbeMethod> probeMethod;
+
+- (instancetype)initWithMethod:(TracerouteMethod)method;
+- (instancetype)initWithProbeMethod:(id<TracerouteProbeMethod>)probeMethod;
+
 @end
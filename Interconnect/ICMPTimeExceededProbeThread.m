@@ -1,16 +1,22 @@
 //
-//  ICMPEchoProbeThread.m
+//  ICMPTimeExceededProbeThread.m
 //  Interconnect
 //
-//  Created by oroboto on 15/05/2016.
+//  Created by oroboto on 17/05/2016.
 //  Copyright © 2016 oroboto. All rights reserved.
 //
 
 #import "ICMPTimeExceededProbeThread.h"
 #import "ProbeThread+Private.h"
 #import "ProbeThread+ProbeInterface.h"
-#import "Probe.h"
+#import "TracerouteProbe.h"
+#import "UDPTracerouteMethod.h"
+#import "ICMPEchoTracerouteMethod.h"
+#import "TCPSYNTracerouteMethod.h"
 #import "PacketHeaders.h"
+#import "PathCache.h"
+#import "ProbeSlotTable.h"
+#import "TimerWheel.h"
 #import <sys/socket.h>
 #import <netinet/in.h>
 #import <arpa/inet.h>
@@ -20,16 +26,15 @@
 #import <netinet/ip_icmp.h>
 #import <sys/select.h>
 #import <sys/time.h>
+#import <fcntl.h>
 
-#define kMaxAttemptsToFindUnusedPort            10
+#define kTTLWindow                              16          // TTLs sent at once, the window is extended while the path is longer
+#define kMaxHopFlightTimeMs                     3000
+#define kMinTokenWaitMs                         10          // a hop waiting on a probe token is retried no sooner than this
+#define kSendLaterWaitMs                        100         // a hop its method couldn't send yet (see HopSendResult) is retried after this
+#define kDefaultTCPTraceroutePort               80          // for hosts that haven't been seen using a port
 
-#define kMaxProbeTTL                            30
-#define kMaxProbeFlightTimeMs                   10000
-#define kMaxProbeRetries                        3
-
-#define kRetriesExceeded                       -2
 #define kError                                 -1
-#define kSuccess                                0
 
 typedef enum
 {
@@ -37,22 +42,12 @@ typedef enum
     kNextHopIsRouter
 } NextHopType;
 
-#pragma pack(1)
-struct payload
-{
-    uint16_t        sequence;
-    unsigned char   ttl;
-    time_t          time_sent;
-    unsigned char   pad;
-};
-#pragma options align=reset
-
 @interface ICMPTimeExceededProbeThread ()
 
 @property (nonatomic) int icmpSocket;
-@property (nonatomic) int udpSocket;
-@property (nonatomic) NSMutableDictionary* probesByDstUDPPort;
+@property (nonatomic) ProbeSlotTable* probesBySlot;
 @property (nonatomic) NSMutableDictionary* probesByHostIdentifier;
+@property (nonatomic, strong) PathCache* pathCache;
 
 @end
 
@@ -60,24 +55,52 @@ struct payload
 
 - (instancetype)init
 {
+    return [self initWithMethod:kTracerouteMethodUDP];
+}
+
+- (instancetype)initWithMethod:(TracerouteMethod)method
+{
+    switch (method)
+    {
+        case kTracerouteMethodICMPEcho:
+            return [self initWithProbeMethod:[[ICMPEchoTracerouteMethod alloc] init]];
+        
+        case kTracerouteMethodTCPSYN:
+            return [self initWithProbeMethod:[[TCPSYNTracerouteMethod alloc] init]];
+        
+        default:
+            return [self initWithProbeMethod:[[UDPTracerouteMethod alloc] init]];
+    }
+}
+
+- (instancetype)initWithProbeMethod:(id<TracerouteProbeMethod>)probeMethod
+{
+    if ( ! probeMethod)
+    {
+        return nil;
+    }
+    
     if (self = [super init])
     {
-        NSLog(@"ICMPTimeExceededProbeThread initialised");
+        NSLog(@"ICMPTimeExceededProbeThread initialised (method: %@)", NSStringFromClass([probeMethod class]));
+        
+        _probeMethod = probeMethod;
         
         _probesByHostIdentifier = [[NSMutableDictionary alloc] init];
-        _probesByDstUDPPort = [[NSMutableDictionary alloc] init];
+        _probesBySlot = [[ProbeSlotTable alloc] initWithCapacity:kMaxConcurrentTraceroutes firstSlot:0];
+        _pathCache = [[PathCache alloc] init];
         
         _icmpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_ICMP);
         if (_icmpSocket < 0)
         {
             NSLog(@"Could not create ICMP socket");
         }
-
-        _udpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-        if (_udpSocket < 0)
-        {
-            NSLog(@"Could not create ICMP socket");
-        }
+        
+        // Connections answered by the destination come back through here, ICMP replies through the socket
+        __weak ICMPTimeExceededProbeThread* weakSelf = self;
+        [_probeMethod attachToProbeThread:self replyHandler:^(uint16_t slot, uint8_t ttl, int attempt, uint64_t timeRecv) {
+            [weakSelf recordReplyForSlot:slot ttl:ttl attempt:attempt receivedAt:timeRecv];
+        }];
     }
     
     return self;
@@ -88,243 +111,345 @@ struct payload
     return self.icmpSocket;
 }
 
-- (void)sendProbe:(NSString*)toHostIdentifier onCompletion:(void (^)(Probe*))completionBlock retrying:(BOOL)retrying
+- (NSUInteger)packetsPerProbe
+{
+    return kTTLWindow;
+}
+
+/**
+ * Start a traceroute to the host. Retries are made per hop as each one times out so retrying is not used here. The
+ * port is only used by the TCP method. A re-probe traces the whole path, the path cache is only used to shorten
+ * traceroutes to hosts we haven't measured yet.
+ */
+- (void)sendProbe:(NSString*)toHostIdentifier port:(uint16_t)port onCompletion:(void (^)(Probe*))completionBlock retrying:(BOOL)retrying reprobing:(BOOL)reprobing
 {
-    NSInteger sendStatus = [self sendPortUnreachableUDPPacketToIPAddress:toHostIdentifier onCompletion:completionBlock retrying:retrying];
+    if (self.probesByHostIdentifier[toHostIdentifier])
+    {
+        NSLog(@"Traceroute to %@ is already in progress", toHostIdentifier);
+        return;
+    }
     
-    if (sendStatus == kRetriesExceeded && self.completeTimedOutProbes)
+    TracerouteProbe* probe = [self createProbeForIPAddress:toHostIdentifier onCompletion:completionBlock];
+    if ( ! probe)
     {
-        Probe* probe = self.probesByHostIdentifier[toHostIdentifier];
-
-        NSLog(@"*** COMPLETING TIMED OUT PROBE to %@", toHostIdentifier);
-        if (probe.completionBlock)
+        return;
+    }
+    
+    probe.dstPort = port ? port : kDefaultTCPTraceroutePort;
+    
+    uint32_t hostAddress = ntohl(probe.dstAddress);
+    uint32_t routers[kMaxProbeTTL + 1];
+    uint8_t cachedHopCount = reprobing ? 0 : [self.pathCache cachedHopCountForAddress:hostAddress routers:routers maxHops:kMaxProbeTTL];
+    
+    /**
+     * Another destination in the same /24 was traced recently, this one is assumed to be just as far away. Its RTT is
+     * its own though, so the one hop at that distance is still sent to measure it.
+     */
+    if (cachedHopCount)
+    {
+        for (uint8_t ttl = 1; ttl < cachedHopCount; ttl++)
         {
-            probe.completionBlock(probe);
+            probe->hops[ttl].state = kHopIsRouter;
+            probe->hops[ttl].responder = routers[ttl];
         }
+        
+        probe.highestTTLSent = cachedHopCount - 1;
+        probe.firstTTLSent = cachedHopCount;
+        probe.confirmingCachedPath = YES;
+        
+        [self sendHopsUpToTTL:cachedHopCount forProbe:probe];
+        [self advanceProbe:probe];
+        return;
     }
     
-    if (sendStatus == kRetriesExceeded || sendStatus == kError)
+    /**
+     * Skip the hops shared by every destination under a covering prefix. The last shared hop is still probed, if the
+     * router we expect doesn't answer there but the destination does, the skipped hops are probed after all.
+     */
+    uint8_t knownHops = reprobing ? 0 : [self.pathCache knownHopsForAddress:hostAddress routers:routers maxHops:kMaxProbeTTL];
+    
+    for (uint8_t ttl = 1; ttl < knownHops; ttl++)
     {
-        [self resetProbe:toHostIdentifier allowRemovalOfInflightProbes:YES];
+        probe->hops[ttl].state = kHopIsRouter;
+        probe->hops[ttl].responder = routers[ttl];
     }
+    
+    probe.highestTTLSent = knownHops ? knownHops - 1 : 0;
+    probe.firstTTLSent = probe.highestTTLSent + 1;
+    
+    [self sendHopsUpToTTL:probe.highestTTLSent + kTTLWindow forProbe:probe];
+    [self advanceProbe:probe];      // in case nothing could be sent
 }
 
-/**
- * Reset probe status for a given host.
- *
- * This allows the host to be reprobed or the UDP port that was being used for probing that host to be reused.
- */
-- (void)resetProbe:(NSString*)forHostIdentifier allowRemovalOfInflightProbes:(BOOL)allowRemovalInFlight
+- (TracerouteProbe*)createProbeForIPAddress:(NSString*)ipAddress onCompletion:(void (^)(Probe*))completionBlock
 {
-    Probe* probe = self.probesByHostIdentifier[forHostIdentifier];
+    struct in_addr dstAddress;
+    if (inet_pton(AF_INET, [ipAddress cStringUsingEncoding:NSASCIIStringEncoding], &dstAddress) != 1)
+    {
+        NSLog(@"Cannot traceroute to %@ as it is not an IPv4 address", ipAddress);
+        return nil;
+    }
     
-    if (probe)
+    TracerouteProbe* probe = [[TracerouteProbe alloc] init];
+    uint16_t slot;
+    
+    if ( ! [self.probesBySlot allocateSlot:&slot forProbe:probe])
     {
-        if (probe.inflight && ! allowRemovalInFlight)
+        NSLog(@"Could not send probe to %@ as all %d traceroute slots are in use", ipAddress, kMaxConcurrentTraceroutes);
+        return nil;
+    }
+    
+    probe.hostIdentifier = ipAddress;
+    probe.slot = slot;
+    probe.dstAddress = dstAddress.s_addr;
+    probe.sequenceNumber = 0;
+    probe.currentTTL = 0;
+    probe.firstTTLSent = 1;
+    probe.highestTTLSent = 0;
+    probe.destinationTTL = 0;
+    probe.prepaidHops = [self packetsPerProbe];
+    probe.confirmingCachedPath = NO;
+    probe.complete = NO;
+    probe.completionBlock = completionBlock;
+    
+    self.probesByHostIdentifier[ipAddress] = probe;
+    
+    return probe;
+}
+
+- (void)sendHopsUpToTTL:(uint8_t)ttl forProbe:(TracerouteProbe*)probe
+{
+    uint8_t firstTTL = probe.highestTTLSent + 1;
+    
+    for (uint8_t hopTTL = firstTTL; hopTTL <= MIN(ttl, kMaxProbeTTL); hopTTL++)
+    {
+        if ( ! [self sendHop:hopTTL forProbe:probe])
         {
-            NSLog(@"Cannot reset probe for %@ as the probe is still in flight", forHostIdentifier);
-            return;
+            probe->hops[hopTTL].state = kHopSilent;
         }
         
-        [self.probesByDstUDPPort removeObjectForKey:[NSNumber numberWithInt:probe.dstPort]];
-        [self.probesByHostIdentifier removeObjectForKey:forHostIdentifier];
+        probe.highestTTLSent = hopTTL;
     }
 }
 
 /**
- * Send the (next) UDP packet to the host while ramping up the TTL in order to effect a UDP based traceroute.
+ * Send (or resend) the packet for one hop of the traceroute, using whichever method the thread was created with.
+ *
+ * The traceroute's first window was paid for when it started, every other packet (further windows, retries and
+ * skipped hops that turn out to be needed) takes a probe token. A hop that can't get one waits for it, deferred, as
+ * does one the method can't send yet (its token is given back).
  */
-- (NSInteger)sendPortUnreachableUDPPacketToIPAddress:(NSString*)ipAddress onCompletion:(void (^)(Probe*))completionBlock retrying:(BOOL)retrying
+- (BOOL)sendHop:(uint8_t)ttl forProbe:(TracerouteProbe*)probe
 {
-    /**
-     * Have we already sent a UDP packet to this IP address? If so, it could be because we're in the middle of a traceroute,
-     * but it could also be because we've already finished a complete traceroute to the host.
-     */
-    Probe* probe = nil;
+    struct hop* hop = &probe->hops[ttl];
+    uint8_t attempt = hop->attempts;
+    
+    [self.timerWheel cancel:hop->timer];
+    hop->timer = 0;
     
-    if ((probe = self.probesByHostIdentifier[ipAddress]))
+    if (attempt > kMaxProbeRetries)
     {
-        NSLog(@"Host %@ already exists (sequence: %hu, currentTTL: %hhu), sending next probe", ipAddress, probe.sequenceNumber, probe.currentTTL);
+        [self.probeMethod closeHop:hop];
+        return NO;
+    }
+    
+    BOOL prepaid = probe.prepaidHops > 0;
+    
+    if (prepaid)
+    {
+        probe.prepaidHops--;
+    }
+    else if ( ! [self takeProbeToken])
+    {
+        // The previous attempt (if any) can still be answered while the hop waits
+        hop->state = kHopDeferred;
+        hop->timer = [self.timerWheel scheduleAfterMs:MAX([self msUntilProbeToken], kMinTokenWaitMs) key:probe.slot context:ttl];
         
-        if (probe.complete)
+        return YES;
+    }
+    
+    [self.probeMethod closeHop:hop];
+    
+    HopSendResult result = [self.probeMethod sendHop:ttl attempt:attempt forProbe:probe];
+    
+    if (result == kHopSendLater)
+    {
+        if (prepaid)
         {
-            // Must call resetProbe: if we want to reprobe the host.
-            [NSException raise:@"sendPortUnreachableUDPPacketToIPAddress" format:@"Cannot send probe to %@ as we have already completed a full probe for it.", ipAddress];
+            probe.prepaidHops++;
         }
-
-        if ( ! retrying)
+        else
         {
-            if (probe.inflight)
-            {
-                [NSException raise:@"sendPortUnreachableUDPPacketToIPAddress" format:@"Cannot send UDP packet to %@ as there is already a packet in flight", ipAddress];
-            }
-
-            // Get ready to send the next probe to find the next hop (otherwise we're retrying last hop)
-            probe.sequenceNumber++;
-            probe.currentTTL++;
-            probe.retries = 0;              // reset retry count, it's per hop
+            [self returnProbeTokens:1];
         }
-        else
+        
+        hop->state = kHopDeferred;
+        hop->timer = [self.timerWheel scheduleAfterMs:kSendLaterWaitMs key:probe.slot context:ttl];
+        
+        return YES;
+    }
+    else if (result == kHopSendFailed)
+    {
+        return NO;
+    }
+    
+    hop->attempts++;
+    hop->state = kHopInflight;
+    hop->timer = [self.timerWheel scheduleAfterMs:kMaxHopFlightTimeMs key:probe.slot context:ttl];
+    
+    probe.timeSent = hop->timeSent[attempt];
+    probe.inflight = YES;
+    
+    return YES;
+}
+
+/**
+ * Extend the TTL window if the path is longer than what has been sent, or finish the traceroute once every hop up to
+ * the destination has either answered or been given up on.
+ */
+- (void)advanceProbe:(TracerouteProbe*)probe
+{
+    uint8_t lastTTL = probe.destinationTTL ? probe.destinationTTL - 1 : probe.highestTTLSent;
+    uint8_t lastRouterTTL = 0;
+    
+    for (uint8_t ttl = 1; ttl <= lastTTL; ttl++)
+    {
+        if (probe->hops[ttl].state == kHopInflight || probe->hops[ttl].state == kHopDeferred)
         {
-            if (++probe.retries > kMaxProbeRetries)
+            // A router answering at the edge of the window means the path goes further, don't wait for stragglers
+            if ( ! probe.destinationTTL && probe->hops[probe.highestTTLSent].state == kHopIsRouter && probe.highestTTLSent < kMaxProbeTTL)
             {
-                NSLog(@"Retry limit (%d) exceeded for %@", kMaxProbeRetries, probe.hostIdentifier);
-                return kRetriesExceeded;
+                [self sendHopsUpToTTL:probe.highestTTLSent + kTTLWindow forProbe:probe];
             }
             
-            // Need to change the destination port in case the response comes back (if it does, we should ignore it)
-            [self.probesByDstUDPPort removeObjectForKey:[NSNumber numberWithInt:probe.dstPort]];
-            
-            probe.dstPort = [self generateDestinationPortForProbe];
-            if ( ! probe.dstPort)
-            {
-                NSLog(@"Could not resend probe to %@ as an unused UDP port is not available", ipAddress);
-                return kError;
-            }
-            
-            self.probesByDstUDPPort[[NSNumber numberWithInt:probe.dstPort]] = probe;
+            return;
         }
         
-        if (probe.currentTTL > kMaxProbeTTL)
+        if (probe->hops[ttl].state == kHopIsRouter)
         {
-            NSLog(@"TTL exceeded for %@", probe.hostIdentifier);
-            return kRetriesExceeded;        // this ensures we complete the probe (if set) at the maximum TTL
+            lastRouterTTL = ttl;
         }
     }
-    else
+    
+    // Any TTL that reached the destination still does, so silence at the cached distance is the destination not answering
+    BOOL cachedHopUnanswered = probe.confirmingCachedPath && ! probe.destinationTTL && probe->hops[probe.firstTTLSent].state == kHopSilent;
+    
+    if ( ! probe.destinationTTL && probe.highestTTLSent < kMaxProbeTTL && ! cachedHopUnanswered)
     {
-        uint16_t dstPort = [self generateDestinationPortForProbe];
-        if ( ! dstPort)
+        [self sendHopsUpToTTL:probe.highestTTLSent + kTTLWindow forProbe:probe];
+        return;
+    }
+    
+    probe.inflight = NO;
+    probe.complete = YES;
+    
+    if (probe.destinationTTL)
+    {
+        probe.currentTTL = probe.destinationTTL;
+        
+        // A path confirmed at the cached distance is already cached, one that turned out longer replaces it
+        if ( ! probe.confirmingCachedPath || probe.destinationTTL != probe.firstTTLSent)
         {
-            NSLog(@"Could not send probe to %@ as an unused UDP port is not available", ipAddress);
-            return kError;
+            uint32_t routers[kMaxProbeTTL + 1];
+            for (uint8_t ttl = 1; ttl < probe.destinationTTL; ttl++)
+            {
+                routers[ttl] = (probe->hops[ttl].state == kHopIsRouter) ? probe->hops[ttl].responder : 0;
+            }
+            
+            [self.pathCache recordPathToAddress:ntohl(probe.dstAddress) routers:routers hopCount:probe.destinationTTL];
         }
         
-        probe = [[Probe alloc] init];
-
-        probe.hostIdentifier = ipAddress;
-        probe.dstPort = dstPort;
-        probe.sequenceNumber = 0;
-        probe.currentTTL = 1;
-        probe.retries = 0;
-        probe.complete = NO;
-        probe.completionBlock = completionBlock;
+        NSLog(@"Finished traceroute %@%@ (hops: %hhu, RTT: %.2fms)", probe.hostIdentifier, probe.confirmingCachedPath ? @" from path cache" : @"", probe.currentTTL, probe.rttToHost);
         
-        self.probesByHostIdentifier[ipAddress] = probe;
-        self.probesByDstUDPPort[[NSNumber numberWithInt:probe.dstPort]] = probe;
+        if (probe.completionBlock)
+        {
+            probe.completionBlock(probe);
+        }
     }
-    
-    struct sockaddr_in dstAddr;
-    memset(&dstAddr, 0, sizeof(dstAddr));
-    dstAddr.sin_family = AF_INET;
-    dstAddr.sin_port = htons(probe.dstPort);
-    dstAddr.sin_addr.s_addr = inet_addr([ipAddress cStringUsingEncoding:NSASCIIStringEncoding]);
-    
-    // Create UDP packet (IP header + UDP header + payload)
-    NSMutableData* payload = [NSMutableData dataWithLength:sizeof(struct payload)];
-    struct payload* pPayload = (struct payload*)[payload mutableBytes];
-    assert([payload length] == sizeof(struct payload));
-    pPayload->sequence = htons(probe.sequenceNumber);
-    pPayload->ttl = probe.currentTTL;
-    
-    time_t timer = time(NULL);
-    pPayload->time_sent = htonl(timer);
-    
-    NSMutableData* packet = [NSMutableData dataWithLength:[payload length]];
-    if ( ! packet)
+    else if (cachedHopUnanswered)
     {
-        NSLog(@"Failed to create UDP request packet");
-        return kError;
+        // The distance still stands but there's no RTT to report (0 leaves the host's last known RTT alone)
+        probe.currentTTL = probe.firstTTLSent;
+        probe.rttToHost = 0;
+        
+        NSLog(@"Finished traceroute %@ from path cache without an RTT (hops: %hhu)", probe.hostIdentifier, probe.currentTTL);
+        
+        if (probe.completionBlock)
+        {
+            probe.completionBlock(probe);
+        }
     }
-    
-    // Set the appropriate TTL
-    int ttl = probe.currentTTL;
-    if (setsockopt(self.udpSocket, IPPROTO_IP, IP_TTL, &ttl, sizeof(ttl)) < 0)
+    else if (self.completeTimedOutProbes)
     {
-        NSLog(@"Could not set IP TTL on UDP socket: %s", strerror(errno));
-        return kError;
+        // The destination never answered, the hop past the last router that did is the best we know
+        probe.currentTTL = lastRouterTTL ? lastRouterTTL + 1 : 0;
+        
+        NSLog(@"*** COMPLETING TIMED OUT PROBE to %@ (hops: at least %hhu)", probe.hostIdentifier, probe.currentTTL);
+        
+        if (probe.completionBlock)
+        {
+            probe.completionBlock(probe);
+        }
     }
     
-    // Send it
-    struct timeval timeSent;
-    if (gettimeofday(&timeSent, NULL))
-    {
-        NSLog(@"Could not get send time");
-        return kError;
-    }
-    probe.timeSent = timeSent;
-    probe.inflight = YES;
+    [self resetProbe:probe.hostIdentifier];
+}
 
-    ssize_t bytesSent = sendto(self.udpSocket, [packet bytes], [packet length], 0, (struct sockaddr*)&dstAddr, sizeof(dstAddr));
-    if (bytesSent < [packet length])
+/**
+ * Forget the traceroute for a host so it can be probed again and its slot reused.
+ */
+- (void)resetProbe:(NSString*)forHostIdentifier
+{
+    TracerouteProbe* probe = self.probesByHostIdentifier[forHostIdentifier];
+    
+    if (probe)
     {
-        NSLog(@"Failed while sending UDP echo request (%lu bytes sent): %s", bytesSent, strerror(errno));
-        return kError;
+        // Hops past the destination are still waiting on their timeouts (and connections)
+        for (uint8_t ttl = 1; ttl <= probe.highestTTLSent; ttl++)
+        {
+            [self.timerWheel cancel:probe->hops[ttl].timer];
+            probe->hops[ttl].timer = 0;
+            
+            [self.probeMethod closeHop:&probe->hops[ttl]];
+        }
+        
+        // A short path (or one answered from the path cache) leaves some of what was charged up front unsent
+        [self returnProbeTokens:probe.prepaidHops];
+        probe.prepaidHops = 0;
+        
+        [self.probesBySlot releaseSlot:probe.slot];
+        [self.probesByHostIdentifier removeObjectForKey:forHostIdentifier];
     }
-    
-    NSLog(@"Sent UDP probe with TTL %u (seq: %u) to %@:%hu (payload length: %lu)", probe.currentTTL, probe.sequenceNumber, probe.hostIdentifier, probe.dstPort, (unsigned long)[payload length]);
-    
-    return kSuccess;
 }
 
 /**
  * Data is available to read on the ICMP socket, should be either ICMP time exceeded (we hit a router) or ICMP port unreachable (we hit the host)
  */
-- (void)processIncomingSocketData
+- (void)processIncomingDatagram:(unsigned char*)datagram length:(ssize_t)length from:(const struct sockaddr_in*)srcAddr receivedAt:(uint64_t)timeRecv
 {
-    switch ([self readICMPResponse])
+    switch ([self readICMPResponse:datagram length:length from:srcAddr receivedAt:timeRecv])
     {
         case kNextHopIsDestination:
             break;
-            
+        
         case kNextHopIsRouter:
             break;
-            
+        
         case kError:
             break;
     }
 }
 
-- (NSInteger)readICMPResponse
+- (NSInteger)readICMPResponse:(unsigned char*)packetRecv length:(ssize_t)bytesRead from:(const struct sockaddr_in*)srcAddr receivedAt:(uint64_t)timeRecv
 {
-    NSMutableData *packetRecv = [NSMutableData dataWithLength:65535];
-    ssize_t bytesNeeded;
-    
-    /**
-     * Returned ICMP time exceeded or destination unreachable packet should contain IP header, ICMP header, sent IP 
-     * header and 8 bytes of sent UDP datagram. It may also include our payload (12 bytes) but this is highly router 
-     * dependant and we do not require it.
-     */
-    bytesNeeded = sizeof(struct hdr_ip) + 8 /* icmp hdr */ + sizeof(struct hdr_ip) + sizeof(struct hdr_udp);
-
-    // @todo: support reading partial packets as per ICMPTimeExceededProbe
-    
-    struct sockaddr srcAddr;
-    socklen_t srcAddrLen = sizeof(srcAddr);
-    ssize_t bytesRead = recvfrom(self.icmpSocket, [packetRecv mutableBytes], [packetRecv length], 0, &srcAddr, &srcAddrLen);
-    if (bytesRead <= 0)
-    {
-        NSLog(@"Failed to read packet from socket");
-        return kError;
-    }
-    
-    struct timeval timeRecv;
-    if (gettimeofday(&timeRecv, NULL))
+    // Does this look like a valid ICMP packet? The returned packet will include the IP header.
+    if (bytesRead < (ssize_t)(sizeof(struct hdr_ip) + ICMP_MINLEN))
     {
-        NSLog(@"Could not get receive time");
+        NSLog(@"Received packet was not long enough to be an ICMP response");
         return kError;
     }
     
-//  NSLog(@"Read %lu bytes from %s", bytesRead, inet_ntoa(((struct sockaddr_in*)&srcAddr)->sin_addr));
-    
-    // Does this look like a valid ICMP error response? The returned packet will include the IP header.
-    if (bytesRead < bytesNeeded)
-    {
-        NSLog(@"Received packet was not long enough to be an ICMP error response");
-        return kError;
-    }
-    
-    struct hdr_ip* ipHdr = (struct hdr_ip*)[packetRecv bytes];
+    struct hdr_ip* ipHdr = (struct hdr_ip*)packetRecv;
     if (IP_VERSION(ipHdr) != 0x04)
     {
         NSLog(@"Received packet was not IPv4");
@@ -337,20 +462,44 @@ struct payload
         return kError;
     }
     
-    // Validate the checksum
-    struct icmp* icmpRecvHdr = (struct icmp*)((unsigned char*)[packetRecv mutableBytes] + IP_HDR_LEN(ipHdr));
+    struct icmp* icmpRecvHdr = (struct icmp*)(packetRecv + IP_HDR_LEN(ipHdr));
+    BOOL isError = (icmpRecvHdr->icmp_type == ICMP_TIMXCEED || icmpRecvHdr->icmp_type == ICMP_UNREACH);
+    
+    if ( ! isError && icmpRecvHdr->icmp_type != ICMP_ECHOREPLY)
+    {
+        NSLog(@"Received ICMP packet was not time exceeded, port unreachable or echo reply (type: %X)", icmpRecvHdr->icmp_type);
+        return kError;
+    }
     
     /**
-     * NOTE: Unprivileged ICMP sockets contain two IP header fields that are converted by the kernel to host byte order
-     *       on reception (even though they're in NBO on the wire). We must convert them back in order for the checksum
-     *       to match (we only need to do this in the reflected IP header contained in the data section of the ICMP packet
-     *       itself because we're calculating the ICMP checksum only over the ICMP portion of the packet, not including
-     *       the wrapping received IP header).
+     * Returned ICMP time exceeded or destination unreachable packet should contain IP header, ICMP header, sent IP
+     * header and the first 8 bytes of the sent transport header (which covers the UDP header, the ICMP echo header
+     * and the TCP ports and sequence number). It may also include our payload but this is highly router dependant
+     * and we do not require it.
      */
-    struct hdr_ip* ipHdrReflected = (struct hdr_ip*)((unsigned char*)[packetRecv mutableBytes] + IP_HDR_LEN(ipHdr) + 8 /* skip over ICMP header */);
-    ipHdrReflected->ip_len = htons(ipHdrReflected->ip_len);
-    ipHdrReflected->ip_flags_offset = htons(ipHdrReflected->ip_flags_offset);
+    struct hdr_ip* ipHdrReflected = (struct hdr_ip*)(packetRecv + IP_HDR_LEN(ipHdr) + 8 /* skip over ICMP header */);
+    
+    if (isError)
+    {
+        if (bytesRead < (ssize_t)(IP_HDR_LEN(ipHdr) + 8 + sizeof(struct hdr_ip)) ||
+            bytesRead < (ssize_t)(IP_HDR_LEN(ipHdr) + 8 + IP_HDR_LEN(ipHdrReflected) + 8))
+        {
+            NSLog(@"Received packet was not long enough to be an ICMP error response");
+            return kError;
+        }
+        
+        /**
+         * NOTE: Unprivileged ICMP sockets contain two IP header fields that are converted by the kernel to host byte order
+         *       on reception (even though they're in NBO on the wire). We must convert them back in order for the checksum
+         *       to match (we only need to do this in the reflected IP header contained in the data section of the ICMP packet
+         *       itself because we're calculating the ICMP checksum only over the ICMP portion of the packet, not including
+         *       the wrapping received IP header).
+         */
+        ipHdrReflected->ip_len = htons(ipHdrReflected->ip_len);
+        ipHdrReflected->ip_flags_offset = htons(ipHdrReflected->ip_flags_offset);
+    }
     
+    // Validate the checksum
     uint16_t checksumRecv = icmpRecvHdr->icmp_cksum;
     icmpRecvHdr->icmp_cksum = 0;    // if left at received value the checksum should compute as 0
     unsigned short checksumNeeded = [self internetChecksum:(unsigned char*)icmpRecvHdr length:(bytesRead - IP_HDR_LEN(ipHdr))];
@@ -361,118 +510,156 @@ struct payload
         return kError;
     }
     
-    // Is this a time exceeded or port unreachable?
-    if (icmpRecvHdr->icmp_type != ICMP_TIMXCEED && icmpRecvHdr->icmp_type != ICMP_UNREACH_PORT)
+    uint16_t slot;
+    uint8_t ttl;
+    int attempt;
+    
+    // Only what the thread's method sent is matched, the socket also sees errors (and replies) for other traffic
+    if (isError ? ! [self.probeMethod matchQuotedHeader:(unsigned char*)ipHdrReflected + IP_HDR_LEN(ipHdrReflected) proto:ipHdrReflected->ip_proto slot:&slot ttl:&ttl attempt:&attempt]
+                : ! [self.probeMethod matchReply:icmpRecvHdr slot:&slot ttl:&ttl attempt:&attempt])
     {
-        NSLog(@"Received ICMP packet was not time exceeded or port unreachable (type: %X)", icmpRecvHdr->icmp_type);
-        return kError;
+        return kError;      // not a response to one of our probes
     }
     
-    // @todo: verification of payload
-    NSLog(@"Received ICMP %@ from %s", icmpRecvHdr->icmp_type == ICMP_TIMXCEED ? @"time exceeded" : @"port unreachable", inet_ntoa(((struct sockaddr_in*)&srcAddr)->sin_addr));
-
-    struct hdr_udp* udpHdrReflected = (struct hdr_udp*)((unsigned char*)[packetRecv mutableBytes] + IP_HDR_LEN(ipHdr) + 8 /* skip over ICMP header */ + IP_HDR_LEN(ipHdrReflected));
-
-    // Try to find the probe that generated this response
-    uint16_t dstPort = ntohs(udpHdrReflected->udp_dport);
-    Probe* probe;
-    
-    if ((probe = self.probesByDstUDPPort[[NSNumber numberWithInt:dstPort]]))
+    if (slot >= kMaxConcurrentTraceroutes || ttl < 1 || ttl > kMaxProbeTTL)
     {
-//      NSLog(@"Found probe record for UDP port %hu and host %@ (actual host: %s)", probe.dstPort, probe.hostIdentifier, inet_ntoa(((struct sockaddr_in*)&srcAddr)->sin_addr));
-        probe.inflight = NO;
-
-        if (icmpRecvHdr->icmp_type == ICMP_TIMXCEED)
-        {
-            // We hit a router, keep going.
-            if ([self sendPortUnreachableUDPPacketToIPAddress:probe.hostIdentifier onCompletion:nil retrying:NO] != kError)
-            {
-                return kNextHopIsRouter;
-            }
-        }
-        else
-        {
-            // End of the line.
-            probe.complete = YES;
-
-            // Calculate the number of ms elapsed between send and receive
-            probe.rttToHost = [self msElapsedBetween:probe.timeSent endTime:timeRecv];
-            
-            NSLog(@"Finished traceroute %@ (hops: %hhu, RTT: %.2fms)", probe.hostIdentifier, probe.currentTTL, probe.rttToHost);
-            
-            if (probe.completionBlock)
-            {
-                probe.completionBlock(probe);
-            }
-
-            return kNextHopIsDestination;
-        }
+        return kError;
     }
-    else
+    
+    TracerouteProbe* probe = (TracerouteProbe*)[self.probesBySlot probeInSlot:slot];
+    in_addr_t probedAddress = isError ? ipHdrReflected->ip_daddr.s_addr : ipHdr->ip_saddr.s_addr;
+    
+    // Replies for TTLs beyond the destination routinely arrive after a traceroute has finished
+    if ( ! probe || probe.dstAddress != probedAddress)
     {
-        NSLog(@"Could not find probe record for UDP port %hu", dstPort);
+        return kError;
     }
+    
+    // Only time exceeded comes from a router, an unreachable or echo reply means the probe got to the destination
+    uint32_t router = (icmpRecvHdr->icmp_type == ICMP_TIMXCEED) ? ntohl(srcAddr->sin_addr.s_addr) : 0;
 
-    return kError;
+//  NSLog(@"Received ICMP type %d from %s for %@ TTL %u", icmpRecvHdr->icmp_type, inet_ntoa(srcAddr->sin_addr), probe.hostIdentifier, ttl);
+    
+    return [self recordReplyForProbe:probe ttl:ttl attempt:attempt fromRouter:router receivedAt:timeRecv];
 }
 
-- (void)cleanupProbes
+/**
+ * A hop answered other than by ICMP (a TCP connection completing), reported by the method.
+ */
+- (void)recordReplyForSlot:(uint16_t)slot ttl:(uint8_t)ttl attempt:(int)attempt receivedAt:(uint64_t)timeRecv
 {
-    struct timeval now;
-    if (gettimeofday(&now, NULL))
+    TracerouteProbe* probe = (slot < kMaxConcurrentTraceroutes) ? (TracerouteProbe*)[self.probesBySlot probeInSlot:slot] : nil;
+    
+    if ( ! probe || ttl < 1 || ttl > kMaxProbeTTL)
     {
-        NSLog(@"Cannot determine time to cleanup probes");
         return;
     }
+    
+    [self recordReplyForProbe:probe ttl:ttl attempt:attempt fromRouter:0 receivedAt:timeRecv];
+    [self serviceTimers];
+}
 
-    NSArray* keys = self.probesByHostIdentifier.allKeys;
+/**
+ * A reply to a hop, from the router at that TTL or (if router is 0) from the destination. Every method ends up here.
+ */
+- (NSInteger)recordReplyForProbe:(TracerouteProbe*)probe ttl:(uint8_t)ttl attempt:(int)attempt fromRouter:(uint32_t)router receivedAt:(uint64_t)timeRecv
+{
+    struct hop* hop = &probe->hops[ttl];
+    if (hop->state != kHopInflight && hop->state != kHopSilent && hop->state != kHopDeferred)
+    {
+        return kError;      // duplicate
+    }
     
-    for (NSString* hostIdentifier in keys)
+    // A hop that went silent because its first send failed (or is still waiting to be sent) was never on the wire
+    if ( ! hop->attempts)
     {
-        Probe* probe = self.probesByHostIdentifier[hostIdentifier];
-        
-        if (probe.complete)
+        return kError;
+    }
+    
+    if (attempt < 0 || attempt >= hop->attempts)
+    {
+        attempt = hop->attempts - 1;
+    }
+    
+    [self.timerWheel cancel:hop->timer];
+    hop->timer = 0;
+    
+    [self.probeMethod closeHop:hop];
+    
+    NSInteger nextHopType;
+    
+    if (router)
+    {
+        hop->state = kHopIsRouter;
+        hop->responder = router;
+        nextHopType = kNextHopIsRouter;
+    }
+    else
+    {
+        // The destination is no further away than the first hop we sent, so the hops skipped from the path cache were wrong
+        // (unless the hop count itself came from the cache, which is all the neighbouring destination's path is trusted for)
+        if (ttl == probe.firstTTLSent && ttl > 1 && ! probe.confirmingCachedPath)
         {
-            NSLog(@"Removing complete probe %@", probe.hostIdentifier);
-            [self resetProbe:probe.hostIdentifier allowRemovalOfInflightProbes:NO];
+            NSLog(@"Destination %@ answered at the first probed TTL %u, probing skipped hops", probe.hostIdentifier, ttl);
+            
+            for (uint8_t skippedTTL = 1; skippedTTL < ttl; skippedTTL++)
+            {
+                memset(&probe->hops[skippedTTL], 0, sizeof(struct hop));
+                
+                if ( ! [self sendHop:skippedTTL forProbe:probe])
+                {
+                    probe->hops[skippedTTL].state = kHopSilent;
+                }
+            }
+            
+            probe.firstTTLSent = 1;
         }
-        else if ([self msElapsedBetween:probe.timeSent endTime:now] > kMaxProbeFlightTimeMs)
+        
+        // Replies can arrive out of order, the destination is as far away as the lowest TTL that reached it
+        hop->state = kHopIsDestination;
+        nextHopType = kNextHopIsDestination;
+        
+        if ( ! probe.destinationTTL || ttl < probe.destinationTTL)
         {
-            // This will remove or complete (depending on completeTimedOutProbes) the probe if the number of retries has been exceeded
-            NSLog(@"Retry (%d) for hop %u for timed out probe %@", probe.retries + 1, probe.currentTTL, probe.hostIdentifier);
-            [self sendProbe:probe.hostIdentifier onCompletion:probe.completionBlock retrying:YES];
+            probe.destinationTTL = ttl;
+            probe.rttToHost = [self msElapsedBetweenNs:hop->timeSent[attempt] endNs:timeRecv];
         }
     }
+    
+    [self advanceProbe:probe];
+    
+    return nextHopType;
 }
 
-- (uint16_t)generateDestinationPortForProbe
+/**
+ * A hop has had no reply within kMaxHopFlightTimeMs, resend it or give up on it if it has run out of retries. A
+ * deferred hop's wait for a probe token is also over, it is sent now if there's one.
+ */
+- (void)probeTimedOut:(uint32_t)key context:(uint32_t)context
 {
-    uint16_t dstPort, attempts = 0;
+    TracerouteProbe* probe = (TracerouteProbe*)[self.probesBySlot probeInSlot:key];
+    uint8_t ttl = context;
     
-    do
+    if ( ! probe || ttl < 1 || ttl > kMaxProbeTTL)
     {
-        dstPort = kBaseTracerouteUDPPort + (arc4random() % (65535 - kBaseTracerouteUDPPort));
-        NSNumber *portKey = [NSNumber numberWithInt:dstPort];
-        
-        // Have we already sent a probe to this port? If so, we can only reuse it if the probe is complete.
-        if (self.probesByDstUDPPort[[NSNumber numberWithInt:dstPort]])
-        {
-            Probe* existingProbe = self.probesByDstUDPPort[portKey];
-            if (existingProbe.complete)
-            {
-                // Good, we can reuse this port.
-                [self resetProbe:existingProbe.hostIdentifier allowRemovalOfInflightProbes:NO];
-            }
-            else
-            {
-                dstPort = 0;
-            }
-        }
-        
-        attempts++;
-    } while ( ! dstPort && attempts < kMaxAttemptsToFindUnusedPort);
-
-    return dstPort;
+        return;
+    }
+    
+    struct hop* hop = &probe->hops[ttl];
+    hop->timer = 0;
+    
+    // Hops at or beyond the destination aren't waited for
+    if ((hop->state != kHopInflight && hop->state != kHopDeferred) || (probe.destinationTTL && ttl >= probe.destinationTTL))
+    {
+        return;
+    }
+    
+    if ( ! [self sendHop:ttl forProbe:probe])
+    {
+        hop->state = kHopSilent;
+    }
+    
+    [self advanceProbe:probe];
 }
 
 @end
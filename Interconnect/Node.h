@@ -13,6 +13,7 @@
 @property (nonatomic, readonly) NSString* identifier;
 
 @property (nonatomic) NSUInteger orbital;
+@property (nonatomic) NSUInteger slot;                  // position within the orbital, held until the node leaves it (see NodeStore)
 @property (nonatomic) float radius;
 
 @property (nonatomic) float targetVolume;
@@ -0,0 +1,68 @@
+//
+//  NodeAnimation.cpp
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#include "NodeAnimation.hpp"
+#include <algorithm>
+
+/**
+ * Pick the colour the node is drawn with this frame then move its pulse, radius and volume on. Once none of them move
+ * the node looks the same every frame until its store changes it.
+ */
+bool NodeAnimation::animate(SceneNode& node, unsigned long orbitalNumber, size_t orbitalCount, double secondsSinceLastFrame) const
+{
+    float orbital = (float)orbitalNumber;
+    float pulseIntensity = node.pulseIntensity, radius = node.radius, volume = node.volume;
+
+    if (node.pulseIntensity > kNodeMinimumPulseIntensity && node.pulseBegin)
+    {
+        // Pulse the node from bright to dark
+        node.red = node.green = node.blue = node.pulseIntensity;
+        node.pulseIntensity -= kNodePulseDeclinePerSecond*secondsSinceLastFrame;
+    }
+    else
+    {
+        node.pulseBegin = false;
+
+        float colourIntensity = (1.0 / orbitalCount) * ((orbitalCount+1) - orbital);
+        colourIntensity = (colourIntensity >= kNodeMinimumColourIntensity) ? colourIntensity : kNodeMinimumColourIntensity;
+
+        if (node.pulseIntensity < colourIntensity)
+        {
+            // Pulse the node back to the desired intensity (prevents flashing)
+            node.red = node.green = node.blue = node.pulseIntensity;
+            node.pulseIntensity += kNodePulseDeclinePerSecond*secondsSinceLastFrame;
+        }
+        else if (colourByOrbital)
+        {
+            node.red = colourIntensity;
+            node.green = node.blue = 0;
+        }
+        // otherwise the preferred colour stands
+    }
+
+    // The node needs to float to its true orbital position
+    if (node.radius < orbital)
+    {
+        node.radius = std::min((float)(node.radius + (radiusGrowthPerSecond*secondsSinceLastFrame)), orbital);
+    }
+    else if (node.radius > orbital)
+    {
+        node.radius = std::max((float)(node.radius - (radiusGrowthPerSecond*secondsSinceLastFrame)), orbital);
+    }
+
+    if (node.volume < node.targetVolume)
+    {
+        node.volume = std::min((float)(node.volume + (kNodeVolumeGrowthPerSecond*secondsSinceLastFrame)), node.targetVolume);
+    }
+    else if (node.volume > node.targetVolume)
+    {
+        node.volume = std::max((float)(node.volume - (kNodeVolumeGrowthPerSecond*secondsSinceLastFrame)), node.targetVolume);
+    }
+
+    return node.pulseIntensity != pulseIntensity || node.radius != radius || node.volume != volume;
+}
@@ -0,0 +1,55 @@
+//
+//  NodeAnimation.hpp
+//  Interconnect
+//
+//  How a node is moved on each frame: a new node pulses from bright to dark, then fades up to its colour, floats out
+//  (or in) to its orbital and grows (or shrinks) to its target volume. NodeLayout animates the app's nodes with it and
+//  SceneBenchmark its synthetic hosts, so the benchmark measures the same work.
+//
+//  Plain C++ so it builds outside the app.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#ifndef NodeAnimation_hpp
+#define NodeAnimation_hpp
+
+#include <stddef.h>
+
+#define kNodeRadiusGrowthPerSecond 0.7                  // how fast do nodes initially change orbitals?
+#define kNodeVolumeGrowthPerSecond 0.08                 // how fast do nodes grow and shrink based on their volume?
+
+#define kNodePulseDeclinePerSecond 0.6                  // @todo: use sin / swing non-linear transition
+#define kNodeMinimumColourIntensity 0.2                 // nodes cannot have individual RGB values smaller than this
+#define kNodeMinimumPulseIntensity 0.4
+
+/**
+ * What's drawn of a node, and what animation moves on.
+ */
+struct SceneNode
+{
+    float       x, y, z;
+    float       red, green, blue;       // colour to draw with
+    float       radius;
+    float       volume;
+    float       targetVolume;
+    float       pulseIntensity;
+    bool        pulseBegin;
+    bool        drawOriginConnector;
+};
+
+class NodeAnimation
+{
+public:
+    NodeAnimation() : radiusGrowthPerSecond(kNodeRadiusGrowthPerSecond), colourByOrbital(false) {}
+
+    // The node's colour is expected to be its preferred colour, which stands once it has stopped pulsing (unless
+    // colouring by orbital). Returns whether the pulse, radius or volume moved.
+    bool animate(SceneNode& node, unsigned long orbital, size_t orbitalCount, double secondsSinceLastFrame) const;
+
+    float radiusGrowthPerSecond;
+    bool colourByOrbital;
+};
+
+#endif /* NodeAnimation_hpp */
@@ -0,0 +1,43 @@
+//
+//  NodeChangeSet.h
+//  Interconnect
+//
+//  The changes a store has made to its nodes since a layout last took them, with what the layout needs of each node
+//  copied while the store was locked. A node changed more than once has one change holding its latest values, so a set
+//  never holds more changes than the store has nodes.
+//
+//  The store fills one set while the layout reads the other, the two are swapped under the store lock (see NodeStore).
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class Node;
+
+typedef struct
+{
+    __unsafe_unretained Node* node;     // the set holds a reference until it's emptied
+    NSUInteger  orbital;
+    NSUInteger  slot;
+    float       targetVolume;
+    float       preferredRed, preferredGreen, preferredBlue;
+    float       originConnector;        // seconds to draw the connector for, the longest asked for since the last take
+    float       radius;                 // the node's own animation state, only used for nodes new to the layout
+    float       volume;
+    float       pulseIntensity;
+    BOOL        pulseBegin;
+} NodeChange;
+
+@interface NodeChangeSet : NSObject
+
+@property (nonatomic) BOOL cleared;                     // the store was emptied, changes before that were dropped
+
+- (void)noteChangeToNode:(Node*)node;
+- (void)removeAllChanges;
+
+- (const NodeChange*)changes;
+- (NSUInteger)count;
+
+@end
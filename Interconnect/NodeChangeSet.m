@@ -0,0 +1,92 @@
+//
+//  NodeChangeSet.m
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "NodeChangeSet.h"
+#import "Node.h"
+
+@interface NodeChangeSet ()
+
+@property (nonatomic, strong) NSMutableData* changeData;
+@property (nonatomic, strong) NSMapTable* changeIndices;    // node to the index of its change plus one (NSMapGet gives 0 for none)
+
+@end
+
+@implementation NodeChangeSet
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _cleared = NO;
+        _changeData = [[NSMutableData alloc] init];
+        _changeIndices = [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality
+                                                   valueOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsIntegerPersonality
+                                                       capacity:0];
+    }
+    
+    return self;
+}
+
+/**
+ * Called by the store under its lock, the node's current values replace any earlier change to it. A request to draw
+ * the node's connector is handed over rather than copied, so later changes to the node don't draw it again.
+ */
+- (void)noteChangeToNode:(Node*)node
+{
+    // The C functions keep ARC away from the integer values
+    NSUInteger index = (NSUInteger)NSMapGet(self.changeIndices, (__bridge void*)node);
+    float originConnector = 0;
+    
+    if ( ! index)
+    {
+        [self.changeData increaseLengthBy:sizeof(NodeChange)];
+        index = [self count];
+        NSMapInsert(self.changeIndices, (__bridge void*)node, (void*)index);
+    }
+    
+    NodeChange* change = (NodeChange*)[self.changeData mutableBytes] + (index - 1);
+    
+    if (change->node)
+    {
+        originConnector = change->originConnector;
+    }
+    
+    change->node = node;
+    change->orbital = node.orbital;
+    change->slot = node.slot;
+    change->targetVolume = node.targetVolume;
+    change->preferredRed = node.preferredRed;
+    change->preferredGreen = node.preferredGreen;
+    change->preferredBlue = node.preferredBlue;
+    change->originConnector = MAX(originConnector, node.originConnector);
+    change->radius = node.radius;
+    change->volume = node.volume;
+    change->pulseIntensity = node.pulseIntensity;
+    change->pulseBegin = node.pulseBegin;
+    
+    node.originConnector = 0;
+}
+
+- (void)removeAllChanges
+{
+    [self.changeData setLength:0];
+    [self.changeIndices removeAllObjects];
+    self.cleared = NO;
+}
+
+- (const NodeChange*)changes
+{
+    return (const NodeChange*)[self.changeData bytes];
+}
+
+- (NSUInteger)count
+{
+    return [self.changeData length] / sizeof(NodeChange);
+}
+
+@end
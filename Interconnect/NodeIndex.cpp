@@ -0,0 +1,480 @@
+//
+//  NodeIndex.cpp
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#include "NodeIndex.hpp"
+#include <math.h>
+#include <algorithm>
+
+#define kMaximumLeafItems       4
+#define kMaximumQueryDepth      64          // the tree is balanced, 2^64 items will do
+#define kRebuildFraction        8           // rebuild once 1/8 of the items have been added or removed since the last
+#define kRefitDegradation       2           // rebuild once refits have grown the leaves' total volume by this much
+#define kRemovedItem            UINT32_MAX
+
+void NodeIndex::update(const std::vector<NodeBounds>& items, bool regrouped)
+{
+    bool sameItems = (items.size() == _items.size()) && ! _nodes.empty();
+
+    for (size_t i = 0; i < items.size() && sameItems; i++)
+    {
+        sameItems = (items[i].identity == _items[i].identity);
+    }
+
+    // The usual case, nothing came or went since the last frame
+    if (sameItems)
+    {
+        _items = items;
+    }
+    else if ( ! remap(items))
+    {
+        rebuild();
+        return;
+    }
+
+    if (regrouped)
+    {
+        rebuild();
+        return;
+    }
+
+    refit();
+
+    if (leafVolume() > _builtLeafVolume * kRefitDegradation)
+    {
+        rebuild();
+    }
+}
+
+/**
+ * Point the tree at the new items by identity: items that are gone are removed from their leaves and new items are
+ * held aside. False if that leaves too much outside the tree and it should be rebuilt instead.
+ */
+bool NodeIndex::remap(const std::vector<NodeBounds>& items)
+{
+    _itemsByIdentity.clear();
+    _itemsByIdentity.reserve(items.size());
+
+    for (uint32_t i = 0; i < items.size(); i++)
+    {
+        _itemsByIdentity[items[i].identity] = i;
+    }
+
+    std::vector<bool> indexed(items.size(), false);
+
+    for (uint32_t& itemIndex : _order)
+    {
+        if (itemIndex == kRemovedItem)
+        {
+            continue;
+        }
+
+        std::unordered_map<const void*, uint32_t>::const_iterator it = _itemsByIdentity.find(_items[itemIndex].identity);
+
+        if (it == _itemsByIdentity.end())
+        {
+            itemIndex = kRemovedItem;
+            _removedCount++;
+        }
+        else
+        {
+            itemIndex = it->second;
+            indexed[itemIndex] = true;
+        }
+    }
+
+    _items = items;
+    _unindexed.clear();
+
+    for (uint32_t i = 0; i < items.size(); i++)
+    {
+        if ( ! indexed[i])
+        {
+            _unindexed.push_back(i);
+        }
+    }
+
+    return ! _nodes.empty() && ((_unindexed.size() + _removedCount) * kRebuildFraction) <= _order.size();
+}
+
+void NodeIndex::rebuild()
+{
+    _order.resize(_items.size());
+    _nodes.clear();
+    _unindexed.clear();
+    _removedCount = 0;
+
+    for (uint32_t i = 0; i < _order.size(); i++)
+    {
+        _order[i] = i;
+    }
+
+    if ( ! _items.empty())
+    {
+        _nodes.reserve((2 * _items.size() / kMaximumLeafItems) + 1);
+        build(0, (uint32_t)_items.size());
+    }
+
+    _builtLeafVolume = leafVolume();
+    _rebuildCount++;
+}
+
+/**
+ * Split at the median of the centres along the longest axis of the node's bounds, so the tree stays balanced however
+ * the nodes are spread.
+ */
+uint32_t NodeIndex::build(uint32_t first, uint32_t count)
+{
+    uint32_t index = (uint32_t)_nodes.size();
+    bvh_node node;
+
+    node.first = first;
+    node.count = count;
+    node.right = 0;
+    boundItems(node);
+    _nodes.push_back(node);
+
+    if (count <= kMaximumLeafItems)
+    {
+        return index;
+    }
+
+    float extent[3] = { node.max[0] - node.min[0], node.max[1] - node.min[1], node.max[2] - node.min[2] };
+    int axis = (extent[0] >= extent[1] && extent[0] >= extent[2]) ? 0 : (extent[1] >= extent[2]) ? 1 : 2;
+    uint32_t half = count / 2;
+    const std::vector<NodeBounds>& items = _items;
+
+    std::nth_element(_order.begin() + first, _order.begin() + first + half, _order.begin() + first + count, [&items, axis](uint32_t a, uint32_t b)
+    {
+        const float* centreA = &items[a].x;
+        const float* centreB = &items[b].x;
+        return centreA[axis] < centreB[axis];
+    });
+
+    build(first, half);
+    uint32_t right = build(first + half, count - half);
+
+    _nodes[index].right = right;        // not node.right, _nodes may have been reallocated
+
+    return index;
+}
+
+/**
+ * Children follow their parent so walking the nodes backwards visits every child before its parent.
+ */
+void NodeIndex::refit()
+{
+    for (size_t i = _nodes.size(); i-- > 0; )
+    {
+        bvh_node& node = _nodes[i];
+
+        if (node.right == 0)
+        {
+            boundItems(node);
+        }
+        else
+        {
+            const bvh_node& left = _nodes[i + 1];
+            const bvh_node& right = _nodes[node.right];
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                node.min[axis] = std::min(left.min[axis], right.min[axis]);
+                node.max[axis] = std::max(left.max[axis], right.max[axis]);
+            }
+        }
+    }
+}
+
+/**
+ * How much space the leaves take up, which a refit can only grow as the leaves' nodes move apart.
+ */
+float NodeIndex::leafVolume() const
+{
+    float volume = 0;
+
+    for (const bvh_node& node : _nodes)
+    {
+        // A leaf whose items have all been removed bounds nothing
+        if (node.right == 0 && node.min[0] <= node.max[0])
+        {
+            volume += (node.max[0] - node.min[0]) * (node.max[1] - node.min[1]) * (node.max[2] - node.min[2]);
+        }
+    }
+
+    return volume;
+}
+
+void NodeIndex::boundItems(bvh_node& node) const
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        node.min[axis] = INFINITY;
+        node.max[axis] = -INFINITY;
+    }
+
+    for (uint32_t i = node.first; i < node.first + node.count; i++)
+    {
+        if (_order[i] == kRemovedItem)
+        {
+            continue;
+        }
+
+        const NodeBounds& item = _items[_order[i]];
+        const float* centre = &item.x;
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            node.min[axis] = std::min(node.min[axis], centre[axis] - item.radius);
+            node.max[axis] = std::max(node.max[axis], centre[axis] + item.radius);
+        }
+    }
+}
+
+/**
+ * Gribb and Hartmann: each plane is the sum or difference of the last row of the combined matrix and one of the others.
+ * Planes are normalised so distances to them are true distances.
+ */
+void NodeIndex::frustumPlanes(const float* modelView, const float* projection, float planes[6][4])
+{
+    float m[16];
+
+    for (int column = 0; column < 4; column++)
+    {
+        for (int row = 0; row < 4; row++)
+        {
+            m[(column * 4) + row] = (projection[row] * modelView[column * 4]) + (projection[4 + row] * modelView[(column * 4) + 1]) +
+                                    (projection[8 + row] * modelView[(column * 4) + 2]) + (projection[12 + row] * modelView[(column * 4) + 3]);
+        }
+    }
+
+    for (int plane = 0; plane < 6; plane++)
+    {
+        int row = plane / 2;
+        float sign = (plane % 2) ? -1.0f : 1.0f;        // left, right, bottom, top, near, far
+
+        for (int column = 0; column < 4; column++)
+        {
+            planes[plane][column] = m[(column * 4) + 3] + (sign * m[(column * 4) + row]);
+        }
+
+        float length = sqrtf((planes[plane][0] * planes[plane][0]) + (planes[plane][1] * planes[plane][1]) + (planes[plane][2] * planes[plane][2]));
+
+        for (int column = 0; column < 4; column++)
+        {
+            planes[plane][column] /= length;
+        }
+    }
+}
+
+bool NodeIndex::itemOutside(const NodeBounds& item, const float planes[6][4]) const
+{
+    for (int plane = 0; plane < 6; plane++)
+    {
+        const float* p = planes[plane];
+
+        if (((p[0] * item.x) + (p[1] * item.y) + (p[2] * item.z) + p[3]) < -item.radius)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Appends the index of every item whose sphere is at least partly inside the frustum. Subtrees entirely inside are
+ * taken whole without testing their items. The number of tree nodes tested is counted into visitedNodes if given.
+ */
+void NodeIndex::queryFrustum(const float planes[6][4], std::vector<uint32_t>& visible, size_t* visitedNodes) const
+{
+    uint32_t stack[kMaximumQueryDepth];
+    int depth = 0;
+    size_t visited = 0;
+
+    for (uint32_t itemIndex : _unindexed)
+    {
+        if ( ! itemOutside(_items[itemIndex], planes))
+        {
+            visible.push_back(itemIndex);
+        }
+    }
+
+    if ( ! _nodes.empty())
+    {
+        stack[depth++] = 0;
+    }
+
+    while (depth > 0)
+    {
+        const bvh_node& node = _nodes[stack[--depth]];
+        bool outside = false, inside = true;
+
+        visited++;
+
+        for (int plane = 0; plane < 6 && ! outside; plane++)
+        {
+            const float* p = planes[plane];
+
+            // The corners of the box furthest along and against the plane's normal
+            float furthest = (p[0] * (p[0] >= 0 ? node.max[0] : node.min[0])) + (p[1] * (p[1] >= 0 ? node.max[1] : node.min[1])) + (p[2] * (p[2] >= 0 ? node.max[2] : node.min[2])) + p[3];
+            float nearest = (p[0] * (p[0] >= 0 ? node.min[0] : node.max[0])) + (p[1] * (p[1] >= 0 ? node.min[1] : node.max[1])) + (p[2] * (p[2] >= 0 ? node.min[2] : node.max[2])) + p[3];
+
+            outside = (furthest < 0);
+            inside = inside && (nearest >= 0);
+        }
+
+        if (outside)
+        {
+            continue;
+        }
+
+        if (inside && _removedCount == 0)
+        {
+            visible.insert(visible.end(), _order.begin() + node.first, _order.begin() + node.first + node.count);
+        }
+        else if (inside || node.right == 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                if (_order[i] != kRemovedItem && (inside || ! itemOutside(_items[_order[i]], planes)))
+                {
+                    visible.push_back(_order[i]);
+                }
+            }
+        }
+        else
+        {
+            stack[depth++] = node.right;
+            stack[depth++] = (uint32_t)(&node - &_nodes[0]) + 1;
+        }
+    }
+
+    if (visitedNodes)
+    {
+        *visitedNodes = visited;
+    }
+}
+
+bool NodeIndex::rayHitsItem(const NodeBounds& item, const float origin[3], const float direction[3], float& distance) const
+{
+    float toCentre[3] = { item.x - origin[0], item.y - origin[1], item.z - origin[2] };
+    float along = (toCentre[0] * direction[0]) + (toCentre[1] * direction[1]) + (toCentre[2] * direction[2]);
+    float missBySquared = (toCentre[0] * toCentre[0]) + (toCentre[1] * toCentre[1]) + (toCentre[2] * toCentre[2]) - (along * along);
+    float radiusSquared = item.radius * item.radius;
+
+    if (missBySquared > radiusSquared)
+    {
+        return false;
+    }
+
+    float halfChord = sqrtf(radiusSquared - missBySquared);
+
+    // Where the ray enters the sphere, or leaves it if it starts inside
+    distance = (along - halfChord >= 0) ? along - halfChord : along + halfChord;
+
+    return distance >= 0;
+}
+
+/**
+ * Slab test, distance is where the ray enters the box (zero if it starts inside).
+ */
+bool NodeIndex::rayHitsNode(const bvh_node& node, const float origin[3], const float inverseDirection[3], float& distance) const
+{
+    float enter = 0, leave = INFINITY;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float toMin = (node.min[axis] - origin[axis]) * inverseDirection[axis];
+        float toMax = (node.max[axis] - origin[axis]) * inverseDirection[axis];
+
+        enter = std::max(enter, std::min(toMin, toMax));
+        leave = std::min(leave, std::max(toMin, toMax));
+    }
+
+    distance = enter;
+
+    return enter <= leave;
+}
+
+/**
+ * Nearer children are visited first and anything further than the nearest hit so far is skipped, so only the few
+ * nodes around the ray are visited.
+ */
+bool NodeIndex::queryRay(const float origin[3], const float direction[3], uint32_t& nearestItem, float* nearestDistance) const
+{
+    float inverseDirection[3] = { 1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2] };
+    float nearest = INFINITY, distance;
+    uint32_t stack[kMaximumQueryDepth];
+    int depth = 0;
+
+    for (uint32_t itemIndex : _unindexed)
+    {
+        if (rayHitsItem(_items[itemIndex], origin, direction, distance) && distance < nearest)
+        {
+            nearest = distance;
+            nearestItem = itemIndex;
+        }
+    }
+
+    if ( ! _nodes.empty() && rayHitsNode(_nodes[0], origin, inverseDirection, distance))
+    {
+        stack[depth++] = 0;
+    }
+
+    while (depth > 0)
+    {
+        uint32_t index = stack[--depth];
+        const bvh_node& node = _nodes[index];
+
+        if ( ! rayHitsNode(node, origin, inverseDirection, distance) || distance > nearest)
+        {
+            continue;
+        }
+
+        if (node.right == 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                if (_order[i] != kRemovedItem && rayHitsItem(_items[_order[i]], origin, direction, distance) && distance < nearest)
+                {
+                    nearest = distance;
+                    nearestItem = _order[i];
+                }
+            }
+
+            continue;
+        }
+
+        float leftDistance, rightDistance;
+        bool hitsLeft = rayHitsNode(_nodes[index + 1], origin, inverseDirection, leftDistance);
+        bool hitsRight = rayHitsNode(_nodes[node.right], origin, inverseDirection, rightDistance);
+
+        // The nearer child goes on the stack last so it's visited first
+        if (hitsLeft && hitsRight && leftDistance < rightDistance)
+        {
+            stack[depth++] = node.right;
+            stack[depth++] = index + 1;
+        }
+        else if (hitsLeft && hitsRight)
+        {
+            stack[depth++] = index + 1;
+            stack[depth++] = node.right;
+        }
+        else if (hitsLeft || hitsRight)
+        {
+            stack[depth++] = hitsLeft ? index + 1 : node.right;
+        }
+    }
+
+    if (nearestDistance)
+    {
+        *nearestDistance = nearest;
+    }
+
+    return nearest != INFINITY;
+}
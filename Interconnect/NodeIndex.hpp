@@ -0,0 +1,82 @@
+//
+//  NodeIndex.hpp
+//  Interconnect
+//
+//  A bounding volume hierarchy over the laid out node spheres, used to find the nodes inside the view frustum and the
+//  node under the mouse without visiting the rest. Items are identified by their index in the array they were given in.
+//
+//  Nodes only move while they float to a new orbital or grow, so the hierarchy is built once for a set of nodes and
+//  then refit (bounds recomputed bottom up, O(n) with no sorting) every frame. When nodes come and go the tree is kept:
+//  nodes that left are dropped from their leaves, new nodes are tested one by one beside the tree, and it's only
+//  rebuilt once those add up to a good part of the whole.
+//
+//  A refit keeps each leaf's nodes together however far apart they've moved, so the tree is also rebuilt when nodes
+//  have been regrouped (they jump to the direction of a new slot) and when refitting has left the leaves' boxes holding
+//  a good deal more space than they did when the tree was built.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#ifndef NodeIndex_hpp
+#define NodeIndex_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+struct NodeBounds
+{
+    const void* identity;           // the same node must have the same identity from one update to the next
+    float x, y, z;
+    float radius;
+};
+
+class NodeIndex
+{
+public:
+    NodeIndex() : _removedCount(0), _rebuildCount(0), _builtLeafVolume(0) {}
+
+    // Regrouped is whether any node has changed orbital or slot since the last update
+    void update(const std::vector<NodeBounds>& items, bool regrouped = false);
+
+    // Planes (a, b, c, d with ax + by + cz + d >= 0 inside) of the frustum of a column major projection * modelview
+    static void frustumPlanes(const float* modelView, const float* projection, float planes[6][4]);
+    void queryFrustum(const float planes[6][4], std::vector<uint32_t>& visible, size_t* visitedNodes = NULL) const;
+
+    // The item whose sphere a ray (origin + t * direction, t >= 0, direction normalised) meets first, false if none
+    bool queryRay(const float origin[3], const float direction[3], uint32_t& nearestItem, float* nearestDistance = NULL) const;
+
+    size_t itemCount() const { return _items.size(); }
+    size_t rebuildCount() const { return _rebuildCount; }
+
+private:
+    struct bvh_node
+    {
+        float min[3], max[3];
+        uint32_t first, count;      // range of _order covered by the node
+        uint32_t right;             // second child (the first follows the node), 0 for a leaf
+    };
+
+    bool remap(const std::vector<NodeBounds>& items);
+    void rebuild();
+    uint32_t build(uint32_t first, uint32_t count);
+    void refit();
+    float leafVolume() const;
+    void boundItems(bvh_node& node) const;
+    bool itemOutside(const NodeBounds& item, const float planes[6][4]) const;
+    bool rayHitsItem(const NodeBounds& item, const float origin[3], const float direction[3], float& distance) const;
+    bool rayHitsNode(const bvh_node& node, const float origin[3], const float inverseDirection[3], float& distance) const;
+
+    std::vector<NodeBounds> _items;
+    std::vector<uint32_t> _order;           // item indices, each node covers a contiguous run (kRemovedItem once gone)
+    std::vector<bvh_node> _nodes;           // pre-order, children always follow their parent
+    std::vector<uint32_t> _unindexed;       // items added since the last rebuild
+    std::unordered_map<const void*, uint32_t> _itemsByIdentity;     // of the items being remapped, kept for its buckets
+    size_t _removedCount;
+    size_t _rebuildCount;
+    float _builtLeafVolume;                 // total volume of the leaves' boxes when the tree was last built
+};
+
+#endif /* NodeIndex_hpp */
@@ -0,0 +1,61 @@
+//
+//  NodeLayout.h
+//  Interconnect
+//
+//  The stage between the node store and the renderer. The store is locked only long enough to swap out the changes it
+//  has made since the last layout (see NodeChangeSet), which are applied to the layout's own copy of every node with
+//  the store unlocked. Positions, colours and animation are then worked out into a flat array of render records. Records
+//  are double buffered: the view draws from the front buffer while the next layout fills the back buffer, and the two
+//  are swapped once it's done.
+//
+//  Once a node has been created its radius, volume, pulse and connector are only animated here (as is whether the view
+//  picked it), the node itself keeps its initial values.
+//
+//  The laid out records are indexed (see NodeIndex) so the view can find those inside its frustum without visiting the
+//  rest, item indices are record indices.
+//
+//  Records hold Objective-C objects so this header is for Objective-C++ only. Not thread safe, expected to be owned by
+//  the render thread.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "NodeIndex.hpp"
+#import "NodeAnimation.hpp"
+
+@class Node;
+@class NodeStore;
+
+typedef enum
+{
+    kColourationByOrbital = 0,                          // colour nodes based on their orbital (itself determined by the grouping strategy)
+    kColourationByPreferredColour                       // colour nodes based on their preferred colour
+} ColourationMode;
+
+/**
+ * What's drawn of a node (see SceneFrame) and which node it is.
+ */
+struct NodeRenderRecord : SceneNode
+{
+    Node*       node;                   // held so the record stays valid should the store let go of the node
+    NSUInteger  orbital;
+    NSUInteger  slot;
+    BOOL        selected;               // may be changed by the view
+    BOOL        visible;                // set by the view for records inside its frustum
+};
+
+@interface NodeLayout : NSObject
+
+@property (nonatomic) ColourationMode colourationMode;
+@property (nonatomic) float nodeRadiusGrowthPerSecond;
+@property (nonatomic, readonly) BOOL isAnimating;       // did the last layout move any node on (pulse, radius, volume or connector)?
+
+- (void)layoutStore:(NodeStore*)store secondsSinceLastFrame:(double)secondsSinceLastFrame;
+
+- (NodeRenderRecord*)records;           // front buffer, as of the last layout
+- (NSUInteger)recordCount;
+- (const NodeIndex&)index;              // of the front buffer
+
+@end
@@ -0,0 +1,294 @@
+//
+//  NodeLayout.mm
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "NodeLayout.h"
+#import "NodeStore.h"
+#import "NodeChangeSet.h"
+#import "Node.h"
+#import "OrbitalLayout.hpp"
+#import <assert.h>
+#import <math.h>
+#import <map>
+#import <unordered_map>
+#import <vector>
+
+/**
+ * The layout's copy of a node, kept from one layout to the next. Changes from the store replace what the store owns,
+ * the rest is animated here.
+ */
+struct node_state
+{
+    Node*       node;
+    NSUInteger  orbital;
+    NSUInteger  slot;
+    float       preferredRed, preferredGreen, preferredBlue;
+    float       targetVolume;
+    float       originConnector;                    // seconds left to draw the connector for
+    float       radius;
+    float       volume;
+    float       pulseIntensity;
+    BOOL        pulseBegin;
+    BOOL        selected;
+};
+
+/**
+ * The records of each orbital are contiguous in the buffer.
+ */
+struct orbital_span
+{
+    NSUInteger  orbital;
+    NSUInteger  first;
+    NSUInteger  count;
+    NSUInteger  slotCount;                          // one past the highest slot held
+};
+
+@interface NodeLayout ()
+{
+    std::vector<struct node_state> _nodes;
+    std::unordered_map<const void*, uint32_t> _nodeIndices;     // node to its index in _nodes
+    NodeChangeSet* _changes;                        // last taken from the store, emptied for the next take
+    std::vector<NodeRenderRecord> _buffers[2];
+    std::vector<uint32_t> _bufferNodes[2];          // index in _nodes of each record
+    std::map<NSUInteger, struct orbital_span> _orbitals;    // of the buffer being laid out
+    OrbitalLayout _orbitalLayout;                   // slot directions of each orbital
+    NodeAnimation _animation;
+    std::vector<NodeBounds> _bounds;
+    NodeIndex _index;
+    BOOL _regrouped;                                // a node changed orbital or slot in the changes being laid out
+    int _front;
+}
+
+@end
+
+@implementation NodeLayout
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _front = 0;
+        _regrouped = NO;
+        _isAnimating = NO;
+        _colourationMode = kColourationByPreferredColour;
+        _nodeRadiusGrowthPerSecond = kNodeRadiusGrowthPerSecond;
+    }
+
+    return self;
+}
+
+- (NodeRenderRecord*)records
+{
+    return _buffers[_front].data();
+}
+
+- (NSUInteger)recordCount
+{
+    return _buffers[_front].size();
+}
+
+- (const NodeIndex&)index
+{
+    return _index;
+}
+
+/**
+ * Take the store's changes, lay every node out into the back buffer and make it the front buffer.
+ */
+- (void)layoutStore:(NodeStore*)store secondsSinceLastFrame:(double)secondsSinceLastFrame
+{
+    std::vector<NodeRenderRecord>& front = _buffers[_front];
+    std::vector<NodeRenderRecord>& back = _buffers[1 - _front];
+    std::vector<uint32_t>& backNodes = _bufferNodes[1 - _front];
+
+    [_changes removeAllChanges];
+
+    [store lockStore];
+    _changes = [store takeChanges:_changes];
+    [store unlockStore];
+
+    // What the view picked is kept with the nodes before the changes are applied (which may clear them)
+    for (size_t i = 0; i < front.size(); i++)
+    {
+        _nodes[_bufferNodes[_front][i]].selected = front[i].selected;
+    }
+
+    [self applyChanges:_changes];
+
+    _animation.radiusGrowthPerSecond = self.nodeRadiusGrowthPerSecond;
+    _animation.colourByOrbital = (self.colourationMode == kColourationByOrbital);
+
+    back.clear();
+    backNodes.clear();
+    _orbitals.clear();
+    _isAnimating = NO;
+
+    // Count each orbital's nodes so its records can be placed together
+    for (const struct node_state& state : _nodes)
+    {
+        struct orbital_span& span = _orbitals[state.orbital];
+
+        span.orbital = state.orbital;
+        span.count++;
+        span.slotCount = MAX(span.slotCount, state.slot + 1);
+    }
+
+    NSUInteger first = 0;
+    std::vector<unsigned long> inhabitedOrbitals;
+
+    for (auto& orbital : _orbitals)
+    {
+        orbital.second.first = first;
+        first += orbital.second.count;
+        orbital.second.count = 0;       // counts back up as records are placed
+        inhabitedOrbitals.push_back(orbital.first);
+    }
+
+    back.resize(_nodes.size());
+    backNodes.resize(_nodes.size());
+
+    for (uint32_t i = 0; i < _nodes.size(); i++)
+    {
+        struct node_state& state = _nodes[i];
+        struct orbital_span& span = _orbitals[state.orbital];
+        NodeRenderRecord& record = back[span.first + span.count];
+
+        record.node = state.node;
+        record.orbital = state.orbital;
+        record.slot = state.slot;
+        record.x = record.y = record.z = 0;
+        record.red = state.preferredRed;
+        record.green = state.preferredGreen;
+        record.blue = state.preferredBlue;
+        record.radius = state.radius;
+        record.volume = state.volume;
+        record.targetVolume = state.targetVolume;
+        record.pulseIntensity = state.pulseIntensity;
+        record.pulseBegin = state.pulseBegin;
+        record.selected = state.selected;
+        record.visible = NO;
+
+        record.drawOriginConnector = (state.originConnector > 0);
+        if (record.drawOriginConnector)
+        {
+            state.originConnector -= secondsSinceLastFrame;
+            _isAnimating = YES;
+        }
+
+        backNodes[span.first + span.count] = i;
+        span.count++;
+    }
+
+    for (const auto& orbital : _orbitals)
+    {
+        const struct orbital_span& span = orbital.second;
+        [self layoutOrbital:span of:_orbitals.size() inRecords:back.data() + span.first secondsSinceLastFrame:secondsSinceLastFrame];
+    }
+
+    _orbitalLayout.forgetOrbitalsOtherThan(inhabitedOrbitals);
+
+    // Mostly a refit, nodes keep their order within an orbital from one layout to the next
+    _bounds.resize(back.size());
+
+    for (size_t i = 0; i < back.size(); i++)
+    {
+        NodeRenderRecord& record = back[i];
+        struct node_state& state = _nodes[backNodes[i]];
+
+        // The animation carries on from here next layout
+        state.radius = record.radius;
+        state.volume = record.volume;
+        state.pulseIntensity = record.pulseIntensity;
+        state.pulseBegin = record.pulseBegin;
+
+        NodeBounds bounds = { (__bridge const void*)record.node, record.x, record.y, record.z, record.volume };
+        _bounds[i] = bounds;
+    }
+
+    _index.update(_bounds, _regrouped);
+
+    _front = 1 - _front;
+}
+
+/**
+ * The changes were copied under the store lock so they're read here without it. A node new to the layout starts from
+ * the node's own animation state, otherwise only what the store owns is replaced.
+ */
+- (void)applyChanges:(NodeChangeSet*)changes
+{
+    _regrouped = NO;
+
+    if (changes.cleared)
+    {
+        _nodes.clear();
+        _nodeIndices.clear();
+    }
+
+    const NodeChange* change = [changes changes];
+
+    for (NSUInteger i = 0; i < [changes count]; i++, change++)
+    {
+        auto found = _nodeIndices.find((__bridge const void*)change->node);
+        struct node_state* state;
+
+        if (found == _nodeIndices.end())
+        {
+            _nodeIndices[(__bridge const void*)change->node] = (uint32_t)_nodes.size();
+            _nodes.push_back(node_state());
+
+            state = &_nodes.back();
+            state->node = change->node;
+            state->radius = change->radius;
+            state->volume = change->volume;
+            state->pulseIntensity = change->pulseIntensity;
+            state->pulseBegin = change->pulseBegin;
+            state->originConnector = 0;
+            state->selected = NO;
+        }
+        else
+        {
+            state = &_nodes[found->second];
+            _regrouped = _regrouped || state->orbital != change->orbital || state->slot != change->slot;
+        }
+
+        state->orbital = change->orbital;
+        state->slot = change->slot;
+        state->preferredRed = change->preferredRed;
+        state->preferredGreen = change->preferredGreen;
+        state->preferredBlue = change->preferredBlue;
+        state->targetVolume = change->targetVolume;
+        state->originConnector = MAX(state->originConnector, change->originConnector);
+    }
+}
+
+/**
+ * Each node is drawn in the direction of its slot (see OrbitalLayout), only slots the orbital hasn't held before are
+ * computed.
+ */
+- (void)layoutOrbital:(const struct orbital_span&)span of:(NSUInteger)orbitalCount inRecords:(NodeRenderRecord*)records secondsSinceLastFrame:(double)secondsSinceLastFrame
+{
+    const OrbitalDirections& directions = _orbitalLayout.directions(span.orbital, span.slotCount);
+
+    for (NSUInteger i = 0; i < span.count; i++)
+    {
+        NodeRenderRecord& record = records[i];
+        float radius = record.radius;
+
+        assert(record.slot < directions.slotCount);
+
+        record.x = radius * directions.x[record.slot];
+        record.y = radius * directions.y[record.slot];
+        record.z = radius * directions.z[record.slot];
+
+        if (_animation.animate(record, record.orbital, orbitalCount, secondsSinceLastFrame))
+        {
+            _isAnimating = YES;
+        }
+    }
+}
+
+@end
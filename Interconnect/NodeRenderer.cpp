@@ -0,0 +1,490 @@
+//
+//  NodeRenderer.cpp
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#include "NodeRenderer.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+#define kInitialInstanceCapacity 1024
+
+/**
+ * Tessellation of each level and the smallest on screen radius (pixels) it's used for. Each level keeps the sphere's
+ * silhouette within about half a pixel of a true circle: a polygon of n sides strays r * (1 - cos(pi / n)) from it.
+ * Anything smaller than the last threshold is an impostor, which is exact at any size.
+ */
+#define kHighDetailSlices       32          // matches the gluSphere the display list was built from
+#define kMediumDetailSlices     16
+#define kLowDetailSlices        8
+#define kHighDetailPixels       24.0f
+#define kMediumDetailPixels     8.0f
+#define kLowDetailPixels        3.0f
+
+#define kAttribVertex           0           // unit sphere vertex, doubles as its normal
+#define kAttribPlacement        1           // per instance: centre and scale
+#define kAttribColour           2           // per instance
+
+/**
+ * Lighting follows the fixed-function equation for a single positional light with no specular component (the material
+ * has none by default), which is all the view has ever enabled. As with fixed-function lighting the colour of a lit node
+ * comes from the material, not the node.
+ */
+#define LIT_COLOUR_FUNCTION \
+    "vec4 litColour(vec3 normal, vec3 eyePosition)\n" \
+    "{\n" \
+    "    vec3 toLight = normalize(gl_LightSource[1].position.xyz - eyePosition);\n" \
+    "    return gl_FrontLightModelProduct.sceneColor + gl_FrontLightProduct[1].ambient + (gl_FrontLightProduct[1].diffuse * max(dot(normal, toLight), 0.0));\n" \
+    "}\n"
+
+static const char* kVertexShaderSource =
+    "#version 120\n"
+    "attribute vec3 vertex;\n"
+    "attribute vec4 placement;\n"
+    "attribute vec3 colour;\n"
+    "uniform bool lighting;\n"
+    "varying vec4 frontColour;\n"
+    LIT_COLOUR_FUNCTION
+    "void main()\n"
+    "{\n"
+    "    vec4 eyePosition = gl_ModelViewMatrix * vec4(placement.xyz + (vertex * placement.w), 1.0);\n"
+    "    gl_Position = gl_ProjectionMatrix * eyePosition;\n"
+    "    frontColour = lighting ? litColour(normalize(gl_NormalMatrix * vertex), eyePosition.xyz) : vec4(colour, 1.0);\n"
+    "}\n";
+
+static const char* kFragmentShaderSource =
+    "#version 120\n"
+    "varying vec4 frontColour;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = frontColour;\n"
+    "}\n";
+
+/**
+ * The impostor quad faces the eye and is just large enough to cover the sphere's silhouette (the cone from the eye
+ * touching the sphere cuts the quad's plane in a circle of radius r * d / sqrt(d^2 - r^2)). Only nodes well clear of
+ * the eye are drawn this way so d is always larger than r.
+ */
+static const char* kImpostorVertexShaderSource =
+    "#version 120\n"
+    "attribute vec3 vertex;\n"
+    "attribute vec4 placement;\n"
+    "attribute vec3 colour;\n"
+    "varying vec3 eyePoint;\n"
+    "varying vec3 eyeCentre;\n"
+    "varying float radius;\n"
+    "varying vec3 flatColour;\n"
+    "void main()\n"
+    "{\n"
+    "    eyeCentre = (gl_ModelViewMatrix * vec4(placement.xyz, 1.0)).xyz;\n"
+    "    radius = placement.w;\n"
+    "    flatColour = colour;\n"
+    "    float distance = length(eyeCentre);\n"
+    "    vec3 forward = eyeCentre / distance;\n"
+    "    vec3 right = normalize(cross(forward, abs(forward.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));\n"
+    "    vec3 up = cross(right, forward);\n"
+    "    float extent = radius * distance / sqrt(max((distance * distance) - (radius * radius), 1e-6));\n"
+    "    eyePoint = eyeCentre + (((right * vertex.x) + (up * vertex.y)) * extent);\n"
+    "    gl_Position = gl_ProjectionMatrix * vec4(eyePoint, 1.0);\n"
+    "}\n";
+
+static const char* kImpostorFragmentShaderSource =
+    "#version 120\n"
+    "uniform bool lighting;\n"
+    "varying vec3 eyePoint;\n"
+    "varying vec3 eyeCentre;\n"
+    "varying float radius;\n"
+    "varying vec3 flatColour;\n"
+    LIT_COLOUR_FUNCTION
+    "void main()\n"
+    "{\n"
+    "    vec3 ray = normalize(eyePoint);\n"
+    "    float along = dot(ray, eyeCentre);\n"
+    "    float discriminant = (along * along) - dot(eyeCentre, eyeCentre) + (radius * radius);\n"
+    "    if (discriminant < 0.0)\n"
+    "    {\n"
+    "        discard;\n"
+    "    }\n"
+    "    vec3 hit = ray * (along - sqrt(discriminant));\n"
+    "    vec4 clip = gl_ProjectionMatrix * vec4(hit, 1.0);\n"
+    "    gl_FragDepth = (((clip.z / clip.w) * gl_DepthRange.diff) + gl_DepthRange.near + gl_DepthRange.far) * 0.5;\n"
+    "    gl_FragColor = lighting ? litColour((hit - eyeCentre) / radius, hit) : vec4(flatColour, 1.0);\n"
+    "}\n";
+
+static GLuint CompileShader(GLenum type, const char* source)
+{
+    GLuint shader = glCreateShader(type);
+    GLint compiled = GL_FALSE;
+
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+
+    if ( ! compiled)
+    {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        fprintf(stderr, "NodeRenderer: could not compile %s shader: %s\n", type == GL_VERTEX_SHADER ? "vertex" : "fragment", log);
+
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+NodeRenderer::NodeRenderer() :
+    _program(0),
+    _uniformLighting(-1),
+    _impostorProgram(0),
+    _impostorUniformLighting(-1),
+    _instanceBuffer(0),
+    _instanceBufferCapacity(0),
+    _levelOfDetail(true)
+{
+    memset(_meshes, 0, sizeof(_meshes));
+    memset(_drawnCounts, 0, sizeof(_drawnCounts));
+}
+
+/**
+ * Expects the context the renderer was prepared in to be current.
+ */
+NodeRenderer::~NodeRenderer()
+{
+    if (_program)
+    {
+        glDeleteProgram(_program);
+    }
+
+    if (_impostorProgram)
+    {
+        glDeleteProgram(_impostorProgram);
+    }
+
+    for (int detail = 0; detail < kNodeDetailLevels; detail++)
+    {
+        GLuint buffers[] = { _meshes[detail].vertexBuffer, _meshes[detail].indexBuffer };
+        glDeleteBuffers(2, buffers);
+    }
+
+    glDeleteBuffers(1, &_instanceBuffer);
+}
+
+bool NodeRenderer::prepare()
+{
+    if (_program)
+    {
+        return true;
+    }
+
+    const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+
+    if ( ! extensions || ! strstr(extensions, "GL_ARB_instanced_arrays"))
+    {
+        fprintf(stderr, "NodeRenderer: GL_ARB_instanced_arrays is not supported by %s\n", glGetString(GL_RENDERER));
+        return false;
+    }
+
+    _program = buildProgram(kVertexShaderSource, kFragmentShaderSource);
+    _impostorProgram = buildProgram(kImpostorVertexShaderSource, kImpostorFragmentShaderSource);
+
+    if ( ! _program || ! _impostorProgram)
+    {
+        glDeleteProgram(_program);
+        glDeleteProgram(_impostorProgram);
+        _program = _impostorProgram = 0;
+        return false;
+    }
+
+    _uniformLighting = glGetUniformLocation(_program, "lighting");
+    _impostorUniformLighting = glGetUniformLocation(_impostorProgram, "lighting");
+
+    buildSphere(kHighDetailSlices, kHighDetailSlices, _meshes[kNodeDetailHigh]);
+    buildSphere(kMediumDetailSlices, kMediumDetailSlices, _meshes[kNodeDetailMedium]);
+    buildSphere(kLowDetailSlices, kLowDetailSlices, _meshes[kNodeDetailLow]);
+    buildImpostor(_meshes[kNodeDetailImpostor]);
+
+    glGenBuffers(1, &_instanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, _instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, kInitialInstanceCapacity * sizeof(NodeInstance), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    _instanceBufferCapacity = kInitialInstanceCapacity;
+    _instances.reserve(kInitialInstanceCapacity);
+
+    return true;
+}
+
+GLuint NodeRenderer::buildProgram(const char* vertexShaderSource, const char* fragmentShaderSource)
+{
+    GLuint vertexShader = CompileShader(GL_VERTEX_SHADER, vertexShaderSource);
+    GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+
+    if ( ! vertexShader || ! fragmentShader)
+    {
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    GLint linked = GL_FALSE;
+
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+
+    // Attribute 0 must be per vertex, some drivers won't draw anything if it's instanced
+    glBindAttribLocation(program, kAttribVertex, "vertex");
+    glBindAttribLocation(program, kAttribPlacement, "placement");
+    glBindAttribLocation(program, kAttribColour, "colour");
+
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+
+    glDeleteShader(vertexShader);       // flagged for deletion, they go with the program
+    glDeleteShader(fragmentShader);
+
+    if ( ! linked)
+    {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        fprintf(stderr, "NodeRenderer: could not link program: %s\n", log);
+
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+/**
+ * A unit sphere around the Z axis, as gluSphere would build it, as an indexed triangle list.
+ */
+void NodeRenderer::buildSphere(int slices, int stacks, Mesh& mesh)
+{
+    std::vector<GLfloat> vertices;
+    std::vector<GLushort> indices;
+
+    vertices.reserve((slices + 1) * (stacks + 1) * 3);
+    indices.reserve(slices * stacks * 6);
+
+    for (int stack = 0; stack <= stacks; stack++)
+    {
+        double rho = M_PI * stack / stacks;
+
+        for (int slice = 0; slice <= slices; slice++)
+        {
+            double theta = 2.0 * M_PI * slice / slices;
+
+            vertices.push_back(sin(rho) * cos(theta));
+            vertices.push_back(sin(rho) * sin(theta));
+            vertices.push_back(cos(rho));
+        }
+    }
+
+    for (int stack = 0; stack < stacks; stack++)
+    {
+        for (int slice = 0; slice < slices; slice++)
+        {
+            GLushort first = (stack * (slices + 1)) + slice;
+            GLushort below = first + slices + 1;
+
+            indices.push_back(first);
+            indices.push_back(below);
+            indices.push_back(first + 1);
+
+            indices.push_back(first + 1);
+            indices.push_back(below);
+            indices.push_back(below + 1);
+        }
+    }
+
+    glGenBuffers(1, &mesh.vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenBuffers(1, &mesh.indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    mesh.indexCount = (GLsizei)indices.size();
+    mesh.mode = GL_TRIANGLES;
+}
+
+/**
+ * A unit quad, the impostor shader turns it to face the eye and sizes it.
+ */
+void NodeRenderer::buildImpostor(Mesh& mesh)
+{
+    const GLfloat vertices[] = { -1, -1, 0,   1, -1, 0,   -1, 1, 0,   1, 1, 0 };
+    const GLushort indices[] = { 0, 1, 2, 3 };
+
+    glGenBuffers(1, &mesh.vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenBuffers(1, &mesh.indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    mesh.indexCount = 4;
+    mesh.mode = GL_TRIANGLE_STRIP;
+}
+
+void NodeRenderer::addNode(GLfloat x, GLfloat y, GLfloat z, GLfloat scale, GLfloat red, GLfloat green, GLfloat blue)
+{
+    NodeInstance instance = { x, y, z, scale, red, green, blue };
+    _instances.push_back(instance);
+}
+
+/**
+ * Group the instances by level of detail, judged by the radius each will have on screen under the current modelview
+ * and projection matrices. A counting sort, the order within a level doesn't matter.
+ */
+void NodeRenderer::sortByDetail()
+{
+    GLfloat modelView[16], projection[16];
+    GLint viewport[4];
+
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelView);
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // On screen radius in pixels of a unit sphere one unit in front of the eye
+    GLfloat pixelsPerUnit = projection[5] * viewport[3] * 0.5f;
+    size_t first[kNodeDetailLevels];
+
+    _details.resize(_instances.size());
+    _sortedInstances.resize(_instances.size());
+    memset(_drawnCounts, 0, sizeof(_drawnCounts));
+
+    for (size_t i = 0; i < _instances.size(); i++)
+    {
+        const NodeInstance& instance = _instances[i];
+        GLfloat depth = -((modelView[2] * instance.x) + (modelView[6] * instance.y) + (modelView[10] * instance.z) + modelView[14]);
+        GLfloat pixels = (depth > instance.scale) ? (instance.scale * pixelsPerUnit) / depth : kHighDetailPixels;
+        NodeDetail detail = kNodeDetailImpostor;
+
+        if ( ! _levelOfDetail || pixels >= kHighDetailPixels)
+        {
+            detail = kNodeDetailHigh;       // also anything the eye is inside of or very near
+        }
+        else if (pixels >= kMediumDetailPixels)
+        {
+            detail = kNodeDetailMedium;
+        }
+        else if (pixels >= kLowDetailPixels)
+        {
+            detail = kNodeDetailLow;
+        }
+
+        _details[i] = detail;
+        _drawnCounts[detail]++;
+    }
+
+    first[0] = 0;
+    for (int detail = 1; detail < kNodeDetailLevels; detail++)
+    {
+        first[detail] = first[detail - 1] + _drawnCounts[detail - 1];
+    }
+
+    for (size_t i = 0; i < _instances.size(); i++)
+    {
+        _sortedInstances[first[_details[i]]++] = _instances[i];
+    }
+}
+
+/**
+ * Draw every node added since the last clear with the current modelview and projection matrices.
+ */
+void NodeRenderer::draw(bool lighting)
+{
+    if ( ! _program || _instances.empty())
+    {
+        return;
+    }
+
+    sortByDetail();
+
+    glBindBuffer(GL_ARRAY_BUFFER, _instanceBuffer);
+
+    while (_instanceBufferCapacity < _sortedInstances.size())
+    {
+        _instanceBufferCapacity *= 2;
+    }
+
+    // Orphan the buffer every frame so the upload never waits on the previous frame's draw
+    glBufferData(GL_ARRAY_BUFFER, _instanceBufferCapacity * sizeof(NodeInstance), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, _sortedInstances.size() * sizeof(NodeInstance), _sortedInstances.data());
+
+    size_t first = 0;
+
+    for (int detail = 0; detail < kNodeDetailLevels; detail++)
+    {
+        if (detail == kNodeDetailImpostor)
+        {
+            drawInstances(_impostorProgram, _impostorUniformLighting, _meshes[detail], first, _drawnCounts[detail], lighting);
+        }
+        else
+        {
+            drawInstances(_program, _uniformLighting, _meshes[detail], first, _drawnCounts[detail], lighting);
+        }
+
+        first += _drawnCounts[detail];
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * One instanced draw of a mesh for a run of the (uploaded, sorted) instances.
+ */
+void NodeRenderer::drawInstances(GLuint program, GLint uniformLighting, const Mesh& mesh, size_t first, size_t count, bool lighting)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    const GLubyte* firstInstance = (const GLubyte*)0 + (first * sizeof(NodeInstance));
+
+    glUseProgram(program);
+    glUniform1i(uniformLighting, lighting ? 1 : 0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, _instanceBuffer);
+
+    glEnableVertexAttribArray(kAttribPlacement);
+    glVertexAttribPointer(kAttribPlacement, 4, GL_FLOAT, GL_FALSE, sizeof(NodeInstance), firstInstance + offsetof(NodeInstance, x));
+    glVertexAttribDivisorARB(kAttribPlacement, 1);
+
+    glEnableVertexAttribArray(kAttribColour);
+    glVertexAttribPointer(kAttribColour, 3, GL_FLOAT, GL_FALSE, sizeof(NodeInstance), firstInstance + offsetof(NodeInstance, red));
+    glVertexAttribDivisorARB(kAttribColour, 1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+    glEnableVertexAttribArray(kAttribVertex);
+    glVertexAttribPointer(kAttribVertex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (const GLvoid*)0);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+    glDrawElementsInstancedARB(mesh.mode, mesh.indexCount, GL_UNSIGNED_SHORT, (const GLvoid*)0, (GLsizei)count);
+
+    // Leave the state as immediate mode drawing expects it
+    glVertexAttribDivisorARB(kAttribPlacement, 0);
+    glVertexAttribDivisorARB(kAttribColour, 0);
+    glDisableVertexAttribArray(kAttribVertex);
+    glDisableVertexAttribArray(kAttribPlacement);
+    glDisableVertexAttribArray(kAttribColour);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+}
@@ -0,0 +1,101 @@
+//
+//  NodeRenderer.hpp
+//  Interconnect
+//
+//  Draws every node sphere in a single instanced call per level of detail. Nodes are collected as per-instance records
+//  (centre, scale and colour) over the frame and uploaded to one buffer, grouped by how large each node will appear on
+//  screen. Near and large nodes get the full 32x32 sphere, smaller ones coarser meshes, and nodes only a few pixels
+//  across are drawn as impostors: a camera facing quad on which the fragment shader ray casts the sphere (including
+//  its depth), so they cost four vertices instead of a thousand.
+//
+//  Only GLSL 1.20 and ARB_instanced_arrays are required so the same code runs on a legacy macOS context and on Mesa's
+//  software rasteriser. The shader reads the fixed-function modelview and projection matrices, lighting and material,
+//  so callers set up the camera and lights exactly as they would for immediate mode drawing.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#ifndef NodeRenderer_hpp
+#define NodeRenderer_hpp
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#include <OpenGL/glext.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
+
+#include <stddef.h>
+#include <vector>
+
+struct NodeInstance
+{
+    GLfloat x, y, z;
+    GLfloat scale;
+    GLfloat red, green, blue;
+};
+
+typedef enum
+{
+    kNodeDetailHigh = 0,
+    kNodeDetailMedium,
+    kNodeDetailLow,
+    kNodeDetailImpostor,
+    kNodeDetailLevels
+} NodeDetail;
+
+class NodeRenderer
+{
+public:
+    NodeRenderer();
+    ~NodeRenderer();
+
+    bool prepare();         // needs a current context, false if instancing is not available (nothing can be drawn)
+    bool isPrepared() const { return _program != 0; }
+
+    void clear() { _instances.clear(); }
+    void addNode(GLfloat x, GLfloat y, GLfloat z, GLfloat scale, GLfloat red, GLfloat green, GLfloat blue);
+    size_t nodeCount() const { return _instances.size(); }
+
+    void draw(bool lighting);
+
+    void setLevelOfDetail(bool enabled) { _levelOfDetail = enabled; }      // otherwise every node is drawn at high detail
+    bool levelOfDetail() const { return _levelOfDetail; }
+    size_t drawnCount(NodeDetail detail) const { return _drawnCounts[detail]; }     // as of the last draw
+
+private:
+    struct Mesh
+    {
+        GLuint vertexBuffer;
+        GLuint indexBuffer;
+        GLsizei indexCount;
+        GLenum mode;
+    };
+
+    GLuint buildProgram(const char* vertexShaderSource, const char* fragmentShaderSource);
+    void buildSphere(int slices, int stacks, Mesh& mesh);
+    void buildImpostor(Mesh& mesh);
+    void sortByDetail();
+    void drawInstances(GLuint program, GLint uniformLighting, const Mesh& mesh, size_t first, size_t count, bool lighting);
+
+    GLuint _program;
+    GLint _uniformLighting;
+    GLuint _impostorProgram;
+    GLint _impostorUniformLighting;
+
+    Mesh _meshes[kNodeDetailLevels];
+
+    GLuint _instanceBuffer;
+    size_t _instanceBufferCapacity;         // in instances
+
+    bool _levelOfDetail;
+    std::vector<NodeInstance> _instances;
+    std::vector<NodeInstance> _sortedInstances;
+    std::vector<unsigned char> _details;
+    size_t _drawnCounts[kNodeDetailLevels];
+};
+
+#endif /* NodeRenderer_hpp */
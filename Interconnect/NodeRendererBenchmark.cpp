@@ -0,0 +1,151 @@
+//
+//  NodeRendererBenchmark.cpp
+//  Interconnect
+//
+//  Frame times of the node renderer over synthetic host counts, with and without level of detail. Hosts are spread
+//  over orbitals as the app would lay them out and drawn offscreen at a typical window size from the initial camera
+//  position. Not part of the app (it's the NodeRendererBenchmark tool target), or build and run with:
+//
+//      c++ -O2 -std=c++11 -DNODE_RENDERER_BENCHMARK NodeRenderer.cpp OrbitalLayout.cpp OffscreenRenderer.cpp NodeRendererBenchmark.cpp -o noderendererbench -framework OpenGL
+//      ./noderendererbench [frames]
+//
+//  On Linux link with -lEGL -lGL instead, Mesa's surfaceless platform needs no display.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#ifdef NODE_RENDERER_BENCHMARK
+
+#include "NodeRenderer.hpp"
+#include "OrbitalLayout.hpp"
+#include "OffscreenRenderer.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+#define kBenchmarkWidth         1280
+#define kBenchmarkHeight        800
+#define kBenchmarkOrbitals      8
+#define kBenchmarkFrames        20          // per measurement, unless given on the command line
+#define kBenchmarkCameraZ       8           // as the view starts
+
+/**
+ * The view's camera and light: 45 degree perspective, looking down -Z from the initial camera position.
+ */
+static void SetupScene()
+{
+    GLfloat near = 0.1f, far = 100.0f;
+    GLfloat top = near * tanf(22.5f * (M_PI / 180.0f));
+    GLfloat right = top * ((GLfloat)kBenchmarkWidth / kBenchmarkHeight);
+    GLfloat lightAmbient[]  = {0.5f, 0.5f, 0.5f, 1.0f};
+    GLfloat lightDiffuse[]  = {0.5f, 0.5f, 0.5f, 1.0f};
+    GLfloat lightPosition[] = {3.0f, 3.0f, 4.0f, 1.0f};
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glFrustum(-right, right, -top, top, near, far);
+
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glTranslatef(0, 0, -kBenchmarkCameraZ);
+
+    glLightfv(GL_LIGHT1, GL_AMBIENT, lightAmbient);
+    glLightfv(GL_LIGHT1, GL_DIFFUSE, lightDiffuse);
+    glLightfv(GL_LIGHT1, GL_POSITION, lightPosition);
+    glEnable(GL_LIGHT1);
+}
+
+/**
+ * Hosts shared evenly between the orbitals, with the volumes hosts have between first being seen and being busy.
+ */
+static void AddHosts(NodeRenderer& renderer, size_t hostCount)
+{
+    OrbitalLayout layout;
+    size_t perOrbital = (hostCount + kBenchmarkOrbitals - 1) / kBenchmarkOrbitals;
+
+    srand(1);
+    renderer.clear();
+
+    for (unsigned long orbital = 1; orbital <= kBenchmarkOrbitals; orbital++)
+    {
+        const OrbitalDirections& directions = layout.directions(orbital, perOrbital);
+
+        for (size_t slot = 0; slot < perOrbital && renderer.nodeCount() < hostCount; slot++)
+        {
+            GLfloat volume = 0.01f + (0.09f * (rand() / (GLfloat)RAND_MAX));
+
+            renderer.addNode(orbital * directions.x[slot], orbital * directions.y[slot], orbital * directions.z[slot], volume, 1, 0, 0);
+        }
+    }
+}
+
+static double MillisecondsPerFrame(NodeRenderer& renderer, int frames)
+{
+    renderer.draw(true);        // warm up, the first upload sizes the instance buffer
+    glFinish();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int frame = 0; frame < frames; frame++)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        renderer.draw(true);
+        glFinish();
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / frames;
+}
+
+int main(int argc, const char* argv[])
+{
+    const size_t hostCounts[] = { 1000, 10000, 50000, 100000 };
+    int frames = (argc > 1) ? atoi(argv[1]) : kBenchmarkFrames;
+    OffscreenRenderer offscreen(kBenchmarkWidth, kBenchmarkHeight);
+
+    if ( ! offscreen.prepare())
+    {
+        fprintf(stderr, "Could not create an offscreen context\n");
+        return 1;
+    }
+
+    // Renderers hold GL objects, so this one lives only while the context does
+    NodeRenderer* renderer = new NodeRenderer();
+
+    if ( ! renderer->prepare())
+    {
+        return 1;
+    }
+
+    SetupScene();
+
+    printf("%s, %dx%d\n", glGetString(GL_RENDERER), kBenchmarkWidth, kBenchmarkHeight);
+    printf("%8s  %12s  %12s  %8s  %28s\n", "hosts", "full ms", "lod ms", "speedup", "high / medium / low / impostor");
+
+    for (size_t hostCount : hostCounts)
+    {
+        AddHosts(*renderer, hostCount);
+
+        renderer->setLevelOfDetail(false);
+        double fullTime = MillisecondsPerFrame(*renderer, frames);
+
+        renderer->setLevelOfDetail(true);
+        double detailTime = MillisecondsPerFrame(*renderer, frames);
+
+        printf("%8zu  %12.2f  %12.2f  %7.1fx  %7zu /%7zu /%5zu /%7zu\n", hostCount, fullTime, detailTime, fullTime / detailTime,
+               renderer->drawnCount(kNodeDetailHigh), renderer->drawnCount(kNodeDetailMedium), renderer->drawnCount(kNodeDetailLow), renderer->drawnCount(kNodeDetailImpostor));
+        fflush(stdout);
+    }
+
+    delete renderer;
+
+    return 0;
+}
+
+#endif
@@ -4,6 +4,17 @@
 //
 //  Do not call methods on this class directly, use a subclass such as HostStore to ensure thread safety.
 //
+//  Every change to the store, or to a node in it, bumps the store's change count so a view can tell when it has nothing
+//  new to draw. The store's own methods do this, subclasses changing nodes directly call noteChange (under the lock), or
+//  noteChangeToNode: if they changed anything a layout draws (its volume, colour or connector).
+//
+//  Changes to how nodes are drawn are also collected in a change set (see NodeChangeSet) for the layout to take. Taking
+//  them only swaps the set for an empty one, so the layout doesn't hold the lock while it reads the nodes.
+//
+//  Each orbital hands its nodes slots, a node keeps its slot for as long as it stays in the orbital and the lowest free
+//  slot is handed out first. Slots decide where nodes are drawn, so adding, removing or regrouping a node never moves
+//  any other node.
+//
 //  @todo: Move the below interface into a private category for subclasses.
 //
 //  Created by oroboto on 16/04/2016.
@@ -13,15 +24,21 @@
 #import <Cocoa/Cocoa.h>
 
 @class Node;
+@class NodeChangeSet;
 
 @interface NodeStore : NSObject
 
+@property (atomic, readonly) NSUInteger changeCount;    // may be read without the lock
+
 - (void)addNode:(Node*)node;
 - (void)updateNode:(Node*)node withOrbital:(NSUInteger)orbital;
 - (void)clearNodes;
+- (void)noteChange;
+- (void)noteChangeToNode:(Node*)node;
+- (NodeChangeSet*)takeChanges:(NodeChangeSet*)emptyChanges;  // under the lock, emptyChanges is the set last taken (or nil)
 
 - (Node*)node:(NSString*)identifier;
-- (NSDictionary*)inhabitedOrbitals;
+- (NSDictionary*)inhabitedOrbitals;                     // orbital number to NSSet of nodes
 - (NSDictionary*)nodes;
 
 - (void)lockStore;
@@ -8,12 +8,63 @@
 
 #import "NodeStore.h"
 #import "Node.h"
+#import "NodeChangeSet.h"
+
+/**
+ * The slots of one orbital. Released slots are handed out again (lowest first) before the orbital grows.
+ */
+@interface OrbitalSlots : NSObject
+
+@property (nonatomic, strong) NSMutableIndexSet* freeSlots;
+@property (nonatomic) NSUInteger slotCount;
+
+- (NSUInteger)allocateSlot;
+- (void)releaseSlot:(NSUInteger)slot;
+
+@end
+
+@implementation OrbitalSlots
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _freeSlots = [[NSMutableIndexSet alloc] init];
+        _slotCount = 0;
+    }
+    
+    return self;
+}
+
+- (NSUInteger)allocateSlot
+{
+    NSUInteger slot = self.freeSlots.firstIndex;
+    
+    if (slot == NSNotFound)
+    {
+        return self.slotCount++;
+    }
+    
+    [self.freeSlots removeIndex:slot];
+    
+    return slot;
+}
+
+- (void)releaseSlot:(NSUInteger)slot
+{
+    [self.freeSlots addIndex:slot];
+}
+
+@end
 
 @interface NodeStore ()
 
 @property (nonatomic, strong) NSMutableDictionary* orbitals;
+@property (nonatomic, strong) NSMutableDictionary* orbitalSlots;
 @property (nonatomic, strong) NSMutableDictionary* nodesByIdentifier;
 @property (nonatomic, strong) NSLock* lock;
+@property (nonatomic, strong) NodeChangeSet* changes;     // since the layout last took them
+@property (atomic, readwrite) NSUInteger changeCount;
 
 @end
 
@@ -26,8 +77,11 @@
     if (self = [super init])
     {
         _orbitals = [[NSMutableDictionary alloc] init];
+        _orbitalSlots = [[NSMutableDictionary alloc] init];
         _nodesByIdentifier = [[NSMutableDictionary alloc] init];
         _lock = [[NSLock alloc] init];
+        _changes = [[NodeChangeSet alloc] init];
+        _changeCount = 0;
     }
     
     return self;
@@ -62,52 +116,89 @@
     
     self.nodesByIdentifier[node.identifier] = node;
 
+    [self addNode:node toOrbital:[NSNumber numberWithUnsignedInteger:node.orbital]];
+    [self noteChangeToNode:node];
+}
+
+- (void)addNode:(Node*)node toOrbital:(NSNumber*)orbitalName
+{
     // Do we already have nodes in this orbital?
-    NSNumber* orbitalName = [NSNumber numberWithUnsignedInteger:node.orbital];
     if (self.orbitals[orbitalName])
     {
-        NSMutableArray* orbitalNodes = self.orbitals[orbitalName];
+        NSMutableSet* orbitalNodes = self.orbitals[orbitalName];
         [orbitalNodes addObject:node];
     }
     else
     {
-        self.orbitals[orbitalName] = [[NSMutableArray alloc] initWithObjects:node, nil];
+        self.orbitals[orbitalName] = [[NSMutableSet alloc] initWithObjects:node, nil];
+        self.orbitalSlots[orbitalName] = [[OrbitalSlots alloc] init];
     }
+    
+    node.slot = [self.orbitalSlots[orbitalName] allocateSlot];
 }
 
 /**
- * @todo: there is a visual bug here in that setting the new orbital causes nodes to jump around as 
- *        they are redrawn because their new orbital will contain a different number of nodes to the
- *        source orbital. possible solution is to allow them to float to their target orbital and 
- *        then change the actual orbital so any jumping occurs at the end of the animation.
+ * The node gives up its slot in the old orbital and takes one in the new, no other node moves. The node itself takes
+ * the direction of its new slot straight away and floats out (or in) to the new orbital from there.
  */
 - (void)updateNode:(Node*)node withOrbital:(NSUInteger)orbital
 {
     NSNumber* oldOrbitalName = [NSNumber numberWithUnsignedInteger:node.orbital];
     NSNumber* newOrbitalName = [NSNumber numberWithUnsignedInteger:orbital];
+    
+    // Already there, it keeps its slot
+    if (orbital == node.orbital)
+    {
+        return;
+    }
 
     // Remove the node from its current orbital
     [self.orbitals[oldOrbitalName] removeObject:node];
+    [self.orbitalSlots[oldOrbitalName] releaseSlot:node.slot];
     
     // Add the new to its new orbital
-    if (self.orbitals[newOrbitalName])
-    {
-        NSMutableArray* orbitalNodes = self.orbitals[newOrbitalName];
-        [orbitalNodes addObject:node];
-    }
-    else
+    if ( ! self.orbitals[newOrbitalName])
     {
         NSLog(@"Creating new orbital: %@", newOrbitalName);
-        self.orbitals[newOrbitalName] = [[NSMutableArray alloc] initWithObjects:node, nil];
     }
     
+    [self addNode:node toOrbital:newOrbitalName];
+    
     node.orbital = orbital;
+    [self noteChangeToNode:node];
 }
 
 - (void)clearNodes
 {
     [self.nodesByIdentifier removeAllObjects];
     [self.orbitals removeAllObjects];
+    [self.orbitalSlots removeAllObjects];
+    [self.changes removeAllChanges];
+    self.changes.cleared = YES;
+    [self noteChange];
+}
+
+- (void)noteChange
+{
+    self.changeCount++;
+}
+
+- (void)noteChangeToNode:(Node*)node
+{
+    [self.changes noteChangeToNode:node];
+    [self noteChange];
+}
+
+/**
+ * The taken set is the layout's to read once the lock is released, it hands the set back emptied next time.
+ */
+- (NodeChangeSet*)takeChanges:(NodeChangeSet*)emptyChanges
+{
+    NodeChangeSet* changes = self.changes;
+    
+    self.changes = emptyChanges ? emptyChanges : [[NodeChangeSet alloc] init];
+    
+    return changes;
 }
 
 - (Node*)node:(NSString*)identifier
@@ -0,0 +1,255 @@
+//
+//  OffscreenRenderer.cpp
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#include "OffscreenRenderer.hpp"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __APPLE__
+#include <OpenGL/OpenGL.h>
+#define kTimeElapsed                GL_TIME_ELAPSED_EXT
+#define GetQueryObjectui64v         glGetQueryObjectui64vEXT
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#define kTimeElapsed                GL_TIME_ELAPSED
+#define GetQueryObjectui64v         glGetQueryObjectui64v
+#endif
+
+OffscreenRenderer::OffscreenRenderer(GLsizei width, GLsizei height) :
+    _width(width),
+    _height(height),
+    _context(NULL),
+    _display(NULL),
+    _framebuffer(0),
+    _frameCount(0)
+{
+    memset(_renderbuffers, 0, sizeof(_renderbuffers));
+    memset(_timerQueries, 0, sizeof(_timerQueries));
+    memset(_timerQueryPending, 0, sizeof(_timerQueryPending));
+}
+
+OffscreenRenderer::~OffscreenRenderer()
+{
+    if ( ! _context)
+    {
+        return;
+    }
+
+    if (_timerQueries[0])
+    {
+        glDeleteQueries(kOffscreenTimerQueryCount, _timerQueries);
+    }
+
+    glDeleteRenderbuffersEXT(2, _renderbuffers);
+    glDeleteFramebuffersEXT(1, &_framebuffer);
+
+#ifdef __APPLE__
+    CGLSetCurrentContext(NULL);
+    CGLDestroyContext((CGLContextObj)_context);
+#else
+    eglMakeCurrent((EGLDisplay)_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext((EGLDisplay)_display, (EGLContext)_context);
+#endif
+}
+
+bool OffscreenRenderer::prepare()
+{
+    if ( ! createContext() || ! createFramebuffer())
+    {
+        return false;
+    }
+
+    glViewport(0, 0, _width, _height);
+
+    const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+
+    // GPU times are optional, frames are still timed on the CPU without them
+    if (extensions && (strstr(extensions, "GL_ARB_timer_query") || strstr(extensions, "GL_EXT_timer_query")))
+    {
+        GLuint64 discarded;
+
+        glGenQueries(kOffscreenTimerQueryCount, _timerQueries);
+
+        // Mesa times the first query in a context from when the context was created, so that one isn't a frame's
+        glBeginQuery(kTimeElapsed, _timerQueries[0]);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEndQuery(kTimeElapsed);
+        GetQueryObjectui64v(_timerQueries[0], GL_QUERY_RESULT, &discarded);
+    }
+
+    return glGetError() == GL_NO_ERROR;
+}
+
+/**
+ * A legacy (compatibility) context with nothing to draw to, frames go to the framebuffer object.
+ */
+bool OffscreenRenderer::createContext()
+{
+#ifdef __APPLE__
+    CGLPixelFormatAttribute attributes[] = { kCGLPFAAccelerated, kCGLPFAOpenGLProfile, (CGLPixelFormatAttribute)kCGLOGLPVersion_Legacy, (CGLPixelFormatAttribute)0 };
+    CGLPixelFormatObj pixelFormat;
+    CGLContextObj context;
+    GLint formatCount;
+
+    if (CGLChoosePixelFormat(attributes, &pixelFormat, &formatCount) != kCGLNoError || CGLCreateContext(pixelFormat, NULL, &context) != kCGLNoError)
+    {
+        return false;
+    }
+
+    CGLDestroyPixelFormat(pixelFormat);
+    _context = context;
+
+    return CGLSetCurrentContext(context) == kCGLNoError;
+#else
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLint contextAttributes[] = { EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT, EGL_NONE };
+    EGLDisplay display = getPlatformDisplay ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : EGL_NO_DISPLAY;
+
+    if (display == EGL_NO_DISPLAY || ! eglInitialize(display, NULL, NULL) || ! eglBindAPI(EGL_OPENGL_API))
+    {
+        return false;
+    }
+
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+
+    if (context == EGL_NO_CONTEXT)
+    {
+        return false;
+    }
+
+    _display = display;
+    _context = context;
+
+    return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+#endif
+}
+
+bool OffscreenRenderer::createFramebuffer()
+{
+    glGenFramebuffersEXT(1, &_framebuffer);
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, _framebuffer);
+    glGenRenderbuffersEXT(2, _renderbuffers);
+
+    glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, _renderbuffers[0]);
+    glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_RGBA8, _width, _height);
+    glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_RENDERBUFFER_EXT, _renderbuffers[0]);
+
+    glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, _renderbuffers[1]);
+    glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT24, _width, _height);
+    glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT, GL_RENDERBUFFER_EXT, _renderbuffers[1]);
+
+    return glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) == GL_FRAMEBUFFER_COMPLETE_EXT;
+}
+
+void OffscreenRenderer::beginFrame()
+{
+    size_t query = _frameCount % kOffscreenTimerQueryCount;
+
+    _frameStart = std::chrono::steady_clock::now();
+
+    if (hasGPUTimes())
+    {
+        // The query is reused every kOffscreenTimerQueryCount frames, by which time its result is normally ready
+        collectTimerQuery(query);
+        glBeginQuery(kTimeElapsed, _timerQueries[query]);
+    }
+}
+
+void OffscreenRenderer::endFrame()
+{
+    // Software rasterisers only draw once the frame is flushed, which has to be inside the query to be timed
+    glFlush();
+
+    if (hasGPUTimes())
+    {
+        glEndQuery(kTimeElapsed);
+        _timerQueryPending[_frameCount % kOffscreenTimerQueryCount] = true;
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - _frameStart;
+    _cpuTimes.push_back(elapsed.count());
+    _frameCount++;
+}
+
+void OffscreenRenderer::finish()
+{
+    glFinish();
+
+    // Oldest first so the GPU times stay in frame order
+    for (uint64_t frame = _frameCount; frame < _frameCount + kOffscreenTimerQueryCount; frame++)
+    {
+        collectTimerQuery(frame % kOffscreenTimerQueryCount);
+    }
+}
+
+void OffscreenRenderer::collectTimerQuery(size_t query)
+{
+    if ( ! _timerQueryPending[query])
+    {
+        return;
+    }
+
+    GLuint64 nanoseconds = 0;
+
+    GetQueryObjectui64v(_timerQueries[query], GL_QUERY_RESULT, &nanoseconds);
+    _gpuTimes.push_back(nanoseconds / 1e6);
+    _timerQueryPending[query] = false;
+}
+
+/**
+ * Write the current frame as a binary PPM (top row first), which image tools and ffmpeg read directly.
+ */
+bool OffscreenRenderer::writeFrame(const char* path) const
+{
+    std::vector<GLubyte> pixels(_width * _height * 3);
+    FILE* file = fopen(path, "wb");
+
+    if ( ! file)
+    {
+        return false;
+    }
+
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, _width, _height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+    glPopClientAttrib();
+
+    fprintf(file, "P6\n%d %d\n255\n", _width, _height);
+
+    for (GLsizei row = _height - 1; row >= 0; row--)
+    {
+        fwrite(&pixels[row * _width * 3], 3, _width, file);
+    }
+
+    return fclose(file) == 0;
+}
+
+/**
+ * Nearest rank percentiles, as RTTStatistics works them out.
+ */
+FrameTimePercentiles OffscreenRenderer::percentiles(std::vector<double> times)
+{
+    FrameTimePercentiles percentiles = { times.size(), 0, 0, 0, 0 };
+
+    if (times.empty())
+    {
+        return percentiles;
+    }
+
+    std::sort(times.begin(), times.end());
+
+    size_t count = times.size();
+    percentiles.p50 = times[std::min((count * 50 + 99) / 100, count) - 1];
+    percentiles.p90 = times[std::min((count * 90 + 99) / 100, count) - 1];
+    percentiles.p99 = times[std::min((count * 99 + 99) / 100, count) - 1];
+    percentiles.maximum = times[count - 1];
+
+    return percentiles;
+}
@@ -0,0 +1,82 @@
+//
+//  OffscreenRenderer.hpp
+//  Interconnect
+//
+//  A legacy OpenGL context with no window, drawing into a framebuffer object, for measuring and recording the scene
+//  without the view or a display link: CGL on macOS, EGL on Linux (Mesa's surfaceless platform needs no display, so it
+//  runs on build machines). Frames are bracketed with beginFrame / endFrame, which time each one on the CPU (from the
+//  start of the frame until its last call is submitted) and on the GPU (with a timer query where supported) and can
+//  write the finished frame out as a binary PPM.
+//
+//  Timer query results are collected a few frames late so waiting on them never stalls the pipeline.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#ifndef OffscreenRenderer_hpp
+#define OffscreenRenderer_hpp
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#include <OpenGL/glext.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include <vector>
+
+#define kOffscreenTimerQueryCount   4           // frames in flight before a timer query is read back
+
+struct FrameTimePercentiles
+{
+    size_t sampleCount;
+    double p50, p90, p99, maximum;              // milliseconds
+};
+
+class OffscreenRenderer
+{
+public:
+    OffscreenRenderer(GLsizei width, GLsizei height);
+    ~OffscreenRenderer();
+
+    bool prepare();                             // creates the context and makes it current
+    GLsizei width() const { return _width; }
+    GLsizei height() const { return _height; }
+    bool hasGPUTimes() const { return _timerQueries[0] != 0; }
+
+    void beginFrame();
+    void endFrame();
+    void finish();                              // wait for the GPU and collect the outstanding timer queries
+    bool writeFrame(const char* path) const;
+
+    const std::vector<double>& cpuTimes() const { return _cpuTimes; }
+    const std::vector<double>& gpuTimes() const { return _gpuTimes; }
+    static FrameTimePercentiles percentiles(std::vector<double> times);
+
+private:
+    bool createContext();
+    bool createFramebuffer();
+    void collectTimerQuery(size_t query);
+
+    GLsizei _width, _height;
+    void* _context;                             // CGLContextObj or EGLContext
+    void* _display;                             // EGLDisplay, unused on macOS
+    GLuint _framebuffer;
+    GLuint _renderbuffers[2];                   // colour, depth
+
+    GLuint _timerQueries[kOffscreenTimerQueryCount];
+    bool _timerQueryPending[kOffscreenTimerQueryCount];
+    uint64_t _frameCount;
+
+    std::chrono::steady_clock::time_point _frameStart;
+    std::vector<double> _cpuTimes;              // milliseconds, one per frame
+    std::vector<double> _gpuTimes;
+};
+
+#endif /* OffscreenRenderer_hpp */
@@ -13,44 +13,49 @@
 #import "HostStore.h"
 #import "Node.h"
 #import "Host.h"
-#import "NSFont_OpenGL.h"
 #import "glm/vec3.hpp"
 #import "glm/gtc/matrix_transform.hpp"
 #import "CaptureWorker.h"
+#import "NodeRenderer.hpp"
+#import "TextRenderer.hpp"
+#import "NodeLayout.h"
+#import "SceneFrame.hpp"
 
 #define kPiOn180 0.0174532925f
 #define kEnableVerticalSync NO
 #define kEnablePerspective YES
 #define kEnableFPSLog NO
 
-#define kNodeRadiusGrowthPerSecond 0.7                  // how fast do nodes initially change orbitals?
 #define kNodeRadiusGrowthPerSecondAccelerated 1.2       // how fast do nodes change orbitals when grouping strategy is changed?
-#define kNodeVolumeGrowthPerSecond 0.08                 // how fast do nodes grow and shrink based on their volume?
-#define kWorldAutoRotationUnitsPerSecond 3              // how fast does the world automatically rotate around Y-axis?
 
-#define kNodePulseDeclinePerSecond 0.6                  // @todo: use sin / swing non-linear transition
-#define kNodeMinimumColourIntensity 0.2                 // nodes cannot have individual RGB values smaller than this
-#define kNodeMinimumPulseIntensity 0.4
+#define kAnimationFramesPerSecond 30                    // frame rate cap while nodes animate, the world rotates or the store changes
+#define kIdleFramesPerSecond 1                          // frame rate when nothing changes (keeps the HUD current)
+#define kWorldAutoRotationIdleSeconds 20                // auto rotation pauses once the store and input are quiet this long
 
-#define kDisplayListCountForText 95
+#define kFontFirstCharacter ' '
+#define kFontCharacterCount 95                         // printable ASCII
+#define kFontAtlasWidth 256                             // glyphs are packed in rows this many pixels wide
 
 #define kCameraInitialX 0
 #define kCameraInitialZ 8
 
-typedef enum
-{
-    kColourationByOrbital = 0,                          // colour nodes based on their orbital (itself determined by the grouping strategy)
-    kColourationByPreferredColour                       // colour nodes based on their preferred colour
-} ColourationMode;
-
 @interface OpenGLView()
+{
+    SceneFrame _frame;                                  // matrices, visible records and connectors of this frame
+}
 
 @property (nonatomic) CVDisplayLinkRef displayLink;     // display link for managing rendering thread
 @property (nonatomic) int64_t lastTicks;                // to determine seconds elapsed since last frame drawn
+@property (atomic) BOOL needsFrame;                     // set by input on the main thread, the next display link tick draws
+@property (nonatomic) BOOL isAnimating;                 // did anything move in the last frame drawn?
+@property (nonatomic) NSUInteger lastStoreChangeCount;  // store change count as of the last frame drawn
+@property (nonatomic) uint64_t lastActivityTime;        // host time of the last frame drawn for a store change, input or animation
+@property (nonatomic) BOOL isWorldAutoRotationPaused;   // auto rotation is on but the board has been quiet (see kWorldAutoRotationIdleSeconds)
 
 @property (nonatomic) BOOL isLightOn;                   // toggleable option (l)
 @property (nonatomic) BOOL isWorldRotating;             // toggleable option (w)
 @property (nonatomic) BOOL isWorldAutoRotating;         // toggleable option (a)
+@property (nonatomic) BOOL isLabellingAllNodes;         // toggleable option (n)
 
 @property (nonatomic) GLfloat rotateY;                  // rotation around Y-axis (looking left and right: our heading)
 @property (nonatomic) GLfloat rotateX;                  // rotation around X-axis
@@ -64,6 +69,7 @@ typedef enum
 @property (nonatomic) Host* previousSelection;
 
 @property (nonatomic) NSUInteger lastNodeCount;         // for HUD
+@property (nonatomic) NSUInteger lastVisibleNodeCount;  // for HUD
 @property (nonatomic) double fps;                       // for HUD
 
 @property (nonatomic) ColourationMode colourationMode;              // how should nodes be coloured?
@@ -71,8 +77,10 @@ typedef enum
 @property (nonatomic) float nodeRadiusGrowthPerSecond;
 
 @property (nonatomic) GLuint displayListNode;           // display list for node objects
-@property (nonatomic) GLuint displayListFontBase;       // base pointer to display lists for font set
 @property (nonatomic) GLUquadricObj* quadric;
+@property (nonatomic) NodeRenderer* nodeRenderer;       // draws all nodes at once, NULL if instancing isn't supported
+@property (nonatomic) TextRenderer* textRenderer;       // draws all of a frame's text at once
+@property (nonatomic, strong) NodeLayout* nodeLayout;   // positions and colours of all nodes as of this frame
 
 @end
 
@@ -83,6 +91,11 @@ typedef enum
 - (void)awakeFromNib
 {
     _lastTicks = 0;
+    _needsFrame = YES;
+    _isAnimating = NO;
+    _lastStoreChangeCount = NSUIntegerMax;
+    _lastActivityTime = 0;
+    _isWorldAutoRotationPaused = NO;
 
     _isLightOn = NO;
     _isWorldRotating = NO;
@@ -97,6 +110,7 @@ typedef enum
     _worldRotateX = 0;
     _worldRotateY = 0;
     _isWorldAutoRotating = YES;
+    _isLabellingAllNodes = NO;
     
     _isPicking = NO;
     
@@ -105,6 +119,7 @@ typedef enum
     _groupingStrategy = [[HostStore sharedStore] groupingStrategy];
     
     _nodeRadiusGrowthPerSecond = kNodeRadiusGrowthPerSecond;
+    _nodeLayout = [[NodeLayout alloc] init];
     
     [self becomeFirstResponder];
 }
@@ -119,9 +134,17 @@ typedef enum
     self.quadric = gluNewQuadric();
     gluQuadricNormals(self.quadric, GLU_SMOOTH);
     
-    [self buildFontDisplayList];
+    [self buildFontAtlas];
     [self buildNodeDisplayList];
     
+    self.nodeRenderer = new NodeRenderer();
+    if ( ! self.nodeRenderer->prepare())
+    {
+        NSLog(@"Instanced rendering is not supported, nodes will be drawn one at a time");
+        delete self.nodeRenderer;
+        self.nodeRenderer = NULL;
+    }
+    
     glShadeModel(GL_SMOOTH);
     glClearColor(0, 0, 0, 0);
 
@@ -172,54 +195,103 @@ typedef enum
     // Release the display link
     CVDisplayLinkRelease(self.displayLink);
     
-    glDeleteLists(self.displayListFontBase, kDisplayListCountForText);
+    // The renderers' buffers and textures belong to the view's context, which needn't be current here
+    [[self openGLContext] makeCurrentContext];
+    
     glDeleteLists(self.displayListNode, 1);
     gluDeleteQuadric(self.quadric);
+    delete self.nodeRenderer;
+    delete self.textRenderer;
 }
 
 #pragma mark - Text
 
-- (void)buildFontDisplayList
+/**
+ * Render the font's glyphs (as NSFont_OpenGL did for its display lists, a cell the size of the character with the
+ * glyph drawn white on black without antialiasing) into one atlas for the text renderer.
+ */
+- (void)buildFontAtlas
 {
-    NSFont *font;
+    NSFont* font = [NSFont fontWithName:@"Courier-Bold" size:10];
+    NSDictionary* attributes = @{ NSFontAttributeName: font, NSForegroundColorAttributeName: [NSColor whiteColor] };
+    std::vector<TextGlyph> glyphs(kFontCharacterCount);
+    GLushort penX = 0, penY = 0, rowHeight = 0;
     
-    self.displayListFontBase = glGenLists(kDisplayListCountForText);   // storage for 95 textures (one per character)
-    font = [NSFont fontWithName:@"Courier-Bold" size:10];
-
-    if ( ! [font makeGLDisplayListsWithFirstCharacter:' ' count:kDisplayListCountForText displayListBase:self.displayListFontBase])
+    self.textRenderer = new TextRenderer();
+    
+    // Lay the cells out in rows from the bottom left
+    for (unichar c = 0; c < kFontCharacterCount; c++)
     {
-        NSLog(@"Could not create font display list");
+        unichar character = kFontFirstCharacter + c;
+        NSRect cell = NSZeroRect;
+        cell.size = [[NSString stringWithCharacters:&character length:1] sizeWithAttributes:attributes];
+        cell = NSIntegralRect(cell);
+        
+        if (penX + cell.size.width > kFontAtlasWidth)
+        {
+            penX = 0;
+            penY += rowHeight;
+            rowHeight = 0;
+        }
+        
+        glyphs[c].x = penX;
+        glyphs[c].y = penY;
+        glyphs[c].width = cell.size.width;
+        glyphs[c].height = cell.size.height;
+        glyphs[c].advance = cell.size.width;
+        
+        penX += cell.size.width;
+        rowHeight = MAX(rowHeight, (GLushort)cell.size.height);
     }
-}
-
-- (void) glPrint:(NSString *)fmt, ...
-{
-    NSString* text;
-    va_list ap;
-    unichar* uniBuffer;
     
-    if (fmt == nil || [ fmt length ] == 0)
+    NSInteger atlasHeight = penY + rowHeight;
+    NSBitmapImageRep* bitmap = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:NULL
+                                                                       pixelsWide:kFontAtlasWidth
+                                                                       pixelsHigh:atlasHeight
+                                                                    bitsPerSample:8
+                                                                  samplesPerPixel:1
+                                                                         hasAlpha:NO
+                                                                         isPlanar:NO
+                                                                   colorSpaceName:NSCalibratedWhiteColorSpace
+                                                                      bytesPerRow:kFontAtlasWidth
+                                                                     bitsPerPixel:8];
+    
+    [NSGraphicsContext saveGraphicsState];
+    [NSGraphicsContext setCurrentContext:[NSGraphicsContext graphicsContextWithBitmapImageRep:bitmap]];
+    [[NSGraphicsContext currentContext] setShouldAntialias:NO];
+    [[NSColor blackColor] set];
+    [NSBezierPath fillRect:NSMakeRect(0, 0, kFontAtlasWidth, atlasHeight)];
+    
+    for (unichar c = 0; c < kFontCharacterCount; c++)
     {
-        return;
+        unichar character = kFontFirstCharacter + c;
+        [[NSString stringWithCharacters:&character length:1] drawInRect:NSMakeRect(glyphs[c].x, glyphs[c].y, glyphs[c].width, glyphs[c].height) withAttributes:attributes];
     }
     
-    va_start(ap, fmt);
-    text = [[NSString alloc] initWithFormat:fmt arguments:ap];
-    va_end(ap);
+    [NSGraphicsContext restoreGraphicsState];
     
-    glPushAttrib(GL_LIST_BIT);                  // push display list bits
+    // The bitmap's first row is its top, OpenGL's is its bottom
+    std::vector<GLubyte> atlas(kFontAtlasWidth * atlasHeight);
+    unsigned char* bitmapBytes = [bitmap bitmapData];
     
-    // Rebase the base list pointer so that we can use ASCII character codes to index and find
-    // the right display list to draw. 32 == space, the character in our first display list.
-    glListBase(self.displayListFontBase - 32);
-    uniBuffer = static_cast<unichar*>(calloc([text length], sizeof(unichar)));
-    [text getCharacters:uniBuffer];
-
-    // Draw n display lists, the index of each being stored in a word of uniBuffer (the string)
-    glCallLists([text length], GL_UNSIGNED_SHORT, uniBuffer);
-    free(uniBuffer);
+    for (NSInteger row = 0; row < atlasHeight; row++)
+    {
+        memcpy(&atlas[(atlasHeight - 1 - row) * kFontAtlasWidth], &bitmapBytes[row * [bitmap bytesPerRow]], kFontAtlasWidth);
+    }
+    
+    if ( ! self.textRenderer->prepare(kFontAtlasWidth, (GLsizei)atlasHeight, atlas.data(), kFontFirstCharacter, glyphs))
+    {
+        NSLog(@"Could not create font atlas");
+    }
+}
 
-    glPopAttrib();                              // pop display list bits
+/**
+ * Queue text anchored to a point in the world (or in front of the camera with the camera matrix), drawn at the end of
+ * the frame.
+ */
+- (void)drawLabel:(NSString*)label x:(GLfloat)x y:(GLfloat)y z:(GLfloat)z modelView:(const GLfloat*)modelView red:(GLfloat)red green:(GLfloat)green blue:(GLfloat)blue
+{
+    self.textRenderer->addLabel([label UTF8String], x, y, z, modelView, _frame.projectionMatrix(), _frame.viewport(), red, green, blue);
 }
 
 
@@ -227,6 +299,8 @@ typedef enum
 
 - (void)keyDown:(NSEvent *)theEvent
 {
+    self.needsFrame = YES;
+    
     if ([[theEvent characters] isEqualToString:@"l"])
     {
         self.isLightOn = ! self.isLightOn;
@@ -240,6 +314,10 @@ typedef enum
     {
         self.isWorldAutoRotating = ! self.isWorldAutoRotating;
     }
+    else if ([[theEvent characters] isEqualToString:@"n"])
+    {
+        self.isLabellingAllNodes = ! self.isLabellingAllNodes;
+    }
     else if ([[theEvent characters] isEqualToString:@"g"])
     {
         switch (self.groupingStrategy)
@@ -251,9 +329,9 @@ typedef enum
                 self.groupingStrategy = kHostStoreGroupBasedOnAS;
                 break;
             case kHostStoreGroupBasedOnAS:
-                self.groupingStrategy = kHostStoreGroupBasedOnNetworkClass;
+                self.groupingStrategy = kHostStoreGroupBasedOnNetworkPrefix;
                 break;
-            case kHostStoreGroupBasedOnNetworkClass:
+            case kHostStoreGroupBasedOnNetworkPrefix:
                 self.groupingStrategy = kHostStoreGroupBasedOnHopCount;
                 break;
         }
@@ -261,6 +339,15 @@ typedef enum
         self.nodeRadiusGrowthPerSecond = kNodeRadiusGrowthPerSecondAccelerated;   // @todo: reset this one the regrouping is complete
         [[HostStore sharedStore] regroupHostsBasedOnStrategy:self.groupingStrategy];
     }
+    else if ([[theEvent characters] isEqualToString:@"p"])
+    {
+        // Cycle the aggregate prefix length used by network prefix grouping through /8, /16 and /24
+        uint8_t prefixLength = ([[HostStore sharedStore] networkPrefixLength] / 8) % 3 * 8 + 8;
+        
+        self.groupingStrategy = kHostStoreGroupBasedOnNetworkPrefix;
+        self.nodeRadiusGrowthPerSecond = kNodeRadiusGrowthPerSecondAccelerated;
+        [[HostStore sharedStore] regroupHostsBasedOnNetworkPrefixLength:prefixLength];
+    }
     else if ([[theEvent characters] isEqualToString:@"c"])
     {
         if (self.colourationMode == kColourationByPreferredColour)
@@ -342,11 +429,13 @@ typedef enum
 {
     self.trackingMousePosition = [self convertPoint:[theEvent locationInWindow] fromView:nil];
     self.isPicking = YES;
+    self.needsFrame = YES;
 }
 
 - (void)mouseUp:(NSEvent*)theEvent
 {
     self.isPicking = NO;
+    self.needsFrame = YES;
 }
 
 - (void)mouseDragged:(NSEvent *)theEvent
@@ -369,6 +458,7 @@ typedef enum
     }
     
     self.trackingMousePosition = locationInView;
+    self.needsFrame = YES;
 }
 
 #pragma mark - View
@@ -382,6 +472,8 @@ typedef enum
     
     NSLog(@"reshape to %.2fx%.2f", rect.size.width, rect.size.height);
     
+    self.needsFrame = YES;
+    
     // Set up a perspective view (things in distance get smaller)
     glViewport(0, 0, rect.size.width, rect.size.height);
     
@@ -422,6 +514,13 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink,
     double nominalRefreshRate = outputTime->videoTimeScale / outputTime->videoRefreshPeriod;    // fps
     double elapsed_seconds = (actualTime->hostTime - self.lastTicks) / CVGetHostClockFrequency();   // should we use outputTime->hostTime?
 
+    // Ticks come every display refresh but frames are only drawn as often as whatever changed needs (allowing half a
+    // refresh of jitter so a 30 FPS cap doesn't miss every other tick)
+    if (elapsed_seconds < [self frameInterval] - (0.5 / nominalRefreshRate))
+    {
+        return kCVReturnSuccess;
+    }
+
     self.fps = 1 / elapsed_seconds;
 
     if (kEnableFPSLog)
@@ -456,16 +555,58 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink,
         elapsed_seconds = 0.01;
     }
 
+    // After an idle spell the scene moves on by one frame, not by however long it sat still (new pulses aren't skipped)
+    if ( ! self.isAnimating)
+    {
+        elapsed_seconds = MIN(elapsed_seconds, 1.0 / kAnimationFramesPerSecond);
+    }
+
+    // Auto rotation alone would keep a quiet board drawing at kAnimationFramesPerSecond, so it pauses (dropping to
+    // kIdleFramesPerSecond) until the store changes or there's input again
+    NSUInteger storeChangeCount = [[HostStore sharedStore] changeCount];
+
+    if (self.needsFrame || self.nodeLayout.isAnimating || storeChangeCount != self.lastStoreChangeCount)
+    {
+        self.lastActivityTime = actualTime->hostTime;
+    }
+
+    self.isWorldAutoRotationPaused = (actualTime->hostTime - self.lastActivityTime) / CVGetHostClockFrequency() > kWorldAutoRotationIdleSeconds;
+
+    self.needsFrame = NO;
+    self.lastStoreChangeCount = storeChangeCount;
+
     [self drawNodeSphere:elapsed_seconds];
     [self drawHUD];
+    self.textRenderer->draw(_frame.viewport());
     
     [[self openGLContext] flushBuffer];
     
+    self.isAnimating = self.nodeLayout.isAnimating || (self.isWorldAutoRotating && ! self.isWorldAutoRotationPaused);
+    
     self.lastTicks = actualTime->hostTime;      // should we use outputTime->hostTime?
 
     return kCVReturnSuccess;
 }
 
+/**
+ * How long after the last frame the next is drawn: every display refresh while the view is being moved or picked from,
+ * kAnimationFramesPerSecond while anything is moving or the store has changed, otherwise kIdleFramesPerSecond.
+ */
+- (double)frameInterval
+{
+    if (self.needsFrame || self.isPicking)
+    {
+        return 0;
+    }
+    
+    if (self.isAnimating || [[HostStore sharedStore] changeCount] != self.lastStoreChangeCount)
+    {
+        return 1.0 / kAnimationFramesPerSecond;
+    }
+    
+    return 1.0 / kIdleFramesPerSecond;
+}
+
 #pragma mark - Drawing
 
 - (void)translateForCamera
@@ -490,7 +631,7 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink,
 {
     glClearColor(0,0,0,0);
     
-    if (self.isWorldAutoRotating)
+    if (self.isWorldAutoRotating && ! self.isWorldAutoRotationPaused)
     {
         self.worldRotateY += kWorldAutoRotationUnitsPerSecond * secondsSinceLastFrame;
     }
@@ -506,211 +647,183 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink,
     // This translates the origin (0, 0, 0) to a new origin
     [self translateForCamera];
     
-    glColor3f(0, 1, 0);
-    glRasterPos2f(0.06, 0.06);
-    [self glPrint:@"localhost"];
+    _frame.begin(self.nodeRenderer, self.textRenderer, self.worldRotateX, self.worldRotateY);
+    
+    // Localhost (origin) marker, it isn't in the store
+    NodeRenderRecord localhost = {};
+    localhost.green = 1;
+    localhost.volume = 0.05;
+    
+    [self drawLabel:@"localhost" x:0.06 y:0.06 z:0 modelView:_frame.cameraMatrix() red:localhost.red green:localhost.green blue:localhost.blue];
+    
+    [self drawNode:&localhost];
+    
+    // The store is only locked while the layout swaps out its changes
+    self.nodeLayout.colourationMode = self.colourationMode;
+    self.nodeLayout.nodeRadiusGrowthPerSecond = self.nodeRadiusGrowthPerSecond;
+    [self.nodeLayout layoutStore:[HostStore sharedStore] secondsSinceLastFrame:secondsSinceLastFrame];
+    
+    NodeRenderRecord* records = [self.nodeLayout records];
+    NSUInteger recordCount = [self.nodeLayout recordCount];
+    
+    _frame.cull([self.nodeLayout index]);
+    
+    // While the mouse is down the nearest node under it is the selection
+    NSUInteger pickedRecord = self.isPicking ? [self pickRecordWithModelView:_frame.worldMatrix() projection:_frame.projectionMatrix()] : NSNotFound;
     
-    [self drawNode:nil x:0 y:0 z:0 secondsSinceLastFrame:secondsSinceLastFrame];     // localhost (origin) marker
-
-    HostStore *hostStore = [HostStore sharedStore];
-    [hostStore lockStore];
-
-    NSDictionary* orbitals = [hostStore inhabitedOrbitals];
-    NSUInteger orbitalCount = [[orbitals allKeys] count];
-
     self.previousSelection = nil;
-    self.lastNodeCount = 0;
-
-    for (NSNumber* orbitalNumber in orbitals)
+    self.lastNodeCount = recordCount;
+    self.lastVisibleNodeCount = _frame.visible().size();
+    
+    for (uint32_t i : _frame.visible())
     {
-        NSArray* nodes = [orbitals objectForKey:orbitalNumber];
-        NSUInteger orbitalNodeCount = [nodes count];
-        float planeCount = floor(sqrt((double)orbitalNodeCount) + 1);
-        float degreeSpacing = 360.0f / planeCount;
-
-        self.lastNodeCount += orbitalNodeCount;
-        
-//      NSLog(@"Orbital %d with %lu nodes generates plane count of %.2f and degree spacing %.2f", [orbitalNumber intValue], (unsigned long)orbitalNodeCount, planeCount, degreeSpacing);
+        records[i].visible = YES;
         
-        NSUInteger nodesDrawn = 0;
-        float thetaOffset = [orbitalNumber intValue] * 30.0;
-        for (float theta = thetaOffset; theta < (thetaOffset + 360.0f); theta += degreeSpacing)
+        if (self.isPicking)
         {
-            for (float phi = 10; phi < 370.0; phi += degreeSpacing)
-            {
-                if (nodesDrawn < orbitalNodeCount)
-                {
-                    Node* node = [nodes objectAtIndex:nodesDrawn];
-                    
-                    float radius = node.radius;
-
-                    GLfloat x = radius * sin(phi * (2*M_PI / 360.0)) * cos(theta * (2*M_PI / 360.0));
-                    GLfloat y = radius * sin(phi * (2*M_PI / 360.0)) * sin(theta * (2*M_PI / 360.0));
-                    GLfloat z = radius * cos(phi * (2*M_PI / 360.0));
-
-                    if (node.pulseIntensity > kNodeMinimumPulseIntensity && node.pulseBegin)
-                    {
-                        // Pulse the node from bright to dark
-                        glColor3f(node.pulseIntensity, node.pulseIntensity, node.pulseIntensity);
-                        node.pulseIntensity -= kNodePulseDeclinePerSecond*secondsSinceLastFrame;
-                    }
-                    else
-                    {
-                        node.pulseBegin = NO;
-
-                        float colourIntensity = (1.0 / orbitalCount) * ((orbitalCount+1) - [orbitalNumber floatValue]);
-                        colourIntensity = (colourIntensity >= kNodeMinimumColourIntensity) ? colourIntensity : kNodeMinimumColourIntensity;
-
-                        if (node.pulseIntensity < colourIntensity)
-                        {
-                            // Pulse the node back to the desired intensity (prevents flashing)
-                            glColor3f(node.pulseIntensity, node.pulseIntensity, node.pulseIntensity);
-                            node.pulseIntensity += kNodePulseDeclinePerSecond*secondsSinceLastFrame;
-                        }
-                        else
-                        {
-                            if (self.colourationMode == kColourationByOrbital)
-                            {
-                                glColor3f(colourIntensity, 0, 0);
-                            }
-                            else if (self.colourationMode == kColourationByPreferredColour)
-                            {
-                                glColor3f(node.preferredRed, node.preferredGreen, node.preferredBlue);
-                            }
-                        }
-                    }
-
-                    [self drawNode:node x:x y:y z:z secondsSinceLastFrame:secondsSinceLastFrame];
-                    
-                    if (node.radius < [orbitalNumber floatValue])
-                    {
-                        // The node needs to float to its true orbital position
-                        [node growRadius:self.nodeRadiusGrowthPerSecond*secondsSinceLastFrame];
-                    }
-                    else if (node.radius > [orbitalNumber floatValue])
-                    {
-                        // The node needs to float to its true orbital position
-                        [node shrinkRadius:self.nodeRadiusGrowthPerSecond*secondsSinceLastFrame];
-                    }
-
-                    if (node.volume < [node targetVolume])
-                    {
-                        [node growVolume:kNodeVolumeGrowthPerSecond*secondsSinceLastFrame];
-                    }
-                    else if (node.volume > [node targetVolume])
-                    {
-                        [node shrinkVolume:kNodeVolumeGrowthPerSecond*secondsSinceLastFrame];
-                    }
-                    
-                    nodesDrawn++;
-                }
-            }
+            records[i].selected = (i == pickedRecord);
         }
         
-        assert(nodesDrawn == orbitalNodeCount);
+        [self drawNode:&records[i]];
     }
     
-    [hostStore unlockStore];
- 
+    [self addConnectorsForRecords:records count:recordCount];
+    
+    if (self.isLabellingAllNodes)
+    {
+        [self drawLabelsForRecords:records];
+    }
+    
+    _frame.draw(self.isLightOn);
 }
 
-- (void)drawNode:(Node*)node x:(GLfloat)x y:(GLfloat)y z:(GLfloat)z secondsSinceLastFrame:(double)secondsSinceLastFrame
+/**
+ * Unproject the mouse once to a ray through the world and ask the node index for the first node it meets.
+ */
+- (NSUInteger)pickRecordWithModelView:(const GLfloat*)modelViewMatrix projection:(const GLfloat*)projectionMatrix
 {
-    GLfloat s = 0.05;
+    GLdouble modelView[16], projection[16];
+    GLdouble rayVertexNear[3];
+    GLdouble rayVertexFar[3];
+    uint32_t pickedRecord;
     
-    if (node)
+    for (int i = 0; i < 16; i++)
     {
-        s = node.volume;
+        modelView[i] = modelViewMatrix[i];
+        projection[i] = projectionMatrix[i];
     }
     
-    // Push the world translation matrix so that each time we draw a quad it's translated from the translated world origin,
-    // not the translation of the last quad drawn (otherwise we end up drawing a torus).
-    glPushMatrix();
+    // Get the ray entry and exit points on the projection frustum
+    gluUnProject(self.trackingMousePosition.x, self.trackingMousePosition.y, 0.0, modelView, projection, _frame.viewport(), &rayVertexNear[0], &rayVertexNear[1], &rayVertexNear[2]);
+    gluUnProject(self.trackingMousePosition.x, self.trackingMousePosition.y, 1.0, modelView, projection, _frame.viewport(), &rayVertexFar[0], &rayVertexFar[1], &rayVertexFar[2]);
     
-    GLfloat worldRotateY = 360.0f - self.worldRotateY;
-    GLfloat worldRotateX = 360.0f - self.worldRotateX;
+    glm::vec3 rayOrigin(rayVertexNear[0], rayVertexNear[1], rayVertexNear[2]);
+    glm::vec3 rayDirection = glm::normalize(glm::vec3(rayVertexFar[0], rayVertexFar[1], rayVertexFar[2]) - rayOrigin);
     
-    glRotatef(worldRotateY, 0.0f, 1.0f, 0.0);       // rotation around Y-axis (looking left and right)
-    glRotatef(worldRotateX, 1.0f, 0.0f, 0.0);       // rotation around Y-axis (looking left and right)
+    if ( ! [self.nodeLayout index].queryRay(&rayOrigin[0], &rayDirection[0], pickedRecord))
+    {
+        return NSNotFound;
+    }
+    
+    return pickedRecord;
+}
 
-    if (self.isPicking)
+/**
+ * Every node with recent traffic has its connector drawn, nodes outside the frustum too as their connectors may still
+ * cross it (they can't be under the mouse though).
+ */
+- (void)addConnectorsForRecords:(NodeRenderRecord*)records count:(NSUInteger)recordCount
+{
+    for (NSUInteger i = 0; i < recordCount; i++)
     {
-        GLint viewport[4];
-        GLdouble modelViewMatrix[16], projectionMatrix[16];
-        GLdouble rayVertexNear[3];
-        GLdouble rayVertexFar[3];
-        
-        glGetDoublev(GL_MODELVIEW_MATRIX, modelViewMatrix);
-        glGetDoublev(GL_PROJECTION_MATRIX, projectionMatrix);
-        glGetIntegerv(GL_VIEWPORT, viewport);
+        NodeRenderRecord& record = records[i];
         
-        // Get the ray entry and exit points on the projection frustum
-        gluUnProject(self.trackingMousePosition.x, self.trackingMousePosition.y, 0.0, modelViewMatrix, projectionMatrix, viewport, &rayVertexNear[0], &rayVertexNear[1], &rayVertexNear[2]);
-        gluUnProject(self.trackingMousePosition.x, self.trackingMousePosition.y, 1.0, modelViewMatrix, projectionMatrix, viewport, &rayVertexFar[0], &rayVertexFar[1], &rayVertexFar[2]);
-
-        glm::vec3 rayVectorNear, rayVectorFar, sphereCenter;
-        rayVectorNear.x = rayVertexNear[0];
-        rayVectorNear.y = rayVertexNear[1];
-        rayVectorNear.z = rayVertexNear[2];
-        rayVectorFar.x = rayVertexFar[0];
-        rayVectorFar.y = rayVertexFar[1];
-        rayVectorFar.z = rayVertexFar[2];
-        sphereCenter.x = x;
-        sphereCenter.y = y;
-        sphereCenter.z = z;
-        
-        // Ray / sphere intersection test
-        glm::vec3 vectDirToSphere = sphereCenter - rayVectorNear;
-        glm::vec3 vectRayDir = glm::normalize(rayVectorNear - rayVectorFar);
-        float lineLength = glm::distance(rayVectorNear, rayVectorFar);
-        float t = glm::dot(vectDirToSphere, vectRayDir);
-        glm::vec3 closestPoint = rayVectorNear + (vectRayDir*t);
+        if ( ! record.visible && self.isPicking)
+        {
+            record.selected = NO;
+        }
         
-        if (glm::distance(sphereCenter, closestPoint) <= s)
+        if (record.drawOriginConnector)
         {
-            node.selected = YES;
+            _frame.addConnector(record);
         }
-        else
+    }
+}
+
+/**
+ * Label every visible node with its hostname (or address), the hosts are read under one store lock.
+ */
+- (void)drawLabelsForRecords:(NodeRenderRecord*)records
+{
+    [[HostStore sharedStore] lockStore];
+    
+    for (uint32_t i : _frame.visible())
+    {
+        NodeRenderRecord& record = records[i];
+        Host* host = (Host*)record.node;
+        
+        if ( ! host || record.selected)
         {
-            node.selected = NO;
+            continue;
         }
+        
+        [self drawLabel:host.hostname.length ? host.hostname : host.ipAddress x:record.x + record.volume y:record.y + record.volume z:record.z modelView:_frame.worldMatrix() red:record.red green:record.green blue:record.blue];
     }
+    
+    [[HostStore sharedStore] unlockStore];
+}
 
-    if (node && node.selected)
+/**
+ * Draw one node's label, the sphere itself is added to the instanced renderer (or drawn from the display list if
+ * instancing isn't supported). Picking has already updated the record's selection, not the node's, and a selected
+ * node is drawn (and its connector) in yellow.
+ */
+- (void)drawNode:(NodeRenderRecord*)record
+{
+    Node* node = record->node;
+    
+    if (node && record->selected)
     {
         Host* host = (Host*)node;
 
-        glColor3f(1, 1, 0);
-        glRasterPos3f(x+s, y+s, z);
-        [self glPrint:[NSString stringWithFormat:@"%@", host.hostname.length ? host.hostname : host.ipAddress]];
-        
+        record->red = record->green = 1;
+        record->blue = 0;
+    
+        [[HostStore sharedStore] lockStore];      // host details are only consistent under the store lock
+        NSString* label = [NSString stringWithFormat:@"%@", host.hostname.length ? host.hostname : host.ipAddress];
+        [[HostStore sharedStore] unlockStore];
+    
+        [self drawLabel:label x:record->x + record->volume y:record->y + record->volume z:record->z modelView:_frame.worldMatrix() red:record->red green:record->green blue:record->blue];
+    
         if (self.previousSelection != nil)
         {
-            // This is simply debugging used to detect multiple selection (ie. ray passed through > 1 node)
-            NSLog(@"Selected %@ (%.2f, %.2f, %.2f) but %@ already selected", node.identifier, x, y, z, self.previousSelection.identifier);
+            // This is simply debugging used to detect multiple selection (picking only ever selects the nearest node)
+            NSLog(@"Selected %@ (%.2f, %.2f, %.2f) but %@ already selected", node.identifier, record->x, record->y, record->z, self.previousSelection.identifier);
         }
         else
         {
             [self drawSelectedHostHUD:host];
         }
-        
-        self.previousSelection = node;
+    
+        self.previousSelection = host;
     }
     
-    if (node && node.originConnector > 0)
+    if (self.nodeRenderer)
     {
-        glBegin(GL_LINES);
-            glVertex3d(0, 0, 0);
-            glVertex3d(x, y, z);
-        glEnd();
-
-        node.originConnector -= secondsSinceLastFrame;
+        _frame.addNode(*record);
+        return;
     }
     
-    glTranslatef(x, y, z);
+    // Push the world translation matrix so that each time we draw a quad it's translated from the translated world origin,
+    // not the translation of the last quad drawn (otherwise we end up drawing a torus).
+    glPushMatrix();
+    _frame.rotateForWorld();
+
+    glColor3f(record->red, record->green, record->blue);
+    glTranslatef(record->x, record->y, record->z);
 
     // Scale the node (nominally at size 1,1,1) to the size we need
-    glScalef(s, s, s);
+    glScalef(record->volume, record->volume, record->volume);
 
     glCallList(self.displayListNode);
 
@@ -730,30 +843,12 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink,
     glEndList();
 }
 
+/**
+ * Queue text at a position in the view (from its top left), drawn in front of everything at the end of the frame.
+ */
 - (void)drawOrthoString:(NSString*)string x:(NSUInteger)x y:(NSUInteger)y colour:(NSColor*)colour
 {
-    GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
-    
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glLoadIdentity();
-    
-    // left, right, bottom, top, z
-    glOrtho(0, viewport[2], viewport[3], 0, -1.0, 1.0);
-    
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    glLoadIdentity();
-    glColor3f([colour redComponent], [colour greenComponent], [colour blueComponent]);
-    glRasterPos3f(x, y, 0);
-    [self glPrint:string];
-    glPopMatrix();
-    
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    
-    glMatrixMode(GL_MODELVIEW);
+    self.textRenderer->addText([string UTF8String], _frame.viewport()[0] + x, _frame.viewport()[1] + _frame.viewport()[3] - (GLfloat)y, 0, [colour redComponent], [colour greenComponent], [colour blueComponent]);
 }
 
 - (void)drawHUD
@@ -771,20 +866,21 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink,
         case kHostStoreGroupBasedOnAS:
             groupingStrategy = @"AS";
             break;
-        case kHostStoreGroupBasedOnNetworkClass:
-            groupingStrategy = @"net";
+        case kHostStoreGroupBasedOnNetworkPrefix:
+            groupingStrategy = [NSString stringWithFormat:@"net /%u", [[HostStore sharedStore] networkPrefixLength]];
             break;
     }
     
-    glRasterPos3f(5, 15, 0);
-    [self drawOrthoString:[NSString stringWithFormat:@"%lu hosts [%.2f FPS, capture: %@, control: %@, light: %@, colour: %@, groups: %@]",
+    [self drawOrthoString:[NSString stringWithFormat:@"%lu hosts (%lu visible) [%.2f FPS, capture: %@, control: %@, light: %@, colour: %@, groups: %@, labels: %@]",
                                                 self.lastNodeCount,
+                                                self.lastVisibleNodeCount,
                                                 self.fps,
                                                 self.captureWorker.workerRunning ? self.captureWorker.captureInterface : @"stopped",
                                                 self.isWorldRotating ? @"world" : @"camera",
                                                 self.isLightOn ? @"yes" : @"no",
                                                 self.colourationMode == kColourationByPreferredColour ? @"preferred" : @"orbital",
-                                                groupingStrategy]
+                                                groupingStrategy,
+                                                self.isLabellingAllNodes ? @"all" : @"selected"]
                         x:5
                         y:15
                    colour:[[NSColor whiteColor] colorUsingColorSpace:[NSColorSpace genericRGBColorSpace]]];
@@ -794,6 +890,9 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink,
 {
     NSString *identifier, *traffic, *distance;
     
+    // The host is read under the store lock (only for as long as it takes to build the strings)
+    [[HostStore sharedStore] lockStore];
+    
     // Build identifier line
     if (host.hostname.length)
     {
@@ -818,6 +917,14 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink,
     
     distance = [NSString stringWithFormat:@"Hops: %3lu RTT: %.1fms", host.hopCount, host.rtt];
     
+    if (host.rttStatistics.sampleCount > 1)
+    {
+        RTTStatistics* stats = host.rttStatistics;
+        distance = [distance stringByAppendingString:[NSString stringWithFormat:@" (min: %.1fms p95: %.1fms jitter: %.1fms over %lu samples)", stats.minimum, stats.p95, stats.jitter, stats.sampleCount]];
+    }
+    
+    [[HostStore sharedStore] unlockStore];
+    
     NSColor *yellow = [[NSColor yellowColor] colorUsingColorSpace:[NSColorSpace genericRGBColorSpace]];
     NSRect rect = [self bounds];        // view's size and position in its own co-ordinate system
     
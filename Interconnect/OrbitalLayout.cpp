@@ -0,0 +1,196 @@
+//
+//  OrbitalLayout.cpp
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#include "OrbitalLayout.hpp"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define kLanes                  4
+#define kSlotStepHeight         0.7548776662466927              // 1 / plastic number
+#define kSlotStepLongitude      0.5698402909980532              // 1 / plastic number squared
+#define kOrbitalOffsetDegrees   30.0                            // longitude offset of each orbital from the last
+
+typedef float   float4  __attribute__((vector_size(16)));
+typedef int32_t int4    __attribute__((vector_size(16)));
+
+/**
+ * Cody-Waite split of pi/2 (each part exact in a float) and the Cephes minimax polynomials for sin and cos over
+ * [-pi/4, pi/4]. Good to about 1e-7, well past what a node's position needs.
+ */
+#define kPiOn2Part1             1.5703125f
+#define kPiOn2Part2             4.837512969970703125e-4f
+#define kPiOn2Part3             7.54978995489188216e-8f
+#define kTwoOnPi                0.636619772367581343f
+
+#define kSinCoefficient1        -1.6666654611e-1f
+#define kSinCoefficient2        8.3321608736e-3f
+#define kSinCoefficient3        -1.9515295891e-4f
+#define kCosCoefficient1        4.166664568298827e-2f
+#define kCosCoefficient2        -1.388731625493765e-3f
+#define kCosCoefficient3        2.443315711809948e-5f
+
+static inline float4 Splat(float value)
+{
+    return (float4){ value, value, value, value };
+}
+
+static inline int4 SplatInt(int32_t value)
+{
+    return (int4){ value, value, value, value };
+}
+
+static inline float4 Select(int4 mask, float4 ifSet, float4 ifClear)
+{
+    return (float4)((mask & (int4)ifSet) | (~mask & (int4)ifClear));
+}
+
+/**
+ * Sine and cosine of four non-negative angles (radians). The angle is reduced to the nearest multiple of pi/2 and the
+ * quadrant decides which polynomial gives which result, and with what sign.
+ */
+static inline void SinCos4(float4 angle, float4* sinOut, float4* cosOut)
+{
+    int4 quadrant = __builtin_convertvector((angle * Splat(kTwoOnPi)) + Splat(0.5f), int4);     // angles are >= 0 so truncating rounds
+    float4 nearest = __builtin_convertvector(quadrant, float4);
+
+    float4 r = angle - (nearest * Splat(kPiOn2Part1));
+    r = r - (nearest * Splat(kPiOn2Part2));
+    r = r - (nearest * Splat(kPiOn2Part3));
+
+    float4 r2 = r * r;
+    float4 s = r + (r * r2 * (Splat(kSinCoefficient1) + (r2 * (Splat(kSinCoefficient2) + (r2 * Splat(kSinCoefficient3))))));
+    float4 c = Splat(1.0f) - (r2 * Splat(0.5f)) + (r2 * r2 * (Splat(kCosCoefficient1) + (r2 * (Splat(kCosCoefficient2) + (r2 * Splat(kCosCoefficient3))))));
+
+    int4 swap = (quadrant & SplatInt(1)) != SplatInt(0);
+    int4 negateSin = (quadrant & SplatInt(2)) != SplatInt(0);
+    int4 negateCos = ((quadrant + SplatInt(1)) & SplatInt(2)) != SplatInt(0);
+
+    float4 sine = Select(swap, c, s);
+    float4 cosine = Select(swap, s, c);
+
+    *sinOut = (float4)((int4)sine ^ (negateSin & SplatInt(0x80000000)));
+    *cosOut = (float4)((int4)cosine ^ (negateCos & SplatInt(0x80000000)));
+}
+
+/**
+ * Longitude and height of a slot from the two dimensional generalisation of the golden ratio sequence (the plastic
+ * number takes the place of phi), which keeps every prefix of slots evenly spread. Heights are spaced uniformly so the
+ * slots are uniform in area on the sphere, and each orbital is turned a little so orbitals don't line up.
+ */
+static void SlotPosition(unsigned long orbital, size_t slot, double* longitude, double* height)
+{
+    double heightTurns = 0.5 + (slot * kSlotStepHeight);
+    double longitudeTurns = 0.5 + (slot * kSlotStepLongitude) + (orbital * (kOrbitalOffsetDegrees / 360.0));
+
+    *longitude = 2*M_PI * (longitudeTurns - floor(longitudeTurns));
+    *height = 1.0 - (2.0 * (heightTurns - floor(heightTurns)));
+}
+
+static size_t PaddedCount(size_t slotCount)
+{
+    return (slotCount + kLanes - 1) & ~(size_t)(kLanes - 1);
+}
+
+void OrbitalLayout::reserveSlots(size_t slotCount, OrbitalDirections& directions)
+{
+    size_t paddedCount = PaddedCount(slotCount);
+
+    directions.x.resize(paddedCount, 0);
+    directions.y.resize(paddedCount, 0);
+    directions.z.resize(paddedCount, 0);
+}
+
+void OrbitalLayout::computeDirections(unsigned long orbital, size_t firstSlot, size_t slotCount, OrbitalDirections& directions)
+{
+    size_t paddedCount = PaddedCount(slotCount);
+
+    firstSlot &= ~(size_t)(kLanes - 1);
+
+    // Longitude goes through x and the distance from the axis through y, both overwritten four at a time once read
+    for (size_t slot = firstSlot; slot < paddedCount; slot++)
+    {
+        double longitude, height;
+
+        SlotPosition(orbital, slot, &longitude, &height);
+
+        directions.x[slot] = longitude;
+        directions.y[slot] = sqrt(1.0 - (height * height));
+        directions.z[slot] = height;
+    }
+
+    for (size_t slot = firstSlot; slot < paddedCount; slot += kLanes)
+    {
+        float4 longitude, axisDistance, sinLongitude, cosLongitude;
+
+        memcpy(&longitude, &directions.x[slot], sizeof(float4));
+        memcpy(&axisDistance, &directions.y[slot], sizeof(float4));
+
+        SinCos4(longitude, &sinLongitude, &cosLongitude);
+
+        float4 x = axisDistance * cosLongitude;
+        float4 y = axisDistance * sinLongitude;
+
+        memcpy(&directions.x[slot], &x, sizeof(float4));
+        memcpy(&directions.y[slot], &y, sizeof(float4));
+    }
+
+    directions.slotCount = slotCount;
+}
+
+/**
+ * The same directions a slot at a time with the libm functions, to compare the kernel against.
+ */
+void OrbitalLayout::computeDirectionsScalar(unsigned long orbital, size_t firstSlot, size_t slotCount, OrbitalDirections& directions)
+{
+    for (size_t slot = firstSlot; slot < slotCount; slot++)
+    {
+        double longitude, height;
+
+        SlotPosition(orbital, slot, &longitude, &height);
+
+        double axisDistance = sqrt(1.0 - (height * height));
+
+        directions.x[slot] = axisDistance * cos(longitude);
+        directions.y[slot] = axisDistance * sin(longitude);
+        directions.z[slot] = height;
+    }
+
+    directions.slotCount = slotCount;
+}
+
+const OrbitalDirections& OrbitalLayout::directions(unsigned long orbital, size_t slotCount)
+{
+    OrbitalDirections& directions = _orbitals[orbital];
+    size_t computedCount = directions.slotCount;                // zero for an orbital not seen before
+
+    // Slots are reused before new ones are handed out, so an orbital only ever needs the slots it's grown into
+    if (slotCount > computedCount)
+    {
+        reserveSlots(slotCount, directions);
+        computeDirections(orbital, computedCount, slotCount, directions);
+        _computedSlotCount += slotCount - computedCount;
+    }
+
+    return directions;
+}
+
+void OrbitalLayout::forgetOrbitalsOtherThan(const std::vector<unsigned long>& orbitals)
+{
+    for (std::map<unsigned long, OrbitalDirections>::iterator it = _orbitals.begin(); it != _orbitals.end(); )
+    {
+        bool inhabited = false;
+
+        for (size_t i = 0; i < orbitals.size() && ! inhabited; i++)
+        {
+            inhabited = (orbitals[i] == it->first);
+        }
+
+        it = inhabited ? ++it : _orbitals.erase(it);
+    }
+}
@@ -0,0 +1,57 @@
+//
+//  OrbitalLayout.hpp
+//  Interconnect
+//
+//  Where each node of an orbital sits on its sphere. Every node holds a slot in its orbital (see NodeStore) and each
+//  slot has a fixed direction from the origin on an open ended Fibonacci sphere: unlike the usual lattice the position
+//  of slot i doesn't depend on how many slots there are, yet any run of slots from zero is evenly spread. An orbital
+//  can gain and lose nodes without the others moving and only new slots ever need computing.
+//
+//  Directions are computed four slots per vector with a polynomial sin/cos into a structure-of-arrays buffer and kept
+//  per orbital. Per frame a node's position is just its slot's direction scaled by its (animated) radius.
+//
+//  Plain C++ with compiler vector extensions (SSE on x86, NEON on ARM) so it can be benchmarked outside the app, see
+//  OrbitalLayoutBenchmark.cpp.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#ifndef OrbitalLayout_hpp
+#define OrbitalLayout_hpp
+
+#include <stddef.h>
+#include <map>
+#include <vector>
+
+/**
+ * Unit direction of each slot, padded to a multiple of four slots.
+ */
+struct OrbitalDirections
+{
+    size_t slotCount;
+    std::vector<float> x, y, z;
+};
+
+class OrbitalLayout
+{
+public:
+    const OrbitalDirections& directions(unsigned long orbital, size_t slotCount);      // only slots not yet seen are computed
+    void forgetOrbitalsOtherThan(const std::vector<unsigned long>& orbitals);
+
+    size_t computedSlotCount() const { return _computedSlotCount; }
+
+    // The kernels fill slots [firstSlot, slotCount) of directions, which must already be sized for slotCount. Exposed
+    // for benchmarking.
+    static void computeDirections(unsigned long orbital, size_t firstSlot, size_t slotCount, OrbitalDirections& directions);
+    static void computeDirectionsScalar(unsigned long orbital, size_t firstSlot, size_t slotCount, OrbitalDirections& directions);
+    static void reserveSlots(size_t slotCount, OrbitalDirections& directions);
+
+    OrbitalLayout() : _computedSlotCount(0) {}
+
+private:
+    std::map<unsigned long, OrbitalDirections> _orbitals;
+    size_t _computedSlotCount;
+};
+
+#endif /* OrbitalLayout_hpp */
@@ -0,0 +1,89 @@
+//
+//  OrbitalLayoutBenchmark.cpp
+//  Interconnect
+//
+//  Times the orbital direction kernel against the same directions computed a slot at a time with libm. Not part of the
+//  app (it's the OrbitalLayoutBenchmark tool target), or build and run with:
+//
+//      c++ -O2 -std=c++11 -DORBITAL_LAYOUT_BENCHMARK OrbitalLayout.cpp OrbitalLayoutBenchmark.cpp -o orbitalbench
+//      ./orbitalbench
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#ifdef ORBITAL_LAYOUT_BENCHMARK
+
+#include "OrbitalLayout.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+
+#define kBenchmarkOrbital       3
+#define kBenchmarkMinimumSlots  100000          // each kernel is repeated until it has computed at least this many
+
+typedef void (*DirectionKernel)(unsigned long orbital, size_t firstSlot, size_t slotCount, OrbitalDirections& directions);
+
+static double NanosecondsPerSlot(DirectionKernel kernel, size_t slotCount, OrbitalDirections& directions)
+{
+    size_t repeats = (kBenchmarkMinimumSlots / slotCount) + 1;
+    double best = 0;
+
+    OrbitalLayout::reserveSlots(slotCount, directions);
+
+    for (int round = 0; round < 5; round++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < repeats; i++)
+        {
+            kernel(kBenchmarkOrbital, 0, slotCount, directions);
+        }
+
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        double perSlot = elapsed.count() / (repeats * slotCount);
+
+        best = (round == 0 || perSlot < best) ? perSlot : best;
+    }
+
+    return best;
+}
+
+int main()
+{
+    const size_t slotCounts[] = { 100, 1000, 10000, 100000 };
+    OrbitalDirections scalar = OrbitalDirections(), vector = OrbitalDirections();
+
+    printf("%8s  %14s  %14s  %8s  %10s\n", "slots", "scalar ns/slot", "kernel ns/slot", "speedup", "max error");
+
+    for (size_t slotCount : slotCounts)
+    {
+        double scalarTime = NanosecondsPerSlot(OrbitalLayout::computeDirectionsScalar, slotCount, scalar);
+        double vectorTime = NanosecondsPerSlot(OrbitalLayout::computeDirections, slotCount, vector);
+        float maximumError = 0;
+
+        for (size_t i = 0; i < slotCount; i++)
+        {
+            maximumError = fmaxf(maximumError, fabsf(scalar.x[i] - vector.x[i]));
+            maximumError = fmaxf(maximumError, fabsf(scalar.y[i] - vector.y[i]));
+            maximumError = fmaxf(maximumError, fabsf(scalar.z[i] - vector.z[i]));
+        }
+
+        printf("%8zu  %14.2f  %14.2f  %7.1fx  %10.2e\n", slotCount, scalarTime, vectorTime, scalarTime / vectorTime, maximumError);
+    }
+
+    // What matters most in the app: an orbital that grows a node at a time only ever computes its new slots
+    OrbitalLayout layout;
+
+    for (size_t slotCount = 1; slotCount <= 1000; slotCount++)
+    {
+        layout.directions(kBenchmarkOrbital, slotCount);
+        layout.directions(kBenchmarkOrbital, slotCount);
+    }
+
+    printf("Orbital grown to 1000 slots a node at a time: %zu slot(s) computed\n", layout.computedSlotCount());
+
+    return 0;
+}
+
+#endif
@@ -104,6 +104,33 @@ struct hdr_tcp
     unsigned short  tcp_urgent_ptr;
 };
 
+/*****************************************************************************************************************
+ * DNS HEADER
+ *****************************************************************************************************************/
+
+#define DNS_HDR_LEN         12
+
+#define DNS_FLAG_QR         0x8000      // message is a response
+#define DNS_FLAG_RD         0x0100      // recursion desired
+#define DNS_RCODE(dns_hdr)  (ntohs((dns_hdr)->dns_flags) & 0x000f)
+
+#define DNS_RCODE_NOERROR   0
+#define DNS_RCODE_SERVFAIL  2
+#define DNS_RCODE_NXDOMAIN  3
+
+#define DNS_TYPE_PTR        12
+#define DNS_CLASS_IN        1
+
+struct hdr_dns
+{
+    unsigned short  dns_id;
+    unsigned short  dns_flags;
+    unsigned short  dns_qdcount;        // entries in question section
+    unsigned short  dns_ancount;        // resource records in answer section
+    unsigned short  dns_nscount;        // name server resource records in authority section
+    unsigned short  dns_arcount;        // resource records in additional records section
+};
+
 #pragma options align=reset
 
 #endif /* PACKET_HEADERS_H */
@@ -0,0 +1,24 @@
+//
+//  PathCache.h
+//  Interconnect
+//
+//  Router hops discovered by traceroutes, kept per destination prefix so later traceroutes can skip the hops they
+//  would share. Paths are held at three levels: the hops common to every destination (our gateway and upstream), the
+//  hops common to every destination in a /16, and the complete path to each /24.
+//
+//  Not thread safe, expected to be owned by a probe thread.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@interface PathCache : NSObject
+
+- (uint8_t)cachedHopCountForAddress:(uint32_t)address routers:(uint32_t*)routers maxHops:(uint8_t)maxHops;
+- (uint8_t)knownHopsForAddress:(uint32_t)address routers:(uint32_t*)routers maxHops:(uint8_t)maxHops;
+- (void)recordPathToAddress:(uint32_t)address routers:(const uint32_t*)routers hopCount:(uint8_t)hopCount;
+- (void)removeAllPaths;
+
+@end
@@ -0,0 +1,189 @@
+//
+//  PathCache.m
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "PathCache.h"
+#import "PrefixTrie.h"
+
+#define kMaxPathHops                64
+#define kMaxCachedPaths             8192        // the cache is cleared (and relearned) if it grows past this
+#define kPathLifetimeSeconds        600         // after which a path is relearned rather than trusted or merged into
+#define kMinPathsForSharedHops      2           // one path says nothing about which of its hops other destinations share
+
+static const uint8_t kPathPrefixLengths[] = { 24, 16, 0 };     // most specific first
+
+/**
+ * routers[ttl] is the address (host byte order) of the router that answered at that TTL, 0 if it stayed silent. Only
+ * routers[1..knownHops] are valid.
+ */
+@interface PathCacheEntry : NSObject
+{
+    @public
+    uint32_t routers[kMaxPathHops + 1];
+}
+
+@property (nonatomic) uint8_t knownHops;
+@property (nonatomic) NSUInteger pathCount;     // how many paths have been merged into this one
+@property (nonatomic) uint8_t hopCount;         // /24 entries only, the destination's distance
+@property (nonatomic, strong) NSDate* learned;
+
+@end
+
+@implementation PathCacheEntry
+
+@end
+
+@interface PathCache ()
+
+@property (nonatomic, strong) PrefixTrie* pathsByPrefix;        // prefix -> index into paths
+@property (nonatomic, strong) NSMutableArray* paths;
+
+@end
+
+@implementation PathCache
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _pathsByPrefix = [[PrefixTrie alloc] init];
+        _paths = [[NSMutableArray alloc] init];
+    }
+
+    return self;
+}
+
+- (PathCacheEntry*)freshPathForPrefixOfAddress:(uint32_t)address length:(uint8_t)length
+{
+    NSUInteger pathIndex;
+
+    if ( ! [self.pathsByPrefix exactMatchForPrefix:address length:length value:&pathIndex])
+    {
+        return nil;
+    }
+
+    PathCacheEntry* path = self.paths[pathIndex];
+
+    return (-[path.learned timeIntervalSinceNow] < kPathLifetimeSeconds) ? path : nil;
+}
+
+/**
+ * A destination in a /24 we've recently completed a traceroute to is assumed to be as far away as the one we traced
+ * (its RTT isn't, the distance is all that's shared). Returns that hop count, or 0 if there's none within maxHops,
+ * and copies the routers on the way into routers[1..n - 1] (0 where one stayed silent).
+ */
+- (uint8_t)cachedHopCountForAddress:(uint32_t)address routers:(uint32_t*)routers maxHops:(uint8_t)maxHops
+{
+    PathCacheEntry* path = [self freshPathForPrefixOfAddress:address length:kPathPrefixLengths[0]];
+
+    if ( ! path || ! path.hopCount || path.hopCount > maxHops)
+    {
+        return 0;
+    }
+
+    memset(&routers[1], 0, (path.hopCount - 1) * sizeof(uint32_t));
+    memcpy(&routers[1], &path->routers[1], MIN(path.knownHops, path.hopCount - 1) * sizeof(uint32_t));
+
+    return path.hopCount;
+}
+
+/**
+ * Returns the number of leading hops known to be shared by every destination under the most specific prefix that
+ * covers the address (excluding complete /24 paths, see cachedHopCountForAddress:), and copies them into routers[1..n].
+ */
+- (uint8_t)knownHopsForAddress:(uint32_t)address routers:(uint32_t*)routers maxHops:(uint8_t)maxHops
+{
+    for (NSUInteger level = 1; level < sizeof(kPathPrefixLengths); level++)
+    {
+        PathCacheEntry* path = [self freshPathForPrefixOfAddress:address length:kPathPrefixLengths[level]];
+
+        if (path.pathCount >= kMinPathsForSharedHops)
+        {
+            uint8_t knownHops = MIN(path.knownHops, maxHops);
+
+            memcpy(&routers[1], &path->routers[1], knownHops * sizeof(uint32_t));
+
+            return knownHops;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * routers[1..hopCount - 1] are the routers on the path to the destination, which answered at hopCount.
+ */
+- (void)recordPathToAddress:(uint32_t)address routers:(const uint32_t*)routers hopCount:(uint8_t)hopCount
+{
+    if ( ! hopCount || hopCount > kMaxPathHops)
+    {
+        return;
+    }
+
+    if (self.paths.count + sizeof(kPathPrefixLengths) > kMaxCachedPaths)
+    {
+        NSLog(@"Path cache is full, clearing %lu paths", (unsigned long)self.paths.count);
+        [self removeAllPaths];
+    }
+
+    uint8_t routerHops = hopCount - 1;
+
+    for (NSUInteger level = 0; level < sizeof(kPathPrefixLengths); level++)
+    {
+        uint8_t length = kPathPrefixLengths[level];
+        PathCacheEntry* path = [self freshPathForPrefixOfAddress:address length:length];
+
+        if (path && level > 0)
+        {
+            // Only the hops this path shares with every earlier path under the prefix stay known
+            uint8_t sharedHops = 0;
+
+            while (sharedHops < MIN(path.knownHops, routerHops) && routers[sharedHops + 1] && path->routers[sharedHops + 1] == routers[sharedHops + 1])
+            {
+                sharedHops++;
+            }
+
+            path.knownHops = sharedHops;
+            path.pathCount++;
+            continue;
+        }
+
+        NSUInteger pathIndex;
+
+        if ( ! [self.pathsByPrefix exactMatchForPrefix:address length:length value:&pathIndex])
+        {
+            pathIndex = self.paths.count;
+            [self.paths addObject:[[PathCacheEntry alloc] init]];
+            [self.pathsByPrefix insertPrefix:address length:length value:pathIndex];
+        }
+
+        // A new (or expired) entry starts from this path, trailing silent hops aren't worth knowing
+        path = self.paths[pathIndex];
+        memcpy(&path->routers[1], &routers[1], routerHops * sizeof(uint32_t));
+        path.knownHops = routerHops;
+        path.pathCount = 1;
+        path.learned = [NSDate date];
+
+        while (path.knownHops && ! path->routers[path.knownHops])
+        {
+            path.knownHops--;
+        }
+
+        if (level == 0)
+        {
+            path.hopCount = hopCount;
+        }
+    }
+}
+
+- (void)removeAllPaths
+{
+    [self.pathsByPrefix removeAllPrefixes];
+    [self.paths removeAllObjects];
+}
+
+@end
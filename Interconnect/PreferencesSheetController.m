@@ -51,7 +51,7 @@
 
 - (void)probeTypeChanged:(id)sender
 {
-    if (self.selectProbe.selectedTag == kProbeTypeThreadTraceroute)
+    if (PROBE_TYPE_IS_THREAD_TRACEROUTE(self.selectProbe.selectedTag))
     {
         self.btnCompleteTimedOutProbes.enabled = YES;
         self.btnCompleteTimedOutProbes.state = self.captureWorker.completeTimedOutProbes ? NSOnState : NSOffState;
@@ -0,0 +1,28 @@
+//
+//  PrefixTrie.h
+//  Interconnect
+//
+//  A path-compressed binary trie of IPv4 CIDR prefixes, each carrying an integer value. Lookups walk at most 32 levels
+//  using only integer operations and return the value of the longest prefix covering the address.
+//
+//  Not thread safe, the owner is expected to serialise access.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@interface PrefixTrie : NSObject
+
+@property (nonatomic, readonly) NSUInteger prefixCount;
+
++ (BOOL)parseCIDR:(NSString*)cidr network:(uint32_t*)network length:(uint8_t*)length;
++ (BOOL)parseIPv4Address:(NSString*)ipAddress address:(uint32_t*)address;
+
+- (void)insertPrefix:(uint32_t)network length:(uint8_t)length value:(NSUInteger)value;
+- (BOOL)longestMatchForAddress:(uint32_t)address value:(NSUInteger*)value length:(uint8_t*)length;
+- (BOOL)exactMatchForPrefix:(uint32_t)network length:(uint8_t)length value:(NSUInteger*)value;
+- (void)removeAllPrefixes;
+
+@end
@@ -0,0 +1,296 @@
+//
+//  PrefixTrie.m
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "PrefixTrie.h"
+#import <arpa/inet.h>
+
+#define kInitialNodeCapacity    64
+
+/**
+ * Nodes live in one contiguous array and refer to their children by index, index 0 is the root (the /0 prefix) so a
+ * child index of 0 means there is no child.
+ */
+struct trie_node
+{
+    uint32_t    network;
+    uint8_t     length;
+    uint8_t     hasValue;       // internal nodes created by splits don't carry a value
+    uint32_t    child[2];
+    NSUInteger  value;
+};
+
+static inline uint32_t PrefixMask(uint8_t length)
+{
+    return length ? (0xffffffffU << (32 - length)) : 0;
+}
+
+static inline int BitAfterPrefix(uint32_t address, uint8_t length)
+{
+    return (address >> (31 - length)) & 1;
+}
+
+@interface PrefixTrie ()
+
+@property (nonatomic) struct trie_node* nodes;
+@property (nonatomic) uint32_t nodeCount;
+@property (nonatomic) uint32_t nodeCapacity;
+
+@end
+
+@implementation PrefixTrie
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _nodeCapacity = kInitialNodeCapacity;
+        _nodes = calloc(_nodeCapacity, sizeof(struct trie_node));
+
+        if ( ! _nodes)
+        {
+            return nil;
+        }
+
+        [self removeAllPrefixes];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_nodes);
+}
+
+#pragma mark - Parsing
+
+/**
+ * "a.b.c.d/len", a bare address is treated as a /32. Host bits in the network are ignored.
+ */
++ (BOOL)parseCIDR:(NSString*)cidr network:(uint32_t*)network length:(uint8_t*)length
+{
+    NSArray* tokens = [cidr componentsSeparatedByString:@"/"];
+    NSInteger prefixLength = 32;
+
+    if (tokens.count > 2 || ! [self parseIPv4Address:tokens[0] address:network])
+    {
+        return NO;
+    }
+
+    if (tokens.count == 2)
+    {
+        NSScanner* scanner = [NSScanner scannerWithString:tokens[1]];
+        if ( ! [scanner scanInteger:&prefixLength] || ! [scanner isAtEnd] || prefixLength < 0 || prefixLength > 32)
+        {
+            return NO;
+        }
+    }
+
+    *length = (uint8_t)prefixLength;
+    *network &= PrefixMask(*length);
+
+    return YES;
+}
+
+/**
+ * Returns the address in host byte order.
+ */
++ (BOOL)parseIPv4Address:(NSString*)ipAddress address:(uint32_t*)address
+{
+    struct in_addr addr;
+
+    if ( ! ipAddress || inet_pton(AF_INET, [ipAddress cStringUsingEncoding:NSASCIIStringEncoding], &addr) != 1)
+    {
+        return NO;
+    }
+
+    *address = ntohl(addr.s_addr);
+
+    return YES;
+}
+
+#pragma mark - Trie Operations
+
+- (uint32_t)allocateNodeForNetwork:(uint32_t)network length:(uint8_t)length
+{
+    if (_nodeCount == _nodeCapacity)
+    {
+        struct trie_node* nodes = realloc(_nodes, _nodeCapacity * 2 * sizeof(struct trie_node));
+
+        if ( ! nodes)
+        {
+            [NSException raise:@"PrefixTrie" format:@"Unable to grow trie beyond %u nodes", _nodeCapacity];
+        }
+
+        _nodes = nodes;
+        _nodeCapacity *= 2;
+    }
+
+    struct trie_node* node = &_nodes[_nodeCount];
+    memset(node, 0, sizeof(struct trie_node));
+    node->network = network;
+    node->length = length;
+
+    return _nodeCount++;
+}
+
+/**
+ * Inserting a prefix that is already present replaces its value.
+ */
+- (void)insertPrefix:(uint32_t)network length:(uint8_t)length value:(NSUInteger)value
+{
+    if (length > 32)
+    {
+        return;
+    }
+
+    network &= PrefixMask(length);
+
+    uint32_t parent = 0;       // always a prefix of the new prefix
+
+    while (_nodes[parent].length < length)
+    {
+        int bit = BitAfterPrefix(network, _nodes[parent].length);
+        uint32_t child = _nodes[parent].child[bit];
+
+        if ( ! child)
+        {
+            uint32_t leaf = [self allocateNodeForNetwork:network length:length];
+            _nodes[parent].child[bit] = leaf;
+            parent = leaf;
+            break;
+        }
+
+        // How many leading bits do the new prefix and the child's prefix share?
+        uint32_t difference = network ^ _nodes[child].network;
+        uint8_t commonLength = difference ? (uint8_t)__builtin_clz(difference) : 32;
+        commonLength = MIN(commonLength, MIN(length, _nodes[child].length));
+
+        if (commonLength == _nodes[child].length)
+        {
+            parent = child;         // the child covers the new prefix, keep descending
+            continue;
+        }
+
+        // The new prefix diverges from (or sits above) the child, so split the edge at the common length
+        uint32_t split = [self allocateNodeForNetwork:network & PrefixMask(commonLength) length:commonLength];
+        _nodes[split].child[BitAfterPrefix(_nodes[child].network, commonLength)] = child;
+        _nodes[parent].child[bit] = split;
+
+        if (commonLength == length)
+        {
+            parent = split;         // the split node is the new prefix
+        }
+        else
+        {
+            uint32_t leaf = [self allocateNodeForNetwork:network length:length];
+            _nodes[split].child[BitAfterPrefix(network, commonLength)] = leaf;
+            parent = leaf;
+        }
+
+        break;
+    }
+
+    if ( ! _nodes[parent].hasValue)
+    {
+        _prefixCount++;
+    }
+
+    _nodes[parent].hasValue = 1;
+    _nodes[parent].value = value;
+}
+
+- (BOOL)longestMatchForAddress:(uint32_t)address value:(NSUInteger*)value length:(uint8_t*)length
+{
+    const struct trie_node* match = NULL;
+    uint32_t index = 0;
+
+    for (;;)
+    {
+        const struct trie_node* node = &_nodes[index];
+
+        if ((address ^ node->network) & PrefixMask(node->length))
+        {
+            break;      // a compressed edge skipped bits that don't match
+        }
+
+        if (node->hasValue)
+        {
+            match = node;
+        }
+
+        if (node->length == 32 || ! (index = node->child[BitAfterPrefix(address, node->length)]))
+        {
+            break;
+        }
+    }
+
+    if ( ! match)
+    {
+        return NO;
+    }
+
+    if (value)
+    {
+        *value = match->value;
+    }
+
+    if (length)
+    {
+        *length = match->length;
+    }
+
+    return YES;
+}
+
+/**
+ * Only a prefix of exactly this length matches, not one that merely covers it.
+ */
+- (BOOL)exactMatchForPrefix:(uint32_t)network length:(uint8_t)length value:(NSUInteger*)value
+{
+    const struct trie_node* node;
+    uint32_t index = 0;
+
+    network &= PrefixMask(length);
+
+    for (;;)
+    {
+        node = &_nodes[index];
+
+        if (node->length > length || ((network ^ node->network) & PrefixMask(node->length)))
+        {
+            return NO;
+        }
+
+        if (node->length == length || ! (index = node->child[BitAfterPrefix(network, node->length)]))
+        {
+            break;
+        }
+    }
+
+    if (node->length != length || ! node->hasValue)
+    {
+        return NO;
+    }
+
+    if (value)
+    {
+        *value = node->value;
+    }
+
+    return YES;
+}
+
+- (void)removeAllPrefixes
+{
+    memset(&_nodes[0], 0, sizeof(struct trie_node));
+    _nodeCount = 1;
+    _prefixCount = 0;
+}
+
+@end
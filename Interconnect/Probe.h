@@ -8,6 +8,7 @@
 
 #import <Cocoa/Cocoa.h>
 #import <sys/time.h>
+#import "TimerWheel.h"
 
 @interface Probe : NSObject
 
@@ -16,10 +17,12 @@
 @property (nonatomic) uint16_t sequenceNumber;
 @property (nonatomic) uint8_t currentTTL;
 @property (nonatomic) float rttToHost;
+@property (nonatomic, strong) NSArray* rttSamples;          // echo probes, every RTT measured (NSNumber ms)
 @property (nonatomic) uint16_t dstPort;
-@property (nonatomic) struct timeval timeSent;
+@property (nonatomic) uint64_t timeSent;        // monotonic ns
 @property (nonatomic) uint8_t retries;
 @property (nonatomic) BOOL inflight;
+@property (nonatomic) TimerWheelHandle timeoutTimer;
 @property (nonatomic) BOOL complete;
 @property (nonatomic, copy) void (^completionBlock)(Probe*);
 
@@ -0,0 +1,32 @@
+//
+//  ProbeSlotTable.h
+//  Interconnect
+//
+//  A fixed size table of in-flight probes indexed directly by a 16-bit key (a UDP port block or ICMP identifier).
+//  Free slots are kept on a FIFO free list so allocation is O(1), never fails while a slot is free, and a released
+//  slot is the last to be reused (giving late replies to its old probe the longest time to drain).
+//
+//  Not thread safe, expected to be owned by a probe thread.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class Probe;
+
+#define kMaxProbeSlots  65536
+
+@interface ProbeSlotTable : NSObject
+
+@property (nonatomic, readonly) NSUInteger capacity;
+@property (nonatomic, readonly) NSUInteger count;
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity firstSlot:(NSUInteger)firstSlot;
+
+- (BOOL)allocateSlot:(uint16_t*)slot forProbe:(Probe*)probe;
+- (Probe*)probeInSlot:(uint16_t)slot;
+- (void)releaseSlot:(uint16_t)slot;
+
+@end
@@ -0,0 +1,102 @@
+//
+//  ProbeSlotTable.m
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "ProbeSlotTable.h"
+#import "Probe.h"
+
+@interface ProbeSlotTable ()
+{
+    __strong Probe** _probes;       // indexed by slot, nil when free
+    uint16_t* _freeSlots;           // ring buffer of free slots
+    NSUInteger _freeHead;
+}
+
+@end
+
+@implementation ProbeSlotTable
+
+/**
+ * firstSlot sets where in the key space allocation starts, slots are then handed out in order and wrap around.
+ */
+- (instancetype)initWithCapacity:(NSUInteger)capacity firstSlot:(NSUInteger)firstSlot
+{
+    if (self = [super init])
+    {
+        _capacity = MIN(MAX(capacity, 1), kMaxProbeSlots);
+        _count = 0;
+        _freeHead = 0;
+
+        _probes = (__strong Probe**)calloc(_capacity, sizeof(Probe*));
+        _freeSlots = calloc(_capacity, sizeof(uint16_t));
+
+        if ( ! _probes || ! _freeSlots)
+        {
+            return nil;
+        }
+
+        for (NSUInteger i = 0; i < _capacity; i++)
+        {
+            _freeSlots[i] = (uint16_t)((firstSlot + i) % _capacity);
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_probes)
+    {
+        // ARC doesn't release objects held in malloc'd memory for us
+        for (NSUInteger i = 0; i < _capacity; i++)
+        {
+            _probes[i] = nil;
+        }
+
+        free(_probes);
+    }
+
+    free(_freeSlots);
+}
+
+- (BOOL)allocateSlot:(uint16_t*)slot forProbe:(Probe*)probe
+{
+    if (_count == _capacity)
+    {
+        return NO;
+    }
+
+    *slot = _freeSlots[_freeHead];
+    _freeHead = (_freeHead + 1) % _capacity;
+    _count++;
+
+    _probes[*slot] = probe;
+
+    return YES;
+}
+
+- (Probe*)probeInSlot:(uint16_t)slot
+{
+    return (slot < _capacity) ? _probes[slot] : nil;
+}
+
+- (void)releaseSlot:(uint16_t)slot
+{
+    if (slot >= _capacity || ! _probes[slot])
+    {
+        return;
+    }
+
+    _probes[slot] = nil;
+
+    // The free slots are the _capacity - _count entries starting at _freeHead, append after the last of them
+    _freeSlots[(_freeHead + (_capacity - _count)) % _capacity] = slot;
+    _count--;
+}
+
+@end
@@ -8,9 +8,21 @@
 //  Copyright © 2016 oroboto. All rights reserved.
 //
 
+@class TimerWheel;
+
 @interface ProbeThread (oroboto_Private)
 
+- (TimerWheel*)timerWheel;      // probe timeouts, keyed and handled by the derived class (see probeTimedOut:context:)
+- (void)serviceTimers;          // call after timeouts may have changed outside of the socket and run loop source callbacks
+
 - (unsigned short)internetChecksum:(unsigned char*)data length:(unsigned short)length;
 - (float)msElapsedBetween:(struct timeval)startTime endTime:(struct timeval)endTime;
 
+- (BOOL)takeProbeToken;         // one packet beyond those charged when the probe started (see packetsPerProbe)
+- (NSUInteger)msUntilProbeToken;
+- (void)returnProbeTokens:(NSUInteger)count;
+
+- (uint64_t)monotonicNs;        // the clock probe times are taken on, see processIncomingDatagram:length:from:receivedAt:
+- (float)msElapsedBetweenNs:(uint64_t)startNs endNs:(uint64_t)endNs;
+
 @end
@@ -8,14 +8,18 @@
 //  Copyright © 2016 oroboto. All rights reserved.
 //
 
+#import <netinet/in.h>
+
 @class Probe;
 
 @interface ProbeThread (oroboto_ProbeInterface)
 
 - (int)getNativeSocket;
-- (void)processIncomingSocketData;
+- (void)processIncomingDatagram:(unsigned char*)datagram length:(ssize_t)length from:(const struct sockaddr_in*)srcAddr receivedAt:(uint64_t)timeRecv;     // timeRecv is monotonic ns
+
+- (void)sendProbe:(NSString*)toHostIdentifier port:(uint16_t)port onCompletion:(void (^)(Probe*))completionBlock retrying:(BOOL)retrying reprobing:(BOOL)reprobing;      // port is the host's service port if known (0 if not), a re-probe must not be answered from a cache
+- (void)probeTimedOut:(uint32_t)key context:(uint32_t)context;      // a timeout scheduled on the timer wheel has expired
 
-- (void)sendProbe:(NSString*)toHostIdentifier onCompletion:(void (^)(Probe*))completionBlock retrying:(BOOL)retrying;
-- (void)cleanupProbes;
+- (NSUInteger)packetsPerProbe;      // charged against the probe rate limit when a probe starts (defaults to 1), any more take a token each
 
 @end
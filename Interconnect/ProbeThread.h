@@ -19,6 +19,8 @@
 - (BOOL)stop:(void (^)(void))threadStoppedBlock;
 
 - (void)queueProbeForHost:(NSString*)hostIdentifier withPriority:(BOOL)priority onCompletion:(void (^)(Probe*))completionBlock;
+- (void)queueProbeForHost:(NSString*)hostIdentifier port:(uint16_t)port withPriority:(BOOL)priority onCompletion:(void (^)(Probe*))completionBlock;
+- (void)queueReprobeForHost:(NSString*)hostIdentifier port:(uint16_t)port onCompletion:(void (^)(Probe*))completionBlock;
 - (void)processHostQueue;
 
 @end
@@ -8,18 +8,61 @@
 
 #import "ProbeThread.h"
 #import "ProbeThread+Private.h"
+#import "ProbeThread+ProbeInterface.h"
+#import "TimerWheel.h"
+#import <arpa/inet.h>
+#import <fcntl.h>
+#import <mach/mach_time.h>
+
+#define kProbeTokensPerSecond       100         // global send budget (packets per second)
+#define kProbeTokenBurst            32          // packets that can be sent back to back after a quiet period
+#define kPrefixPacingLength         24          // hosts sharing a prefix of this length share the routers nearest them...
+#define kPrefixPacingMs             250         // ...so probes to them are started at least this far apart
+#define kSchedulerIntervalSeconds   0.05
+#define kMaxQueueEntriesScanned     256         // bounds the work done per scheduler pass when a prefix dominates the queue
+#define kTimeoutIntervalSeconds     1           // the timeout timer is rescheduled to the wheel's next expiry, this is a backstop
+#define kReceiveBufferBytes         65535
+#define kMaxDatagramsPerRead        64          // bounds the time spent in one socket callback, the rest are read on the next
+#define kControlBufferBytes         64          // room for the receive timestamp
 
 @interface ProbeThread ()
+{
+    unsigned char* _receiveBuffer;      // reused for every datagram read
+}
 
 @property (nonatomic, strong) NSThread* probeThread;
 @property (nonatomic, copy) void (^stopBlock)(void);        // used to signal probe thread exit
 @property (nonatomic) CFRunLoopRef cfRunLoop;
 @property (nonatomic, strong) NSLock* probeQueueLock;
-@property (nonatomic, strong) NSMutableArray* probeQueue;
+@property (nonatomic, strong) NSMutableArray* probeQueue;                 // high priority
+@property (nonatomic, strong) NSMutableArray* lowPriorityProbeQueue;      // only served once the high priority queue is empty
 @property (nonatomic) CFRunLoopSourceRef probeQueueInputSource;
 
+@property (nonatomic) double probeTokens;
+@property (nonatomic) uint64_t probeTokensUpdated;                          // monotonicNs, so clock steps can't drain the bucket
+@property (nonatomic, strong) NSMutableDictionary* lastProbeTimeByPrefix;     // NSNumber prefix -> NSNumber monotonicNs
+
+@property (nonatomic, strong) TimerWheel* timerWheel;
+@property (nonatomic, strong) NSTimer* timeoutTimer;
+
 @end
 
+/**
+ * Probe send and receive times are taken on the monotonic clock (mach absolute time, which is also what the kernel
+ * stamps received datagrams with) so RTTs aren't skewed by the wall clock being adjusted.
+ */
+static uint64_t MachTimeToNs(uint64_t machTime)
+{
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t token;
+    
+    dispatch_once(&token, ^{
+        mach_timebase_info(&timebase);
+    });
+    
+    return machTime * timebase.numer / timebase.denom;
+}
+
 @implementation ProbeThread
 
 - (instancetype)init
@@ -27,21 +70,44 @@
     if (self = [super init])
     {
         NSLog(@"ProbeThread initialised");
-
+        
         _probeThread = [[NSThread alloc] initWithTarget:self selector:@selector(threadMain:) object:nil];
         _stopBlock = nil;
         _threadRunning = NO;
         _completeTimedOutProbes = YES;
-
+        
         _cfRunLoop = NULL;
         _probeQueueLock = [[NSLock alloc] init];
         _probeQueueInputSource = NULL;
         _probeQueue = [NSMutableArray arrayWithCapacity:16];
+        _lowPriorityProbeQueue = [NSMutableArray arrayWithCapacity:16];
+        
+        _probeTokens = kProbeTokenBurst;
+        _probeTokensUpdated = [self monotonicNs];
+        _lastProbeTimeByPrefix = [[NSMutableDictionary alloc] init];
+        
+        // Probe timeouts are delivered to the derived class
+        __weak ProbeThread* weakSelf = self;
+        _timerWheel = [[TimerWheel alloc] initWithHandler:^(uint32_t key, uint32_t context) {
+            [weakSelf probeTimedOut:key context:context];
+        }];
+        _timeoutTimer = nil;
+        
+        _receiveBuffer = malloc(kReceiveBufferBytes);
+        if ( ! _receiveBuffer)
+        {
+            return nil;
+        }
     }
     
     return self;
 }
 
+- (void)dealloc
+{
+    free(_receiveBuffer);
+}
+
 - (void)start
 {
     [self.probeThread start];
@@ -63,7 +129,7 @@
 
 #pragma mark - ProbeInterface
 
-- (void)sendProbe:(NSString*)toHostIdentifier onCompletion:(void (^)(Probe*))completionBlock retrying:(BOOL)retrying
+- (void)sendProbe:(NSString*)toHostIdentifier port:(uint16_t)port onCompletion:(void (^)(Probe*))completionBlock retrying:(BOOL)retrying reprobing:(BOOL)reprobing
 {
     [NSException raise:@"sendProbe" format:@"Must be over-ridden"];
 }
@@ -78,34 +144,76 @@
 }
 
 /**
- * Should be overridden by derived classes.
+ * Should be overridden by derived classes. The datagram is only valid for the duration of the call.
  */
-- (void)processIncomingSocketData
+- (void)processIncomingDatagram:(unsigned char*)datagram length:(ssize_t)length from:(const struct sockaddr_in*)srcAddr receivedAt:(uint64_t)timeRecv
 {
-    [NSException raise:@"processIncomingSocketData" format:@"Must be over-ridden"];
+    [NSException raise:@"processIncomingDatagram" format:@"Must be over-ridden"];
 }
 
 /**
- * Should be overridden by derived classes.
+ * May be overridden by derived classes that send more than one packet when a probe starts.
+ */
+- (NSUInteger)packetsPerProbe
+{
+    return 1;
+}
+
+/**
+ * Should be overridden by derived classes that schedule timeouts on the timer wheel.
  */
-- (void)cleanupProbes
+- (void)probeTimedOut:(uint32_t)key context:(uint32_t)context
 {
-    [NSException raise:@"cleanupProbes" format:@"Must be over-ridden"];
+    [NSException raise:@"probeTimedOut" format:@"Must be over-ridden"];
 }
 
 #pragma mark - Custom Run Loop Input Source (Public Interface)
 
 /**
- * Add a host to the probe queue. 
+ * Add a host to the probe queue. Priority hosts are queued ahead of all others and the worker is woken immediately,
+ * other hosts wait for the next scheduler pass. Either way probes are only sent as the rate limits allow.
  *
  * Expected to be called in the context of the client thread.
  */
 - (void)queueProbeForHost:(NSString *)hostIdentifier withPriority:(BOOL)priority onCompletion:(void (^)(Probe*))completionBlock
 {
+    [self queueProbeForHost:hostIdentifier port:0 withPriority:priority onCompletion:completionBlock];
+}
+
+/**
+ * As above, for probe types that connect to a service on the host (port is the one the host was seen using).
+ */
+- (void)queueProbeForHost:(NSString *)hostIdentifier port:(uint16_t)port withPriority:(BOOL)priority onCompletion:(void (^)(Probe*))completionBlock
+{
+    [self queueProbeForHost:hostIdentifier port:port withPriority:priority reprobing:NO onCompletion:completionBlock];
+}
+
+/**
+ * Queue a host that has been probed before to be probed again. Re-probes wait behind other hosts and are never
+ * answered from what was learned by earlier probes (such as the path cache), the point is to see if it has changed.
+ */
+- (void)queueReprobeForHost:(NSString *)hostIdentifier port:(uint16_t)port onCompletion:(void (^)(Probe*))completionBlock
+{
+    [self queueProbeForHost:hostIdentifier port:port withPriority:NO reprobing:YES onCompletion:completionBlock];
+}
+
+- (void)queueProbeForHost:(NSString *)hostIdentifier port:(uint16_t)port withPriority:(BOOL)priority reprobing:(BOOL)reprobing onCompletion:(void (^)(Probe*))completionBlock
+{
+    struct in_addr hostAddress;
+    uint32_t prefix = 0;
+    
+    if (inet_pton(AF_INET, [hostIdentifier cStringUsingEncoding:NSASCIIStringEncoding], &hostAddress) == 1)
+    {
+        prefix = ntohl(hostAddress.s_addr) & (0xffffffffU << (32 - kPrefixPacingLength));
+    }
+    
     [self.probeQueueLock lock];
     
     NSMutableDictionary* probeQueueEntry = [@{
-                                      @"hostIdentifier": hostIdentifier
+                                      @"hostIdentifier": hostIdentifier,
+                                      @"port": [NSNumber numberWithUnsignedShort:port],
+                                      @"prefix": [NSNumber numberWithUnsignedInt:prefix],
+                                      @"reprobe": [NSNumber numberWithBool:reprobing]
     } mutableCopy];
     
     if (completionBlock != nil)
@@ -113,8 +221,8 @@
         probeQueueEntry[@"completionBlock"] = completionBlock;
     }
     
-    [self.probeQueue addObject:probeQueueEntry];
-
+    [(priority ? self.probeQueue : self.lowPriorityProbeQueue) addObject:probeQueueEntry];
+    
     [self.probeQueueLock unlock];
     
     if (priority)
@@ -156,6 +264,7 @@ void RunLoopSourcePerformRoutine(void *context)
 {
     ProbeThread* probeThread = (__bridge ProbeThread*)context;
     [probeThread processNewHosts];
+    [probeThread serviceTimers];
 }
 
 /**
@@ -168,22 +277,140 @@ void RunLoopSourceCancelRoutine(void *context, CFRunLoopRef runLoop, CFStringRef
 
 /**
  * The callback called by the run loop when the custom input source has data to process (ie. hosts to drain from probe queue)
+ * and periodically by the scheduler timer.
+ *
+ * Probes are drawn from a token bucket shared by all hosts so a burst of new hosts is spread out rather than sent at
+ * once (which triggers ICMP rate limiting on the routers we're probing), and probes towards the same prefix are spaced
+ * out so the routers in front of it aren't hit by many probes at once either.
  */
 - (void)processNewHosts
 {
     [self.probeQueueLock lock];
+    
+    if ( ! self.probeQueue.count && ! self.lowPriorityProbeQueue.count)
+    {
+        [self.probeQueueLock unlock];
+        return;
+    }
+    
+    [self refillProbeTokens];
+    
+    // Forget prefixes that are no longer being paced
+    uint64_t now = [self monotonicNs];
+    NSArray* pacedPrefixes = [self.lastProbeTimeByPrefix keysOfEntriesPassingTest:^BOOL(id key, NSNumber* lastProbeTime, BOOL *stop) {
+        return [self msElapsedBetweenNs:[lastProbeTime unsignedLongLongValue] endNs:now] >= kPrefixPacingMs;
+    }].allObjects;
+    [self.lastProbeTimeByPrefix removeObjectsForKeys:pacedPrefixes];
+    
+    NSUInteger probeCost = MIN([self packetsPerProbe], kProbeTokenBurst);
+    NSUInteger probesSent = 0, entriesScanned = 0;
+    
+    for (NSMutableArray* queue in @[self.probeQueue, self.lowPriorityProbeQueue])
+    {
+        NSUInteger entryIndex = 0;
+        
+        while (entryIndex < queue.count && self.probeTokens >= probeCost && entriesScanned++ < kMaxQueueEntriesScanned)
+        {
+            NSMutableDictionary* probeQueueEntry = queue[entryIndex];
+            
+            if (self.lastProbeTimeByPrefix[probeQueueEntry[@"prefix"]])
+            {
+                entryIndex++;       // leave it queued in order until its prefix has cooled down
+                continue;
+            }
+            
+            [self sendProbe:probeQueueEntry[@"hostIdentifier"] port:[probeQueueEntry[@"port"] unsignedShortValue] onCompletion:(probeQueueEntry[@"completionBlock"] ? probeQueueEntry[@"completionBlock"] : nil) retrying:NO reprobing:[probeQueueEntry[@"reprobe"] boolValue]];
+            
+            self.lastProbeTimeByPrefix[probeQueueEntry[@"prefix"]] = @(now);
+            self.probeTokens -= probeCost;
+            probesSent++;
+            
+            [queue removeObjectAtIndex:entryIndex];
+        }
+    }
+    
+    if (probesSent)
+    {
+        NSLog(@"Worker sent %lu probes (%lu priority and %lu other hosts still queued)", probesSent, self.probeQueue.count, self.lowPriorityProbeQueue.count);
+    }
+    
+    [self.probeQueueLock unlock];
+}
 
-    NSLog(@"Worker found %lu hosts to probe", self.probeQueue.count);
+- (void)schedulerTimerFired:(NSTimer*)timer
+{
+    [self processNewHosts];
+    [self serviceTimers];
+}
+
+#pragma mark - Probe Tokens
+
+/**
+ * Refill the bucket for the time since it was last refilled (never negative, see msElapsedBetweenNs:endNs:).
+ */
+- (void)refillProbeTokens
+{
+    uint64_t now = [self monotonicNs];
+    
+    self.probeTokens = MIN(kProbeTokenBurst, self.probeTokens + ([self msElapsedBetweenNs:self.probeTokensUpdated endNs:now] * kProbeTokensPerSecond / 1000.0));
+    self.probeTokensUpdated = now;
+}
 
-    NSMutableDictionary* probeQueueEntry;
+/**
+ * Packets sent after a probe has started (retries, further hops) are drawn from the same bucket as the packets it
+ * started with, one at a time.
+ */
+- (BOOL)takeProbeToken
+{
+    [self refillProbeTokens];
     
-    while ((probeQueueEntry = [self.probeQueue firstObject]))
+    if (self.probeTokens < 1)
     {
-        [self sendProbe:probeQueueEntry[@"hostIdentifier"] onCompletion:(probeQueueEntry[@"completionBlock"] ? probeQueueEntry[@"completionBlock"] : nil) retrying:NO];
-        [self.probeQueue removeObjectAtIndex:0];
+        return NO;
     }
+    
+    self.probeTokens -= 1;
+    
+    return YES;
+}
 
-    [self.probeQueueLock unlock];
+- (NSUInteger)msUntilProbeToken
+{
+    [self refillProbeTokens];
+    
+    return (self.probeTokens >= 1) ? 0 : (NSUInteger)ceil((1 - self.probeTokens) * 1000.0 / kProbeTokensPerSecond);
+}
+
+/**
+ * Give back tokens a probe was charged for when it started but never used.
+ */
+- (void)returnProbeTokens:(NSUInteger)count
+{
+    [self refillProbeTokens];
+    
+    self.probeTokens = MIN(kProbeTokenBurst, self.probeTokens + count);
+}
+
+#pragma mark - Probe Timeouts
+
+/**
+ * Fire any probe timeouts that are due then move the timeout timer to the wheel's next expiry, so retries are sent
+ * when they're due rather than on the next pass over every probe.
+ *
+ * Called after anything that may have scheduled or cancelled a timeout.
+ */
+- (void)serviceTimers
+{
+    [self.timerWheel advance];
+    
+    NSInteger msUntilNextExpiry = [self.timerWheel msUntilNextExpiry];
+    
+    self.timeoutTimer.fireDate = (msUntilNextExpiry < 0) ? [NSDate dateWithTimeIntervalSinceNow:kTimeoutIntervalSeconds] : [NSDate dateWithTimeIntervalSinceNow:msUntilNextExpiry / 1000.0];
+}
+
+- (void)timeoutTimerFired:(NSTimer*)timer
+{
+    [self serviceTimers];
 }
 
 #pragma mark - Socket Run Loop Input Source
@@ -196,7 +423,65 @@ void SocketCallback(CFSocketRef s, CFSocketCallBackType callbackType, CFDataRef
     if (callbackType == kCFSocketReadCallBack)
     {
         ProbeThread* probeThread = (__bridge ProbeThread *)(info);
-        [probeThread processIncomingSocketData];
+        [probeThread readIncomingDatagrams:CFSocketGetNative(s)];
+        [probeThread serviceTimers];
+    }
+}
+
+/**
+ * The socket is non-blocking so everything that has arrived since the last callback is read in one go, into the one
+ * receive buffer, rather than a datagram (and a buffer allocation) per pass through the run loop.
+ *
+ * Each datagram is stamped with the time the kernel received it, so the RTTs measured from it don't include however
+ * long this thread took to be scheduled and get to it.
+ */
+- (void)readIncomingDatagrams:(int)socket
+{
+    for (NSUInteger datagramsRead = 0; datagramsRead < kMaxDatagramsPerRead; datagramsRead++)
+    {
+        struct sockaddr_in srcAddr;
+        struct iovec iov = { _receiveBuffer, kReceiveBufferBytes };
+        uint64_t control[kControlBufferBytes / sizeof(uint64_t)];      // cmsg data must be aligned
+        struct msghdr msg;
+        
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &srcAddr;
+        msg.msg_namelen = sizeof(srcAddr);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        
+        ssize_t bytesRead = recvmsg(socket, &msg, 0);
+        
+        if (bytesRead < 0)
+        {
+            if (errno != EAGAIN && errno != EINTR)
+            {
+                NSLog(@"Failed to read packet from socket: %s", strerror(errno));
+            }
+            
+            return;
+        }
+        
+        uint64_t timeRecv = 0;
+        
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMP_MONOTONIC)
+            {
+                uint64_t machTime;
+                memcpy(&machTime, CMSG_DATA(cmsg), sizeof(machTime));
+                timeRecv = MachTimeToNs(machTime);
+            }
+        }
+        
+        if ( ! timeRecv)
+        {
+            timeRecv = [self monotonicNs];      // the socket isn't timestamping, this is the best we have
+        }
+        
+        [self processIncomingDatagram:_receiveBuffer length:bytesRead from:&srcAddr receivedAt:timeRecv];
     }
 }
 
@@ -207,9 +492,10 @@ void SocketCallback(CFSocketRef s, CFSocketCallBackType callbackType, CFDataRef
     _threadRunning = YES;
     
     NSRunLoop* runLoop = [NSRunLoop currentRunLoop];
-
+    
     CFSocketRef cfSocketRef = NULL;
     CFRunLoopSourceRef cfSocketSource = NULL;
+    NSTimer* schedulerTimer = nil;
     
     @try
     {
@@ -236,6 +522,18 @@ void SocketCallback(CFSocketRef s, CFSocketCallBackType callbackType, CFDataRef
         {
             CFSocketContext socketContext;
             
+            if (fcntl(socket, F_SETFL, fcntl(socket, F_GETFL) | O_NONBLOCK) < 0)
+            {
+                [NSException raise:@"socket" format:@"Could not make socket non-blocking"];
+            }
+            
+            // Have the kernel timestamp datagrams on arrival, using the same clock as monotonicNs
+            int timestamp = 1;
+            if (setsockopt(socket, SOL_SOCKET, SO_TIMESTAMP_MONOTONIC, &timestamp, sizeof(timestamp)) < 0)
+            {
+                NSLog(@"Could not enable receive timestamps, RTTs will include our own latency: %s", strerror(errno));
+            }
+            
             socketContext.version = 0;
             socketContext.info = (__bridge void *)(self);
             socketContext.retain = NULL;
@@ -252,16 +550,23 @@ void SocketCallback(CFSocketRef s, CFSocketCallBackType callbackType, CFDataRef
                 {
                     [NSException raise:@"socket" format:@"Could not add CFSocket to run loop"];
                 }
-
+                
                 CFRunLoopAddSource(self.cfRunLoop, cfSocketSource, kCFRunLoopDefaultMode);
             }
         }
-
+        
+        // Queued hosts that couldn't be probed straight away are picked up by the scheduler
+        schedulerTimer = [NSTimer timerWithTimeInterval:kSchedulerIntervalSeconds target:self selector:@selector(schedulerTimerFired:) userInfo:nil repeats:YES];
+        [runLoop addTimer:schedulerTimer forMode:NSDefaultRunLoopMode];
+        
+        // Probe timeouts are kept on the timer wheel, this timer is moved to whenever the next one is due
+        self.timeoutTimer = [NSTimer timerWithTimeInterval:kTimeoutIntervalSeconds target:self selector:@selector(timeoutTimerFired:) userInfo:nil repeats:YES];
+        [runLoop addTimer:self.timeoutTimer forMode:NSDefaultRunLoopMode];
+        
         do
         {
             // Run the run loop but time out after 1 second if no input sources or timers have caused it to exit sooner
             [runLoop runUntilDate:[NSDate dateWithTimeIntervalSinceNow:1]];
-            [self cleanupProbes];
         }
         while ( ! self.stopBlock);
     }
@@ -273,6 +578,10 @@ void SocketCallback(CFSocketRef s, CFSocketCallBackType callbackType, CFDataRef
     {
         NSLog(@"ProbeThread::threadMain exiting");
         
+        [schedulerTimer invalidate];
+        [self.timeoutTimer invalidate];
+        self.timeoutTimer = nil;
+        
         CFRunLoopRemoveSource(self.cfRunLoop, self.probeQueueInputSource, kCFRunLoopDefaultMode);
         
         if (cfSocketSource)
@@ -356,4 +665,14 @@ void SocketCallback(CFSocketRef s, CFSocketCallBackType callbackType, CFDataRef
     return msElapsed;
 }
 
+- (uint64_t)monotonicNs
+{
+    return MachTimeToNs(mach_absolute_time());
+}
+
+- (float)msElapsedBetweenNs:(uint64_t)startNs endNs:(uint64_t)endNs
+{
+    return (endNs > startNs) ? (endNs - startNs) / 1000000.0 : 0;
+}
+
 @end
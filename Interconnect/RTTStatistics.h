@@ -0,0 +1,28 @@
+//
+//  RTTStatistics.h
+//  Interconnect
+//
+//  Rolling RTT statistics for a host over its most recent samples. The median is what the host is grouped by, it
+//  doesn't move between RTT bands because of one slow (or one lucky) echo. Jitter is the smoothed difference between
+//  consecutive samples, as in RFC 3550.
+//
+//  Not thread safe, hosts are guarded by the store lock.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@interface RTTStatistics : NSObject
+
+@property (nonatomic, readonly) NSUInteger sampleCount;     // in the window, at most kRTTWindowSamples
+@property (nonatomic, readonly) NSUInteger totalSamples;
+@property (nonatomic, readonly) float minimum;
+@property (nonatomic, readonly) float median;
+@property (nonatomic, readonly) float p95;
+@property (nonatomic, readonly) float jitter;
+
+- (void)addSample:(float)rtt;
+
+@end
@@ -0,0 +1,79 @@
+//
+//  RTTStatistics.m
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "RTTStatistics.h"
+
+#define kRTTWindowSamples       32          // about six probes' worth of echoes
+#define kJitterGain             16          // RFC 3550 smoothing
+
+@interface RTTStatistics ()
+{
+    float _samples[kRTTWindowSamples];      // ring buffer, oldest overwritten first
+    NSUInteger _nextSample;
+    float _lastSample;
+}
+
+@end
+
+@implementation RTTStatistics
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _sampleCount = 0;
+        _totalSamples = 0;
+        _nextSample = 0;
+        _lastSample = 0;
+        _minimum = 0;
+        _median = 0;
+        _p95 = 0;
+        _jitter = 0;
+    }
+    
+    return self;
+}
+
+static int CompareSamples(const void* a, const void* b)
+{
+    float x = *(const float*)a, y = *(const float*)b;
+    
+    return (x > y) - (x < y);
+}
+
+- (void)addSample:(float)rtt
+{
+    if (rtt <= 0)
+    {
+        return;
+    }
+    
+    if (_totalSamples)
+    {
+        _jitter += (fabsf(rtt - _lastSample) - _jitter) / kJitterGain;
+    }
+    
+    _lastSample = rtt;
+    _totalSamples++;
+    
+    _samples[_nextSample] = rtt;
+    _nextSample = (_nextSample + 1) % kRTTWindowSamples;
+    _sampleCount = MIN(_sampleCount + 1, kRTTWindowSamples);
+    
+    // The window is small enough that sorting a copy on every sample is cheaper than keeping an order statistic tree
+    float sorted[kRTTWindowSamples];
+    
+    memcpy(sorted, _samples, _sampleCount * sizeof(float));
+    qsort(sorted, _sampleCount, sizeof(float), CompareSamples);
+    
+    _minimum = sorted[0];
+    _median = (_sampleCount % 2) ? sorted[_sampleCount / 2] : (sorted[_sampleCount / 2 - 1] + sorted[_sampleCount / 2]) / 2;
+    _p95 = sorted[MIN((_sampleCount * 95 + 99) / 100, _sampleCount) - 1];        // nearest rank
+}
+
+@end
@@ -0,0 +1,29 @@
+//
+//  ResolutionCache.h
+//  Interconnect
+//
+//  A persistent cache of host name and AS resolution results. The cache file is a fixed size, memory-mapped pair of
+//  open-addressed hash tables so it is usable as soon as it is mapped (there is nothing to parse at startup) and
+//  results survive both restarts and store resets.
+//
+//  AS details are cached against a prefix (/32 if the prefix isn't known) so one lookup can label a whole network.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@interface ResolutionCache : NSObject
+
++ (instancetype)sharedCache;
+
+- (BOOL)cachedHostName:(NSString**)hostName forIPAddress:(NSString*)ipAddress;
+- (void)cacheHostName:(NSString*)hostName forIPAddress:(NSString*)ipAddress;
+
+- (NSDictionary*)cachedASDetailsForIPAddress:(NSString*)ipAddress;
+- (void)cacheASDetails:(NSDictionary*)asDetails forIPAddress:(NSString*)ipAddress prefixLength:(uint8_t)prefixLength;
+
+- (void)synchronise;
+
+@end
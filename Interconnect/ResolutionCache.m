@@ -0,0 +1,413 @@
+//
+//  ResolutionCache.m
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "ResolutionCache.h"
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <fcntl.h>
+#import <arpa/inet.h>
+
+#define kCacheFileName                  @"resolution.cache"
+#define kCacheMagic                     0x43524349          // "ICRC"
+#define kCacheVersion                   1
+#define kCacheHeaderBytes               4096
+#define kCacheSlotsPerTable             32768               // power of two
+#define kCacheMaxProbes                 16                  // linear probe window before a slot is evicted
+
+#define kHostNameTTLSeconds             (24 * 60 * 60)
+#define kUnresolvedTTLSeconds           (60 * 60)           // addresses without a PTR record or an AS are asked about again sooner
+#define kASDetailsTTLSeconds            (7 * 24 * 60 * 60)
+
+#define kRecordTextBytes                244
+
+typedef enum
+{
+    kCacheTableHostName = 0,
+    kCacheTableASDetails,
+    kCacheTableCount
+} CacheTable;
+
+/**
+ * The on-disk layout, which is also the in-memory layout. Changing either struct requires bumping kCacheVersion.
+ */
+struct cache_header
+{
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    slotsPerTable;
+    uint32_t    recordBytes;
+    uint64_t    asPrefixLengths;        // bit n set if any AS record has been stored for a /n prefix
+};
+
+struct cache_record
+{
+    uint32_t    address;                // network address in host byte order
+    uint8_t     prefixLength;           // 0 if the slot has never been used
+    uint8_t     reserved[3];
+    uint32_t    expiry;                 // seconds since the epoch
+    char        text[kRecordTextBytes]; // host name, or AS number and AS description separated by NUL
+};
+
+@interface ResolutionCache ()
+
+@property (nonatomic, strong) NSLock* lock;
+@property (nonatomic) void* mapping;
+@property (nonatomic) size_t mappingBytes;
+@property (nonatomic) struct cache_header* header;
+
+@end
+
+@implementation ResolutionCache
+
+#pragma mark - Initialisation
+
++ (instancetype)sharedCache
+{
+    static ResolutionCache *sharedCache;
+    static dispatch_once_t token;
+
+    dispatch_once(&token, ^{
+        sharedCache = [[self alloc] initPrivate];
+    });
+
+    return sharedCache;
+}
+
+- (instancetype)init
+{
+    [NSException raise:@"Singleton" format:@"Use +[ResolutionCache sharedCache]"];
+    return nil;
+}
+
+- (instancetype)initPrivate
+{
+    if (self = [super init])
+    {
+        _lock = [[NSLock alloc] init];
+        _mapping = NULL;
+        _header = NULL;
+        _mappingBytes = kCacheHeaderBytes + (kCacheTableCount * kCacheSlotsPerTable * sizeof(struct cache_record));
+
+        [self mapCacheFile];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_mapping)
+    {
+        munmap(_mapping, _mappingBytes);
+    }
+}
+
+/**
+ * Map the cache file, creating (or recreating, if its layout is from another version) it as required. If the file
+ * cannot be mapped the cache simply never hits.
+ */
+- (void)mapCacheFile
+{
+    NSURL* cacheDirectory = [[[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask] firstObject];
+    cacheDirectory = [cacheDirectory URLByAppendingPathComponent:[[NSBundle mainBundle] bundleIdentifier] ?: @"Interconnect"];
+    [[NSFileManager defaultManager] createDirectoryAtURL:cacheDirectory withIntermediateDirectories:YES attributes:nil error:nil];
+
+    NSString* cachePath = [[cacheDirectory URLByAppendingPathComponent:kCacheFileName] path];
+
+    int fd = open([cachePath fileSystemRepresentation], O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        NSLog(@"Could not open resolution cache %@: %s", cachePath, strerror(errno));
+        return;
+    }
+
+    struct stat st;
+    BOOL sizeChanged = (fstat(fd, &st) < 0 || st.st_size != (off_t)self.mappingBytes);
+
+    // Extending with ftruncate gives a sparse file, pages of never used slots aren't written
+    if (sizeChanged && ftruncate(fd, self.mappingBytes) < 0)
+    {
+        NSLog(@"Could not size resolution cache %@: %s", cachePath, strerror(errno));
+        close(fd);
+        return;
+    }
+
+    void* mapping = mmap(NULL, self.mappingBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);      // the mapping holds its own reference to the file
+
+    if (mapping == MAP_FAILED)
+    {
+        NSLog(@"Could not map resolution cache %@: %s", cachePath, strerror(errno));
+        return;
+    }
+
+    self.mapping = mapping;
+    self.header = (struct cache_header*)mapping;
+
+    if (self.header->magic != kCacheMagic || self.header->version != kCacheVersion ||
+        self.header->slotsPerTable != kCacheSlotsPerTable || self.header->recordBytes != sizeof(struct cache_record))
+    {
+        NSLog(@"Initialising resolution cache %@", cachePath);
+
+        memset(mapping, 0, self.mappingBytes);
+        self.header->magic = kCacheMagic;
+        self.header->version = kCacheVersion;
+        self.header->slotsPerTable = kCacheSlotsPerTable;
+        self.header->recordBytes = sizeof(struct cache_record);
+        self.header->asPrefixLengths = 0;
+    }
+    else
+    {
+        NSLog(@"Mapped resolution cache %@", cachePath);
+    }
+}
+
+/**
+ * Flush dirty pages to disk. The kernel will do this anyway, this just bounds how much is lost on a crash.
+ */
+- (void)synchronise
+{
+    if (self.mapping)
+    {
+        msync(self.mapping, self.mappingBytes, MS_ASYNC);
+    }
+}
+
+#pragma mark - Host Names
+
+/**
+ * Returns YES if the cache holds an unexpired result for the address. An empty host name means the address is known
+ * not to resolve.
+ */
+- (BOOL)cachedHostName:(NSString**)hostName forIPAddress:(NSString*)ipAddress
+{
+    uint32_t address;
+    BOOL found = NO;
+
+    if ( ! self.mapping || ! [self address:&address fromIPAddress:ipAddress])
+    {
+        return NO;
+    }
+
+    [self.lock lock];
+
+    struct cache_record* record = [self findRecordInTable:kCacheTableHostName address:address prefixLength:32];
+    if (record)
+    {
+        *hostName = [NSString stringWithUTF8String:record->text] ?: @"";
+        found = YES;
+    }
+
+    [self.lock unlock];
+
+    return found;
+}
+
+- (void)cacheHostName:(NSString*)hostName forIPAddress:(NSString*)ipAddress
+{
+    uint32_t address;
+
+    if ( ! self.mapping || ! [self address:&address fromIPAddress:ipAddress])
+    {
+        return;
+    }
+
+    const char* text = hostName.length ? [hostName UTF8String] : "";
+    if (strlen(text) >= kRecordTextBytes)
+    {
+        return;
+    }
+
+    [self.lock lock];
+
+    struct cache_record* record = [self claimRecordInTable:kCacheTableHostName address:address prefixLength:32];
+    record->expiry = (uint32_t)time(NULL) + (strlen(text) ? kHostNameTTLSeconds : kUnresolvedTTLSeconds);
+    strlcpy(record->text, text, sizeof(record->text));
+
+    [self.lock unlock];
+}
+
+#pragma mark - AS Details
+
+/**
+ * Returns the AS details (keys "as" and "asDesc") for the longest cached prefix covering the address, or nil. An empty
+ * "as" means the address is known not to be announced.
+ */
+- (NSDictionary*)cachedASDetailsForIPAddress:(NSString*)ipAddress
+{
+    uint32_t address;
+    NSDictionary* asDetails = nil;
+
+    if ( ! self.mapping || ! [self address:&address fromIPAddress:ipAddress])
+    {
+        return nil;
+    }
+
+    [self.lock lock];
+
+    uint64_t prefixLengths = self.header->asPrefixLengths;
+
+    for (int prefixLength = 32; prefixLength > 0 && ! asDetails; prefixLength--)
+    {
+        if ( ! (prefixLengths & (1ULL << prefixLength)))
+        {
+            continue;
+        }
+
+        uint32_t network = address & (0xffffffffU << (32 - prefixLength));
+        struct cache_record* record = [self findRecordInTable:kCacheTableASDetails address:network prefixLength:prefixLength];
+
+        if (record)
+        {
+            const char* as = record->text;
+            const char* asDesc = record->text + strlen(as) + 1;
+
+            asDetails = @{
+                @"as": [NSString stringWithUTF8String:as] ?: @"",
+                @"asDesc": [NSString stringWithUTF8String:asDesc] ?: @""
+            };
+        }
+    }
+
+    [self.lock unlock];
+
+    return asDetails;
+}
+
+- (void)cacheASDetails:(NSDictionary*)asDetails forIPAddress:(NSString*)ipAddress prefixLength:(uint8_t)prefixLength
+{
+    uint32_t address;
+
+    if ( ! self.mapping || ! asDetails[@"as"] || ! asDetails[@"asDesc"] || prefixLength == 0 || prefixLength > 32 ||
+        ! [self address:&address fromIPAddress:ipAddress])
+    {
+        return;
+    }
+
+    const char* as = [asDetails[@"as"] UTF8String];
+    const char* asDesc = [asDetails[@"asDesc"] UTF8String];
+    size_t asLen = strlen(as), asDescLen = strlen(asDesc);
+
+    if (asLen + 2 >= kRecordTextBytes)
+    {
+        return;
+    }
+
+    // Truncate long descriptions rather than not caching them
+    if (asLen + 1 + asDescLen + 1 > kRecordTextBytes)
+    {
+        asDescLen = kRecordTextBytes - asLen - 2;
+    }
+
+    uint32_t network = address & (0xffffffffU << (32 - prefixLength));
+
+    [self.lock lock];
+
+    struct cache_record* record = [self claimRecordInTable:kCacheTableASDetails address:network prefixLength:prefixLength];
+    record->expiry = (uint32_t)time(NULL) + (asLen ? kASDetailsTTLSeconds : kUnresolvedTTLSeconds);
+    memset(record->text, 0, sizeof(record->text));
+    memcpy(record->text, as, asLen);
+    memcpy(record->text + asLen + 1, asDesc, asDescLen);
+
+    self.header->asPrefixLengths |= (1ULL << prefixLength);
+
+    [self.lock unlock];
+}
+
+#pragma mark - Hash Table
+
+- (BOOL)address:(uint32_t*)address fromIPAddress:(NSString*)ipAddress
+{
+    struct in_addr addr;
+
+    if ( ! inet_aton([ipAddress cStringUsingEncoding:NSASCIIStringEncoding], &addr))
+    {
+        return NO;
+    }
+
+    *address = ntohl(addr.s_addr);
+    return YES;
+}
+
+- (struct cache_record*)table:(CacheTable)table
+{
+    return (struct cache_record*)((uint8_t*)self.mapping + kCacheHeaderBytes) + (table * kCacheSlotsPerTable);
+}
+
+static inline uint32_t CacheSlotForKey(uint32_t address, uint8_t prefixLength)
+{
+    uint32_t hash = (address ^ ((uint32_t)prefixLength << 24)) * 2654435761U;      // Knuth multiplicative hash
+    return (hash >> 17) & (kCacheSlotsPerTable - 1);
+}
+
+/**
+ * Find the unexpired record for a key. Must be called with the lock held.
+ */
+- (struct cache_record*)findRecordInTable:(CacheTable)table address:(uint32_t)address prefixLength:(uint8_t)prefixLength
+{
+    struct cache_record* records = [self table:table];
+    uint32_t slot = CacheSlotForKey(address, prefixLength);
+    uint32_t now = (uint32_t)time(NULL);
+
+    for (int probe = 0; probe < kCacheMaxProbes; probe++)
+    {
+        struct cache_record* record = &records[(slot + probe) & (kCacheSlotsPerTable - 1)];
+
+        if ( ! record->prefixLength)
+        {
+            break;      // slots are never emptied once used, so the key can't be further along
+        }
+
+        if (record->address == address && record->prefixLength == prefixLength)
+        {
+            return (record->expiry > now) ? record : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Find the slot a key should be written to: its existing slot, else the first free or expired slot in the probe
+ * window, else the slot in the window closest to expiry. Must be called with the lock held.
+ */
+- (struct cache_record*)claimRecordInTable:(CacheTable)table address:(uint32_t)address prefixLength:(uint8_t)prefixLength
+{
+    struct cache_record* records = [self table:table];
+    uint32_t slot = CacheSlotForKey(address, prefixLength);
+    uint32_t now = (uint32_t)time(NULL);
+    struct cache_record* candidate = NULL;
+
+    for (int probe = 0; probe < kCacheMaxProbes; probe++)
+    {
+        struct cache_record* record = &records[(slot + probe) & (kCacheSlotsPerTable - 1)];
+
+        if (record->prefixLength && record->address == address && record->prefixLength == prefixLength)
+        {
+            return record;
+        }
+
+        if ( ! record->prefixLength)
+        {
+            candidate = candidate ?: record;
+            break;
+        }
+
+        if ( ! candidate || (candidate->expiry > now && record->expiry < candidate->expiry))
+        {
+            candidate = record;
+        }
+    }
+
+    candidate->address = address;
+    candidate->prefixLength = prefixLength;
+
+    return candidate;
+}
+
+@end
@@ -0,0 +1,33 @@
+//
+//  ReverseDNSResolver.h
+//  Interconnect
+//
+//  Resolves IPv4 addresses to host names by pipelining PTR queries over a single UDP socket serviced by one thread.
+//  Unlike getnameinfo() no thread blocks per lookup, so a burst of new hosts costs a handful of round trips rather
+//  than one round trip per host per worker.
+//
+//  The name server is supplied by the client which allows the resolver to be pointed at a local stub server.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#define kDNSPort 53
+
+@interface ReverseDNSResolver : NSObject
+
+@property (nonatomic, readonly) BOOL threadRunning;
+
++ (NSString*)systemNameServer;
+
+- (instancetype)initWithNameServer:(NSString*)nameServer port:(uint16_t)port;
+
+- (void)start;
+- (BOOL)stop:(void (^)(void))threadStoppedBlock;
+
+- (void)resolveHostNameForIPAddress:(NSString*)ipAddress onCompletion:(void (^)(NSString* ipAddress, NSString* hostName))completionBlock;
+- (void)cancelOutstandingResolutions;
+
+@end
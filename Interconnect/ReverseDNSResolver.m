@@ -0,0 +1,696 @@
+//
+//  ReverseDNSResolver.m
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "ReverseDNSResolver.h"
+#import "PacketHeaders.h"
+#import <sys/socket.h>
+#import <sys/time.h>
+#import <netinet/in.h>
+#import <arpa/inet.h>
+#import <netdb.h>
+#import <fcntl.h>
+
+#define kResolvConfPath                 @"/etc/resolv.conf"
+
+#define kMaxOutstandingQueries          256         // how many PTR queries can be in flight on the socket at once?
+#define kMaxQueryFlightTimeMs           1500
+#define kMaxQueryRetries                2
+#define kNegativeCacheTTLSeconds        300         // how long do we remember that an address has no name?
+#define kQueryTimeoutCheckPeriod        0.1         // seconds between checks for timed out queries
+#define kMaxDNSMessageBytes             1500
+#define kMaxCompressionPointerJumps     16
+
+#pragma mark - Query
+
+@interface ReverseDNSQuery : NSObject
+
+@property (nonatomic, copy) NSString* ipAddress;
+@property (nonatomic, strong) NSMutableData* packet;            // header + question, identifier is set on each send
+@property (nonatomic) uint16_t queryIdentifier;
+@property (nonatomic) struct timeval timeSent;
+@property (nonatomic) uint8_t retries;
+@property (nonatomic, strong) NSMutableArray* completionBlocks; // concurrent requests for the same address share a query
+
+@end
+
+@implementation ReverseDNSQuery
+
+@end
+
+#pragma mark - Resolver
+
+@interface ReverseDNSResolver ()
+
+@property (nonatomic, strong) NSThread* resolverThread;
+@property (nonatomic, copy) void (^stopBlock)(void);            // used to signal resolver thread exit
+@property (nonatomic) CFRunLoopRef cfRunLoop;
+@property (nonatomic) CFRunLoopSourceRef requestQueueInputSource;
+
+@property (nonatomic, strong) NSLock* requestQueueLock;
+@property (nonatomic, strong) NSMutableArray* requestQueue;     // requests from client threads, drained on the resolver thread
+@property (nonatomic) BOOL cancelRequested;
+
+@property (nonatomic) int socket;
+@property (nonatomic) struct sockaddr_in nameServerAddr;
+@property (nonatomic, strong) NSMutableData* recvBuffer;
+
+@property (nonatomic, strong) NSMutableDictionary* queriesByIdentifier;     // queries on the wire
+@property (nonatomic, strong) NSMutableDictionary* queriesByIPAddress;      // queries on the wire or in the backlog
+@property (nonatomic, strong) NSMutableArray* queryBacklog;                 // queries waiting for a free slot on the wire
+@property (nonatomic, strong) NSMutableDictionary* negativeCache;           // IP address -> NSDate after which we can ask again
+
+@end
+
+@implementation ReverseDNSResolver
+
+#pragma mark - Initialisation
+
+/**
+ * The first IPv4 name server listed in resolv.conf (on OS X this file is maintained by configd).
+ */
++ (NSString*)systemNameServer
+{
+    NSString* resolvConf = [NSString stringWithContentsOfFile:kResolvConfPath encoding:NSASCIIStringEncoding error:nil];
+
+    for (NSString* line in [resolvConf componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]])
+    {
+        NSArray* tokens = [[line stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]] componentsSeparatedByCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        struct in_addr addr;
+
+        if (tokens.count >= 2 && [tokens[0] isEqualToString:@"nameserver"] && inet_aton([tokens[1] cStringUsingEncoding:NSASCIIStringEncoding], &addr))
+        {
+            return tokens[1];
+        }
+    }
+
+    return nil;
+}
+
+- (instancetype)initWithNameServer:(NSString*)nameServer port:(uint16_t)port
+{
+    if (self = [super init])
+    {
+        _resolverThread = [[NSThread alloc] initWithTarget:self selector:@selector(threadMain:) object:nil];
+        _stopBlock = nil;
+        _threadRunning = NO;
+        _cfRunLoop = NULL;
+        _requestQueueInputSource = NULL;
+
+        _requestQueueLock = [[NSLock alloc] init];
+        _requestQueue = [NSMutableArray arrayWithCapacity:16];
+        _cancelRequested = NO;
+
+        _recvBuffer = [NSMutableData dataWithLength:kMaxDNSMessageBytes];
+        _queriesByIdentifier = [[NSMutableDictionary alloc] init];
+        _queriesByIPAddress = [[NSMutableDictionary alloc] init];
+        _queryBacklog = [[NSMutableArray alloc] init];
+        _negativeCache = [[NSMutableDictionary alloc] init];
+        _socket = -1;
+
+        memset(&_nameServerAddr, 0, sizeof(_nameServerAddr));
+        _nameServerAddr.sin_family = AF_INET;
+        _nameServerAddr.sin_len = sizeof(_nameServerAddr);
+        _nameServerAddr.sin_port = htons(port);
+
+        if ( ! inet_aton([nameServer cStringUsingEncoding:NSASCIIStringEncoding], &_nameServerAddr.sin_addr))
+        {
+            NSLog(@"Invalid name server address [%@]", nameServer);
+            return nil;
+        }
+
+        /**
+         * Connecting the socket means the kernel only delivers datagrams from the name server to us, and we can
+         * use send() / recv() rather than carrying the address around.
+         */
+        _socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (_socket < 0 || connect(_socket, (struct sockaddr*)&_nameServerAddr, sizeof(_nameServerAddr)) < 0)
+        {
+            NSLog(@"Could not create DNS socket to %@:%hu: %s", nameServer, port, strerror(errno));
+            return nil;
+        }
+
+        fcntl(_socket, F_SETFL, fcntl(_socket, F_GETFL) | O_NONBLOCK);
+
+        NSLog(@"ReverseDNSResolver initialised with name server %@:%hu", nameServer, port);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_socket >= 0)
+    {
+        close(_socket);
+    }
+}
+
+- (void)start
+{
+    [self.resolverThread start];
+}
+
+- (BOOL)stop:(void (^)(void))threadStoppedBlock
+{
+    if (self.stopBlock)
+    {
+        NSLog(@"Could not stop resolver thread, a stop is already requested");
+        return NO;
+    }
+
+    self.stopBlock = threadStoppedBlock;
+    [self signalResolverThread];
+
+    return YES;
+}
+
+#pragma mark - Public Interface
+
+/**
+ * Queue an address for resolution. The completion block is called on the resolver thread with an empty host name if
+ * the address has no name, or a nil host name if the name server couldn't answer (SERVFAIL, REFUSED or no response)
+ * in which case it is worth asking again later.
+ *
+ * Expected to be called in the context of a client thread.
+ */
+- (void)resolveHostNameForIPAddress:(NSString*)ipAddress onCompletion:(void (^)(NSString* ipAddress, NSString* hostName))completionBlock
+{
+    [self.requestQueueLock lock];
+    [self.requestQueue addObject:@{
+                                   @"ipAddress": ipAddress,
+                                   @"completionBlock": completionBlock
+    }];
+    [self.requestQueueLock unlock];
+
+    [self signalResolverThread];
+}
+
+/**
+ * Drop all queued and in flight resolutions without calling their completion blocks. Late responses are ignored.
+ */
+- (void)cancelOutstandingResolutions
+{
+    [self.requestQueueLock lock];
+    [self.requestQueue removeAllObjects];
+    self.cancelRequested = YES;
+    [self.requestQueueLock unlock];
+
+    [self signalResolverThread];
+}
+
+- (void)signalResolverThread
+{
+    if (self.cfRunLoop && self.requestQueueInputSource)
+    {
+        CFRunLoopSourceSignal(self.requestQueueInputSource);
+        CFRunLoopWakeUp(self.cfRunLoop);
+    }
+}
+
+#pragma mark - Run Loop Input Sources
+
+static void ResolverRequestQueuePerformRoutine(void *context)
+{
+    ReverseDNSResolver* resolver = (__bridge ReverseDNSResolver*)context;
+    [resolver processRequestQueue];
+}
+
+static void ResolverSocketCallback(CFSocketRef s, CFSocketCallBackType callbackType, CFDataRef address, const void* data, void* info)
+{
+    if (callbackType == kCFSocketReadCallBack)
+    {
+        ReverseDNSResolver* resolver = (__bridge ReverseDNSResolver*)info;
+        [resolver readResponses];
+    }
+}
+
+#pragma mark - Worker Logic
+
+- (void)threadMain:(id)context
+{
+    _threadRunning = YES;
+
+    NSRunLoop* runLoop = [NSRunLoop currentRunLoop];
+    CFSocketRef cfSocketRef = NULL;
+    CFRunLoopSourceRef cfSocketSource = NULL;
+    NSTimer* timeoutTimer = nil;
+
+    @try
+    {
+        NSLog(@"ReverseDNSResolver::threadMain running on %@", [NSThread currentThread]);
+
+        self.cfRunLoop = CFRunLoopGetCurrent();
+
+        CFRunLoopSourceContext inputSourceContext = {
+            0,
+            (__bridge void *)(self),
+            NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+            ResolverRequestQueuePerformRoutine
+        };
+
+        self.requestQueueInputSource = CFRunLoopSourceCreate(NULL, 0, &inputSourceContext);
+        CFRunLoopAddSource(self.cfRunLoop, self.requestQueueInputSource, kCFRunLoopDefaultMode);
+
+        CFSocketContext socketContext = {0, (__bridge void *)(self), NULL, NULL, NULL};
+
+        if ( ! (cfSocketRef = CFSocketCreateWithNative(kCFAllocatorDefault, self.socket, kCFSocketReadCallBack, &ResolverSocketCallback, &socketContext)))
+        {
+            [NSException raise:@"socket" format:@"Could not create CFSocket from DNS socket"];
+        }
+
+        if ( ! (cfSocketSource = CFSocketCreateRunLoopSource(kCFAllocatorDefault, cfSocketRef, 0)))
+        {
+            [NSException raise:@"socket" format:@"Could not add CFSocket to run loop"];
+        }
+
+        CFRunLoopAddSource(self.cfRunLoop, cfSocketSource, kCFRunLoopDefaultMode);
+
+        timeoutTimer = [NSTimer scheduledTimerWithTimeInterval:kQueryTimeoutCheckPeriod target:self selector:@selector(checkQueryTimeouts) userInfo:nil repeats:YES];
+
+        // Anything queued before the input source existed would otherwise wait for the next request
+        [self processRequestQueue];
+
+        do
+        {
+            [runLoop runUntilDate:[NSDate dateWithTimeIntervalSinceNow:1]];
+        }
+        while ( ! self.stopBlock);
+    }
+    @catch (NSException *e)
+    {
+        NSLog(@"ReverseDNSResolver::threadMain caught exception: %@", e);
+    }
+    @finally
+    {
+        NSLog(@"ReverseDNSResolver::threadMain exiting");
+
+        [timeoutTimer invalidate];
+
+        if (self.requestQueueInputSource)
+        {
+            CFRunLoopRemoveSource(self.cfRunLoop, self.requestQueueInputSource, kCFRunLoopDefaultMode);
+            CFRelease(self.requestQueueInputSource);
+            self.requestQueueInputSource = NULL;
+        }
+
+        if (cfSocketSource)
+        {
+            CFRunLoopRemoveSource(self.cfRunLoop, cfSocketSource, kCFRunLoopDefaultMode);
+            CFRelease(cfSocketSource);
+        }
+
+        if (cfSocketRef)
+        {
+            // Don't let CFSocket close the native socket, we own it
+            CFSocketSetSocketFlags(cfSocketRef, CFSocketGetSocketFlags(cfSocketRef) & ~kCFSocketCloseOnInvalidate);
+            CFSocketInvalidate(cfSocketRef);
+            CFRelease(cfSocketRef);
+        }
+
+        _threadRunning = NO;
+
+        if (self.stopBlock)
+        {
+            self.stopBlock();
+        }
+    }
+}
+
+/**
+ * Drain requests from client threads onto the wire (or the backlog if kMaxOutstandingQueries are already in flight).
+ */
+- (void)processRequestQueue
+{
+    [self.requestQueueLock lock];
+
+    NSArray* requests = [self.requestQueue copy];
+    [self.requestQueue removeAllObjects];
+
+    BOOL cancelRequested = self.cancelRequested;
+    self.cancelRequested = NO;
+
+    [self.requestQueueLock unlock];
+
+    if (cancelRequested)
+    {
+        NSLog(@"Cancelling %lu outstanding reverse DNS queries", (unsigned long)self.queriesByIPAddress.count);
+
+        [self.queriesByIdentifier removeAllObjects];
+        [self.queriesByIPAddress removeAllObjects];
+        [self.queryBacklog removeAllObjects];
+    }
+
+    for (NSDictionary* request in requests)
+    {
+        [self beginQueryForIPAddress:request[@"ipAddress"] onCompletion:request[@"completionBlock"]];
+    }
+
+    [self sendBackloggedQueries];
+}
+
+- (void)beginQueryForIPAddress:(NSString*)ipAddress onCompletion:(void (^)(NSString*, NSString*))completionBlock
+{
+    // Did we recently fail to resolve this address?
+    NSDate* negativeCacheExpiry = self.negativeCache[ipAddress];
+    if (negativeCacheExpiry)
+    {
+        if ([negativeCacheExpiry timeIntervalSinceNow] > 0)
+        {
+            completionBlock(ipAddress, @"");
+            return;
+        }
+
+        [self.negativeCache removeObjectForKey:ipAddress];
+    }
+
+    // Is there already a query for this address? If so, just wait for its answer.
+    ReverseDNSQuery* query = self.queriesByIPAddress[ipAddress];
+    if (query)
+    {
+        [query.completionBlocks addObject:completionBlock];
+        return;
+    }
+
+    query = [[ReverseDNSQuery alloc] init];
+    query.ipAddress = ipAddress;
+    query.retries = 0;
+    query.completionBlocks = [NSMutableArray arrayWithObject:completionBlock];
+
+    if ( ! (query.packet = [self buildPTRQueryForIPAddress:ipAddress]))
+    {
+        NSLog(@"Could not build PTR query for %@", ipAddress);
+        completionBlock(ipAddress, @"");
+        return;
+    }
+
+    self.queriesByIPAddress[ipAddress] = query;
+    [self.queryBacklog addObject:query];
+}
+
+- (void)sendBackloggedQueries
+{
+    while (self.queryBacklog.count && self.queriesByIdentifier.count < kMaxOutstandingQueries)
+    {
+        ReverseDNSQuery* query = [self.queryBacklog firstObject];
+        [self.queryBacklog removeObjectAtIndex:0];
+
+        [self sendQuery:query];
+    }
+}
+
+/**
+ * (Re)send a query, a new identifier is used for every send so a late answer to a previous attempt is ignored.
+ */
+- (void)sendQuery:(ReverseDNSQuery*)query
+{
+    uint16_t queryIdentifier;
+
+    do
+    {
+        queryIdentifier = arc4random();
+    } while (self.queriesByIdentifier[[NSNumber numberWithInt:queryIdentifier]]);
+
+    query.queryIdentifier = queryIdentifier;
+    ((struct hdr_dns*)[query.packet mutableBytes])->dns_id = htons(queryIdentifier);
+
+    struct timeval timeSent;
+    gettimeofday(&timeSent, NULL);
+    query.timeSent = timeSent;
+
+    self.queriesByIdentifier[[NSNumber numberWithInt:queryIdentifier]] = query;
+
+    if (send(self.socket, [query.packet bytes], [query.packet length], 0) < (ssize_t)[query.packet length])
+    {
+        // Leave the query on the wire, it will be retried (and eventually failed) by checkQueryTimeouts
+        NSLog(@"Failed to send PTR query for %@: %s", query.ipAddress, strerror(errno));
+    }
+}
+
+/**
+ * Build a recursive PTR query for d.c.b.a.in-addr.arpa, the identifier is filled in by sendQuery:.
+ */
+- (NSMutableData*)buildPTRQueryForIPAddress:(NSString*)ipAddress
+{
+    struct in_addr addr;
+
+    if ( ! inet_aton([ipAddress cStringUsingEncoding:NSASCIIStringEncoding], &addr))
+    {
+        return nil;
+    }
+
+    const unsigned char* octets = (const unsigned char*)&addr.s_addr;
+    NSString* queryName = [NSString stringWithFormat:@"%u.%u.%u.%u.in-addr.arpa", octets[3], octets[2], octets[1], octets[0]];
+
+    NSMutableData* packet = [NSMutableData dataWithLength:sizeof(struct hdr_dns)];
+    struct hdr_dns* dnsHdr = (struct hdr_dns*)[packet mutableBytes];
+    dnsHdr->dns_flags = htons(DNS_FLAG_RD);
+    dnsHdr->dns_qdcount = htons(1);
+
+    for (NSString* label in [queryName componentsSeparatedByString:@"."])
+    {
+        uint8_t labelLen = label.length;
+        [packet appendBytes:&labelLen length:1];
+        [packet appendData:[label dataUsingEncoding:NSASCIIStringEncoding]];
+    }
+
+    uint8_t rootLabel = 0;
+    uint16_t questionTypeAndClass[2] = { htons(DNS_TYPE_PTR), htons(DNS_CLASS_IN) };
+    [packet appendBytes:&rootLabel length:1];
+    [packet appendBytes:questionTypeAndClass length:sizeof(questionTypeAndClass)];
+
+    return packet;
+}
+
+#pragma mark - Response Processing
+
+/**
+ * Read the (possibly compressed) domain name at offset into name (if not NULL) in dotted form.
+ *
+ * Returns the offset of the byte following the name as it is encoded at offset, or -1 if the name is malformed.
+ */
+static ssize_t ReadDNSName(const uint8_t* message, size_t messageLen, size_t offset, char* name, size_t nameLen)
+{
+    ssize_t nextOffset = -1;
+    size_t nameUsed = 0;
+    int jumps = 0;
+
+    if (name && nameLen)
+    {
+        name[0] = '\0';
+    }
+
+    while (offset < messageLen)
+    {
+        uint8_t labelLen = message[offset];
+
+        if ((labelLen & 0xc0) == 0xc0)
+        {
+            // Compression pointer to a name (or name suffix) earlier in the message
+            if (offset + 1 >= messageLen || ++jumps > kMaxCompressionPointerJumps)
+            {
+                return -1;
+            }
+
+            if (nextOffset < 0)
+            {
+                nextOffset = offset + 2;
+            }
+
+            offset = ((labelLen & 0x3f) << 8) | message[offset + 1];
+            continue;
+        }
+        else if (labelLen & 0xc0)
+        {
+            return -1;      // reserved label type
+        }
+
+        if (labelLen == 0)
+        {
+            return (nextOffset < 0) ? (ssize_t)(offset + 1) : nextOffset;
+        }
+
+        if (offset + 1 + labelLen > messageLen)
+        {
+            return -1;
+        }
+
+        if (name)
+        {
+            if (nameUsed + labelLen + 2 > nameLen)
+            {
+                return -1;
+            }
+
+            if (nameUsed)
+            {
+                name[nameUsed++] = '.';
+            }
+
+            memcpy(name + nameUsed, message + offset + 1, labelLen);
+            nameUsed += labelLen;
+            name[nameUsed] = '\0';
+        }
+
+        offset += 1 + labelLen;
+    }
+
+    return -1;
+}
+
+/**
+ * Data is available on the DNS socket, drain every datagram that is waiting.
+ */
+- (void)readResponses
+{
+    ssize_t bytesRead;
+
+    while ((bytesRead = recv(self.socket, [self.recvBuffer mutableBytes], [self.recvBuffer length], 0)) > 0)
+    {
+        [self processResponse:(const uint8_t*)[self.recvBuffer bytes] length:bytesRead];
+    }
+
+    if (bytesRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+        NSLog(@"Failed to read from DNS socket: %s", strerror(errno));
+    }
+
+    [self sendBackloggedQueries];
+}
+
+- (void)processResponse:(const uint8_t*)message length:(size_t)messageLen
+{
+    if (messageLen < sizeof(struct hdr_dns))
+    {
+        NSLog(@"Received DNS message was not long enough to contain a header");
+        return;
+    }
+
+    const struct hdr_dns* dnsHdr = (const struct hdr_dns*)message;
+    NSNumber* queryKey = [NSNumber numberWithInt:ntohs(dnsHdr->dns_id)];
+    ReverseDNSQuery* query = self.queriesByIdentifier[queryKey];
+
+    if ( ! query)
+    {
+        return;     // cancelled, retried under a new identifier or not ours
+    }
+
+    if ( ! (ntohs(dnsHdr->dns_flags) & DNS_FLAG_QR) || ntohs(dnsHdr->dns_qdcount) != 1)
+    {
+        NSLog(@"Received DNS message for %@ was not a response to our query", query.ipAddress);
+        return;
+    }
+
+    // The question section must echo ours byte for byte
+    size_t questionLen = [query.packet length] - sizeof(struct hdr_dns);
+    if (messageLen < sizeof(struct hdr_dns) + questionLen || memcmp(message + sizeof(struct hdr_dns), (const uint8_t*)[query.packet bytes] + sizeof(struct hdr_dns), questionLen) != 0)
+    {
+        NSLog(@"Received DNS response for %@ did not match our question", query.ipAddress);
+        return;
+    }
+
+    [self.queriesByIdentifier removeObjectForKey:queryKey];
+
+    char hostName[NI_MAXHOST];
+    hostName[0] = '\0';
+
+    // Only an answer (or NXDOMAIN) says anything about the address, other failures are the name server's
+    if (DNS_RCODE(dnsHdr) != DNS_RCODE_NOERROR && DNS_RCODE(dnsHdr) != DNS_RCODE_NXDOMAIN)
+    {
+        NSLog(@"PTR query for %@ failed with response code %d", query.ipAddress, DNS_RCODE(dnsHdr));
+        [self completeQuery:query withHostName:nil];
+        return;
+    }
+
+    if (DNS_RCODE(dnsHdr) == DNS_RCODE_NOERROR)
+    {
+        size_t offset = sizeof(struct hdr_dns) + questionLen;
+        uint16_t answers = ntohs(dnsHdr->dns_ancount);
+
+        for (uint16_t i = 0; i < answers && ! hostName[0]; i++)
+        {
+            ssize_t rrOffset = ReadDNSName(message, messageLen, offset, NULL, 0);
+            if (rrOffset < 0 || (size_t)rrOffset + 10 > messageLen)
+            {
+                break;
+            }
+
+            // type (2), class (2), TTL (4), rdlength (2) then rdata
+            uint16_t rrType = (message[rrOffset] << 8) | message[rrOffset + 1];
+            uint16_t rrDataLen = (message[rrOffset + 8] << 8) | message[rrOffset + 9];
+            size_t rrDataOffset = rrOffset + 10;
+
+            if (rrDataOffset + rrDataLen > messageLen)
+            {
+                break;
+            }
+
+            // A malformed name (a compression loop say) may have been partly read, none of it can be trusted
+            if (rrType == DNS_TYPE_PTR && ReadDNSName(message, messageLen, rrDataOffset, hostName, sizeof(hostName)) < 0)
+            {
+                hostName[0] = '\0';
+            }
+
+            offset = rrDataOffset + rrDataLen;
+        }
+    }
+
+    [self completeQuery:query withHostName:[NSString stringWithCString:hostName encoding:NSASCIIStringEncoding]];
+}
+
+/**
+ * An empty host name means the address has no name, which is negatively cached. A nil host name means there was no
+ * usable answer and isn't cached, so the next request for the address asks again.
+ */
+- (void)completeQuery:(ReverseDNSQuery*)query withHostName:(NSString*)hostName
+{
+    if (hostName && ! hostName.length)
+    {
+        self.negativeCache[query.ipAddress] = [NSDate dateWithTimeIntervalSinceNow:kNegativeCacheTTLSeconds];
+    }
+
+    [self.queriesByIPAddress removeObjectForKey:query.ipAddress];
+
+    for (void (^completionBlock)(NSString*, NSString*) in query.completionBlocks)
+    {
+        completionBlock(query.ipAddress, hostName);
+    }
+}
+
+- (void)checkQueryTimeouts
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    // Only queries on the wire can time out and there are at most kMaxOutstandingQueries of them
+    for (ReverseDNSQuery* query in [self.queriesByIdentifier allValues])
+    {
+        struct timeval timeSent = query.timeSent;
+        float msElapsed = ((now.tv_sec - timeSent.tv_sec) * 1000.0) + ((now.tv_usec - timeSent.tv_usec) / 1000.0);
+
+        if (msElapsed < kMaxQueryFlightTimeMs)
+        {
+            continue;
+        }
+
+        [self.queriesByIdentifier removeObjectForKey:[NSNumber numberWithInt:query.queryIdentifier]];
+
+        if (++query.retries > kMaxQueryRetries)
+        {
+            NSLog(@"PTR query for %@ timed out", query.ipAddress);
+            [self completeQuery:query withHostName:nil];
+        }
+        else
+        {
+            [self sendQuery:query];
+        }
+    }
+
+    [self sendBackloggedQueries];
+}
+
+@end
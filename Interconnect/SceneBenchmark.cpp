@@ -0,0 +1,491 @@
+//
+//  SceneBenchmark.cpp
+//  Interconnect
+//
+//  Renders the scene headless, frame by frame at a fixed 60 FPS of simulated time, and reports CPU and GPU frame time
+//  percentiles, so rendering regressions can be measured on machines with no display (see OffscreenRenderer). Frames
+//  are animated and submitted by the same code as the view's (NodeAnimation and SceneFrame): nodes are culled against
+//  the frustum and drawn by NodeRenderer, connectors are drawn for every node with recent traffic, and the HUD and
+//  labels by TextRenderer.
+//
+//  Traffic comes from a synthetic store (hosts first seen over the first two seconds, then steady traffic to random
+//  hosts) or is replayed from a file with one event per line: seconds since the start, address, orbital and volume,
+//
+//      0.25 192.168.1.10 3 0.12
+//
+//  Hosts are created the first time their address is seen and then grow, pulse and float to their orbital as
+//  NodeLayout animates them. The Objective-C store and layout themselves aren't used, so the benchmark builds anywhere
+//  there's a C++ compiler and OpenGL. Not part of the app (it's the SceneBenchmark tool target), or build and run with:
+//
+//      c++ -O2 -std=c++11 -DSCENE_BENCHMARK NodeRenderer.cpp TextRenderer.cpp NodeIndex.cpp OrbitalLayout.cpp NodeAnimation.cpp SceneFrame.cpp OffscreenRenderer.cpp SceneBenchmark.cpp -o scenebench -framework OpenGL
+//      ./scenebench [--hosts count] [--seconds seconds] [--replay file] [--labels] [--dump directory] [--max-p99 milliseconds]
+//
+//  On Linux link with -lEGL -lGL instead. --dump writes every frame to the directory as frame00000.ppm onwards, turn
+//  them into a video with: ffmpeg -framerate 60 -i frame%05d.ppm -pix_fmt yuv420p scene.mp4
+//  --max-p99 exits with status 2 if the 99th percentile of CPU or GPU frame time is over the budget.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#ifdef SCENE_BENCHMARK
+
+#include "OffscreenRenderer.hpp"
+#include "NodeRenderer.hpp"
+#include "TextRenderer.hpp"
+#include "NodeIndex.hpp"
+#include "OrbitalLayout.hpp"
+#include "NodeAnimation.hpp"
+#include "SceneFrame.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define kSceneWidth                     1280
+#define kSceneHeight                    800
+#define kSceneFrameRate                 60
+#define kSceneCameraZ                   8           // as the view starts
+#define kSceneOrbitals                  8
+#define kSceneHosts                     10000       // synthetic hosts, unless given on the command line
+#define kSceneSeconds                   10          // of simulated time, unless given on the command line
+#define kSceneArrivalSeconds            2           // synthetic hosts are first seen over this long
+#define kSceneTrafficPerSecond          500         // synthetic traffic events once all hosts have arrived
+
+// As HostStore sizes hosts
+#define kNodeInitialVolume              0.01
+#define kMinVolume                      0.05
+#define kMaxVolume                      0.3
+
+// A blocky stand-in for the view's Courier-Bold 10 atlas, which needs AppKit to render: same cell size, same cost
+#define kFontFirstCharacter             ' '
+#define kFontCharacterCount             95
+#define kFontGlyphWidth                 6
+#define kFontGlyphHeight                13
+#define kFontAtlasWidth                 256
+
+struct traffic_event
+{
+    double seconds;
+    std::string address;
+    unsigned long orbital;
+    float volume;
+};
+
+struct scene_host : SceneNode
+{
+    std::string address;
+    unsigned long orbital;
+    size_t slot;
+    float originConnector;                  // seconds left to draw the connector for
+};
+
+struct scene_options
+{
+    size_t hostCount;
+    double seconds;
+    const char* replayPath;
+    bool labels;
+    const char* dumpDirectory;
+    double maximumP99;                      // 0 for no budget
+};
+
+struct scene_state
+{
+    std::deque<scene_host> hosts;           // never reallocated, host addresses are index identities
+    std::unordered_map<std::string, scene_host*> hostsByAddress;
+    std::map<unsigned long, size_t> slotCounts;
+    OrbitalLayout orbitalLayout;
+    std::vector<NodeBounds> bounds;
+    NodeIndex index;
+    NodeAnimation animation;
+    SceneFrame frame;
+    NodeRenderer nodeRenderer;
+    TextRenderer textRenderer;
+    GLfloat worldRotateY;
+};
+
+static bool ParseOptions(int argc, const char* argv[], scene_options& options)
+{
+    options.hostCount = kSceneHosts;
+    options.seconds = kSceneSeconds;
+    options.replayPath = NULL;
+    options.labels = false;
+    options.dumpDirectory = NULL;
+    options.maximumP99 = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = (i + 1 < argc);
+
+        if ( ! strcmp(argv[i], "--hosts") && hasValue)
+        {
+            options.hostCount = strtoul(argv[++i], NULL, 10);
+        }
+        else if ( ! strcmp(argv[i], "--seconds") && hasValue)
+        {
+            options.seconds = atof(argv[++i]);
+        }
+        else if ( ! strcmp(argv[i], "--replay") && hasValue)
+        {
+            options.replayPath = argv[++i];
+        }
+        else if ( ! strcmp(argv[i], "--labels"))
+        {
+            options.labels = true;
+        }
+        else if ( ! strcmp(argv[i], "--dump") && hasValue)
+        {
+            options.dumpDirectory = argv[++i];
+        }
+        else if ( ! strcmp(argv[i], "--max-p99") && hasValue)
+        {
+            options.maximumP99 = atof(argv[++i]);
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool ReadReplay(const char* path, std::vector<traffic_event>& events)
+{
+    FILE* file = fopen(path, "r");
+    char line[256], address[64];
+
+    if ( ! file)
+    {
+        fprintf(stderr, "Could not open %s\n", path);
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), file))
+    {
+        traffic_event event;
+
+        if (sscanf(line, "%lf %63s %lu %f", &event.seconds, address, &event.orbital, &event.volume) != 4 || event.orbital == 0)
+        {
+            continue;
+        }
+
+        event.address = address;
+        events.push_back(event);
+    }
+
+    fclose(file);
+
+    // Events may be logged from several threads, they're replayed in time order
+    std::stable_sort(events.begin(), events.end(), [](const traffic_event& a, const traffic_event& b) { return a.seconds < b.seconds; });
+
+    return true;
+}
+
+static void SyntheticTraffic(size_t hostCount, double seconds, std::vector<traffic_event>& events)
+{
+    char address[32];
+
+    srand(1);
+
+    for (size_t host = 0; host < hostCount; host++)
+    {
+        snprintf(address, sizeof(address), "10.%zu.%zu.%zu", (host >> 16) & 0xff, (host >> 8) & 0xff, host & 0xff);
+
+        traffic_event event = { kSceneArrivalSeconds * ((double)host / hostCount), address, 1 + (unsigned long)(rand() % kSceneOrbitals), 0 };
+        event.volume = kMinVolume + ((kMaxVolume - kMinVolume) * (rand() / (float)RAND_MAX) * (rand() / (float)RAND_MAX));
+        events.push_back(event);
+    }
+
+    for (double time = kSceneArrivalSeconds; time < seconds && hostCount; time += 1.0 / kSceneTrafficPerSecond)
+    {
+        traffic_event event = events[rand() % hostCount];
+        event.seconds = time;
+        events.push_back(event);
+    }
+}
+
+/**
+ * As HostStore would: a new host starts small and pulsing with a connector, traffic to a known host shows its
+ * connector again and sets how large it grows to.
+ */
+static void ApplyEvent(scene_state& scene, const traffic_event& event)
+{
+    std::unordered_map<std::string, scene_host*>::iterator known = scene.hostsByAddress.find(event.address);
+    scene_host* host;
+
+    if (known == scene.hostsByAddress.end())
+    {
+        scene_host created = {};
+
+        created.address = event.address;
+        created.orbital = event.orbital;
+        created.slot = scene.slotCounts[event.orbital]++;
+        created.red = 1;
+        created.radius = event.orbital;
+        created.volume = kNodeInitialVolume;
+        created.pulseIntensity = 1;
+        created.pulseBegin = true;
+        created.originConnector = 2;
+
+        scene.hosts.push_back(created);
+        host = &scene.hosts.back();
+        scene.hostsByAddress[event.address] = host;
+    }
+    else
+    {
+        host = known->second;
+        host->originConnector = 1;
+    }
+
+    host->targetVolume = std::max(std::min(event.volume, (float)kMaxVolume), (float)kMinVolume);
+}
+
+static void LayoutHosts(scene_state& scene, double secondsSinceLastFrame)
+{
+    std::map<unsigned long, const OrbitalDirections*> directions;
+
+    for (const std::pair<const unsigned long, size_t>& orbital : scene.slotCounts)
+    {
+        directions[orbital.first] = &scene.orbitalLayout.directions(orbital.first, orbital.second);
+    }
+
+    scene.bounds.resize(scene.hosts.size());
+
+    for (size_t i = 0; i < scene.hosts.size(); i++)
+    {
+        scene_host& host = scene.hosts[i];
+        const OrbitalDirections& slots = *directions[host.orbital];
+
+        // As NodeLayout lays out a record: from its preferred colour, positioned then animated
+        host.red = 1;
+        host.green = host.blue = 0;
+
+        host.drawOriginConnector = (host.originConnector > 0);
+        if (host.drawOriginConnector)
+        {
+            host.originConnector -= secondsSinceLastFrame;
+        }
+
+        host.x = host.radius * slots.x[host.slot];
+        host.y = host.radius * slots.y[host.slot];
+        host.z = host.radius * slots.z[host.slot];
+
+        scene.animation.animate(host, host.orbital, scene.slotCounts.size(), secondsSinceLastFrame);
+
+        NodeBounds bounds = { &host, host.x, host.y, host.z, host.volume };
+        scene.bounds[i] = bounds;
+    }
+
+    scene.index.update(scene.bounds);
+}
+
+/**
+ * One frame as the view draws it: camera, world rotation, culled nodes, connectors, labels and the HUD.
+ */
+static void DrawFrame(scene_state& scene, const scene_options& options, double secondsSinceLastFrame)
+{
+    SceneFrame& frame = scene.frame;
+    SceneNode localhost = {};
+    char hud[128];
+
+    scene.worldRotateY += kWorldAutoRotationUnitsPerSecond * secondsSinceLastFrame;
+    LayoutHosts(scene, secondsSinceLastFrame);
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glTranslatef(0, 0, -kSceneCameraZ);
+
+    frame.begin(&scene.nodeRenderer, &scene.textRenderer, 0, scene.worldRotateY);
+
+    localhost.green = 1;
+    localhost.volume = 0.05f;
+    scene.textRenderer.addLabel("localhost", 0.06f, 0.06f, 0, frame.cameraMatrix(), frame.projectionMatrix(), frame.viewport(), 0, 1, 0);
+    frame.addNode(localhost);
+
+    frame.cull(scene.index);
+
+    for (uint32_t i : frame.visible())
+    {
+        const scene_host& host = scene.hosts[i];
+
+        frame.addNode(host);
+
+        if (options.labels)
+        {
+            scene.textRenderer.addLabel(host.address.c_str(), host.x + host.volume, host.y + host.volume, host.z, frame.worldMatrix(), frame.projectionMatrix(), frame.viewport(), host.red, host.green, host.blue);
+        }
+    }
+
+    for (const scene_host& host : scene.hosts)
+    {
+        if (host.drawOriginConnector)
+        {
+            frame.addConnector(host);
+        }
+    }
+
+    frame.draw(false);
+
+    snprintf(hud, sizeof(hud), "%zu hosts (%zu visible)", scene.hosts.size(), frame.visible().size());
+    scene.textRenderer.addText(hud, frame.viewport()[0] + 5, frame.viewport()[1] + frame.viewport()[3] - 15, 0, 1, 1, 1);
+    scene.textRenderer.draw(frame.viewport());
+}
+
+static bool PrepareScene(scene_state& scene)
+{
+    GLfloat near = 0.1f, far = 100.0f;
+    GLfloat top = near * tanf(22.5f * (M_PI / 180.0f));
+    GLfloat right = top * ((GLfloat)kSceneWidth / kSceneHeight);
+    GLsizei atlasHeight = ((kFontCharacterCount + (kFontAtlasWidth / kFontGlyphWidth) - 1) / (kFontAtlasWidth / kFontGlyphWidth)) * kFontGlyphHeight;
+    std::vector<GLubyte> atlas(kFontAtlasWidth * atlasHeight);
+    std::vector<TextGlyph> glyphs(kFontCharacterCount);
+
+    // Each glyph's pixels are set from the bits of its character, roughly as many as a real glyph
+    for (int c = 0; c < kFontCharacterCount; c++)
+    {
+        TextGlyph glyph = { (GLushort)((c % (kFontAtlasWidth / kFontGlyphWidth)) * kFontGlyphWidth), (GLushort)((c / (kFontAtlasWidth / kFontGlyphWidth)) * kFontGlyphHeight), kFontGlyphWidth, kFontGlyphHeight, kFontGlyphWidth };
+        unsigned int bits = (c + kFontFirstCharacter) * 2654435761u;
+
+        for (int row = 2; row < kFontGlyphHeight - 2; row++)
+        {
+            for (int column = 1; column < kFontGlyphWidth - 1; column++)
+            {
+                atlas[((glyph.y + row) * kFontAtlasWidth) + glyph.x + column] = ((bits >> ((row * 5 + column) % 32)) & 1) ? 255 : 0;
+            }
+        }
+
+        glyphs[c] = glyph;
+    }
+
+    if ( ! scene.nodeRenderer.prepare() || ! scene.textRenderer.prepare(kFontAtlasWidth, atlasHeight, atlas.data(), kFontFirstCharacter, glyphs))
+    {
+        return false;
+    }
+
+    glShadeModel(GL_SMOOTH);
+    glClearColor(0, 0, 0, 0);
+    glClearDepth(1.0f);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glFrustum(-right, right, -top, top, near, far);
+
+    scene.worldRotateY = 0;
+
+    return true;
+}
+
+static void PrintPercentiles(const char* name, const std::vector<double>& times)
+{
+    FrameTimePercentiles percentiles = OffscreenRenderer::percentiles(times);
+
+    printf("%-4s  %8zu  %8.2f  %8.2f  %8.2f  %8.2f\n", name, percentiles.sampleCount, percentiles.p50, percentiles.p90, percentiles.p99, percentiles.maximum);
+}
+
+int main(int argc, const char* argv[])
+{
+    scene_options options;
+    std::vector<traffic_event> events;
+    OffscreenRenderer renderer(kSceneWidth, kSceneHeight);
+
+    if ( ! ParseOptions(argc, argv, options))
+    {
+        return 1;
+    }
+
+    if (options.replayPath)
+    {
+        if ( ! ReadReplay(options.replayPath, events))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        SyntheticTraffic(options.hostCount, options.seconds, events);
+    }
+
+    if ( ! renderer.prepare())
+    {
+        fprintf(stderr, "Could not create an offscreen context\n");
+        return 1;
+    }
+
+    // Renderers hold GL objects, so the scene lives only while the context does
+    scene_state* scene = new scene_state();
+
+    if ( ! PrepareScene(*scene))
+    {
+        fprintf(stderr, "Could not prepare the renderers\n");
+        return 1;
+    }
+
+    size_t frameCount = (size_t)(options.seconds * kSceneFrameRate);
+    size_t nextEvent = 0;
+    char path[1024];
+
+    printf("%s, %dx%d, %zu frames, %zu events%s\n", glGetString(GL_RENDERER), kSceneWidth, kSceneHeight, frameCount, events.size(), renderer.hasGPUTimes() ? "" : " (no GPU timer)");
+    fflush(stdout);
+
+    for (size_t frame = 0; frame < frameCount; frame++)
+    {
+        double now = (double)frame / kSceneFrameRate;
+
+        while (nextEvent < events.size() && events[nextEvent].seconds <= now)
+        {
+            ApplyEvent(*scene, events[nextEvent++]);
+        }
+
+        renderer.beginFrame();
+        DrawFrame(*scene, options, 1.0 / kSceneFrameRate);
+        renderer.endFrame();
+
+        if (options.dumpDirectory)
+        {
+            snprintf(path, sizeof(path), "%s/frame%05zu.ppm", options.dumpDirectory, frame);
+
+            if ( ! renderer.writeFrame(path))
+            {
+                fprintf(stderr, "Could not write %s\n", path);
+                return 1;
+            }
+        }
+    }
+
+    renderer.finish();
+    printf("%zu hosts, %zu visible in the last frame\n", scene->hosts.size(), scene->frame.visible().size());
+    delete scene;
+
+    printf("%-4s  %8s  %8s  %8s  %8s  %8s\n", "ms", "frames", "p50", "p90", "p99", "max");
+    PrintPercentiles("cpu", renderer.cpuTimes());
+    PrintPercentiles("gpu", renderer.gpuTimes());
+    fflush(stdout);
+
+    if (options.maximumP99 > 0)
+    {
+        double cpuP99 = OffscreenRenderer::percentiles(renderer.cpuTimes()).p99;
+        double gpuP99 = OffscreenRenderer::percentiles(renderer.gpuTimes()).p99;
+
+        if (cpuP99 > options.maximumP99 || gpuP99 > options.maximumP99)
+        {
+            fprintf(stderr, "99th percentile frame time over the %.2f ms budget\n", options.maximumP99);
+            return 2;
+        }
+    }
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,90 @@
+//
+//  SceneFrame.cpp
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#include "SceneFrame.hpp"
+
+void SceneFrame::begin(NodeRenderer* nodeRenderer, TextRenderer* textRenderer, GLfloat worldRotateX, GLfloat worldRotateY)
+{
+    _nodeRenderer = nodeRenderer;
+    _worldRotateX = worldRotateX;
+    _worldRotateY = worldRotateY;
+
+    if (_nodeRenderer)
+    {
+        _nodeRenderer->clear();
+    }
+
+    textRenderer->clear();
+    _visible.clear();
+    _connectors.clear();
+
+    // Labels are projected with this frame's matrices, the world matrix includes its rotation
+    glGetFloatv(GL_MODELVIEW_MATRIX, _cameraMatrix);
+    glGetFloatv(GL_PROJECTION_MATRIX, _projectionMatrix);
+    glGetIntegerv(GL_VIEWPORT, _viewport);
+    glPushMatrix();
+    rotateForWorld();
+    glGetFloatv(GL_MODELVIEW_MATRIX, _worldMatrix);
+    glPopMatrix();
+}
+
+void SceneFrame::rotateForWorld() const
+{
+    glRotatef(360.0f - _worldRotateY, 0.0f, 1.0f, 0.0);        // rotation around Y-axis (looking left and right)
+    glRotatef(360.0f - _worldRotateX, 1.0f, 0.0f, 0.0);        // rotation around X-axis
+}
+
+/**
+ * Only nodes inside the view frustum are drawn (and so can be picked, the mouse ray never leaves the frustum).
+ */
+void SceneFrame::cull(const NodeIndex& index)
+{
+    GLfloat frustumPlanes[6][4];
+
+    NodeIndex::frustumPlanes(_worldMatrix, _projectionMatrix, frustumPlanes);
+    index.queryFrustum(frustumPlanes, _visible);
+}
+
+void SceneFrame::addNode(const SceneNode& node)
+{
+    if (_nodeRenderer)
+    {
+        _nodeRenderer->addNode(node.x, node.y, node.z, node.volume, node.red, node.green, node.blue);
+    }
+}
+
+/**
+ * Nodes outside the frustum aren't drawn but their connectors may still cross it, so every node's is queued.
+ */
+void SceneFrame::addConnector(const SceneNode& node)
+{
+    _connectors.insert(_connectors.end(), { node.red, node.green, node.blue, node.x, node.y, node.z });
+}
+
+void SceneFrame::draw(bool lighting)
+{
+    glPushMatrix();
+    rotateForWorld();
+    glBegin(GL_LINES);
+
+    for (size_t i = 0; i < _connectors.size(); i += 6)
+    {
+        glColor3f(_connectors[i], _connectors[i + 1], _connectors[i + 2]);
+        glVertex3f(0, 0, 0);
+        glVertex3f(_connectors[i + 3], _connectors[i + 4], _connectors[i + 5]);
+    }
+
+    glEnd();
+
+    if (_nodeRenderer)
+    {
+        _nodeRenderer->draw(lighting);
+    }
+
+    glPopMatrix();
+}
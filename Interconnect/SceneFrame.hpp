@@ -0,0 +1,62 @@
+//
+//  SceneFrame.hpp
+//  Interconnect
+//
+//  What the view submits for one frame of the node sphere, shared with SceneBenchmark so the benchmark measures the
+//  view's own work. The frame takes its matrices from the camera the caller has loaded, culls the node index against
+//  the frustum, queues the visible nodes for the instanced renderer and every node's origin connector, then draws the
+//  connectors in one pass and the nodes in one call under a single world rotation.
+//
+//  Labels and the HUD go to the text renderer as they're drawn, the caller draws it last (over everything).
+//
+//  Plain C++ so it builds outside the app.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#ifndef SceneFrame_hpp
+#define SceneFrame_hpp
+
+#include "NodeAnimation.hpp"
+#include "NodeIndex.hpp"
+#include "NodeRenderer.hpp"
+#include "TextRenderer.hpp"
+#include <stdint.h>
+#include <vector>
+
+#define kWorldAutoRotationUnitsPerSecond 3              // how fast does the world automatically rotate around Y-axis?
+
+class SceneFrame
+{
+public:
+    SceneFrame() : _nodeRenderer(NULL), _worldRotateX(0), _worldRotateY(0) {}
+
+    // With the camera's modelview loaded. Clears both renderers, the node renderer may be NULL (nodes are then drawn
+    // by the caller).
+    void begin(NodeRenderer* nodeRenderer, TextRenderer* textRenderer, GLfloat worldRotateX, GLfloat worldRotateY);
+    void rotateForWorld() const;
+    void cull(const NodeIndex& index);
+
+    void addNode(const SceneNode& node);
+    void addConnector(const SceneNode& node);
+    void draw(bool lighting);
+
+    const std::vector<uint32_t>& visible() const { return _visible; }      // items of the index inside the frustum
+    const GLfloat* cameraMatrix() const { return _cameraMatrix; }
+    const GLfloat* worldMatrix() const { return _worldMatrix; }             // camera and world rotation
+    const GLfloat* projectionMatrix() const { return _projectionMatrix; }
+    const GLint* viewport() const { return _viewport; }
+
+private:
+    NodeRenderer* _nodeRenderer;
+    GLfloat _worldRotateX, _worldRotateY;
+    GLfloat _cameraMatrix[16];
+    GLfloat _worldMatrix[16];
+    GLfloat _projectionMatrix[16];
+    GLint _viewport[4];
+    std::vector<uint32_t> _visible;
+    std::vector<GLfloat> _connectors;       // colour then position of each connector
+};
+
+#endif /* SceneFrame_hpp */
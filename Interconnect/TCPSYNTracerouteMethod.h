@@ -0,0 +1,15 @@
+//
+//  TCPSYNTracerouteMethod.h
+//  Interconnect
+//
+//  Connections to the host's service port, the destination answers with SYN-ACK or RST.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "TracerouteProbeMethod.h"
+
+@interface TCPSYNTracerouteMethod : NSObject <TracerouteProbeMethod>
+
+@end
@@ -0,0 +1,247 @@
+//
+//  TCPSYNTracerouteMethod.m
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "TCPSYNTracerouteMethod.h"
+#import "TracerouteProbe.h"
+#import "ProbeThread+Private.h"
+#import <sys/socket.h>
+#import <arpa/inet.h>
+#import <fcntl.h>
+
+#define TCP_PORT_OWNER(slot, ttl)               ((((uint32_t)(slot) + 1) << 8) | (ttl))      // 0 is no owner
+#define kMaxTCPConnectionsInFlight              128         // well under the default soft RLIMIT_NOFILE of 256, the app has other descriptors open
+
+@interface TCPSYNTracerouteMethod ()
+{
+    uint32_t* _tcpPortOwners;               // TCP_PORT_OWNER by local port, for connections in flight
+    NSUInteger _connectionsInFlight;        // each holds a file descriptor until it's closed
+}
+
+@property (nonatomic, weak) ProbeThread* probeThread;
+@property (nonatomic, copy) TracerouteReplyHandler replyHandler;
+
+@end
+
+@implementation TCPSYNTracerouteMethod
+
+/**
+ * Crafting a SYN needs a raw socket (and root), so the kernel is left to send it by starting a non-blocking connect()
+ * with the TTL set on a socket of its own. The connection succeeding or being refused both mean the SYN reached the
+ * destination. An ICMP error for a SYN quotes its ports, the local port is looked up in the table of connections in
+ * flight.
+ *
+ * Every connection in flight holds a file descriptor for up to kMaxHopFlightTimeMs, at the probe rate that's more than
+ * the process may have open. Connections are capped below that, hops beyond the cap (or that find the descriptors run
+ * out anyway) are sent later rather than given up on as silent.
+ */
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _tcpPortOwners = calloc(65536, sizeof(uint32_t));
+        if ( ! _tcpPortOwners)
+        {
+            return nil;
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_tcpPortOwners);
+}
+
+- (void)attachToProbeThread:(ProbeThread*)probeThread replyHandler:(TracerouteReplyHandler)replyHandler
+{
+    self.probeThread = probeThread;
+    self.replyHandler = replyHandler;
+}
+
+/**
+ * Start a connection to the host's service port with the TTL set, the kernel sends the SYN (and retransmits it, which
+ * can draw a second ICMP error for the same attempt). The connection is watched on the probe thread's run loop.
+ */
+- (HopSendResult)sendHop:(uint8_t)ttl attempt:(uint8_t)attempt forProbe:(TracerouteProbe*)probe
+{
+    struct hop* hop = &probe->hops[ttl];
+    int ipTTL = ttl;
+
+    if (_connectionsInFlight >= kMaxTCPConnectionsInFlight)
+    {
+        return kHopSendLater;
+    }
+
+    int tcpSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (tcpSocket < 0)
+    {
+        if (errno == EMFILE || errno == ENFILE)
+        {
+            return kHopSendLater;
+        }
+
+        NSLog(@"Could not create TCP socket: %s", strerror(errno));
+        return kHopSendFailed;
+    }
+
+    if (fcntl(tcpSocket, F_SETFL, fcntl(tcpSocket, F_GETFL, 0) | O_NONBLOCK) < 0 ||
+        setsockopt(tcpSocket, IPPROTO_IP, IP_TTL, &ipTTL, sizeof(ipTTL)) < 0)
+    {
+        NSLog(@"Could not configure TCP socket for TTL %d: %s", ipTTL, strerror(errno));
+        close(tcpSocket);
+        return kHopSendFailed;
+    }
+
+    struct sockaddr_in dstAddr;
+    memset(&dstAddr, 0, sizeof(dstAddr));
+    dstAddr.sin_family = AF_INET;
+    dstAddr.sin_port = htons(probe.dstPort);
+    dstAddr.sin_addr.s_addr = probe.dstAddress;
+
+    hop->timeSent[attempt] = [self.probeThread monotonicNs];
+
+    if (connect(tcpSocket, (struct sockaddr*)&dstAddr, sizeof(dstAddr)) < 0 && errno != EINPROGRESS)
+    {
+        NSLog(@"Failed while starting TCP probe to %@:%hu: %s", probe.hostIdentifier, probe.dstPort, strerror(errno));
+        close(tcpSocket);
+        return kHopSendFailed;
+    }
+
+    struct sockaddr_in localAddr;
+    socklen_t localAddrLen = sizeof(localAddr);
+
+    if (getsockname(tcpSocket, (struct sockaddr*)&localAddr, &localAddrLen) < 0)
+    {
+        NSLog(@"Could not get local port of TCP probe: %s", strerror(errno));
+        close(tcpSocket);
+        return kHopSendFailed;
+    }
+
+    // Invalidating the CFSocket closes the native socket
+    CFSocketContext context = { 0, (__bridge void*)self, NULL, NULL, NULL };
+    CFSocketRef connection = CFSocketCreateWithNative(NULL, tcpSocket, kCFSocketConnectCallBack | kCFSocketWriteCallBack, &TCPConnectionCallback, &context);
+    if ( ! connection)
+    {
+        close(tcpSocket);
+        return kHopSendFailed;
+    }
+
+    CFRunLoopSourceRef connectionSource = CFSocketCreateRunLoopSource(NULL, connection, 0);
+    CFRunLoopAddSource(CFRunLoopGetCurrent(), connectionSource, kCFRunLoopDefaultMode);
+    CFRelease(connectionSource);
+
+    hop->connection = connection;
+    hop->localPort = ntohs(localAddr.sin_port);
+    _tcpPortOwners[hop->localPort] = TCP_PORT_OWNER(probe.slot, ttl);
+    _connectionsInFlight++;
+
+    return kHopSent;
+}
+
+/**
+ * Only the latest attempt's connection is kept, an earlier one answering late would be indistinguishable.
+ */
+- (void)closeHop:(struct hop*)hop
+{
+    if ( ! hop->connection)
+    {
+        return;
+    }
+
+    _tcpPortOwners[hop->localPort] = 0;
+    _connectionsInFlight--;
+
+    CFSocketInvalidate(hop->connection);
+    CFRelease(hop->connection);
+
+    hop->connection = NULL;
+    hop->localPort = 0;
+}
+
+- (BOOL)matchQuotedHeader:(const unsigned char*)header proto:(uint8_t)proto slot:(uint16_t*)slot ttl:(uint8_t*)ttl attempt:(int*)attempt
+{
+    if (proto != IPPROTO_TCP)
+    {
+        return NO;
+    }
+
+    // Source port then destination port, only connections still in flight are known
+    uint16_t srcPort = ntohs(((const uint16_t*)header)[0]);
+    uint32_t owner = _tcpPortOwners[srcPort];
+
+    if ( ! owner)
+    {
+        return NO;
+    }
+
+    *slot = (owner >> 8) - 1;
+    *ttl = owner & 0xff;
+    *attempt = -1;      // always the latest
+
+    return YES;
+}
+
+/**
+ * The destination answers on the connection, not with ICMP (see connectionFinished:).
+ */
+- (BOOL)matchReply:(const struct icmp*)icmpHdr slot:(uint16_t*)slot ttl:(uint8_t*)ttl attempt:(int*)attempt
+{
+    return NO;
+}
+
+/**
+ * Called when a probe's connection attempt completes (the write callback is the same event should the connect
+ * callback not be delivered for a socket CFSocket didn't connect itself).
+ */
+void TCPConnectionCallback(CFSocketRef s, CFSocketCallBackType callbackType, CFDataRef address, const void* data, void* info)
+{
+    TCPSYNTracerouteMethod* method = (__bridge TCPSYNTracerouteMethod*)info;
+    [method connectionFinished:s];
+}
+
+/**
+ * A connection started for a hop has finished connecting, one way or the other. Unlike ICMP replies there's no kernel
+ * timestamp for this so the receive time is taken now.
+ */
+- (void)connectionFinished:(CFSocketRef)connection
+{
+    uint64_t timeRecv = [self.probeThread monotonicNs];
+    int tcpSocket = CFSocketGetNative(connection);
+
+    struct sockaddr_in localAddr;
+    socklen_t localAddrLen = sizeof(localAddr);
+    int error = 0;
+    socklen_t errorLen = sizeof(error);
+
+    if (getsockname(tcpSocket, (struct sockaddr*)&localAddr, &localAddrLen) < 0 ||
+        getsockopt(tcpSocket, SOL_SOCKET, SO_ERROR, &error, &errorLen) < 0)
+    {
+        return;
+    }
+
+    // A closed connection gives up its port (and its callbacks), so an owner means this is the hop's latest attempt
+    uint32_t owner = _tcpPortOwners[ntohs(localAddr.sin_port)];
+
+    if ( ! owner)
+    {
+        return;
+    }
+
+    // Anything other than an answer from the destination (such as a host unreachable) is left to time out
+    if (error != 0 && error != ECONNREFUSED && error != ECONNRESET)
+    {
+        return;
+    }
+
+//  NSLog(@"TCP probe with TTL %u was %@", owner & 0xff, error ? @"refused" : @"accepted");
+
+    self.replyHandler((owner >> 8) - 1, owner & 0xff, -1, timeRecv);
+}
+
+@end
@@ -0,0 +1,207 @@
+//
+//  TextRenderer.cpp
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#include "TextRenderer.hpp"
+#include <math.h>
+#include <stddef.h>
+
+#define kInitialVertexCapacity  (6 * 1024)
+
+TextRenderer::TextRenderer() :
+    _texture(0),
+    _atlasWidth(0),
+    _atlasHeight(0),
+    _firstCharacter(0),
+    _vertexBuffer(0),
+    _vertexBufferCapacity(0)
+{
+}
+
+/**
+ * Expects the context the renderer was prepared in to be current.
+ */
+TextRenderer::~TextRenderer()
+{
+    glDeleteTextures(1, &_texture);
+    glDeleteBuffers(1, &_vertexBuffer);
+}
+
+bool TextRenderer::prepare(GLsizei atlasWidth, GLsizei atlasHeight, const GLubyte* atlas, unsigned char firstCharacter, const std::vector<TextGlyph>& glyphs)
+{
+    std::vector<GLubyte> alpha(atlas, atlas + (atlasWidth * atlasHeight));
+
+    // Glyph bitmaps are either on or off, as they were for glBitmap
+    for (GLubyte& coverage : alpha)
+    {
+        coverage = coverage ? 255 : 0;
+    }
+
+    glGenTextures(1, &_texture);
+    glBindTexture(GL_TEXTURE_2D, _texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA8, atlasWidth, atlasHeight, 0, GL_ALPHA, GL_UNSIGNED_BYTE, alpha.data());
+    glPopClientAttrib();
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenBuffers(1, &_vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, kInitialVertexCapacity * sizeof(TextVertex), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    _atlasWidth = atlasWidth;
+    _atlasHeight = atlasHeight;
+    _firstCharacter = firstCharacter;
+    _glyphs = glyphs;
+    _vertexBufferCapacity = kInitialVertexCapacity;
+    _vertices.reserve(kInitialVertexCapacity);
+
+    return glGetError() == GL_NO_ERROR;
+}
+
+/**
+ * Text starts at a window position (pixels from the bottom left, depth 0 nearest to 1 furthest) and runs right.
+ * Characters without a glyph are skipped, as glCallLists skipped lists that didn't exist.
+ */
+void TextRenderer::addText(const char* text, GLfloat windowX, GLfloat windowY, GLfloat windowZ, GLfloat red, GLfloat green, GLfloat blue)
+{
+    // glBitmap puts the bitmap's bottom left corner at the floor of the raster position
+    GLfloat penX = floorf(windowX);
+    GLfloat penY = floorf(windowY);
+    GLubyte colour[3] = { (GLubyte)lroundf(red * 255), (GLubyte)lroundf(green * 255), (GLubyte)lroundf(blue * 255) };
+
+    for (const unsigned char* character = (const unsigned char*)text; *character; character++)
+    {
+        if (*character < _firstCharacter || *character >= _firstCharacter + _glyphs.size())
+        {
+            continue;
+        }
+
+        const TextGlyph& glyph = _glyphs[*character - _firstCharacter];
+        GLfloat left = penX, right = penX + glyph.width;
+        GLfloat bottom = penY, top = penY + glyph.height;
+        GLfloat s0 = (GLfloat)glyph.x / _atlasWidth, s1 = (GLfloat)(glyph.x + glyph.width) / _atlasWidth;
+        GLfloat t0 = (GLfloat)glyph.y / _atlasHeight, t1 = (GLfloat)(glyph.y + glyph.height) / _atlasHeight;
+
+        // Depth runs down -Z in the orthographic projection the text is drawn with
+        TextVertex corners[4] =
+        {
+            { left, bottom, -windowZ, s0, t0, colour[0], colour[1], colour[2], 255 },
+            { right, bottom, -windowZ, s1, t0, colour[0], colour[1], colour[2], 255 },
+            { right, top, -windowZ, s1, t1, colour[0], colour[1], colour[2], 255 },
+            { left, top, -windowZ, s0, t1, colour[0], colour[1], colour[2], 255 },
+        };
+
+        _vertices.push_back(corners[0]);
+        _vertices.push_back(corners[1]);
+        _vertices.push_back(corners[2]);
+        _vertices.push_back(corners[0]);
+        _vertices.push_back(corners[2]);
+        _vertices.push_back(corners[3]);
+
+        penX += glyph.advance;
+    }
+}
+
+/**
+ * Text anchored to a point in the scene, projected as glRasterPos would project it. Like glRasterPos nothing is drawn
+ * if the point is outside the view volume.
+ */
+bool TextRenderer::addLabel(const char* text, GLfloat x, GLfloat y, GLfloat z, const GLfloat* modelView, const GLfloat* projection, const GLint* viewport, GLfloat red, GLfloat green, GLfloat blue)
+{
+    GLfloat eye[4], clip[4];
+
+    for (int row = 0; row < 4; row++)
+    {
+        eye[row] = (modelView[row] * x) + (modelView[4 + row] * y) + (modelView[8 + row] * z) + modelView[12 + row];
+    }
+
+    for (int row = 0; row < 4; row++)
+    {
+        clip[row] = (projection[row] * eye[0]) + (projection[4 + row] * eye[1]) + (projection[8 + row] * eye[2]) + (projection[12 + row] * eye[3]);
+    }
+
+    if (clip[3] <= 0 || fabsf(clip[0]) > clip[3] || fabsf(clip[1]) > clip[3] || fabsf(clip[2]) > clip[3])
+    {
+        return false;
+    }
+
+    GLfloat windowX = viewport[0] + (viewport[2] * ((clip[0] / clip[3]) + 1) * 0.5f);
+    GLfloat windowY = viewport[1] + (viewport[3] * ((clip[1] / clip[3]) + 1) * 0.5f);
+    GLfloat windowZ = ((clip[2] / clip[3]) + 1) * 0.5f;
+
+    addText(text, windowX, windowY, windowZ, red, green, blue);
+
+    return true;
+}
+
+/**
+ * Draw all the text added since the last clear in window co-ordinates. Leaves the matrices and state as it found them.
+ */
+void TextRenderer::draw(const GLint* viewport)
+{
+    if ( ! _texture || _vertices.empty())
+    {
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+
+    while (_vertexBufferCapacity < _vertices.size())
+    {
+        _vertexBufferCapacity *= 2;
+    }
+
+    // Orphan the buffer every frame so the upload never waits on the previous frame's draw
+    glBufferData(GL_ARRAY_BUFFER, _vertexBufferCapacity * sizeof(TextVertex), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, _vertices.size() * sizeof(TextVertex), _vertices.data());
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(viewport[0], viewport[0] + viewport[2], viewport[1], viewport[1] + viewport[3], 0, 1);
+
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT);
+    glDisable(GL_LIGHTING);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, _texture);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glEnable(GL_ALPHA_TEST);
+    glAlphaFunc(GL_GREATER, 0.5f);
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(TextVertex), (const GLvoid*)offsetof(TextVertex, x));
+    glTexCoordPointer(2, GL_FLOAT, sizeof(TextVertex), (const GLvoid*)offsetof(TextVertex, s));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(TextVertex), (const GLvoid*)offsetof(TextVertex, red));
+
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)_vertices.size());
+
+    glPopClientAttrib();
+    glPopAttrib();
+
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,78 @@
+//
+//  TextRenderer.hpp
+//  Interconnect
+//
+//  Draws all of a frame's text (HUD lines and node labels) in one call. Glyphs come from a bitmap atlas texture built
+//  once from the font, every string added over the frame becomes textured quads in a vertex buffer that's streamed to
+//  the GPU and drawn at the end of the frame.
+//
+//  Text is placed in window co-ordinates as glRasterPos would place it, glyphs are pixel aligned and drawn with alpha
+//  test so they look exactly like the glBitmap glyphs they replace. Labels keep the depth of the point they're anchored
+//  to (so nodes in front hide them), HUD text is always in front.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#ifndef TextRenderer_hpp
+#define TextRenderer_hpp
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#include <OpenGL/glext.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
+
+#include <stddef.h>
+#include <vector>
+
+/**
+ * Where a glyph is in the atlas (pixels from the bottom left) and how far it moves the pen.
+ */
+struct TextGlyph
+{
+    GLushort x, y;
+    GLushort width, height;
+    GLfloat advance;
+};
+
+class TextRenderer
+{
+public:
+    TextRenderer();
+    ~TextRenderer();
+
+    // Glyphs are for consecutive characters from firstCharacter, the atlas is one byte (coverage) per pixel
+    bool prepare(GLsizei atlasWidth, GLsizei atlasHeight, const GLubyte* atlas, unsigned char firstCharacter, const std::vector<TextGlyph>& glyphs);
+    bool isPrepared() const { return _texture != 0; }
+
+    void clear() { _vertices.clear(); }
+    void addText(const char* text, GLfloat windowX, GLfloat windowY, GLfloat windowZ, GLfloat red, GLfloat green, GLfloat blue);
+    bool addLabel(const char* text, GLfloat x, GLfloat y, GLfloat z, const GLfloat* modelView, const GLfloat* projection, const GLint* viewport, GLfloat red, GLfloat green, GLfloat blue);
+    size_t glyphCount() const { return _vertices.size() / 6; }
+
+    void draw(const GLint* viewport);
+
+private:
+    struct TextVertex
+    {
+        GLfloat x, y, z;
+        GLfloat s, t;
+        GLubyte red, green, blue, alpha;
+    };
+
+    GLuint _texture;
+    GLsizei _atlasWidth, _atlasHeight;
+    unsigned char _firstCharacter;
+    std::vector<TextGlyph> _glyphs;
+
+    GLuint _vertexBuffer;
+    size_t _vertexBufferCapacity;           // in vertices
+
+    std::vector<TextVertex> _vertices;
+};
+
+#endif /* TextRenderer_hpp */
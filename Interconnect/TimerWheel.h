@@ -0,0 +1,36 @@
+//
+//  TimerWheel.h
+//  Interconnect
+//
+//  A hierarchical timing wheel with millisecond resolution. Three levels of 256 slots cover 256ms, 65s and 4.6h, a
+//  timer is placed in the finest level that reaches its deadline and cascades down as the wheel turns. Scheduling and
+//  cancelling are O(1) and advancing costs O(expired timers) plus one step per elapsed millisecond.
+//
+//  Timers carry two integers rather than a block so scheduling doesn't allocate, every expiry is passed to the one
+//  handler given at initialisation. Handles include a generation so cancelling a timer that has already fired (and
+//  whose entry may have been reused) is harmless.
+//
+//  Not thread safe, expected to be owned by a probe thread.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+typedef uint64_t TimerWheelHandle;      // 0 is never a valid handle
+
+@interface TimerWheel : NSObject
+
+@property (nonatomic, readonly) NSUInteger count;
+
++ (uint64_t)monotonicMs;
+
+- (instancetype)initWithHandler:(void (^)(uint32_t key, uint32_t context))handler;
+
+- (TimerWheelHandle)scheduleAfterMs:(uint32_t)delayMs key:(uint32_t)key context:(uint32_t)context;
+- (void)cancel:(TimerWheelHandle)handle;
+- (void)advance;
+- (NSInteger)msUntilNextExpiry;
+
+@end
@@ -0,0 +1,334 @@
+//
+//  TimerWheel.m
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "TimerWheel.h"
+#import <mach/mach_time.h>
+
+#define kWheelLevels            3
+#define kWheelSlotBits          8
+#define kWheelSlots             (1 << kWheelSlotBits)
+#define kWheelSlotMask          (kWheelSlots - 1)
+#define kWheelSpanTicks         (1ULL << (kWheelLevels * kWheelSlotBits))      // deadlines further out wait in the last level
+#define kInitialTimerCapacity   256
+
+/**
+ * Entries live in one array and are linked into their slot's list by index, index 0 is unused so 0 means "none".
+ */
+struct wheel_timer
+{
+    uint64_t    deadline;       // in ticks (ms) since the wheel was created
+    uint32_t    key;
+    uint32_t    context;
+    uint32_t    generation;     // bumped each time the entry is freed, part of the handle
+    uint32_t    next;
+    uint32_t    prev;
+    uint16_t    slot;           // level * kWheelSlots + slot index, while scheduled
+    uint8_t     scheduled;
+};
+
+@interface TimerWheel ()
+{
+    struct wheel_timer* _timers;
+    uint32_t _timerCapacity;
+    uint32_t _freeTimers;                           // singly linked through next
+    uint32_t _slots[kWheelLevels * kWheelSlots];    // head of each slot's list
+    uint64_t _currentTick;
+    uint64_t _startMs;
+}
+
+@property (nonatomic, copy) void (^handler)(uint32_t key, uint32_t context);
+
+@end
+
+@implementation TimerWheel
+
++ (uint64_t)monotonicMs
+{
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t token;
+
+    dispatch_once(&token, ^{
+        mach_timebase_info(&timebase);
+    });
+
+    return (mach_absolute_time() * timebase.numer / timebase.denom) / NSEC_PER_MSEC;
+}
+
+/**
+ * The clock the wheel turns by (tests drive the wheel with their own).
+ */
+- (uint64_t)nowMs
+{
+    return [TimerWheel monotonicMs];
+}
+
+- (instancetype)initWithHandler:(void (^)(uint32_t key, uint32_t context))handler
+{
+    if (self = [super init])
+    {
+        _handler = [handler copy];
+        _count = 0;
+        _freeTimers = 0;
+        _timerCapacity = 0;
+        _timers = NULL;
+        memset(_slots, 0, sizeof(_slots));
+
+        _startMs = [self nowMs];
+        _currentTick = 0;
+
+        if ( ! [self growTimers])
+        {
+            return nil;
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_timers);
+}
+
+- (BOOL)growTimers
+{
+    uint32_t capacity = _timerCapacity ? _timerCapacity * 2 : kInitialTimerCapacity;
+    struct wheel_timer* timers = realloc(_timers, capacity * sizeof(struct wheel_timer));
+
+    if ( ! timers)
+    {
+        NSLog(@"Unable to grow timer wheel beyond %u timers", _timerCapacity);
+        return NO;
+    }
+
+    memset(&timers[_timerCapacity], 0, (capacity - _timerCapacity) * sizeof(struct wheel_timer));
+
+    // Entry 0 is reserved
+    for (uint32_t i = capacity - 1; i >= MAX(_timerCapacity, 1); i--)
+    {
+        timers[i].next = _freeTimers;
+        _freeTimers = i;
+    }
+
+    _timers = timers;
+    _timerCapacity = capacity;
+
+    return YES;
+}
+
+#pragma mark - Slot Lists
+
+/**
+ * Place a timer in the slot for its deadline. A timer that's already due goes in the slot for firstTick, which is the
+ * next tick when scheduling but the current one when cascading (its slot hasn't been run yet).
+ */
+- (void)linkTimer:(uint32_t)index firstTick:(uint64_t)firstTick
+{
+    struct wheel_timer* timer = &_timers[index];
+    uint64_t delta = (timer->deadline > _currentTick) ? timer->deadline - _currentTick : 0;
+    uint64_t deadline = timer->deadline;
+    int level = 0;
+
+    while (level < kWheelLevels - 1 && delta >= (1ULL << ((level + 1) * kWheelSlotBits)))
+    {
+        level++;
+    }
+
+    if (delta >= kWheelSpanTicks)
+    {
+        deadline = _currentTick + kWheelSpanTicks - 1;       // park it in the furthest slot, it'll be re-placed when it cascades
+    }
+    else if (timer->deadline < firstTick)
+    {
+        deadline = firstTick;                               // already due, fire as soon as possible
+    }
+
+    uint16_t slot = (level * kWheelSlots) + ((deadline >> (level * kWheelSlotBits)) & kWheelSlotMask);
+
+    timer->slot = slot;
+    timer->scheduled = 1;
+    timer->prev = 0;
+    timer->next = _slots[slot];
+
+    if (_slots[slot])
+    {
+        _timers[_slots[slot]].prev = index;
+    }
+
+    _slots[slot] = index;
+}
+
+- (void)unlinkTimer:(uint32_t)index
+{
+    struct wheel_timer* timer = &_timers[index];
+
+    if (timer->prev)
+    {
+        _timers[timer->prev].next = timer->next;
+    }
+    else
+    {
+        _slots[timer->slot] = timer->next;
+    }
+
+    if (timer->next)
+    {
+        _timers[timer->next].prev = timer->prev;
+    }
+
+    timer->scheduled = 0;
+}
+
+- (void)freeTimer:(uint32_t)index
+{
+    _timers[index].generation++;
+    _timers[index].next = _freeTimers;
+    _freeTimers = index;
+    _count--;
+}
+
+#pragma mark - Public Interface
+
+- (TimerWheelHandle)scheduleAfterMs:(uint32_t)delayMs key:(uint32_t)key context:(uint32_t)context
+{
+    if ( ! _freeTimers && ! [self growTimers])
+    {
+        return 0;
+    }
+
+    uint32_t index = _freeTimers;
+    struct wheel_timer* timer = &_timers[index];
+
+    _freeTimers = timer->next;
+    _count++;
+
+    // Deadlines are relative to the real time rather than the last tick the wheel was advanced to
+    timer->deadline = ([self nowMs] - _startMs) + delayMs;
+    timer->key = key;
+    timer->context = context;
+
+    [self linkTimer:index firstTick:_currentTick + 1];
+
+    return ((TimerWheelHandle)timer->generation << 32) | index;
+}
+
+- (void)cancel:(TimerWheelHandle)handle
+{
+    uint32_t index = (uint32_t)handle;
+
+    if ( ! index || index >= _timerCapacity || _timers[index].generation != (uint32_t)(handle >> 32) || ! _timers[index].scheduled)
+    {
+        return;
+    }
+
+    [self unlinkTimer:index];
+    [self freeTimer:index];
+}
+
+/**
+ * Turn the wheel up to the current time, calling the handler for every timer that has expired.
+ */
+- (void)advance
+{
+    uint64_t nowTick = [self nowMs] - _startMs;
+
+    if ( ! _count)
+    {
+        _currentTick = MAX(_currentTick, nowTick);
+        return;
+    }
+
+    while (_currentTick < nowTick)
+    {
+        _currentTick++;
+
+        // Each time a level wraps, the next slot of the level above is redistributed into the levels below it
+        for (int level = 1; level < kWheelLevels; level++)
+        {
+            if (_currentTick & ((1ULL << (level * kWheelSlotBits)) - 1))
+            {
+                break;
+            }
+
+            [self cascadeSlot:(level * kWheelSlots) + ((_currentTick >> (level * kWheelSlotBits)) & kWheelSlotMask)];
+        }
+
+        // Timers are taken off the head one at a time because the handler is free to schedule and cancel timers
+        uint16_t slot = _currentTick & kWheelSlotMask;
+        uint32_t index;
+
+        while ((index = _slots[slot]))
+        {
+            [self unlinkTimer:index];
+
+            if (_timers[index].deadline > _currentTick)
+            {
+                [self linkTimer:index firstTick:_currentTick + 1];     // parked beyond the wheel's span, never lands back in this slot
+            }
+            else
+            {
+                uint32_t key = _timers[index].key, context = _timers[index].context;
+
+                [self freeTimer:index];
+                self.handler(key, context);
+            }
+        }
+
+        if ( ! _count)
+        {
+            _currentTick = nowTick;
+        }
+    }
+}
+
+- (void)cascadeSlot:(uint16_t)slot
+{
+    uint32_t index = _slots[slot];
+
+    _slots[slot] = 0;
+
+    while (index)
+    {
+        uint32_t next = _timers[index].next;
+
+        [self linkTimer:index firstTick:_currentTick];
+        index = next;
+    }
+}
+
+/**
+ * How long until the wheel next needs to be advanced, or -1 if no timers are scheduled. This is exact for timers due
+ * in the finest level and otherwise the time until that level wraps and the next slot above cascades into it.
+ */
+- (NSInteger)msUntilNextExpiry
+{
+    if ( ! _count)
+    {
+        return -1;
+    }
+
+    uint64_t nowTick = [self nowMs] - _startMs;
+    NSInteger behind = (nowTick > _currentTick) ? (NSInteger)(nowTick - _currentTick) : 0;
+
+    for (NSInteger ticks = 1; ticks < kWheelSlots; ticks++)
+    {
+        if (_slots[(_currentTick + ticks) & kWheelSlotMask])
+        {
+            return MAX(ticks - behind, 0);
+        }
+
+        if (((_currentTick + ticks) & kWheelSlotMask) == 0)
+        {
+            return MAX(ticks - behind, 0);      // level wraps here
+        }
+    }
+
+    return MAX(kWheelSlots - behind, 0);
+}
+
+@end
@@ -0,0 +1,69 @@
+//
+//  TracerouteProbe.h
+//  Interconnect
+//
+//  The state of one traceroute on the threaded probe engine, shared by ICMPTimeExceededProbeThread (which matches
+//  replies to hops and runs the timeouts) and the method that puts its packets on the wire (see TracerouteProbeMethod).
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "Probe.h"
+#import "ICMPTimeExceededProbeThread.h"
+
+#define kMaxProbeRetries                        3           // per hop
+#define kMaxConcurrentTraceroutes               ((65536 - kBaseTracerouteUDPPort) / kMaxProbeTTL)
+
+/**
+ * What UDP and echo probes carry, the attempt and TTL are also encoded where replies quote them (see each method).
+ */
+#pragma pack(1)
+struct payload
+{
+    uint16_t        sequence;
+    unsigned char   ttl;
+    time_t          time_sent;
+    unsigned char   pad;
+};
+#pragma options align=reset
+
+typedef enum
+{
+    kHopNotSent = 0,
+    kHopInflight,
+    kHopIsRouter,           // ICMP time exceeded received
+    kHopIsDestination,      // ICMP unreachable or echo reply received, or the connection was answered
+    kHopSilent,             // no response after all retries
+    kHopDeferred            // waiting on a probe token (or the method) to be sent (or resent)
+} HopState;
+
+struct hop
+{
+    uint8_t         state;
+    uint8_t         attempts;
+    uint32_t        responder;                          // host byte order, routers only
+    TimerWheelHandle timer;                             // while inflight or deferred, keyed by slot with the TTL as context
+    uint64_t        timeSent[kMaxProbeRetries + 1];     // monotonic ns per attempt, so a late reply to an earlier attempt still gets its own RTT
+    CFSocketRef     connection;                         // TCP only, the latest attempt's connection while it's in flight
+    uint16_t        localPort;                          // TCP only, host byte order
+};
+
+/**
+ * All hops of one traceroute are tracked together, the Probe it extends is what's handed to the completion block.
+ */
+@interface TracerouteProbe : Probe
+{
+    @public
+    struct hop hops[kMaxProbeTTL + 1];      // indexed by TTL
+}
+
+@property (nonatomic) uint16_t slot;
+@property (nonatomic) in_addr_t dstAddress;         // network byte order
+@property (nonatomic) uint8_t firstTTLSent;         // above 1 when hops known from the path cache were skipped
+@property (nonatomic) uint8_t highestTTLSent;
+@property (nonatomic) uint8_t destinationTTL;       // lowest TTL that reached the destination, 0 until one has
+@property (nonatomic) uint8_t prepaidHops;          // sends left from those charged when the traceroute started
+@property (nonatomic) BOOL confirmingCachedPath;    // only the hop count from the path cache is being probed
+
+@end
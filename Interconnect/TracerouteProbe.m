@@ -0,0 +1,13 @@
+//
+//  TracerouteProbe.m
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "TracerouteProbe.h"
+
+@implementation TracerouteProbe
+
+@end
@@ -0,0 +1,69 @@
+//
+//  TracerouteProbeMethod.h
+//  Interconnect
+//
+//  How a traceroute's packets are sent and how the ICMP messages that come back are matched to them. The probe thread
+//  owns everything else (slots, hop state, timeouts, retries, the token bucket and the path cache), so a method is
+//  only the packet on the wire and where it encodes the traceroute, TTL and attempt:
+//
+//  UDPTracerouteMethod             datagrams to unused high ports, the destination answers with port unreachable
+//  ICMPEchoTracerouteMethod        echo requests, the destination answers with an echo reply
+//  TCPSYNTracerouteMethod          connections to the host's service port, the destination answers with SYN-ACK or RST
+//
+//  Methods are called on the probe thread only.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <netinet/in.h>
+
+@class ProbeThread;
+@class TracerouteProbe;
+struct hop;
+struct icmp;
+
+/**
+ * A hop was answered other than by an ICMP message (a TCP connection completing), attempt is -1 for the latest.
+ */
+typedef void (^TracerouteReplyHandler)(uint16_t slot, uint8_t ttl, int attempt, uint64_t timeRecv);
+
+typedef enum
+{
+    kHopSendFailed = 0,
+    kHopSent,
+    kHopSendLater           // out of something other hops give back as they finish (connections, file descriptors)
+} HopSendResult;
+
+@protocol TracerouteProbeMethod <NSObject>
+
+/**
+ * Called once by the probe thread before anything is sent. The method sends on the probe thread's ICMP socket if it
+ * needs to and reports answers that don't arrive as ICMP to the reply handler.
+ */
+- (void)attachToProbeThread:(ProbeThread*)probeThread replyHandler:(TracerouteReplyHandler)replyHandler;
+
+/**
+ * Send one attempt at a hop, recording its send time in hops[ttl].timeSent[attempt] (as late as possible). A hop that
+ * can't be sent yet is deferred by the probe thread and tried again, the attempt isn't used up.
+ */
+- (HopSendResult)sendHop:(uint8_t)ttl attempt:(uint8_t)attempt forProbe:(TracerouteProbe*)probe;
+
+/**
+ * The hop's latest attempt is no longer waited on (it was answered, is being resent or the traceroute is over).
+ */
+- (void)closeHop:(struct hop*)hop;
+
+/**
+ * Find the traceroute slot, TTL and attempt from the transport header quoted by an ICMP error (which covers at least
+ * its first 8 bytes). Returns NO for anything this method didn't send, the socket also sees errors for other traffic.
+ */
+- (BOOL)matchQuotedHeader:(const unsigned char*)header proto:(uint8_t)proto slot:(uint16_t*)slot ttl:(uint8_t*)ttl attempt:(int*)attempt;
+
+/**
+ * As above for an ICMP message other than an error, which can only have come from the destination itself.
+ */
+- (BOOL)matchReply:(const struct icmp*)icmpHdr slot:(uint16_t*)slot ttl:(uint8_t*)ttl attempt:(int*)attempt;
+
+@end
@@ -0,0 +1,15 @@
+//
+//  UDPTracerouteMethod.h
+//  Interconnect
+//
+//  Datagrams to unused high ports, the destination answers with port unreachable.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "TracerouteProbeMethod.h"
+
+@interface UDPTracerouteMethod : NSObject <TracerouteProbeMethod>
+
+@end
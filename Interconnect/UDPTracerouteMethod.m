@@ -0,0 +1,148 @@
+//
+//  UDPTracerouteMethod.m
+//  Interconnect
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import "UDPTracerouteMethod.h"
+#import "TracerouteProbe.h"
+#import "ProbeThread+Private.h"
+#import "PacketHeaders.h"
+#import <sys/socket.h>
+#import <arpa/inet.h>
+
+@interface UDPTracerouteMethod ()
+{
+    int _udpSockets[kMaxProbeTTL + 1];      // indexed by TTL
+}
+
+@property (nonatomic, weak) ProbeThread* probeThread;
+
+@end
+
+@implementation UDPTracerouteMethod
+
+/**
+ * Darwin has no sendmmsg and ignores an IP_TTL control message on send, so rather than a setsockopt before every
+ * datagram each TTL gets its own UDP socket with the TTL set once.
+ */
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        for (int ttl = 1; ttl <= kMaxProbeTTL; ttl++)
+        {
+            _udpSockets[ttl] = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            if (_udpSockets[ttl] < 0)
+            {
+                NSLog(@"Could not create UDP socket for TTL %d", ttl);
+            }
+            else if (setsockopt(_udpSockets[ttl], IPPROTO_IP, IP_TTL, &ttl, sizeof(ttl)) < 0)
+            {
+                NSLog(@"Could not set IP TTL %d on UDP socket: %s", ttl, strerror(errno));
+                close(_udpSockets[ttl]);
+                _udpSockets[ttl] = -1;
+            }
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    for (int ttl = 1; ttl <= kMaxProbeTTL; ttl++)
+    {
+        if (_udpSockets[ttl] >= 0)
+        {
+            close(_udpSockets[ttl]);
+        }
+    }
+}
+
+- (void)attachToProbeThread:(ProbeThread*)probeThread replyHandler:(TracerouteReplyHandler)replyHandler
+{
+    self.probeThread = probeThread;
+}
+
+/**
+ * Each traceroute owns a block of kMaxProbeTTL destination ports above kBaseTracerouteUDPPort, the port a probe is
+ * sent to encodes the traceroute (its slot) and the TTL. The attempt is encoded in the datagram length.
+ */
+- (HopSendResult)sendHop:(uint8_t)ttl attempt:(uint8_t)attempt forProbe:(TracerouteProbe*)probe
+{
+    struct sockaddr_in dstAddr;
+    memset(&dstAddr, 0, sizeof(dstAddr));
+    dstAddr.sin_family = AF_INET;
+    dstAddr.sin_port = htons(kBaseTracerouteUDPPort + (probe.slot * kMaxProbeTTL) + (ttl - 1));
+    dstAddr.sin_addr.s_addr = probe.dstAddress;
+
+    // The payload is padded by one byte per attempt
+    unsigned char packet[sizeof(struct payload) + kMaxProbeRetries];
+    size_t packetLength = sizeof(struct payload) + attempt;
+    struct payload* pPayload = (struct payload*)packet;
+
+    memset(packet, 0, sizeof(packet));
+    pPayload->sequence = htons(attempt);
+    pPayload->ttl = ttl;
+    pPayload->time_sent = htonl(time(NULL));
+
+    // The socket for the TTL already has it set
+    if (_udpSockets[ttl] < 0)
+    {
+        return kHopSendFailed;
+    }
+
+    // Send it, the send time is taken as late as possible (Darwin has no transmit timestamps)
+    probe->hops[ttl].timeSent[attempt] = [self.probeThread monotonicNs];
+
+    ssize_t bytesSent = sendto(_udpSockets[ttl], packet, packetLength, 0, (struct sockaddr*)&dstAddr, sizeof(dstAddr));
+    if (bytesSent < (ssize_t)packetLength)
+    {
+        NSLog(@"Failed while sending UDP probe (%ld bytes sent): %s", (long)bytesSent, strerror(errno));
+        return kHopSendFailed;
+    }
+
+//  NSLog(@"Sent UDP probe with TTL %u (attempt: %u) to %@:%hu", ttl, attempt, probe.hostIdentifier, ntohs(dstAddr.sin_port));
+
+    return kHopSent;
+}
+
+- (void)closeHop:(struct hop*)hop
+{
+}
+
+- (BOOL)matchQuotedHeader:(const unsigned char*)header proto:(uint8_t)proto slot:(uint16_t*)slot ttl:(uint8_t*)ttl attempt:(int*)attempt
+{
+    if (proto != IPPROTO_UDP)
+    {
+        return NO;
+    }
+
+    const struct hdr_udp* udpHdrReflected = (const struct hdr_udp*)header;
+
+    // Decode the traceroute and TTL from the destination port, and the attempt from the datagram length
+    uint16_t dstPort = ntohs(udpHdrReflected->udp_dport);
+    if (dstPort < kBaseTracerouteUDPPort)
+    {
+        return NO;
+    }
+
+    *slot = (dstPort - kBaseTracerouteUDPPort) / kMaxProbeTTL;
+    *ttl = ((dstPort - kBaseTracerouteUDPPort) % kMaxProbeTTL) + 1;
+    *attempt = (int)ntohs(udpHdrReflected->udp_len) - (int)sizeof(struct hdr_udp) - (int)sizeof(struct payload);
+
+    return YES;
+}
+
+/**
+ * The destination answers with port unreachable, an error like any other.
+ */
+- (BOOL)matchReply:(const struct icmp*)icmpHdr slot:(uint16_t*)slot ttl:(uint8_t*)ttl attempt:(int*)attempt
+{
+    return NO;
+}
+
+@end
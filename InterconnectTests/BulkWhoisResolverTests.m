@@ -0,0 +1,266 @@
+//
+//  BulkWhoisResolverTests.m
+//  InterconnectTests
+//
+//  Runs the resolver against a fake bulk whois server on the loopback interface. The server reads a session up to
+//  "end", then answers with whatever the test scripts (after an optional delay) or never answers at all.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "BulkWhoisResolver.h"
+#import <sys/socket.h>
+#import <netinet/in.h>
+#import <arpa/inet.h>
+
+#define kSessionWaitSeconds             5
+
+#pragma mark - Fake Whois Server
+
+/**
+ * Returns the response to a session's request, or nil to hold the connection open without answering.
+ */
+typedef NSString* (^FakeWhoisResponder)(NSString* request);
+
+@interface FakeWhoisServer : NSObject
+
+@property (nonatomic, readonly) uint16_t port;
+@property (atomic, readonly) NSUInteger sessionCount;
+@property (atomic, copy) NSString* lastRequest;
+@property (atomic, copy) FakeWhoisResponder responder;
+@property (atomic) NSTimeInterval responseDelay;
+
+- (void)close;
+
+@end
+
+@implementation FakeWhoisServer
+{
+    int _listenSocket;
+    dispatch_queue_t _queue;
+    dispatch_source_t _acceptSource;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        struct sockaddr_in addr;
+        socklen_t addrLen = sizeof(addr);
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_len = sizeof(addr);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        _listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (_listenSocket < 0 || bind(_listenSocket, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(_listenSocket, 4) < 0 ||
+            getsockname(_listenSocket, (struct sockaddr*)&addr, &addrLen) < 0)
+        {
+            return nil;
+        }
+
+        _port = ntohs(addr.sin_port);
+        _queue = dispatch_queue_create("FakeWhoisServer", DISPATCH_QUEUE_SERIAL);
+        _acceptSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, _listenSocket, 0, _queue);
+
+        // Sessions are served one at a time on the queue, as the resolver runs them
+        __weak FakeWhoisServer* weakSelf = self;
+        int listenSocket = _listenSocket;
+
+        dispatch_source_set_event_handler(_acceptSource, ^{
+            int sessionSocket = accept(listenSocket, NULL, NULL);
+
+            if (sessionSocket >= 0)
+            {
+                [weakSelf serveSession:sessionSocket];
+                close(sessionSocket);
+            }
+        });
+        dispatch_resume(_acceptSource);
+    }
+
+    return self;
+}
+
+- (void)close
+{
+    dispatch_source_cancel(_acceptSource);
+    dispatch_sync(_queue, ^{});
+    close(_listenSocket);
+}
+
+- (void)serveSession:(int)sessionSocket
+{
+    NSMutableData* request = [NSMutableData data];
+    uint8_t buffer[1024];
+    ssize_t bytesRead;
+
+    _sessionCount++;
+
+    while ( ! [[[NSString alloc] initWithData:request encoding:NSASCIIStringEncoding] hasSuffix:@"end\n"] &&
+           (bytesRead = recv(sessionSocket, buffer, sizeof(buffer), 0)) > 0)
+    {
+        [request appendBytes:buffer length:bytesRead];
+    }
+
+    self.lastRequest = [[NSString alloc] initWithData:request encoding:NSASCIIStringEncoding];
+
+    NSString* response = self.responder(self.lastRequest);
+
+    if ( ! response)
+    {
+        // Wait for the client to give up on us
+        while (recv(sessionSocket, buffer, sizeof(buffer), 0) > 0);
+        return;
+    }
+
+    [NSThread sleepForTimeInterval:self.responseDelay];
+
+    NSData* responseData = [response dataUsingEncoding:NSASCIIStringEncoding];
+    send(sessionSocket, [responseData bytes], [responseData length], 0);
+}
+
+@end
+
+#pragma mark - Tests
+
+@interface BulkWhoisResolverTests : XCTestCase
+
+@property (nonatomic, strong) FakeWhoisServer* whoisServer;
+@property (nonatomic, strong) BulkWhoisResolver* resolver;
+
+@end
+
+@implementation BulkWhoisResolverTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.whoisServer = [[FakeWhoisServer alloc] init];
+    XCTAssertNotNil(self.whoisServer);
+
+    self.resolver = [[BulkWhoisResolver alloc] initWithWhoisServer:@"127.0.0.1" port:self.whoisServer.port];
+}
+
+- (void)tearDown
+{
+    [self.whoisServer close];
+
+    [super tearDown];
+}
+
+/**
+ * Addresses requested together go to the server in one verbose bulk session and each gets its own line of the answer.
+ */
+- (void)testRequestsAreBatchedIntoOneSession
+{
+    NSMutableDictionary* results = [NSMutableDictionary dictionary];
+    NSArray* ipAddresses = @[ @"192.0.2.1", @"198.51.100.7", @"203.0.113.9" ];
+
+    self.whoisServer.responder = ^NSString*(NSString* request) {
+        return @"Bulk mode; whois.cymru.com [2026-10-19 00:00:00 +0000]\n"
+               @"AS      | IP               | BGP Prefix          | CC | Registry | Allocated  | AS Name\n"
+               @"64500   | 192.0.2.1        | 192.0.2.0/24        | AU | apnic    | 2016-04-10 | EXAMPLE-ONE, AU\n"
+               @"64501   | 198.51.100.7     | 198.51.100.0/23     | US | arin     | 2016-04-10 | EXAMPLE-TWO, US\n"
+               @"NA      | 203.0.113.9      | NA                  |    | other    |            | NA\n";
+    };
+
+    for (NSString* ipAddress in ipAddresses)
+    {
+        XCTestExpectation* resolved = [self expectationWithDescription:ipAddress];
+
+        [self.resolver resolveASDetailsForIPAddress:ipAddress onCompletion:^(NSString* resolvedAddress, NSDictionary* asDetails, uint8_t prefixLength) {
+            @synchronized (results)
+            {
+                results[resolvedAddress] = @[ asDetails ?: [NSNull null], [NSNumber numberWithUnsignedChar:prefixLength] ];
+            }
+
+            [resolved fulfill];
+        }];
+    }
+
+    [self waitForExpectationsWithTimeout:kSessionWaitSeconds handler:nil];
+
+    XCTAssertEqual(self.whoisServer.sessionCount, (NSUInteger)1);
+    XCTAssertTrue([self.whoisServer.lastRequest hasPrefix:@"begin\nverbose\n"]);
+    XCTAssertTrue([self.whoisServer.lastRequest hasSuffix:@"\nend\n"]);
+
+    for (NSString* ipAddress in ipAddresses)
+    {
+        XCTAssertTrue([self.whoisServer.lastRequest containsString:[NSString stringWithFormat:@"\n%@\n", ipAddress]]);
+    }
+
+    XCTAssertEqualObjects(results[@"192.0.2.1"][0], (@{ @"as": @"64500", @"asDesc": @"EXAMPLE-ONE, AU" }));
+    XCTAssertEqualObjects(results[@"192.0.2.1"][1], @24);
+    XCTAssertEqualObjects(results[@"198.51.100.7"][0], (@{ @"as": @"64501", @"asDesc": @"EXAMPLE-TWO, US" }));
+    XCTAssertEqualObjects(results[@"198.51.100.7"][1], @23);
+
+    // Unannounced addresses are answered (so they can be cached) with an empty AS
+    XCTAssertEqualObjects(results[@"203.0.113.9"][0], (@{ @"as": @"", @"asDesc": @"" }));
+    XCTAssertEqualObjects(results[@"203.0.113.9"][1], @32);
+}
+
+- (void)testSilentServerTimesOut
+{
+    XCTestExpectation* resolved = [self expectationWithDescription:@"resolved"];
+    __block NSDictionary* result = @{};
+
+    self.resolver.sessionTimeout = 0.5;
+    self.whoisServer.responder = ^NSString*(NSString* request) {
+        return nil;
+    };
+
+    [self.resolver resolveASDetailsForIPAddress:@"192.0.2.1" onCompletion:^(NSString* resolvedAddress, NSDictionary* asDetails, uint8_t prefixLength) {
+        result = asDetails;
+        [resolved fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:kSessionWaitSeconds handler:nil];
+
+    XCTAssertNil(result);
+}
+
+/**
+ * Lookups cancelled while their session is on the wire are never completed, and the resolver carries on afterwards.
+ * Sessions run one at a time so the second lookup completing means the cancelled session is over.
+ */
+- (void)testCancelledLookupsAreNotCompleted
+{
+    XCTestExpectation* resolved = [self expectationWithDescription:@"resolved after cancel"];
+    __block BOOL cancelledLookupCompleted = NO;
+
+    self.whoisServer.responseDelay = 0.5;
+    self.whoisServer.responder = ^NSString*(NSString* request) {
+        return @"64500   | 192.0.2.1        | 192.0.2.0/24        | AU | apnic    | 2016-04-10 | EXAMPLE-ONE, AU\n"
+               @"64501   | 198.51.100.7     | 198.51.100.0/23     | US | arin     | 2016-04-10 | EXAMPLE-TWO, US\n";
+    };
+
+    [self.resolver resolveASDetailsForIPAddress:@"192.0.2.1" onCompletion:^(NSString* resolvedAddress, NSDictionary* asDetails, uint8_t prefixLength) {
+        cancelledLookupCompleted = YES;
+    }];
+
+    NSDate* deadline = [NSDate dateWithTimeIntervalSinceNow:kSessionWaitSeconds];
+    while (self.whoisServer.sessionCount == 0 && [deadline timeIntervalSinceNow] > 0)
+    {
+        [NSThread sleepForTimeInterval:0.01];
+    }
+
+    XCTAssertEqual(self.whoisServer.sessionCount, (NSUInteger)1);
+    [self.resolver cancelOutstandingResolutions];
+
+    [self.resolver resolveASDetailsForIPAddress:@"198.51.100.7" onCompletion:^(NSString* resolvedAddress, NSDictionary* asDetails, uint8_t prefixLength) {
+        XCTAssertEqualObjects(asDetails[@"as"], @"64501");
+        [resolved fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:kSessionWaitSeconds handler:nil];
+
+    XCTAssertFalse(cancelledLookupCompleted);
+    XCTAssertEqual(self.whoisServer.sessionCount, (NSUInteger)2);
+}
+
+@end
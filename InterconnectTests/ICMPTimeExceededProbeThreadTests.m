@@ -0,0 +1,116 @@
+//
+//  ICMPTimeExceededProbeThreadTests.m
+//  InterconnectTests
+//
+//  Traceroutes to the loopback address, which answers at every TTL (so at TTL 1 when the whole path is traced). The
+//  path cache is seeded with a longer path to it, so the hop count each traceroute reports shows whether it came from
+//  the cache or from probing.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "ICMPTimeExceededProbeThread.h"
+#import "PathCache.h"
+#import "Probe.h"
+
+#define kLoopbackAddress                @"127.0.0.1"
+#define kCachedHopCount                 5
+#define kProbeWaitSeconds               10
+
+@interface ICMPTimeExceededProbeThread (Testing)
+
+- (PathCache*)pathCache;
+
+@end
+
+@interface ICMPTimeExceededProbeThreadTests : XCTestCase
+
+@property (nonatomic, strong) ICMPTimeExceededProbeThread* probeThread;
+
+@end
+
+@implementation ICMPTimeExceededProbeThreadTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    // Echo requests need no privileges and the loopback interface answers them itself
+    self.probeThread = [[ICMPTimeExceededProbeThread alloc] initWithMethod:kTracerouteMethodICMPEcho];
+
+    uint32_t routers[kCachedHopCount];
+    for (uint32_t ttl = 1; ttl < kCachedHopCount; ttl++)
+    {
+        routers[ttl] = 0x0a000000 | ttl;        // 10.0.0.ttl
+    }
+
+    // Recorded just now, so well within the cache's lifetime for both probes
+    [self.probeThread.pathCache recordPathToAddress:0x7f000001 routers:routers hopCount:kCachedHopCount];
+    [self.probeThread start];
+}
+
+- (void)tearDown
+{
+    XCTestExpectation* stopped = [self expectationWithDescription:@"probe thread stopped"];
+
+    [self.probeThread stop:^{
+        [stopped fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:kProbeWaitSeconds handler:nil];
+
+    [super tearDown];
+}
+
+/**
+ * Probe the loopback address (or re-probe it) and return the finished probe.
+ */
+- (Probe*)probeLoopbackReprobing:(BOOL)reprobing
+{
+    XCTestExpectation* finished = [self expectationWithDescription:@"probe finished"];
+    __block Probe* result = nil;
+
+    void (^completionBlock)(Probe*) = ^(Probe* probe) {
+        result = probe;
+        [finished fulfill];
+    };
+
+    if (reprobing)
+    {
+        [self.probeThread queueReprobeForHost:kLoopbackAddress port:0 onCompletion:completionBlock];
+        [self.probeThread processHostQueue];
+    }
+    else
+    {
+        [self.probeThread queueProbeForHost:kLoopbackAddress withPriority:YES onCompletion:completionBlock];
+    }
+
+    [self waitForExpectationsWithTimeout:kProbeWaitSeconds handler:nil];
+
+    return result;
+}
+
+- (void)testCachedHopCountStillMeasuresRTT
+{
+    Probe* probe = [self probeLoopbackReprobing:NO];
+
+    XCTAssertEqual(probe.currentTTL, (uint8_t)kCachedHopCount);
+    XCTAssertGreaterThan(probe.rttToHost, 0);
+}
+
+/**
+ * A re-probe inside the cached path's lifetime traces the path from the first hop rather than trusting the cache.
+ */
+- (void)testReprobeIsNotAnsweredFromPathCache
+{
+    XCTAssertEqual([self probeLoopbackReprobing:NO].currentTTL, (uint8_t)kCachedHopCount);
+
+    Probe* probe = [self probeLoopbackReprobing:YES];
+
+    XCTAssertEqual(probe.currentTTL, (uint8_t)1);
+    XCTAssertGreaterThan(probe.rttToHost, 0);
+}
+
+@end
@@ -0,0 +1,187 @@
+//
+//  NodeIndexTests.mm
+//  InterconnectTests
+//
+//  Nodes laid out as the app lays them out (see OrbitalLayout), all starting in the first orbital as hosts do before
+//  they're grouped, then regrouped across several orbitals and floated out to them a frame at a time. A narrow view
+//  looks at part of the sphere throughout.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import <math.h>
+#import <string.h>
+#import <vector>
+#import "NodeIndex.hpp"
+#import "OrbitalLayout.hpp"
+
+#define kNodeCount                      8000
+#define kOrbitalCount                   8
+#define kNodeVolume                     0.05
+#define kRadiusGrowthPerFrame           (0.7 / 30)      // as NodeLayout at 30 FPS
+#define kViewFieldOfView                8               // degrees
+#define kMinimumVisibleNodes            100             // fewer and there's no ratio worth measuring
+#define kMaximumVisitsPerVisibleNode    4               // a freshly built tree visits less than 2
+
+@interface NodeIndexTests : XCTestCase
+{
+    OrbitalLayout _orbitalLayout;
+    std::vector<NodeBounds> _items;
+    std::vector<unsigned long> _orbitals;
+    std::vector<size_t> _slots;
+    std::vector<float> _radii;
+    float _frustumPlanes[6][4];
+}
+
+@end
+
+@implementation NodeIndexTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    _items.resize(kNodeCount);
+    _orbitals.assign(kNodeCount, 1);
+    _slots.resize(kNodeCount);
+    _radii.assign(kNodeCount, 1);
+
+    for (size_t i = 0; i < kNodeCount; i++)
+    {
+        _slots[i] = i;
+    }
+
+    // A perspective projection from the camera's starting distance, looking off to one side of the origin
+    float projection[16], modelView[16];
+    float f = 1.0f / tanf(kViewFieldOfView * M_PI / 360);
+    float near = 0.1, far = 100;
+
+    memset(projection, 0, sizeof(projection));
+    projection[0] = f / 1.5;
+    projection[5] = f;
+    projection[10] = (far + near) / (near - far);
+    projection[11] = -1;
+    projection[14] = (2 * far * near) / (near - far);
+
+    memset(modelView, 0, sizeof(modelView));
+    modelView[0] = modelView[5] = modelView[10] = modelView[15] = 1;
+    modelView[12] = -2;
+    modelView[14] = -8;
+
+    NodeIndex::frustumPlanes(modelView, projection, _frustumPlanes);
+}
+
+/**
+ * Each node in the direction of its slot at its radius, the node's address is its identity.
+ */
+- (void)placeNodes
+{
+    for (size_t i = 0; i < kNodeCount; i++)
+    {
+        const OrbitalDirections& directions = _orbitalLayout.directions(_orbitals[i], kNodeCount);
+        NodeBounds bounds = { &_slots[i], _radii[i] * directions.x[_slots[i]], _radii[i] * directions.y[_slots[i]], _radii[i] * directions.z[_slots[i]], kNodeVolume };
+
+        _items[i] = bounds;
+    }
+}
+
+- (void)regroupNodes
+{
+    for (size_t i = 0; i < kNodeCount; i++)
+    {
+        _orbitals[i] = 1 + (i % kOrbitalCount);
+        _slots[i] = i / kOrbitalCount;
+    }
+}
+
+/**
+ * Returns whether any node is still floating out to its orbital.
+ */
+- (BOOL)floatNodes
+{
+    BOOL moving = NO;
+
+    for (size_t i = 0; i < kNodeCount; i++)
+    {
+        if (_radii[i] < _orbitals[i])
+        {
+            _radii[i] = fminf(_radii[i] + kRadiusGrowthPerFrame, _orbitals[i]);
+            moving = YES;
+        }
+    }
+
+    return moving;
+}
+
+- (void)testRegroupRebuilds
+{
+    NodeIndex index;
+
+    [self placeNodes];
+    index.update(_items);
+
+    [self regroupNodes];
+    [self placeNodes];
+    index.update(_items, true);
+
+    XCTAssertEqual(index.rebuildCount(), (size_t)2);
+}
+
+/**
+ * Refitting alone would keep each leaf's nodes together as they spread across the orbitals, until most of the tree
+ * overlaps the view.
+ */
+- (void)testVisitedNodesStayProportionalToVisibleAfterRegroup
+{
+    NodeIndex index;
+    std::vector<uint32_t> visible;
+    size_t visitedNodes;
+    BOOL regrouped = YES;
+
+    [self placeNodes];
+    index.update(_items);
+
+    [self regroupNodes];
+
+    while ([self floatNodes])
+    {
+        [self placeNodes];
+        index.update(_items, regrouped);
+        regrouped = NO;
+
+        visible.clear();
+        index.queryFrustum(_frustumPlanes, visible, &visitedNodes);
+
+        if (visible.size() >= kMinimumVisibleNodes)
+        {
+            XCTAssertLessThanOrEqual(visitedNodes, kMaximumVisitsPerVisibleNode * visible.size());
+        }
+    }
+
+    XCTAssertGreaterThanOrEqual(visible.size(), (size_t)kMinimumVisibleNodes);
+}
+
+/**
+ * Without being told of the regroup the tree is still rebuilt once the nodes have floated far enough apart.
+ */
+- (void)testRefitDegradationRebuilds
+{
+    NodeIndex index;
+
+    [self placeNodes];
+    index.update(_items);
+
+    [self regroupNodes];
+
+    while ([self floatNodes])
+    {
+        [self placeNodes];
+        index.update(_items);
+    }
+
+    XCTAssertGreaterThan(index.rebuildCount(), (size_t)1);
+}
+
+@end
@@ -0,0 +1,272 @@
+//
+//  PrefixTrieTests.m
+//  InterconnectTests
+//
+//  Prefixes are inserted in orders that take each path through the compressed insert: descending past a covering
+//  node, adding a leaf, splitting an edge above an existing node and splitting one where two prefixes diverge.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "PrefixTrie.h"
+
+#define kRandomPrefixCount              2000
+#define kRandomLookupCount              20000
+
+@interface PrefixTrieTests : XCTestCase
+
+@property (nonatomic, strong) PrefixTrie* trie;
+
+@end
+
+@implementation PrefixTrieTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.trie = [[PrefixTrie alloc] init];
+}
+
+- (void)insert:(NSString*)cidr value:(NSUInteger)value
+{
+    uint32_t network;
+    uint8_t length;
+
+    XCTAssertTrue([PrefixTrie parseCIDR:cidr network:&network length:&length], @"%@", cidr);
+    [self.trie insertPrefix:network length:length value:value];
+}
+
+/**
+ * The value and length of the longest prefix covering the address, or NSNotFound if none does.
+ */
+- (NSUInteger)longestMatch:(NSString*)ipAddress length:(uint8_t*)length
+{
+    uint32_t address;
+    NSUInteger value;
+
+    XCTAssertTrue([PrefixTrie parseIPv4Address:ipAddress address:&address], @"%@", ipAddress);
+
+    return [self.trie longestMatchForAddress:address value:&value length:length] ? value : NSNotFound;
+}
+
+- (NSUInteger)exactMatch:(NSString*)cidr
+{
+    uint32_t network;
+    uint8_t length;
+    NSUInteger value;
+
+    XCTAssertTrue([PrefixTrie parseCIDR:cidr network:&network length:&length], @"%@", cidr);
+
+    return [self.trie exactMatchForPrefix:network length:length value:&value] ? value : NSNotFound;
+}
+
+- (void)assertLongestMatch:(NSString*)ipAddress value:(NSUInteger)expectedValue length:(uint8_t)expectedLength
+{
+    uint8_t length = 0xff;
+    NSUInteger value = [self longestMatch:ipAddress length:&length];
+
+    XCTAssertEqual(value, expectedValue, @"%@", ipAddress);
+
+    if (expectedValue != NSNotFound)
+    {
+        XCTAssertEqual(length, expectedLength, @"%@", ipAddress);
+    }
+}
+
+- (void)assertNestedMatches
+{
+    XCTAssertEqual(self.trie.prefixCount, (NSUInteger)3);
+
+    [self assertLongestMatch:@"10.1.2.3" value:3 length:24];
+    [self assertLongestMatch:@"10.1.3.1" value:2 length:16];
+    [self assertLongestMatch:@"10.2.0.1" value:1 length:8];
+    [self assertLongestMatch:@"11.0.0.1" value:NSNotFound length:0];
+
+    XCTAssertEqual([self exactMatch:@"10.0.0.0/8"], (NSUInteger)1);
+    XCTAssertEqual([self exactMatch:@"10.1.0.0/16"], (NSUInteger)2);
+    XCTAssertEqual([self exactMatch:@"10.1.2.0/24"], (NSUInteger)3);
+
+    // Covered by an inserted prefix but not inserted themselves
+    XCTAssertEqual([self exactMatch:@"10.1.0.0/17"], NSNotFound);
+    XCTAssertEqual([self exactMatch:@"10.1.2.0/25"], NSNotFound);
+    XCTAssertEqual([self exactMatch:@"10.0.0.0/7"], NSNotFound);
+}
+
+- (void)testNestedPrefixesInsertedShortestFirst
+{
+    [self insert:@"10.0.0.0/8" value:1];
+    [self insert:@"10.1.0.0/16" value:2];
+    [self insert:@"10.1.2.0/24" value:3];
+
+    [self assertNestedMatches];
+}
+
+/**
+ * Each shorter prefix splits the edge above the longer one already inserted.
+ */
+- (void)testNestedPrefixesInsertedLongestFirst
+{
+    [self insert:@"10.1.2.0/24" value:3];
+    [self insert:@"10.0.0.0/8" value:1];
+    [self insert:@"10.1.0.0/16" value:2];
+
+    [self assertNestedMatches];
+}
+
+/**
+ * Adjacent /24s diverge at the last bit of their /23, which is split out without a value of its own.
+ */
+- (void)testSiblingPrefixes
+{
+    [self insert:@"192.168.0.0/24" value:1];
+    [self insert:@"192.168.1.0/24" value:2];
+
+    XCTAssertEqual(self.trie.prefixCount, (NSUInteger)2);
+
+    [self assertLongestMatch:@"192.168.0.5" value:1 length:24];
+    [self assertLongestMatch:@"192.168.1.5" value:2 length:24];
+    [self assertLongestMatch:@"192.168.2.1" value:NSNotFound length:0];
+
+    XCTAssertEqual([self exactMatch:@"192.168.0.0/23"], NSNotFound);
+}
+
+/**
+ * 10/8 and 12/8 share only their first 5 bits, the /5 split between them can then be given a value of its own.
+ */
+- (void)testDivergingPrefixes
+{
+    [self insert:@"10.0.0.0/8" value:1];
+    [self insert:@"12.0.0.0/8" value:2];
+
+    [self assertLongestMatch:@"9.0.0.1" value:NSNotFound length:0];
+    XCTAssertEqual([self exactMatch:@"8.0.0.0/5"], NSNotFound);
+
+    [self insert:@"8.0.0.0/5" value:3];
+
+    XCTAssertEqual(self.trie.prefixCount, (NSUInteger)3);
+
+    [self assertLongestMatch:@"9.0.0.1" value:3 length:5];
+    [self assertLongestMatch:@"10.1.1.1" value:1 length:8];
+    [self assertLongestMatch:@"12.1.1.1" value:2 length:8];
+    [self assertLongestMatch:@"16.0.0.1" value:NSNotFound length:0];
+
+    XCTAssertEqual([self exactMatch:@"8.0.0.0/5"], (NSUInteger)3);
+}
+
+- (void)testDefaultRouteAndHostPrefixes
+{
+    [self assertLongestMatch:@"1.2.3.4" value:NSNotFound length:0];
+
+    [self insert:@"0.0.0.0/0" value:7];
+    [self insert:@"1.2.3.4/32" value:8];
+    [self insert:@"255.255.255.255/32" value:9];
+    [self insert:@"0.0.0.0/32" value:10];
+
+    [self assertLongestMatch:@"1.2.3.4" value:8 length:32];
+    [self assertLongestMatch:@"1.2.3.5" value:7 length:0];
+    [self assertLongestMatch:@"255.255.255.255" value:9 length:32];
+    [self assertLongestMatch:@"255.255.255.254" value:7 length:0];
+    [self assertLongestMatch:@"0.0.0.0" value:10 length:32];
+
+    XCTAssertEqual([self exactMatch:@"0.0.0.0/0"], (NSUInteger)7);
+    XCTAssertEqual([self exactMatch:@"1.2.3.4/32"], (NSUInteger)8);
+    XCTAssertEqual([self exactMatch:@"1.2.3.0/24"], NSNotFound);
+}
+
+- (void)testReinsertingReplacesTheValue
+{
+    [self insert:@"10.1.2.3/8" value:1];        // host bits are ignored
+    [self insert:@"10.0.0.0/8" value:2];
+
+    XCTAssertEqual(self.trie.prefixCount, (NSUInteger)1);
+    XCTAssertEqual([self exactMatch:@"10.0.0.0/8"], (NSUInteger)2);
+
+    [self.trie removeAllPrefixes];
+
+    XCTAssertEqual(self.trie.prefixCount, (NSUInteger)0);
+    [self assertLongestMatch:@"10.0.0.1" value:NSNotFound length:0];
+}
+
+/**
+ * Random prefixes clustered in a few /8s (so they nest and diverge) checked against a scan of every prefix, well
+ * past the trie's initial capacity.
+ */
+- (void)testRandomPrefixesMatchALinearScan
+{
+    uint32_t networks[kRandomPrefixCount];
+    uint8_t lengths[kRandomPrefixCount];
+    NSUInteger inserted = 0;
+
+    srandom(1);
+
+    for (NSUInteger i = 0; i < kRandomPrefixCount; i++)
+    {
+        uint8_t length = 8 + random() % 25;
+        uint32_t mask = length ? 0xffffffffU << (32 - length) : 0;
+        uint32_t network = (((uint32_t)(random() % 4) + 10) << 24 | ((uint32_t)random() & 0xffffff)) & mask;
+        BOOL duplicate = NO;
+
+        for (NSUInteger j = 0; j < inserted; j++)
+        {
+            duplicate = duplicate || (networks[j] == network && lengths[j] == length);
+        }
+
+        if (duplicate)
+        {
+            continue;
+        }
+
+        networks[inserted] = network;
+        lengths[inserted] = length;
+        [self.trie insertPrefix:network length:length value:inserted];
+        inserted++;
+    }
+
+    XCTAssertEqual(self.trie.prefixCount, inserted);
+
+    for (NSUInteger i = 0; i < kRandomLookupCount; i++)
+    {
+        uint32_t address = (((uint32_t)(random() % 5) + 10) << 24) | ((uint32_t)random() & 0xffffff);
+        NSUInteger expectedValue = NSNotFound;
+        int expectedLength = -1;
+
+        for (NSUInteger j = 0; j < inserted; j++)
+        {
+            uint32_t mask = lengths[j] ? 0xffffffffU << (32 - lengths[j]) : 0;
+
+            if ((address & mask) == networks[j] && lengths[j] > expectedLength)
+            {
+                expectedValue = j;
+                expectedLength = lengths[j];
+            }
+        }
+
+        NSUInteger value = NSNotFound;
+        uint8_t length = 0;
+
+        if ( ! [self.trie longestMatchForAddress:address value:&value length:&length])
+        {
+            value = NSNotFound;
+        }
+
+        XCTAssertEqual(value, expectedValue, @"address %08x", address);
+
+        if (expectedValue != NSNotFound)
+        {
+            XCTAssertEqual(length, (uint8_t)expectedLength, @"address %08x", address);
+        }
+    }
+
+    for (NSUInteger j = 0; j < inserted; j++)
+    {
+        NSUInteger value = NSNotFound;
+
+        XCTAssertTrue([self.trie exactMatchForPrefix:networks[j] length:lengths[j] value:&value]);
+        XCTAssertEqual(value, j);
+    }
+}
+
+@end
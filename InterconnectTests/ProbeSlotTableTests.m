@@ -0,0 +1,135 @@
+//
+//  ProbeSlotTableTests.m
+//  InterconnectTests
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "ProbeSlotTable.h"
+#import "Probe.h"
+
+#define kSmallCapacity                  8
+#define kSmallFirstSlot                 5
+
+@interface ProbeSlotTableTests : XCTestCase
+
+@end
+
+@implementation ProbeSlotTableTests
+
+- (void)testSlotsAreHandedOutFromTheFirstSlotAndWrap
+{
+    ProbeSlotTable* table = [[ProbeSlotTable alloc] initWithCapacity:kSmallCapacity firstSlot:kSmallFirstSlot];
+    uint16_t slot;
+
+    for (NSUInteger i = 0; i < kSmallCapacity; i++)
+    {
+        Probe* probe = [[Probe alloc] init];
+
+        XCTAssertTrue([table allocateSlot:&slot forProbe:probe]);
+        XCTAssertEqual(slot, (uint16_t)((kSmallFirstSlot + i) % kSmallCapacity));
+        XCTAssertEqual([table probeInSlot:slot], probe);
+    }
+
+    XCTAssertEqual(table.count, (NSUInteger)kSmallCapacity);
+    XCTAssertFalse([table allocateSlot:&slot forProbe:[[Probe alloc] init]]);
+}
+
+/**
+ * A released slot goes to the back of the free list, behind every slot that was already free.
+ */
+- (void)testReleasedSlotsAreReusedLast
+{
+    ProbeSlotTable* table = [[ProbeSlotTable alloc] initWithCapacity:4 firstSlot:0];
+    uint16_t slot;
+
+    XCTAssertTrue([table allocateSlot:&slot forProbe:[[Probe alloc] init]]);        // 0
+    XCTAssertTrue([table allocateSlot:&slot forProbe:[[Probe alloc] init]]);        // 1
+
+    [table releaseSlot:0];
+    XCTAssertNil([table probeInSlot:0]);
+
+    XCTAssertTrue([table allocateSlot:&slot forProbe:[[Probe alloc] init]]);
+    XCTAssertEqual(slot, (uint16_t)2);
+    XCTAssertTrue([table allocateSlot:&slot forProbe:[[Probe alloc] init]]);
+    XCTAssertEqual(slot, (uint16_t)3);
+    XCTAssertTrue([table allocateSlot:&slot forProbe:[[Probe alloc] init]]);
+    XCTAssertEqual(slot, (uint16_t)0);
+    XCTAssertFalse([table allocateSlot:&slot forProbe:[[Probe alloc] init]]);
+
+    [table releaseSlot:3];
+    [table releaseSlot:1];
+
+    XCTAssertTrue([table allocateSlot:&slot forProbe:[[Probe alloc] init]]);
+    XCTAssertEqual(slot, (uint16_t)3);
+    XCTAssertTrue([table allocateSlot:&slot forProbe:[[Probe alloc] init]]);
+    XCTAssertEqual(slot, (uint16_t)1);
+}
+
+/**
+ * Releasing a slot that's free (or out of range) must not put it on the free list a second time.
+ */
+- (void)testReleasingAFreeSlotIsIgnored
+{
+    ProbeSlotTable* table = [[ProbeSlotTable alloc] initWithCapacity:2 firstSlot:0];
+    uint16_t first, second, third;
+
+    XCTAssertTrue([table allocateSlot:&first forProbe:[[Probe alloc] init]]);
+
+    [table releaseSlot:first];
+    [table releaseSlot:first];
+    [table releaseSlot:kSmallCapacity];
+
+    XCTAssertEqual(table.count, (NSUInteger)0);
+
+    XCTAssertTrue([table allocateSlot:&second forProbe:[[Probe alloc] init]]);
+    XCTAssertTrue([table allocateSlot:&third forProbe:[[Probe alloc] init]]);
+    XCTAssertNotEqual(second, third);
+    XCTAssertFalse([table allocateSlot:&third forProbe:[[Probe alloc] init]]);
+}
+
+/**
+ * The whole key space from a random first slot: every slot is handed out once, then after releasing them all (in an
+ * order of their own) they come back in that order.
+ */
+- (void)testEverySlotIsUsedOnceAtFullCapacity
+{
+    NSUInteger firstSlot = arc4random_uniform(kMaxProbeSlots);
+    ProbeSlotTable* table = [[ProbeSlotTable alloc] initWithCapacity:kMaxProbeSlots + 1 firstSlot:firstSlot];
+    NSMutableData* seenData = [NSMutableData dataWithLength:kMaxProbeSlots];
+    uint8_t* seen = [seenData mutableBytes];
+    Probe* probe = [[Probe alloc] init];
+    uint16_t slot;
+
+    XCTAssertEqual(table.capacity, (NSUInteger)kMaxProbeSlots);
+
+    for (NSUInteger i = 0; i < kMaxProbeSlots; i++)
+    {
+        XCTAssertTrue([table allocateSlot:&slot forProbe:probe]);
+        XCTAssertEqual(slot, (uint16_t)((firstSlot + i) % kMaxProbeSlots));
+        XCTAssertFalse(seen[slot]);
+        seen[slot] = 1;
+    }
+
+    XCTAssertFalse([table allocateSlot:&slot forProbe:probe]);
+
+    // Every seventh slot (coprime with the capacity, so each is released once)
+    for (NSUInteger i = 0; i < kMaxProbeSlots; i++)
+    {
+        [table releaseSlot:(uint16_t)(i * 7)];
+    }
+
+    XCTAssertEqual(table.count, (NSUInteger)0);
+
+    for (NSUInteger i = 0; i < kMaxProbeSlots; i++)
+    {
+        XCTAssertTrue([table allocateSlot:&slot forProbe:probe]);
+        XCTAssertEqual(slot, (uint16_t)(i * 7));
+    }
+
+    XCTAssertEqual(table.count, (NSUInteger)kMaxProbeSlots);
+}
+
+@end
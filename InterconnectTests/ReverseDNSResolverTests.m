@@ -0,0 +1,313 @@
+//
+//  ReverseDNSResolverTests.m
+//  InterconnectTests
+//
+//  Runs the resolver against a stub name server on the loopback interface whose answer to each query is scripted by
+//  the test (or dropped, to make the resolver retry).
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "ReverseDNSResolver.h"
+#import "PacketHeaders.h"
+#import <sys/socket.h>
+#import <netinet/in.h>
+#import <arpa/inet.h>
+
+#define kTestAddress                    @"192.0.2.1"
+#define kTestHostName                   @"stub.example.net"
+#define kRetryTimeoutSeconds            5           // the resolver waits 1.5 s before its first retry
+
+#pragma mark - Stub Name Server
+
+/**
+ * Returns the response to send for a query, or nil to drop it.
+ */
+typedef NSData* (^StubResponder)(NSData* query, NSUInteger queryNumber);
+
+@interface StubNameServer : NSObject
+
+@property (nonatomic, readonly) uint16_t port;
+@property (atomic, readonly) NSUInteger queryCount;
+@property (atomic, copy) StubResponder responder;
+@property (atomic) NSTimeInterval responseDelay;
+
+- (void)close;
+
+@end
+
+@implementation StubNameServer
+{
+    int _socket;
+    dispatch_queue_t _queue;
+    dispatch_source_t _readSource;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        struct sockaddr_in addr;
+        socklen_t addrLen = sizeof(addr);
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_len = sizeof(addr);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        _socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (_socket < 0 || bind(_socket, (struct sockaddr*)&addr, sizeof(addr)) < 0 || getsockname(_socket, (struct sockaddr*)&addr, &addrLen) < 0)
+        {
+            return nil;
+        }
+
+        _port = ntohs(addr.sin_port);
+        _queue = dispatch_queue_create("StubNameServer", DISPATCH_QUEUE_SERIAL);
+        _readSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, _socket, 0, _queue);
+
+        __weak StubNameServer* weakSelf = self;
+        dispatch_source_set_event_handler(_readSource, ^{
+            [weakSelf readQuery];
+        });
+        dispatch_resume(_readSource);
+    }
+
+    return self;
+}
+
+- (void)close
+{
+    dispatch_source_cancel(_readSource);
+    dispatch_sync(_queue, ^{});
+    close(_socket);
+}
+
+- (void)readQuery
+{
+    uint8_t buffer[1500];
+    struct sockaddr_in from;
+    socklen_t fromLen = sizeof(from);
+    ssize_t bytesRead = recvfrom(_socket, buffer, sizeof(buffer), 0, (struct sockaddr*)&from, &fromLen);
+
+    if (bytesRead < (ssize_t)sizeof(struct hdr_dns))
+    {
+        return;
+    }
+
+    NSUInteger queryNumber = ++_queryCount;
+    NSData* response = self.responder([NSData dataWithBytes:buffer length:bytesRead], queryNumber);
+
+    if ( ! response)
+    {
+        return;
+    }
+
+    int socket = _socket;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.responseDelay * NSEC_PER_SEC)), _queue, ^{
+        sendto(socket, [response bytes], [response length], 0, (struct sockaddr*)&from, fromLen);
+    });
+}
+
+/**
+ * A response echoing the query's identifier and question, with rcode and (if rdata is given) one PTR answer whose
+ * owner name points back at the question.
+ */
++ (NSData*)responseToQuery:(NSData*)query rcode:(uint16_t)rcode answerData:(NSData*)rdata
+{
+    NSMutableData* response = [query mutableCopy];
+    struct hdr_dns* dnsHdr = (struct hdr_dns*)[response mutableBytes];
+
+    dnsHdr->dns_flags = htons(DNS_FLAG_QR | DNS_FLAG_RD | rcode);
+    dnsHdr->dns_ancount = htons(rdata ? 1 : 0);
+
+    if (rdata)
+    {
+        uint8_t answer[12] = { 0xc0, sizeof(struct hdr_dns), 0, DNS_TYPE_PTR, 0, DNS_CLASS_IN, 0, 0, 0x0e, 0x10, 0, 0 };
+        answer[10] = [rdata length] >> 8;
+        answer[11] = [rdata length] & 0xff;
+
+        [response appendBytes:answer length:sizeof(answer)];
+        [response appendData:rdata];
+    }
+
+    return response;
+}
+
++ (NSData*)encodedName:(NSString*)name
+{
+    NSMutableData* encoded = [NSMutableData data];
+
+    for (NSString* label in [name componentsSeparatedByString:@"."])
+    {
+        uint8_t labelLen = label.length;
+        [encoded appendBytes:&labelLen length:1];
+        [encoded appendData:[label dataUsingEncoding:NSASCIIStringEncoding]];
+    }
+
+    uint8_t rootLabel = 0;
+    [encoded appendBytes:&rootLabel length:1];
+
+    return encoded;
+}
+
+@end
+
+#pragma mark - Tests
+
+@interface ReverseDNSResolverTests : XCTestCase
+
+@property (nonatomic, strong) StubNameServer* nameServer;
+@property (nonatomic, strong) ReverseDNSResolver* resolver;
+
+@end
+
+@implementation ReverseDNSResolverTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.nameServer = [[StubNameServer alloc] init];
+    XCTAssertNotNil(self.nameServer);
+
+    self.resolver = [[ReverseDNSResolver alloc] initWithNameServer:@"127.0.0.1" port:self.nameServer.port];
+    XCTAssertNotNil(self.resolver);
+    [self.resolver start];
+}
+
+- (void)tearDown
+{
+    XCTestExpectation* stopped = [self expectationWithDescription:@"resolver stopped"];
+
+    [self.resolver stop:^{
+        [stopped fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:kRetryTimeoutSeconds handler:nil];
+    [self.nameServer close];
+
+    [super tearDown];
+}
+
+/**
+ * Resolve kTestAddress and return the host name the completion block was given ([NSNull null] for nil).
+ */
+- (id)resolveTestAddress
+{
+    XCTestExpectation* resolved = [self expectationWithDescription:@"resolved"];
+    __block id result = nil;
+
+    [self.resolver resolveHostNameForIPAddress:kTestAddress onCompletion:^(NSString* ipAddress, NSString* hostName) {
+        XCTAssertEqualObjects(ipAddress, kTestAddress);
+        result = hostName ? hostName : [NSNull null];
+        [resolved fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:kRetryTimeoutSeconds handler:nil];
+
+    return result;
+}
+
+- (void)testAnswerIsResolved
+{
+    self.nameServer.responder = ^NSData*(NSData* query, NSUInteger queryNumber) {
+        return [StubNameServer responseToQuery:query rcode:DNS_RCODE_NOERROR answerData:[StubNameServer encodedName:kTestHostName]];
+    };
+
+    XCTAssertEqualObjects([self resolveTestAddress], kTestHostName);
+}
+
+- (void)testUnansweredQueryIsRetriedUnderANewIdentifier
+{
+    __block uint16_t firstIdentifier = 0, secondIdentifier = 0;
+
+    self.nameServer.responder = ^NSData*(NSData* query, NSUInteger queryNumber) {
+        uint16_t identifier = ntohs(((const struct hdr_dns*)[query bytes])->dns_id);
+
+        if (queryNumber == 1)
+        {
+            firstIdentifier = identifier;
+            return nil;
+        }
+
+        secondIdentifier = identifier;
+        return [StubNameServer responseToQuery:query rcode:DNS_RCODE_NOERROR answerData:[StubNameServer encodedName:kTestHostName]];
+    };
+
+    XCTAssertEqualObjects([self resolveTestAddress], kTestHostName);
+    XCTAssertEqual(self.nameServer.queryCount, (NSUInteger)2);
+    XCTAssertNotEqual(firstIdentifier, secondIdentifier);
+}
+
+- (void)testNXDomainIsNegativelyCached
+{
+    self.nameServer.responder = ^NSData*(NSData* query, NSUInteger queryNumber) {
+        return [StubNameServer responseToQuery:query rcode:DNS_RCODE_NXDOMAIN answerData:nil];
+    };
+
+    XCTAssertEqualObjects([self resolveTestAddress], @"");
+    XCTAssertEqualObjects([self resolveTestAddress], @"");
+    XCTAssertEqual(self.nameServer.queryCount, (NSUInteger)1);
+}
+
+- (void)testServFailIsNotCached
+{
+    self.nameServer.responder = ^NSData*(NSData* query, NSUInteger queryNumber) {
+        if (queryNumber == 1)
+        {
+            return [StubNameServer responseToQuery:query rcode:DNS_RCODE_SERVFAIL answerData:nil];
+        }
+
+        return [StubNameServer responseToQuery:query rcode:DNS_RCODE_NOERROR answerData:[StubNameServer encodedName:kTestHostName]];
+    };
+
+    XCTAssertEqualObjects([self resolveTestAddress], [NSNull null]);
+    XCTAssertEqualObjects([self resolveTestAddress], kTestHostName);
+    XCTAssertEqual(self.nameServer.queryCount, (NSUInteger)2);
+}
+
+/**
+ * A label followed by a pointer back to itself would otherwise read as "loop.loop.loop..." until the jump limit.
+ */
+- (void)testCompressionLoopIsNotReadAsAName
+{
+    self.nameServer.responder = ^NSData*(NSData* query, NSUInteger queryNumber) {
+        NSData* response = [StubNameServer responseToQuery:query rcode:DNS_RCODE_NOERROR answerData:[NSData dataWithBytes:"\x04loop\xc0\x00" length:7]];
+        NSMutableData* looped = [response mutableCopy];
+        size_t rdataOffset = [looped length] - 7;
+
+        ((uint8_t*)[looped mutableBytes])[rdataOffset + 6] = rdataOffset;
+
+        return looped;
+    };
+
+    XCTAssertEqualObjects([self resolveTestAddress], @"");
+}
+
+- (void)testConcurrentRequestsShareOneQuery
+{
+    XCTestExpectation* firstResolved = [self expectationWithDescription:@"first resolved"];
+    XCTestExpectation* secondResolved = [self expectationWithDescription:@"second resolved"];
+
+    self.nameServer.responseDelay = 0.2;
+    self.nameServer.responder = ^NSData*(NSData* query, NSUInteger queryNumber) {
+        return [StubNameServer responseToQuery:query rcode:DNS_RCODE_NOERROR answerData:[StubNameServer encodedName:kTestHostName]];
+    };
+
+    [self.resolver resolveHostNameForIPAddress:kTestAddress onCompletion:^(NSString* ipAddress, NSString* hostName) {
+        XCTAssertEqualObjects(hostName, kTestHostName);
+        [firstResolved fulfill];
+    }];
+
+    [self.resolver resolveHostNameForIPAddress:kTestAddress onCompletion:^(NSString* ipAddress, NSString* hostName) {
+        XCTAssertEqualObjects(hostName, kTestHostName);
+        [secondResolved fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:kRetryTimeoutSeconds handler:nil];
+    XCTAssertEqual(self.nameServer.queryCount, (NSUInteger)1);
+}
+
+@end
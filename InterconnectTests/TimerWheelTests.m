@@ -0,0 +1,199 @@
+//
+//  TimerWheelTests.m
+//  InterconnectTests
+//
+//  The wheel is turned by a clock the tests set, so deadlines in every level (and beyond the wheel's span) are reached
+//  in moments. Each timer's context is its index in the test, the handler records when each one fired.
+//
+//  Created by agent on 19/10/2026.
+//  Copyright © 2026 oroboto. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "TimerWheel.h"
+
+#define kLevel1Ticks                    256             // a level 0 wrap
+#define kLevel2Ticks                    65536           // a level 1 wrap
+#define kWheelSpanTicks                 16777216        // deadlines beyond this are parked in the last level
+#define kClockStepMs                    997             // not a multiple of any level's span, so wraps land mid step
+
+@interface TimerWheel (Testing)
+
+- (uint64_t)nowMs;
+
+@end
+
+/**
+ * A wheel whose clock only moves when the test moves it.
+ */
+@interface ManualClockTimerWheel : TimerWheel
+
+@property (nonatomic) uint64_t clockMs;
+
+@end
+
+@implementation ManualClockTimerWheel
+
+- (uint64_t)nowMs
+{
+    return self.clockMs;
+}
+
+@end
+
+@interface TimerWheelTests : XCTestCase
+
+@property (nonatomic, strong) ManualClockTimerWheel* wheel;
+@property (nonatomic, strong) NSMutableDictionary* firedAt;     // context -> array of clock times it fired at
+
+@end
+
+@implementation TimerWheelTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    __weak TimerWheelTests* weakSelf = self;
+
+    self.firedAt = [NSMutableDictionary dictionary];
+    self.wheel = [[ManualClockTimerWheel alloc] initWithHandler:^(uint32_t key, uint32_t context) {
+        TimerWheelTests* strongSelf = weakSelf;
+        NSMutableArray* times = strongSelf.firedAt[@(context)];
+
+        if ( ! times)
+        {
+            times = strongSelf.firedAt[@(context)] = [NSMutableArray array];
+        }
+
+        [times addObject:@(strongSelf.wheel.clockMs)];
+    }];
+}
+
+/**
+ * Move the clock on in steps, advancing the wheel after each.
+ */
+- (void)advanceToMs:(uint64_t)clockMs stepMs:(uint64_t)stepMs
+{
+    while (self.wheel.clockMs < clockMs)
+    {
+        self.wheel.clockMs = MIN(self.wheel.clockMs + stepMs, clockMs);
+        [self.wheel advance];
+    }
+}
+
+- (void)testTimersInEveryLevelFireOnceAtOrAfterTheirDeadline
+{
+    const uint32_t delays[] = {
+        1, 2, kLevel1Ticks - 1, kLevel1Ticks, kLevel1Ticks + 1, 1000,
+        kLevel2Ticks - 1, kLevel2Ticks, kLevel2Ticks + 1, 3 * kLevel2Ticks + 17,
+        kWheelSpanTicks - 1, kWheelSpanTicks, kWheelSpanTicks + 1, kWheelSpanTicks + 3 * kLevel2Ticks + 5
+    };
+    const size_t timerCount = sizeof(delays) / sizeof(delays[0]);
+    uint32_t lastDelay = 0;
+
+    for (uint32_t i = 0; i < timerCount; i++)
+    {
+        XCTAssertNotEqual([self.wheel scheduleAfterMs:delays[i] key:0 context:i], (TimerWheelHandle)0);
+        lastDelay = MAX(lastDelay, delays[i]);
+    }
+
+    XCTAssertEqual(self.wheel.count, timerCount);
+
+    [self advanceToMs:lastDelay + kClockStepMs stepMs:kClockStepMs];
+
+    XCTAssertEqual(self.wheel.count, (NSUInteger)0);
+
+    for (uint32_t i = 0; i < timerCount; i++)
+    {
+        NSArray* times = self.firedAt[@(i)];
+
+        XCTAssertEqual(times.count, (NSUInteger)1, @"timer due after %u ms", delays[i]);
+
+        // Fired by the first advance that reached the deadline
+        uint64_t firedAt = [times.firstObject unsignedLongLongValue];
+        XCTAssertGreaterThanOrEqual(firedAt, (uint64_t)delays[i], @"timer due after %u ms", delays[i]);
+        XCTAssertLessThan(firedAt, (uint64_t)delays[i] + kClockStepMs, @"timer due after %u ms", delays[i]);
+    }
+}
+
+/**
+ * Scheduled partway through the wheel's turn, so deadlines fall at different offsets within each level's slots. Two
+ * fall exactly on a level wrap, so they cascade down on the tick they're due.
+ */
+- (void)testTimersScheduledMidTurnFireAtTheirDeadline
+{
+    const uint32_t delays[] = {
+        300,
+        356,                        // the level 0 wrap at 257 * 256
+        kLevel2Ticks + 300,
+        kLevel2Ticks + 100,         // the level 1 wrap at 2 * kLevel2Ticks
+        5 * kLevel2Ticks
+    };
+    const size_t timerCount = sizeof(delays) / sizeof(delays[0]);
+
+    [self advanceToMs:kLevel2Ticks - 100 stepMs:kClockStepMs];
+    uint64_t scheduledAt = self.wheel.clockMs;     // kLevel2Ticks - 100
+
+    for (uint32_t i = 0; i < timerCount; i++)
+    {
+        [self.wheel scheduleAfterMs:delays[i] key:0 context:i];
+    }
+
+    // Every millisecond, so each timer must fire exactly at its deadline
+    [self advanceToMs:scheduledAt + 5 * kLevel2Ticks stepMs:1];
+
+    for (uint32_t i = 0; i < timerCount; i++)
+    {
+        NSArray* times = self.firedAt[@(i)];
+
+        XCTAssertEqual(times.count, (NSUInteger)1, @"timer due after %u ms", delays[i]);
+        XCTAssertEqual([times.firstObject unsignedLongLongValue], scheduledAt + delays[i], @"timer due after %u ms", delays[i]);
+    }
+}
+
+- (void)testAlreadyDueTimerFiresOnTheNextTick
+{
+    [self.wheel scheduleAfterMs:0 key:0 context:0];
+    [self.wheel advance];
+
+    XCTAssertNil(self.firedAt[@0]);
+
+    [self advanceToMs:1 stepMs:1];
+
+    XCTAssertEqual([self.firedAt[@0] count], (NSUInteger)1);
+}
+
+- (void)testCancelledTimerNeverFires
+{
+    TimerWheelHandle handle = [self.wheel scheduleAfterMs:kLevel2Ticks + 1 key:0 context:0];
+
+    [self advanceToMs:kLevel2Ticks - 1 stepMs:kClockStepMs];
+    [self.wheel cancel:handle];
+    [self advanceToMs:2 * kLevel2Ticks stepMs:kClockStepMs];
+
+    XCTAssertNil(self.firedAt[@0]);
+    XCTAssertEqual(self.wheel.count, (NSUInteger)0);
+}
+
+/**
+ * A handle whose timer has fired refers to an entry that's since been reused, cancelling it must leave the new timer be.
+ */
+- (void)testCancellingAStaleHandleLeavesTheReusedEntryScheduled
+{
+    TimerWheelHandle firedHandle = [self.wheel scheduleAfterMs:10 key:0 context:0];
+
+    [self advanceToMs:10 stepMs:1];
+    XCTAssertEqual([self.firedAt[@0] count], (NSUInteger)1);
+
+    TimerWheelHandle reusedHandle = [self.wheel scheduleAfterMs:10 key:0 context:1];
+    XCTAssertEqual((uint32_t)reusedHandle, (uint32_t)firedHandle);       // same entry, new generation
+
+    [self.wheel cancel:firedHandle];
+    [self advanceToMs:20 stepMs:1];
+
+    XCTAssertEqual([self.firedAt[@0] count], (NSUInteger)1);
+    XCTAssertEqual([self.firedAt[@1] count], (NSUInteger)1);
+}
+
+@end